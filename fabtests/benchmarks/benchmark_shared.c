@@ -79,8 +79,22 @@ void ft_benchmark_usage(void)
 			"# of iterations > window size");
 }
 
+/* Each sample is the time since the previous iteration ended */
+static inline void pingpong_sample(uint64_t *samples, int i, uint64_t *last)
+{
+	uint64_t now;
+
+	if (!samples || i < opts.warmup_iterations)
+		return;
+
+	now = ft_gettime_ns();
+	samples[i - opts.warmup_iterations] = now - *last;
+	*last = now;
+}
+
 int pingpong(void)
 {
+	uint64_t *samples = NULL, last = 0;
 	int ret, i, inject_size;
 
 	inject_size = inject_size_set ?
@@ -89,52 +103,77 @@ int pingpong(void)
 	if (opts.options & FT_OPT_ENABLE_HMEM)
 		inject_size = 0;
 
+	if (ft_check_opts(FT_OPT_LAT_SAMPLES)) {
+		samples = calloc(opts.iterations, sizeof(*samples));
+		if (!samples)
+			return -FI_ENOMEM;
+	}
+
 	ret = ft_sync();
 	if (ret)
-		return ret;
+		goto out;
 
 	if (opts.dst_addr) {
 		for (i = 0; i < opts.iterations + opts.warmup_iterations; i++) {
-			if (i == opts.warmup_iterations)
+			if (i == opts.warmup_iterations) {
 				ft_start();
+				last = ft_gettime_ns();
+			}
 
 			if (opts.transfer_size < inject_size)
 				ret = ft_inject(ep, remote_fi_addr, opts.transfer_size);
 			else
 				ret = ft_tx(ep, remote_fi_addr, opts.transfer_size, &tx_ctx);
 			if (ret)
-				return ret;
+				goto out;
 
 			ret = ft_rx(ep, opts.transfer_size);
 			if (ret)
-				return ret;
+				goto out;
+
+			pingpong_sample(samples, i, &last);
 		}
 	} else {
 		for (i = 0; i < opts.iterations + opts.warmup_iterations; i++) {
-			if (i == opts.warmup_iterations)
+			if (i == opts.warmup_iterations) {
 				ft_start();
+				last = ft_gettime_ns();
+			}
 
 			ret = ft_rx(ep, opts.transfer_size);
 			if (ret)
-				return ret;
+				goto out;
 
 			if (opts.transfer_size < inject_size)
 				ret = ft_inject(ep, remote_fi_addr, opts.transfer_size);
 			else
 				ret = ft_tx(ep, remote_fi_addr, opts.transfer_size, &tx_ctx);
 			if (ret)
-				return ret;
+				goto out;
+
+			pingpong_sample(samples, i, &last);
 		}
 	}
 	ft_stop();
 
+	if (ft_check_opts(FT_OPT_JSON)) {
+		ret = show_perf_json(NULL, opts.transfer_size, opts.iterations,
+				     &start, &end, 2, samples);
+		goto out;
+	}
+
 	if (opts.machr)
 		show_perf_mr(opts.transfer_size, opts.iterations, &start, &end, 2,
 				opts.argc, opts.argv);
 	else
 		show_perf(NULL, opts.transfer_size, opts.iterations, &start, &end, 2);
 
-	return 0;
+	if (samples)
+		ret = show_perf_lat(opts.transfer_size, samples,
+				    opts.iterations, 2);
+out:
+	free(samples);
+	return ret;
 }
 
 static int bw_tx_comp()
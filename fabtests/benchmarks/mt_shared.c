@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include <shared.h>
+#include "mt_shared.h"
+
+/*
+ * Threads drive data endpoints opened next to the control endpoint set up
+ * by ft_init_fabric.  Thread i uses endpoint i / threads_per_ep and talks
+ * to thread i of the peer over the matching remote endpoint, with the
+ * thread index as tag.  Completion queues are either one per endpoint or
+ * one shared by every endpoint.  They are read by the threads waiting for
+ * completions, or only by a dedicated progress thread.
+ *
+ * Both sides must use the same thread count and threads per endpoint.
+ * Each message size is run with 1, 2, 4, ... threads up to the maximum.
+ */
+
+#define MT_CQ_BATCH	16
+#define MT_ACK_TAG	(1ULL << 32)
+
+struct mt_thread;
+
+struct mt_ctx {
+	struct fi_context2	context;
+	struct mt_thread	*thread;
+};
+
+struct mt_thread {
+	int			id;
+	pthread_t		tid;
+	struct fid_ep		*ep;
+	struct fid_cq		*cq;
+	fi_addr_t		addr;
+	char			*tx_buf;
+	char			*rx_buf;
+	struct mt_ctx		*tx_ctx;
+	struct mt_ctx		*rx_ctx;
+	uint64_t		tx_cnt;
+	uint64_t		rx_cnt;
+	uint64_t		tx_posted;
+	uint64_t		rx_posted;
+	uint64_t		nsec;
+};
+
+static int thread_cnt = 1, threads_per_ep = 1, ep_cnt, cq_cnt;
+static int shared_cq, progress_thread;
+static enum mt_test test_type;
+
+static struct fid_ep **mt_eps;
+static struct fid_cq **mt_cqs;
+static fi_addr_t *mt_addrs;
+static struct fi_info *mt_info;
+static struct mt_thread *threads;
+static struct fid_mr *mt_mr;
+static void *mt_desc;
+static char *mt_buf;
+static size_t mt_buf_size;
+
+static int active_cnt, active_cqs, go, stop, progress_ret;
+static pthread_t progress_tid;
+
+int mt_parse_opts(int op, char *optarg)
+{
+	switch (op) {
+	case 'n':
+		thread_cnt = atoi(optarg);
+		break;
+	case 'T':
+		threads_per_ep = atoi(optarg);
+		break;
+	case 'q':
+		if (!strcasecmp(optarg, "shared")) {
+			shared_cq = 1;
+		} else if (!strcasecmp(optarg, "ep")) {
+			shared_cq = 0;
+		} else {
+			FT_ERR("unknown CQ mode %s", optarg);
+			return -FI_EINVAL;
+		}
+		break;
+	case 'R':
+		progress_thread = 1;
+		break;
+	default:
+		return -FI_EINVAL;
+	}
+	return 0;
+}
+
+void mt_usage(void)
+{
+	FT_PRINT_OPTS_USAGE("-n <threads>", "maximum number of threads, "
+			    "runs 1, 2, 4, ... up to it (default 1)");
+	FT_PRINT_OPTS_USAGE("-T <threads>", "threads per endpoint (default 1)");
+	FT_PRINT_OPTS_USAGE("-q <mode>", "CQ mode: ep (one per endpoint, "
+			    "default) or shared (one for all endpoints)");
+	FT_PRINT_OPTS_USAGE("-R", "read CQs only from a separate progress "
+			    "thread");
+}
+
+static int mt_read_cq(struct fid_cq *cq)
+{
+	struct fi_cq_tagged_entry comp[MT_CQ_BATCH];
+	struct mt_thread *thread;
+	ssize_t ret, i;
+
+	ret = fi_cq_read(cq, comp, MT_CQ_BATCH);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret == -FI_EAVAIL)
+		return ft_cq_readerr(cq);
+	if (ret < 0) {
+		FT_PRINTERR("fi_cq_read", ret);
+		return (int) ret;
+	}
+
+	/* The completion may belong to any thread using this CQ */
+	for (i = 0; i < ret; i++) {
+		thread = ((struct mt_ctx *) comp[i].op_context)->thread;
+		__atomic_add_fetch(comp[i].flags & FI_SEND ? &thread->tx_cnt :
+				   &thread->rx_cnt, 1, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static int mt_progress(struct mt_thread *thread)
+{
+	int ret;
+
+	if (!progress_thread)
+		return mt_read_cq(thread->cq);
+
+	ret = __atomic_load_n(&progress_ret, __ATOMIC_ACQUIRE);
+	return ret;
+}
+
+static int mt_wait(struct mt_thread *thread, uint64_t *cnt, uint64_t target)
+{
+	int ret;
+
+	while (__atomic_load_n(cnt, __ATOMIC_ACQUIRE) < target) {
+		ret = mt_progress(thread);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int mt_post(struct mt_thread *thread, int tx, size_t len, uint64_t tag,
+		   struct mt_ctx *ctx)
+{
+	ssize_t ret;
+
+	for (;;) {
+		if (tx)
+			ret = fi_tsend(thread->ep, thread->tx_buf, len, mt_desc,
+				       thread->addr, tag, ctx);
+		else
+			ret = fi_trecv(thread->ep, thread->rx_buf, len, mt_desc,
+				       FI_ADDR_UNSPEC, tag, 0, ctx);
+		if (!ret)
+			break;
+
+		if (ret != -FI_EAGAIN) {
+			if (tx)
+				FT_PRINTERR("fi_tsend", ret);
+			else
+				FT_PRINTERR("fi_trecv", ret);
+			return (int) ret;
+		}
+
+		ret = mt_progress(thread);
+		if (ret)
+			return (int) ret;
+	}
+
+	if (tx)
+		thread->tx_posted++;
+	else
+		thread->rx_posted++;
+	return 0;
+}
+
+/* Windows of sends, with one acknowledgement when every window is done */
+static int mt_bw(struct mt_thread *thread)
+{
+	uint64_t start = 0;
+	int i, j, cnt, ret;
+
+	if (opts.dst_addr) {
+		ret = mt_post(thread, 0, 0, MT_ACK_TAG | thread->id,
+			      &thread->rx_ctx[0]);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < opts.iterations + opts.warmup_iterations; i += cnt) {
+		if (i == opts.warmup_iterations)
+			start = ft_gettime_ns();
+
+		cnt = MIN(opts.window_size, opts.warmup_iterations > i ?
+			  opts.warmup_iterations - i :
+			  opts.iterations + opts.warmup_iterations - i);
+
+		for (j = 0; j < cnt; j++) {
+			if (opts.dst_addr)
+				ret = mt_post(thread, 1, opts.transfer_size,
+					      thread->id, &thread->tx_ctx[j]);
+			else
+				ret = mt_post(thread, 0, opts.transfer_size,
+					      thread->id, &thread->rx_ctx[j]);
+			if (ret)
+				return ret;
+		}
+
+		if (opts.dst_addr)
+			ret = mt_wait(thread, &thread->tx_cnt,
+				      thread->tx_posted);
+		else
+			ret = mt_wait(thread, &thread->rx_cnt,
+				      thread->rx_posted);
+		if (ret)
+			return ret;
+	}
+
+	if (opts.dst_addr) {
+		ret = mt_wait(thread, &thread->rx_cnt, thread->rx_posted);
+	} else {
+		ret = mt_post(thread, 1, 0, MT_ACK_TAG | thread->id,
+			      &thread->tx_ctx[0]);
+		if (!ret)
+			ret = mt_wait(thread, &thread->tx_cnt,
+				      thread->tx_posted);
+	}
+
+	thread->nsec = ft_gettime_ns() - start;
+	return ret;
+}
+
+static int mt_pingpong(struct mt_thread *thread)
+{
+	uint64_t start = 0;
+	int i, ret;
+
+	for (i = 0; i < opts.iterations + opts.warmup_iterations; i++) {
+		if (i == opts.warmup_iterations)
+			start = ft_gettime_ns();
+
+		ret = mt_post(thread, 0, opts.transfer_size, thread->id,
+			      &thread->rx_ctx[0]);
+		if (ret)
+			return ret;
+
+		if (opts.dst_addr) {
+			ret = mt_post(thread, 1, opts.transfer_size,
+				      thread->id, &thread->tx_ctx[0]);
+			if (ret)
+				return ret;
+
+			ret = mt_wait(thread, &thread->rx_cnt,
+				      thread->rx_posted);
+		} else {
+			ret = mt_wait(thread, &thread->rx_cnt,
+				      thread->rx_posted);
+			if (ret)
+				return ret;
+
+			ret = mt_post(thread, 1, opts.transfer_size,
+				      thread->id, &thread->tx_ctx[0]);
+		}
+		if (ret)
+			return ret;
+
+		ret = mt_wait(thread, &thread->tx_cnt, thread->tx_posted);
+		if (ret)
+			return ret;
+	}
+
+	thread->nsec = ft_gettime_ns() - start;
+	return 0;
+}
+
+static void *mt_thread_func(void *arg)
+{
+	struct mt_thread *thread = arg;
+
+	while (!__atomic_load_n(&go, __ATOMIC_ACQUIRE))
+		;
+
+	return (void *) (intptr_t) (test_type == MT_BW ?
+				    mt_bw(thread) : mt_pingpong(thread));
+}
+
+static void *mt_progress_func(void *arg)
+{
+	int i, ret = 0;
+
+	while (!ret && !__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+		for (i = 0; i < active_cqs && !ret; i++)
+			ret = mt_read_cq(mt_cqs[i]);
+	}
+
+	__atomic_store_n(&progress_ret, ret ? ret : -FI_ECANCELED,
+			 __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void mt_show(double *base_rate)
+{
+	static int header = 1;
+	uint64_t nsec = 0, sum = 0;
+	char str[FT_STR_LEN];
+	int i, eps, xfers_per_iter;
+	double rate, lat, scaling;
+
+	for (i = 0; i < active_cnt; i++) {
+		nsec = MAX(nsec, threads[i].nsec);
+		sum += threads[i].nsec;
+	}
+
+	xfers_per_iter = test_type == MT_PINGPONG ? 2 : 1;
+	rate = nsec ? (double) active_cnt * opts.iterations * xfers_per_iter *
+		      1000 / nsec : 0;
+	if (active_cnt == 1)
+		*base_rate = rate;
+
+	/* Latency is averaged over all threads */
+	lat = (double) sum / 1000.0 / active_cnt / opts.iterations /
+	      xfers_per_iter;
+	scaling = *base_rate ? rate / (*base_rate * active_cnt) : 0;
+	eps = (active_cnt + threads_per_ep - 1) / threads_per_ep;
+
+	if (ft_check_opts(FT_OPT_JSON)) {
+		ft_json_begin(NULL, opts.transfer_size, opts.iterations);
+		printf(", \"threads\": %d, \"eps\": %d, \"cq\": \"%s\", "
+		       "\"progress_thread\": %s, \"time_sec\": %f, "
+		       "\"MB_per_sec\": %f, \"Mmsgs_per_sec\": %f, "
+		       "\"usec_per_xfer\": %f, \"scaling\": %f",
+		       active_cnt, eps, shared_cq ? "shared" : "ep",
+		       progress_thread ? "true" : "false", nsec / 1e9,
+		       rate * opts.transfer_size, rate, lat, scaling);
+		ft_json_end();
+		return;
+	}
+
+	if (header) {
+		printf("%-8s%-5s%-8s%-8s%8s %10s%13s%13s%10s\n",
+		       "threads", "eps", "bytes", "iters", "time", "MB/sec",
+		       "Mmsgs/sec", "usec/xfer", "scaling");
+		header = 0;
+	}
+
+	printf("%-8d", active_cnt);
+	printf("%-5d", eps);
+	printf("%-8s", size_str(str, opts.transfer_size));
+	printf("%-8s", cnt_str(str, opts.iterations));
+	printf("%8.2fs%10.2f%13.3f%13.2f%10.2f\n", nsec / 1e9,
+	       rate * opts.transfer_size, rate, lat, scaling);
+}
+
+static int mt_run_step(int cnt)
+{
+	void *thread_ret;
+	int i, ret, started = 0;
+
+	active_cnt = cnt;
+	active_cqs = shared_cq ? 1 : (cnt + threads_per_ep - 1) / threads_per_ep;
+	go = 0;
+	stop = 0;
+	progress_ret = 0;
+
+	ret = ft_sync();
+	if (ret)
+		return ret;
+
+	if (progress_thread) {
+		ret = pthread_create(&progress_tid, NULL, mt_progress_func,
+				     NULL);
+		if (ret) {
+			FT_PRINTERR("pthread_create", -ret);
+			return -ret;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		ret = pthread_create(&threads[i].tid, NULL, mt_thread_func,
+				     &threads[i]);
+		if (ret) {
+			FT_PRINTERR("pthread_create", -ret);
+			ret = -ret;
+			break;
+		}
+		started++;
+	}
+
+	/* Unblock the threads even on failure so that they can be joined */
+	__atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i].tid, &thread_ret);
+		if (!ret)
+			ret = (int) (intptr_t) thread_ret;
+	}
+
+	if (progress_thread) {
+		__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+		pthread_join(progress_tid, NULL);
+	}
+	return ret;
+}
+
+static int mt_run_size(void)
+{
+	double base_rate = 0;
+	int cnt, ret;
+
+	for (cnt = 1; ; cnt = MIN(cnt * 2, thread_cnt)) {
+		ret = mt_run_step(cnt);
+		if (ret)
+			return ret;
+
+		mt_show(&base_rate);
+		if (cnt == thread_cnt)
+			break;
+	}
+	return 0;
+}
+
+static int mt_open_ep(int idx)
+{
+	int ret;
+
+	ret = fi_endpoint(domain, mt_info, &mt_eps[idx], NULL);
+	if (ret) {
+		FT_PRINTERR("fi_endpoint", ret);
+		return ret;
+	}
+
+	return ft_enable_ep(mt_eps[idx], eq, av, mt_cqs[shared_cq ? 0 : idx],
+			    mt_cqs[shared_cq ? 0 : idx], NULL, NULL);
+}
+
+static int mt_alloc_res(void)
+{
+	struct fi_cq_attr attr = {
+		.format = FI_CQ_FORMAT_TAGGED,
+		.wait_obj = FI_WAIT_NONE,
+	};
+	struct fi_info *mt_hints;
+	size_t size;
+	int i, ret;
+
+	/* Data endpoints need their own addresses, not the control port */
+	mt_hints = fi_dupinfo(fi);
+	if (!mt_hints)
+		return -FI_ENOMEM;
+
+	free(mt_hints->src_addr);
+	mt_hints->src_addr = NULL;
+	mt_hints->src_addrlen = 0;
+	ret = fi_getinfo(FT_FIVERSION, opts.src_addr, NULL, 0, mt_hints,
+			 &mt_info);
+	fi_freeinfo(mt_hints);
+	if (ret) {
+		FT_PRINTERR("fi_getinfo", ret);
+		return ret;
+	}
+
+	mt_eps = calloc(ep_cnt, sizeof(*mt_eps));
+	mt_cqs = calloc(cq_cnt, sizeof(*mt_cqs));
+	mt_addrs = calloc(ep_cnt, sizeof(*mt_addrs));
+	threads = calloc(thread_cnt, sizeof(*threads));
+	if (!mt_eps || !mt_cqs || !mt_addrs || !threads)
+		return -FI_ENOMEM;
+
+	attr.size = (fi->tx_attr->size + fi->rx_attr->size) *
+		    (shared_cq ? ep_cnt : 1);
+	for (i = 0; i < cq_cnt; i++) {
+		ret = fi_cq_open(domain, &attr, &mt_cqs[i], NULL);
+		if (ret) {
+			FT_PRINTERR("fi_cq_open", ret);
+			return ret;
+		}
+	}
+
+	for (i = 0; i < ep_cnt; i++) {
+		ret = mt_open_ep(i);
+		if (ret)
+			return ret;
+	}
+
+	size = opts.options & FT_OPT_SIZE ? opts.transfer_size :
+	       test_size[TEST_CNT - 1].size;
+	size = MIN(size, fi->ep_attr->max_msg_size);
+	mt_buf_size = size * 2 * thread_cnt;
+	mt_buf = calloc(1, mt_buf_size);
+	if (!mt_buf)
+		return -FI_ENOMEM;
+
+	ret = ft_reg_mr(fi, mt_buf, mt_buf_size, ft_info_to_mr_access(fi),
+			FT_MR_KEY + 1, &mt_mr, &mt_desc);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].id = i;
+		threads[i].ep = mt_eps[i / threads_per_ep];
+		threads[i].cq = mt_cqs[shared_cq ? 0 : i / threads_per_ep];
+		threads[i].tx_buf = mt_buf + size * 2 * i;
+		threads[i].rx_buf = threads[i].tx_buf + size;
+		threads[i].tx_ctx = calloc(opts.window_size,
+					   sizeof(*threads[i].tx_ctx));
+		threads[i].rx_ctx = calloc(opts.window_size,
+					   sizeof(*threads[i].rx_ctx));
+		if (!threads[i].tx_ctx || !threads[i].rx_ctx)
+			return -FI_ENOMEM;
+	}
+	return 0;
+}
+
+static void mt_free_res(void)
+{
+	int i;
+
+	if (threads) {
+		for (i = 0; i < thread_cnt; i++) {
+			free(threads[i].tx_ctx);
+			free(threads[i].rx_ctx);
+		}
+	}
+
+	for (i = 0; mt_eps && i < ep_cnt; i++)
+		FT_CLOSE_FID(mt_eps[i]);
+	for (i = 0; mt_cqs && i < cq_cnt; i++)
+		FT_CLOSE_FID(mt_cqs[i]);
+	FT_CLOSE_FID(mt_mr);
+
+	free(threads);
+	free(mt_addrs);
+	free(mt_cqs);
+	free(mt_eps);
+	free(mt_buf);
+	if (mt_info)
+		fi_freeinfo(mt_info);
+}
+
+int mt_run(enum mt_test test)
+{
+	int i, j, ret;
+
+	if (thread_cnt < 1 || threads_per_ep < 1) {
+		FT_ERR("thread counts must be at least 1");
+		return -FI_EINVAL;
+	}
+
+	test_type = test;
+	ep_cnt = (thread_cnt + threads_per_ep - 1) / threads_per_ep;
+	cq_cnt = shared_cq ? 1 : ep_cnt;
+	opts.av_size = ep_cnt + 1;
+
+	ret = ft_init_fabric();
+	if (ret)
+		return ret;
+
+	ret = mt_alloc_res();
+	if (ret)
+		goto out;
+
+	for (i = 0; i < ep_cnt; i++) {
+		ret = ft_init_av_addr(av, mt_eps[i], &mt_addrs[i]);
+		if (ret)
+			goto out;
+	}
+
+	for (i = 0; i < thread_cnt; i++) {
+		threads[i].addr = mt_addrs[i / threads_per_ep];
+		for (j = 0; j < opts.window_size; j++) {
+			threads[i].tx_ctx[j].thread = &threads[i];
+			threads[i].rx_ctx[j].thread = &threads[i];
+		}
+	}
+
+	if (!(opts.options & FT_OPT_SIZE)) {
+		for (i = 0; i < TEST_CNT; i++) {
+			if (!ft_use_size(i, opts.sizes_enabled))
+				continue;
+			opts.transfer_size = test_size[i].size;
+			init_test(&opts, test_name, sizeof(test_name));
+			ret = mt_run_size();
+			if (ret)
+				goto out;
+		}
+	} else {
+		init_test(&opts, test_name, sizeof(test_name));
+		ret = mt_run_size();
+		if (ret)
+			goto out;
+	}
+
+	ret = ft_finalize();
+out:
+	mt_free_res();
+	return ret;
+}
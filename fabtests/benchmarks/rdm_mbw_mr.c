@@ -0,0 +1,800 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <rdma/fi_cm.h>
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include <shared.h>
+#include "benchmark_shared.h"
+
+/*
+ * Aggregate message rate test for N senders and M receivers on one node,
+ * in the style of osu_mbw_mr.  Traffic flows over max(N, M) pairs, where
+ * pair k connects sender k % N to receiver k % M.  N == M gives independent
+ * pairs, M == 1 gives N-to-1 incast, and N == 1 gives 1-to-M outcast.
+ *
+ * All senders and receivers are started from a single invocation.  By
+ * default each one is a separate process with its own endpoint.  With -T,
+ * the senders are threads sharing one endpoint in one process, and the
+ * receivers likewise.  Endpoint names, a barrier and the results are kept
+ * in an anonymous shared mapping created before forking.
+ */
+
+#define MBW_MAX_WORKERS	256
+#define MBW_CQ_BATCH	16
+#define MBW_CHECK_SPINS	4096
+#define MBW_DATA_TAG	(1ULL << 32)
+#define MBW_ACK_TAG	(2ULL << 32)
+
+struct mbw_name {
+	size_t		max_msg_size;
+	size_t		len;
+	char		addr[FT_MAX_CTRL_MSG];
+};
+
+struct mbw_result {
+	uint64_t	nsec;
+};
+
+struct mbw_shared {
+	uint32_t		arrived;
+	uint32_t		gen;
+	uint32_t		total;
+	int			abort;
+	struct mbw_name		name[MBW_MAX_WORKERS];
+	struct mbw_result	result[MBW_MAX_WORKERS];
+};
+
+struct mbw_worker;
+
+struct mbw_ctx {
+	struct fi_context2	context;
+	struct mbw_worker	*worker;
+};
+
+/* Workers 0..N-1 are senders, N..N+M-1 are receivers */
+struct mbw_worker {
+	int			id;
+	int			rank;
+	int			sender;
+	int			peer_cnt;
+	int			*peer;
+	struct mbw_ctx		*ctx;
+	uint64_t		tx_cnt;
+	uint64_t		rx_cnt;
+	uint64_t		tx_target;
+	uint64_t		rx_target;
+	pthread_t		thread;
+};
+
+static struct mbw_shared *shared;
+static struct mbw_worker *workers;
+static fi_addr_t *worker_addr;
+static int sender_cnt = 1, receiver_cnt = 1, local_cnt;
+static int shared_ep, show_pairs;
+static size_t max_msg_size;
+static pid_t launcher;
+
+static int pair_cnt(void)
+{
+	return MAX(sender_cnt, receiver_cnt);
+}
+
+static int mbw_progress_cq(struct fid_cq *cq, int tx)
+{
+	struct fi_cq_tagged_entry comp[MBW_CQ_BATCH];
+	struct mbw_ctx *ctx;
+	ssize_t ret, i;
+
+	ret = fi_cq_read(cq, comp, MBW_CQ_BATCH);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret == -FI_EAVAIL)
+		return ft_cq_readerr(cq);
+	if (ret < 0) {
+		FT_PRINTERR("fi_cq_read", ret);
+		return (int) ret;
+	}
+
+	/* Threads sharing an endpoint may reap each other's completions */
+	for (i = 0; i < ret; i++) {
+		ctx = comp[i].op_context;
+		__atomic_add_fetch(tx ? &ctx->worker->tx_cnt :
+				   &ctx->worker->rx_cnt, 1, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+static int mbw_progress(void)
+{
+	int ret;
+
+	ret = mbw_progress_cq(txcq, 1);
+	if (ret)
+		return ret;
+
+	return mbw_progress_cq(rxcq, 0);
+}
+
+static int mbw_check_abort(unsigned int *spin)
+{
+	if (__atomic_load_n(&shared->abort, __ATOMIC_ACQUIRE))
+		return -FI_ECANCELED;
+
+	/* Don't spin forever if the launcher died, but getppid is a syscall */
+	if (!(++*spin % MBW_CHECK_SPINS) && getppid() != launcher)
+		return -FI_ECANCELED;
+	return 0;
+}
+
+static int mbw_wait(uint64_t *cnt, uint64_t target)
+{
+	unsigned int spin = 0;
+	int ret;
+
+	while (__atomic_load_n(cnt, __ATOMIC_ACQUIRE) < target) {
+		ret = mbw_check_abort(&spin);
+		if (ret)
+			return ret;
+		ret = mbw_progress();
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static void mbw_abort(void)
+{
+	__atomic_store_n(&shared->abort, 1, __ATOMIC_RELEASE);
+}
+
+/* Returns nonzero if a child exited before the test finished */
+static int mbw_check_children(void)
+{
+	int status;
+	pid_t pid;
+
+	pid = waitpid(-1, &status, WNOHANG);
+	if (pid <= 0)
+		return 0;
+
+	if (WIFSIGNALED(status))
+		FT_ERR("worker process %d killed by signal %d", (int) pid,
+		       WTERMSIG(status));
+	else
+		FT_ERR("worker process %d exited with status %d", (int) pid,
+		       WEXITSTATUS(status));
+	return 1;
+}
+
+/*
+ * Sense reversing barrier across all workers and the launching process.
+ * Workers keep driving progress while they wait, since a peer may still
+ * need acknowledgements from this endpoint to complete its last transfer.
+ */
+static int mbw_barrier(int progress)
+{
+	unsigned int spin = 0;
+	uint32_t gen;
+	int ret;
+
+	gen = __atomic_load_n(&shared->gen, __ATOMIC_ACQUIRE);
+	if (__atomic_add_fetch(&shared->arrived, 1, __ATOMIC_ACQ_REL) ==
+	    shared->total) {
+		__atomic_store_n(&shared->arrived, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&shared->gen, gen + 1, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	while (__atomic_load_n(&shared->gen, __ATOMIC_ACQUIRE) == gen) {
+		if (progress) {
+			ret = mbw_check_abort(&spin);
+			if (ret)
+				return ret;
+
+			ret = mbw_progress();
+			if (ret) {
+				mbw_abort();
+				return ret;
+			}
+		} else {
+			if (__atomic_load_n(&shared->abort, __ATOMIC_ACQUIRE))
+				return -FI_ECANCELED;
+
+			if (mbw_check_children()) {
+				mbw_abort();
+				return -FI_ECANCELED;
+			}
+			sched_yield();
+		}
+	}
+	return 0;
+}
+
+static int mbw_post(struct mbw_worker *w, int tx, size_t len, fi_addr_t addr,
+		    uint64_t tag, int idx)
+{
+	struct mbw_ctx *ctx = &w->ctx[idx];
+	unsigned int spin = 0;
+	ssize_t ret;
+
+	for (;;) {
+		if (tx)
+			ret = fi_tsend(ep, tx_buf, len, mr_desc, addr, tag, ctx);
+		else
+			ret = fi_trecv(ep, rx_buf, len, mr_desc, addr, tag, 0,
+				       ctx);
+		if (!ret)
+			break;
+
+		if (ret != -FI_EAGAIN) {
+			if (tx)
+				FT_PRINTERR("fi_tsend", ret);
+			else
+				FT_PRINTERR("fi_trecv", ret);
+			return (int) ret;
+		}
+
+		ret = mbw_check_abort(&spin);
+		if (!ret)
+			ret = mbw_progress();
+		if (ret)
+			return (int) ret;
+	}
+
+	if (tx)
+		w->tx_target++;
+	else
+		w->rx_target++;
+	return 0;
+}
+
+/*
+ * Each window, a sender posts one acknowledgement receive per target,
+ * sends a window of messages to every target, and waits for the sends
+ * and the acknowledgements to complete.
+ */
+static int mbw_send(struct mbw_worker *w, int cnt)
+{
+	int i, ret;
+
+	for (i = 0; i < w->peer_cnt; i++) {
+		ret = mbw_post(w, 0, FT_MAX_CTRL_MSG, FI_ADDR_UNSPEC,
+			       MBW_ACK_TAG | w->id, i);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < w->peer_cnt * cnt; i++) {
+		ret = mbw_post(w, 1, opts.transfer_size,
+			       worker_addr[w->peer[i % w->peer_cnt]],
+			       MBW_DATA_TAG | w->peer[i % w->peer_cnt],
+			       w->peer_cnt + i);
+		if (ret)
+			return ret;
+	}
+
+	ret = mbw_wait(&w->tx_cnt, w->tx_target);
+	if (ret)
+		return ret;
+
+	return mbw_wait(&w->rx_cnt, w->rx_target);
+}
+
+static int mbw_recv(struct mbw_worker *w, int cnt)
+{
+	int i, ret;
+
+	for (i = 0; i < w->peer_cnt * cnt; i++) {
+		ret = mbw_post(w, 0, opts.transfer_size, FI_ADDR_UNSPEC,
+			       MBW_DATA_TAG | w->id, w->peer_cnt + i);
+		if (ret)
+			return ret;
+	}
+
+	ret = mbw_wait(&w->rx_cnt, w->rx_target);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < w->peer_cnt; i++) {
+		ret = mbw_post(w, 1, 0, worker_addr[w->peer[i]],
+			       MBW_ACK_TAG | w->peer[i], i);
+		if (ret)
+			return ret;
+	}
+
+	return mbw_wait(&w->tx_cnt, w->tx_target);
+}
+
+static int mbw_xfer(struct mbw_worker *w)
+{
+	uint64_t start = 0;
+	int i, cnt, ret;
+
+	for (i = 0; i < opts.iterations + opts.warmup_iterations; i += cnt) {
+		if (i == opts.warmup_iterations)
+			start = ft_gettime_ns();
+
+		cnt = MIN(opts.window_size, opts.warmup_iterations > i ?
+			  opts.warmup_iterations - i :
+			  opts.iterations + opts.warmup_iterations - i);
+		ret = w->sender ? mbw_send(w, cnt) : mbw_recv(w, cnt);
+		if (ret)
+			return ret;
+	}
+
+	shared->result[w->id].nsec = ft_gettime_ns() - start;
+	return 0;
+}
+
+/* Every process must run the same sizes, including the launcher */
+static void mbw_set_max_msg_size(void)
+{
+	int i;
+
+	max_msg_size = shared->name[0].max_msg_size;
+	for (i = 1; i < sender_cnt + receiver_cnt; i++)
+		max_msg_size = MIN(max_msg_size, shared->name[i].max_msg_size);
+}
+
+static int mbw_use_size(int index)
+{
+	return test_size[index].size <= max_msg_size &&
+		((opts.sizes_enabled == FT_ENABLE_SIZES) ||
+		(opts.sizes_enabled & test_size[index].enable_flags));
+}
+
+static int mbw_run_worker(struct mbw_worker *w)
+{
+	int i, ret;
+
+	ret = mbw_barrier(1);
+	if (ret)
+		return ret;
+
+	/* The first local worker inserts every name into the shared AV */
+	if (w == workers) {
+		mbw_set_max_msg_size();
+		for (i = 0; i < sender_cnt + receiver_cnt; i++) {
+			ret = ft_av_insert(av, shared->name[i].addr, 1,
+					   &worker_addr[i], 0, NULL);
+			if (ret) {
+				mbw_abort();
+				return ret;
+			}
+		}
+	}
+
+	ret = mbw_barrier(1);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < TEST_CNT; i++) {
+		if (!(opts.options & FT_OPT_SIZE) && !mbw_use_size(i))
+			continue;
+
+		if (w == workers) {
+			if (!(opts.options & FT_OPT_SIZE))
+				opts.transfer_size = test_size[i].size;
+			init_test(&opts, test_name, sizeof(test_name));
+		}
+
+		ret = mbw_barrier(1);
+		if (ret)
+			return ret;
+
+		ret = mbw_xfer(w);
+		if (ret) {
+			mbw_abort();
+			return ret;
+		}
+
+		ret = mbw_barrier(1);
+		if (ret)
+			return ret;
+
+		if (opts.options & FT_OPT_SIZE)
+			break;
+	}
+	return 0;
+}
+
+static void *mbw_thread(void *arg)
+{
+	return (void *) (intptr_t) mbw_run_worker(arg);
+}
+
+static int mbw_init_worker(struct mbw_worker *w, int id)
+{
+	int k;
+
+	w->id = id;
+	w->sender = id < sender_cnt;
+	w->rank = w->sender ? id : id - sender_cnt;
+
+	w->peer = calloc(pair_cnt(), sizeof(*w->peer));
+	if (!w->peer)
+		return -FI_ENOMEM;
+
+	for (k = 0; k < pair_cnt(); k++) {
+		if (w->sender && k % sender_cnt == w->rank)
+			w->peer[w->peer_cnt++] = sender_cnt + k % receiver_cnt;
+		else if (!w->sender && k % receiver_cnt == w->rank)
+			w->peer[w->peer_cnt++] = k % sender_cnt;
+	}
+
+	w->ctx = calloc(w->peer_cnt * (opts.window_size + 1),
+			sizeof(*w->ctx));
+	if (!w->ctx)
+		return -FI_ENOMEM;
+
+	for (k = 0; k < w->peer_cnt * (opts.window_size + 1); k++)
+		w->ctx[k].worker = w;
+	return 0;
+}
+
+/* Runs workers first..first+cnt-1 over one endpoint in this process */
+static int mbw_child(int first, int cnt)
+{
+	void *thread_ret;
+	size_t len;
+	int i, ret;
+
+	ret = ft_init();
+	if (ret)
+		goto out;
+
+	/* Let the provider pick an address for every process, rather than
+	 * binding them all to the default port.
+	 */
+	ret = fi_getinfo(FT_FIVERSION, opts.src_addr, NULL,
+			 opts.src_addr ? FI_SOURCE : 0, hints, &fi);
+	if (ret) {
+		FT_PRINTERR("fi_getinfo", ret);
+		goto out;
+	}
+
+	ret = ft_open_fabric_res();
+	if (ret)
+		goto out;
+
+	ret = ft_alloc_active_res(fi);
+	if (ret)
+		goto out;
+
+	ret = ft_enable_ep(ep, eq, av, txcq, rxcq, txcntr, rxcntr);
+	if (ret)
+		goto out;
+
+	workers = calloc(cnt, sizeof(*workers));
+	worker_addr = calloc(sender_cnt + receiver_cnt, sizeof(*worker_addr));
+	if (!workers || !worker_addr) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		ret = mbw_init_worker(&workers[i], first + i);
+		if (ret)
+			goto out;
+
+		len = sizeof(shared->name[0].addr);
+		ret = fi_getname(&ep->fid, shared->name[first + i].addr, &len);
+		if (ret) {
+			FT_PRINTERR("fi_getname", ret);
+			goto out;
+		}
+		shared->name[first + i].len = len;
+		shared->name[first + i].max_msg_size = fi->ep_attr->max_msg_size;
+	}
+	local_cnt = cnt;
+
+	for (i = 1; i < cnt; i++) {
+		ret = pthread_create(&workers[i].thread, NULL, mbw_thread,
+				     &workers[i]);
+		if (ret) {
+			FT_PRINTERR("pthread_create", -ret);
+			local_cnt = i;
+			ret = -ret;
+			goto join;
+		}
+	}
+
+	ret = mbw_run_worker(&workers[0]);
+join:
+	for (i = 1; i < local_cnt; i++) {
+		pthread_join(workers[i].thread, &thread_ret);
+		if (!ret)
+			ret = (int) (intptr_t) thread_ret;
+	}
+out:
+	if (ret)
+		mbw_abort();
+	if (workers) {
+		for (i = 0; i < cnt; i++) {
+			free(workers[i].peer);
+			free(workers[i].ctx);
+		}
+	}
+	free(workers);
+	free(worker_addr);
+	ft_free_res();
+	return ft_exit_code(ret);
+}
+
+static void mbw_show(void)
+{
+	static int header = 1;
+	struct mbw_result *res;
+	double rate, sum = 0, sum_sq = 0, min = 0, max = 0;
+	double bw, msg_rate, fairness;
+	uint64_t msgs = 0, nsec = 0;
+	char str[FT_STR_LEN];
+	int i, k, s, r;
+
+	for (i = 0; i < sender_cnt + receiver_cnt; i++)
+		nsec = MAX(nsec, shared->result[i].nsec);
+
+	/* A pair's rate is its share of its sender's messages over time */
+	for (k = 0; k < pair_cnt(); k++) {
+		res = &shared->result[k % sender_cnt];
+		rate = res->nsec ? (double) opts.iterations * 1000 / res->nsec : 0;
+		sum += rate;
+		sum_sq += rate * rate;
+		min = k ? MIN(min, rate) : rate;
+		max = MAX(max, rate);
+		msgs += opts.iterations;
+	}
+
+	bw = nsec ? (double) msgs * opts.transfer_size * 1000 / nsec : 0;
+	msg_rate = nsec ? (double) msgs * 1000 / nsec : 0;
+	fairness = sum_sq ? sum * sum / (pair_cnt() * sum_sq) : 0;
+
+	if (ft_check_opts(FT_OPT_JSON)) {
+		ft_json_begin(NULL, opts.transfer_size, opts.iterations);
+		printf(", \"senders\": %d, \"receivers\": %d, \"pairs\": %d, "
+		       "\"shared_ep\": %s, \"total_bytes\": %" PRIu64 ", "
+		       "\"time_sec\": %f, \"MB_per_sec\": %f, "
+		       "\"Mmsgs_per_sec\": %f, \"pair_min_Mmsgs_per_sec\": %f, "
+		       "\"pair_max_Mmsgs_per_sec\": %f, \"fairness\": %f",
+		       sender_cnt, receiver_cnt, pair_cnt(),
+		       shared_ep ? "true" : "false",
+		       msgs * opts.transfer_size, nsec / 1e9, bw, msg_rate,
+		       min, max, fairness);
+		ft_json_end();
+		return;
+	}
+
+	if (header) {
+		printf("%-8s%-8s%-8s%-8s%8s %10s%13s%13s%13s%10s\n",
+		       "bytes", "iters", "pairs", "total", "time", "MB/sec",
+		       "Mmsgs/sec", "pair min", "pair max", "fairness");
+		header = 0;
+	}
+
+	printf("%-8s", size_str(str, opts.transfer_size));
+	printf("%-8s", cnt_str(str, opts.iterations));
+	printf("%-8d", pair_cnt());
+	printf("%-8s", size_str(str, msgs * opts.transfer_size));
+	printf("%8.2fs%10.2f%13.3f%13.3f%13.3f%10.3f\n", nsec / 1e9,
+	       bw, msg_rate, min, max, fairness);
+
+	if (!show_pairs)
+		return;
+
+	for (k = 0; k < pair_cnt(); k++) {
+		s = k % sender_cnt;
+		r = k % receiver_cnt;
+		res = &shared->result[s];
+		printf("  pair %d: sender %d -> receiver %d%13.3f Mmsgs/sec\n",
+		       k, s, r, res->nsec ?
+		       (double) opts.iterations * 1000 / res->nsec : 0);
+	}
+}
+
+static int mbw_parent(void)
+{
+	int i, ret;
+
+	ret = mbw_barrier(0);
+	if (ret)
+		return ret;
+
+	mbw_set_max_msg_size();
+
+	ret = mbw_barrier(0);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < TEST_CNT; i++) {
+		if (!(opts.options & FT_OPT_SIZE)) {
+			if (!mbw_use_size(i))
+				continue;
+			opts.transfer_size = test_size[i].size;
+		}
+		init_test(&opts, test_name, sizeof(test_name));
+
+		ret = mbw_barrier(0);
+		if (ret)
+			return ret;
+
+		ret = mbw_barrier(0);
+		if (ret)
+			return ret;
+
+		mbw_show();
+		if (opts.options & FT_OPT_SIZE)
+			break;
+	}
+	return 0;
+}
+
+static int mbw_fork(int first, int cnt)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		FT_PRINTERR("fork", -errno);
+		return -errno;
+	}
+
+	if (!pid)
+		exit(mbw_child(first, cnt));
+	return 0;
+}
+
+static int run(void)
+{
+	int i, ret = 0, status;
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		FT_PRINTERR("mmap", -errno);
+		return -errno;
+	}
+	shared->total = sender_cnt + receiver_cnt + 1;
+	launcher = getpid();
+
+	if (shared_ep) {
+		ret = mbw_fork(0, sender_cnt);
+		if (!ret)
+			ret = mbw_fork(sender_cnt, receiver_cnt);
+	} else {
+		for (i = 0; i < sender_cnt + receiver_cnt && !ret; i++)
+			ret = mbw_fork(i, 1);
+	}
+
+	if (ret)
+		mbw_abort();
+	else
+		ret = mbw_parent();
+
+	while (wait(&status) > 0) {
+		if (!ret && (!WIFEXITED(status) || WEXITSTATUS(status)))
+			ret = -FI_EOTHER;
+	}
+
+	munmap(shared, sizeof(*shared));
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+
+	opts = INIT_OPTS;
+	opts.options |= FT_OPT_BW;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt_long(argc, argv, "n:r:TPh" CS_OPTS INFO_OPTS
+				 BENCHMARK_OPTS, long_opts, &lopt_idx)) != -1) {
+		switch (op) {
+		default:
+			if (!ft_parse_long_opts(op, optarg))
+				continue;
+			ft_parse_benchmark_opts(op, optarg);
+			ft_parseinfo(op, optarg, hints, &opts);
+			ft_parsecsopts(op, optarg, &opts);
+			break;
+		case 'n':
+			sender_cnt = atoi(optarg);
+			break;
+		case 'r':
+			receiver_cnt = atoi(optarg);
+			break;
+		case 'T':
+			shared_ep = 1;
+			break;
+		case 'P':
+			show_pairs = 1;
+			break;
+		case '?':
+		case 'h':
+			ft_usage(argv[0], "Aggregate message rate test with "
+				 "multiple senders and receivers on one node.");
+			FT_PRINT_OPTS_USAGE("-n <senders>",
+					    "number of senders (default 1)");
+			FT_PRINT_OPTS_USAGE("-r <receivers>",
+					    "number of receivers (default 1)");
+			FT_PRINT_OPTS_USAGE("-T", "run senders and receivers "
+					    "as threads sharing one endpoint "
+					    "per side");
+			FT_PRINT_OPTS_USAGE("-P", "show the rate of each "
+					    "sender/receiver pair");
+			ft_benchmark_usage();
+			ft_longopts_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (sender_cnt < 1 || receiver_cnt < 1 ||
+	    sender_cnt + receiver_cnt > MBW_MAX_WORKERS) {
+		FT_ERR("senders and receivers must be at least 1 and at most "
+		       "%d in total", MBW_MAX_WORKERS);
+		return EXIT_FAILURE;
+	}
+
+	if (opts.options & FT_OPT_ENABLE_HMEM) {
+		hints->caps |= FI_HMEM;
+		hints->domain_attr->mr_mode |= FI_MR_HMEM;
+	}
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->domain_attr->resource_mgmt = FI_RM_ENABLED;
+	hints->caps |= FI_TAGGED;
+	hints->mode |= FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->domain_attr->threading = shared_ep ? FI_THREAD_SAFE :
+					FI_THREAD_DOMAIN;
+	hints->tx_attr->tclass = FI_TC_BULK_DATA;
+	hints->addr_format = opts.address_format;
+
+	ret = run();
+
+	ft_free_res();
+	return ft_exit_code(ret);
+}
@@ -102,6 +102,7 @@ const char *greeting = "Hello from Client!";
 char test_name[50] = "custom";
 int timeout = -1;
 struct timespec start, end;
+static FILE *sample_out;
 
 int listen_sock = -1;
 int sock = -1;
@@ -1659,6 +1660,11 @@ void ft_free_res(void)
 {
 	int ret;
 
+	if (sample_out) {
+		fclose(sample_out);
+		sample_out = NULL;
+	}
+
 	ft_cleanup_mr_array(tx_ctx_arr, tx_mr_bufs);
 	ft_cleanup_mr_array(rx_ctx_arr, rx_mr_bufs);
 
@@ -2848,6 +2854,12 @@ void show_perf(char *name, size_t tsize, int iters, struct timespec *start,
 	long long bytes = (long long) iters * tsize * xfers_per_iter;
 	float usec_per_xfer;
 
+	if (ft_check_opts(FT_OPT_JSON)) {
+		(void) show_perf_json(name, tsize, iters, start, end,
+				      xfers_per_iter, NULL);
+		return;
+	}
+
 	if (name) {
 		if (header) {
 			printf("%-50s%-8s%-8s%-8s%8s %10s%13s%13s\n",
@@ -2889,6 +2901,12 @@ void show_perf_mr(size_t tsize, int iters, struct timespec *start,
 	int i;
 	float usec_per_xfer;
 
+	if (ft_check_opts(FT_OPT_JSON)) {
+		(void) show_perf_json(NULL, tsize, iters, start, end,
+				      xfers_per_iter, NULL);
+		return;
+	}
+
 	if (header) {
 		printf("---\n");
 
@@ -2912,6 +2930,241 @@ void show_perf_mr(size_t tsize, int iters, struct timespec *start,
 	printf(" }\n");
 }
 
+static int ft_sample_cmp(const void *a, const void *b)
+{
+	uint64_t sa = *(const uint64_t *) a, sb = *(const uint64_t *) b;
+
+	return sa < sb ? -1 : sa > sb;
+}
+
+/* Nearest rank percentile of a sorted array */
+uint64_t ft_percentile(const uint64_t *sorted, int cnt, double pct)
+{
+	double rank = pct * cnt / 100.0;
+	int idx = (int) rank;
+
+	if (idx < rank || !idx)
+		idx++;
+	return sorted[idx - 1];
+}
+
+/* Samples are written in iteration order: CSV with a row per iteration,
+ * or, if the file name ends in .json, one JSON object per message size.
+ */
+static int ft_write_samples(size_t tsize, const uint64_t *samples, int iters,
+			    int xfers_per_iter)
+{
+	size_t len = strlen(opts.sample_file);
+	int i, json;
+
+	json = len > 5 && !strcmp(&opts.sample_file[len - 5], ".json");
+	if (!sample_out) {
+		sample_out = fopen(opts.sample_file, "w");
+		if (!sample_out) {
+			FT_PRINTERR("fopen", -errno);
+			return -errno;
+		}
+		if (!json)
+			fprintf(sample_out, "bytes,xfers_per_iter,iteration,"
+				"nsec\n");
+	}
+
+	if (json) {
+		fprintf(sample_out, "{\"bytes\": %zu, \"xfers_per_iter\": %d, "
+			"\"nsec\": [", tsize, xfers_per_iter);
+		for (i = 0; i < iters; i++)
+			fprintf(sample_out, "%s%" PRIu64, i ? ", " : "",
+				samples[i]);
+		fprintf(sample_out, "]}\n");
+	} else {
+		for (i = 0; i < iters; i++)
+			fprintf(sample_out, "%zu,%d,%d,%" PRIu64 "\n", tsize,
+				xfers_per_iter, i, samples[i]);
+	}
+	fflush(sample_out);
+	return 0;
+}
+
+static const double lat_pct[] = { 50, 90, 99, 99.9 };
+static const char *lat_pct_str[] = { "p50", "p90", "p99", "p99.9" };
+
+/* Writes the samples if requested, then sorts them for ft_percentile() */
+static int ft_sort_samples(size_t tsize, uint64_t *samples, int iters,
+			   int xfers_per_iter)
+{
+	int ret;
+
+	if (opts.sample_file) {
+		ret = ft_write_samples(tsize, samples, iters, xfers_per_iter);
+		if (ret)
+			return ret;
+	}
+
+	qsort(samples, iters, sizeof(*samples), ft_sample_cmp);
+	return 0;
+}
+
+/*
+ * Reports percentiles of the per iteration times in samples, in nsec.
+ * Like usec/xfer, each iteration time is divided by xfers_per_iter.  The
+ * samples are sorted in place.
+ */
+int show_perf_lat(size_t tsize, uint64_t *samples, int iters,
+		  int xfers_per_iter)
+{
+	double div = 1000.0 * xfers_per_iter;
+	char str[FT_STR_LEN];
+	size_t i;
+	int ret;
+
+	if (iters <= 0)
+		return 0;
+
+	ret = ft_sort_samples(tsize, samples, iters, xfers_per_iter);
+	if (ret)
+		return ret;
+
+	if (opts.machr) {
+		printf("- { xfer_size: %zu, usec/xfer_min: %f, ", tsize,
+		       samples[0] / div);
+		for (i = 0; i < ARRAY_SIZE(lat_pct); i++)
+			printf("usec/xfer_%s: %f, ", lat_pct_str[i],
+			       ft_percentile(samples, iters, lat_pct[i]) / div);
+		printf("usec/xfer_max: %f }\n", samples[iters - 1] / div);
+		return 0;
+	}
+
+	printf("%-8s%-16s", size_str(str, tsize), "usec/xfer");
+	printf("min %.2f", samples[0] / div);
+	for (i = 0; i < ARRAY_SIZE(lat_pct); i++)
+		printf("  %s %.2f", lat_pct_str[i],
+		       ft_percentile(samples, iters, lat_pct[i]) / div);
+	printf("  max %.2f\n", samples[iters - 1] / div);
+	return 0;
+}
+
+static void ft_json_escape(const char *val)
+{
+	const char *c;
+
+	putchar('"');
+	for (c = val; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			printf("\\%c", *c);
+		else if ((unsigned char) *c < 0x20)
+			printf("\\u%04x", *c);
+		else
+			putchar(*c);
+	}
+	putchar('"');
+}
+
+void ft_json_str(const char *key, const char *val)
+{
+	printf(", \"%s\": ", key);
+	if (val)
+		ft_json_escape(val);
+	else
+		printf("null");
+}
+
+/*
+ * Starts a JSON Lines record describing the test, the provider in use and
+ * the hints it was selected with.  Callers add fields with printf, each
+ * starting with ", ", and close the record with ft_json_end().
+ */
+void ft_json_begin(const char *name, size_t tsize, int iters)
+{
+	const char *test = "";
+	struct fi_info *info = fi ? fi : fi_pep;
+	char *sep;
+
+	if (opts.argv && opts.argv[0]) {
+		test = opts.argv[0];
+		sep = strrchr(test, '/');
+		if (sep)
+			test = sep + 1;
+	}
+
+	printf("{\"test\": ");
+	ft_json_escape(test);
+	if (name)
+		ft_json_str("name", name);
+
+	if (info) {
+		ft_json_str("provider", info->fabric_attr->prov_name);
+		ft_json_str("fabric", info->fabric_attr->name);
+		ft_json_str("domain", info->domain_attr->name);
+		ft_json_str("ep_type", fi_tostr(&info->ep_attr->type,
+						 FI_TYPE_EP_TYPE));
+	}
+
+	printf(", \"hints\": {\"provider\": ");
+	if (hints && hints->fabric_attr && hints->fabric_attr->prov_name)
+		ft_json_escape(hints->fabric_attr->prov_name);
+	else
+		printf("null");
+	if (hints) {
+		ft_json_str("ep_type", fi_tostr(&hints->ep_attr->type,
+						 FI_TYPE_EP_TYPE));
+		ft_json_str("caps", fi_tostr(&hints->caps, FI_TYPE_CAPS));
+		ft_json_str("mode", fi_tostr(&hints->mode, FI_TYPE_MODE));
+	}
+	printf("}");
+
+	printf(", \"xfer_size\": %zu, \"iterations\": %d", tsize, iters);
+}
+
+void ft_json_end(void)
+{
+	printf("}\n");
+	fflush(stdout);
+}
+
+/*
+ * Reports one JSON record per transfer size.  If samples is given, the
+ * per iteration latency percentiles are included, in usec per transfer.
+ */
+int show_perf_json(char *name, size_t tsize, int iters, struct timespec *start,
+		   struct timespec *end, int xfers_per_iter, uint64_t *samples)
+{
+	int64_t elapsed = get_elapsed(start, end, MICRO);
+	long long bytes = (long long) iters * tsize * xfers_per_iter;
+	double usec_per_xfer, div = 1000.0 * xfers_per_iter;
+	size_t i;
+	int ret;
+
+	if (iters <= 0 || elapsed <= 0)
+		return 0;
+
+	usec_per_xfer = (double) elapsed / iters / xfers_per_iter;
+
+	ft_json_begin(name, tsize, iters);
+	printf(", \"xfers_per_iter\": %d, \"total_bytes\": %lld, "
+	       "\"time_sec\": %f, \"MB_per_sec\": %f, "
+	       "\"usec_per_xfer\": %f, \"Mxfers_per_sec\": %f",
+	       xfers_per_iter, bytes, elapsed / 1000000.0,
+	       bytes / (1.0 * elapsed), usec_per_xfer, 1.0 / usec_per_xfer);
+
+	if (samples) {
+		ret = ft_sort_samples(tsize, samples, iters, xfers_per_iter);
+		if (ret) {
+			ft_json_end();
+			return ret;
+		}
+
+		printf(", \"latency_usec\": {\"min\": %f",
+		       samples[0] / div);
+		for (i = 0; i < ARRAY_SIZE(lat_pct); i++)
+			printf(", \"%s\": %f", lat_pct_str[i],
+			       ft_percentile(samples, iters, lat_pct[i]) / div);
+		printf(", \"max\": %f}", samples[iters - 1] / div);
+	}
+
+	ft_json_end();
+	return 0;
+}
+
 void ft_addr_usage()
 {
 	FT_PRINT_OPTS_USAGE("-B <src_port>", "non default source port number");
@@ -3731,6 +3984,15 @@ void ft_longopts_usage()
 	FT_PRINT_OPTS_USAGE("--debug-assert",
 		"Replace asserts with while loops to force process to\n"
 		"spin until a debugger can be attached.");
+	FT_PRINT_OPTS_USAGE("--percentiles",
+		"Time every iteration of pingpong tests and report\n"
+		"min, p50, p90, p99, p99.9 and max latency.");
+	FT_PRINT_OPTS_USAGE("--json",
+		"Report results as JSON, one record per line.  Implies\n"
+		"--percentiles.");
+	FT_PRINT_OPTS_USAGE("--samples <file>",
+		"Implies --percentiles.  Write every iteration time to\n"
+		"file, as JSON if the name ends in .json, else CSV.");
 }
 
 int debug_assert;
@@ -3740,6 +4002,9 @@ struct option long_opts[] = {
 	{"pin-core", required_argument, NULL, LONG_OPT_PIN_CORE},
 	{"timeout", required_argument, NULL, LONG_OPT_TIMEOUT},
 	{"debug-assert", no_argument, &debug_assert, LONG_OPT_DEBUG_ASSERT},
+	{"percentiles", no_argument, NULL, LONG_OPT_PERCENTILES},
+	{"samples", required_argument, NULL, LONG_OPT_SAMPLES},
+	{"json", no_argument, NULL, LONG_OPT_JSON},
 	{NULL, 0, NULL, 0},
 };
 
@@ -3753,6 +4018,15 @@ int ft_parse_long_opts(int op, char *optarg)
 		return 0;
 	case LONG_OPT_DEBUG_ASSERT:
 		return 0;
+	case LONG_OPT_JSON:
+		opts.options |= FT_OPT_JSON | FT_OPT_LAT_SAMPLES;
+		return 0;
+	case LONG_OPT_SAMPLES:
+		opts.sample_file = optarg;
+		/* fall through */
+	case LONG_OPT_PERCENTILES:
+		opts.options |= FT_OPT_LAT_SAMPLES;
+		return 0;
 	default:
 		return EXIT_FAILURE;
 	}
@@ -125,6 +125,8 @@ enum {
 	FT_OPT_SRX		= 1 << 21,
 	FT_OPT_STX		= 1 << 22,
 	FT_OPT_SKIP_ADDR_EXCH	= 1 << 23,
+	FT_OPT_LAT_SAMPLES	= 1 << 24,
+	FT_OPT_JSON		= 1 << 25,
 	FT_OPT_OOB_CTRL		= FT_OPT_OOB_SYNC | FT_OPT_OOB_ADDR_EXCH,
 };
 
@@ -184,6 +186,7 @@ struct ft_opts {
 	int force_prefix;
 	enum fi_hmem_iface iface;
 	uint64_t device;
+	char *sample_file;
 
 	char **argv;
 };
@@ -545,6 +548,14 @@ void show_perf(char *name, size_t tsize, int iters, struct timespec *start,
 		struct timespec *end, int xfers_per_iter);
 void show_perf_mr(size_t tsize, int iters, struct timespec *start,
 		struct timespec *end, int xfers_per_iter, int argc, char *argv[]);
+int show_perf_lat(size_t tsize, uint64_t *samples, int iters,
+		  int xfers_per_iter);
+uint64_t ft_percentile(const uint64_t *sorted, int cnt, double pct);
+int show_perf_json(char *name, size_t tsize, int iters, struct timespec *start,
+		   struct timespec *end, int xfers_per_iter, uint64_t *samples);
+void ft_json_begin(const char *name, size_t tsize, int iters);
+void ft_json_str(const char *key, const char *val);
+void ft_json_end(void);
 void ft_parse_opts_range(char *optarg);
 int ft_send_recv_greeting(struct fid_ep *ep);
 int ft_send_greeting(struct fid_ep *ep);
@@ -567,6 +578,9 @@ enum {
 	LONG_OPT_PIN_CORE = 1,
 	LONG_OPT_TIMEOUT,
 	LONG_OPT_DEBUG_ASSERT,
+	LONG_OPT_PERCENTILES,
+	LONG_OPT_SAMPLES,
+	LONG_OPT_JSON,
 };
 
 extern int debug_assert;
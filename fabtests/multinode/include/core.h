@@ -91,7 +91,20 @@ struct multinode_xfer_state {
 	uint64_t		rx_flags;
 };
 
+/* Options handled by the test program rather than the harness.  Letters in
+ * optstr must not be used by the harness (CS_OPTS, INFO_OPTS, n, C, h).
+ * Unless size_sweep is set, a single transfer size (-S) is used.
+ */
+struct multinode_opts {
+	const char	*optstr;
+	const char	*desc;
+	int		(*parse)(int op, char *optarg);
+	void		(*usage)(void);
+	bool		size_sweep;
+};
+
 extern struct pm_job_info pm_job;
+extern struct multinode_opts multinode_opts;
 int multinode_run_tests(int argc, char **argv);
 int pm_allgather(void *my_item, void *items, int item_size);
 void pm_barrier();
@@ -0,0 +1,651 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_domain.h>
+#include <rdma/fabric.h>
+#include <rdma/fi_endpoint.h>
+#include <rdma/fi_cm.h>
+#include <rdma/fi_collective.h>
+
+#include <core.h>
+#include <shared.h>
+
+/*
+ * Times collectives over all ranks of a multinode job.  Every rank records
+ * the time of each iteration; an iteration takes as long as its slowest
+ * rank, so rank 0 reports percentiles of the per iteration maximum.
+ */
+
+enum bench_coll {
+	BENCH_BARRIER,
+	BENCH_ALLREDUCE,
+	BENCH_ALLGATHER,
+	BENCH_BROADCAST,
+	BENCH_SCATTER,
+	BENCH_COLL_MAX,
+};
+
+static const struct {
+	const char		*name;
+	enum fi_collective_op	op;
+} bench_colls[] = {
+	[BENCH_BARRIER]		= { "barrier", FI_BARRIER },
+	[BENCH_ALLREDUCE]	= { "allreduce", FI_ALLREDUCE },
+	[BENCH_ALLGATHER]	= { "allgather", FI_ALLGATHER },
+	[BENCH_BROADCAST]	= { "broadcast", FI_BROADCAST },
+	[BENCH_SCATTER]		= { "scatter", FI_SCATTER },
+};
+
+#define BENCH_ALL	(-1)
+
+static uint32_t coll_mask = ~0;
+static int bench_op = FI_SUM;
+static int bench_datatype = FI_UINT64;
+
+static struct fid_av_set *av_set;
+static struct fid_mc *coll_mc;
+static fi_addr_t coll_addr;
+
+static void *send_buf, *recv_buf;
+static uint64_t *samples, *all_samples;
+static size_t max_size;
+static int max_iters;
+
+static int parse_name(const char *name, int first, int last,
+		      enum fi_type type)
+{
+	char buf[32];
+	int i;
+
+	if (!strcasecmp(name, "all"))
+		return BENCH_ALL;
+
+	for (i = first; i <= last; i++) {
+		fi_tostr_r(buf, sizeof(buf), &i, type);
+		if (!strcasecmp(name, buf) || !strcasecmp(name, buf + 3))
+			return i;
+	}
+	return -FI_EINVAL;
+}
+
+static int bench_parse_opt(int op, char *optarg)
+{
+	char *name, *saveptr;
+	int i;
+
+	switch (op) {
+	case 'x':
+		coll_mask = 0;
+		for (name = strtok_r(optarg, ",", &saveptr); name;
+		     name = strtok_r(NULL, ",", &saveptr)) {
+			for (i = 0; i < BENCH_COLL_MAX; i++) {
+				if (!strcasecmp(name, bench_colls[i].name))
+					break;
+			}
+			if (!strcasecmp(name, "all")) {
+				coll_mask = ~0;
+			} else if (i == BENCH_COLL_MAX) {
+				FT_ERR("unknown collective %s", name);
+				return -FI_EINVAL;
+			}
+			coll_mask |= 1 << i;
+		}
+		break;
+	case 'o':
+		bench_op = parse_name(optarg, FI_MIN, FI_BXOR,
+				      FI_TYPE_ATOMIC_OP);
+		if (bench_op == -FI_EINVAL) {
+			FT_ERR("unknown reduction op %s", optarg);
+			return -FI_EINVAL;
+		}
+		break;
+	case 'y':
+		bench_datatype = parse_name(optarg, FI_INT8, FI_UINT128,
+					    FI_TYPE_ATOMIC_TYPE);
+		if (bench_datatype == -FI_EINVAL) {
+			FT_ERR("unknown datatype %s", optarg);
+			return -FI_EINVAL;
+		}
+		break;
+	}
+	return 0;
+}
+
+static void bench_usage(void)
+{
+	FT_PRINT_OPTS_USAGE("-x <coll>[,<coll>]",
+		"collectives to time: barrier, allreduce, allgather,\n"
+		"broadcast, scatter or all (default: all)");
+	FT_PRINT_OPTS_USAGE("-o <op>",
+		"allreduce operation, e.g. sum or FI_MAX, or all\n"
+		"(default: sum)");
+	FT_PRINT_OPTS_USAGE("-y <datatype>",
+		"allreduce datatype, e.g. uint64 or FI_DOUBLE, or all\n"
+		"(default: uint64)");
+	FT_PRINT_OPTS_USAGE("-S <size>",
+		"bytes contributed by each rank, or all (default: sweep)");
+}
+
+struct multinode_opts multinode_opts = {
+	.optstr = "x:o:y:",
+	.desc = "Collective latency and bandwidth benchmark",
+	.parse = bench_parse_opt,
+	.usage = bench_usage,
+	.size_sweep = true,
+};
+
+static int bench_wait_cq(void *ctx)
+{
+	struct fi_cq_err_entry comp = { 0 };
+	struct fid_cq *cqs[] = { rxcq, txcq };
+	ssize_t ret;
+	int i;
+
+	for (;;) {
+		for (i = 0; i < ARRAY_SIZE(cqs); i++) {
+			ret = fi_cq_read(cqs[i], &comp, 1);
+			if (ret == 1 && comp.op_context == ctx)
+				return 0;
+			if (ret == -FI_EAVAIL)
+				return ft_cq_readerr(cqs[i]);
+			if (ret < 0 && ret != -FI_EAGAIN) {
+				FT_PRINTERR("fi_cq_read", ret);
+				return (int) ret;
+			}
+		}
+	}
+}
+
+/* The join completes on the EQ, but needs the CQs to be progressed */
+static int bench_wait_join(void)
+{
+	struct fi_cq_err_entry comp = { 0 };
+	uint32_t event;
+	ssize_t ret;
+
+	for (;;) {
+		ret = fi_eq_read(eq, &event, NULL, 0, 0);
+		if (ret >= 0 && event == FI_JOIN_COMPLETE)
+			return 0;
+		if (ret < 0 && ret != -FI_EAGAIN) {
+			FT_PRINTERR("fi_eq_read", ret);
+			return (int) ret;
+		}
+
+		(void) fi_cq_read(rxcq, &comp, 1);
+		(void) fi_cq_read(txcq, &comp, 1);
+	}
+}
+
+static int bench_join(void)
+{
+	struct fi_av_set_attr attr = {
+		.count = 0,
+		.start_addr = 0,
+		.end_addr = pm_job.num_ranks - 1,
+		.stride = 1,
+	};
+	fi_addr_t world_addr;
+	int ret;
+
+	ret = fi_av_set(av, &attr, &av_set, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_av_set", ret);
+		return ret;
+	}
+
+	ret = fi_av_set_addr(av_set, &world_addr);
+	if (ret) {
+		FT_PRINTERR("fi_av_set_addr", ret);
+		return ret;
+	}
+
+	ret = fi_join_collective(ep, world_addr, av_set, 0, &coll_mc, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_join_collective", ret);
+		return ret;
+	}
+
+	ret = bench_wait_join();
+	if (ret)
+		return ret;
+
+	coll_addr = fi_mc_addr(coll_mc);
+	return 0;
+}
+
+static ssize_t bench_post(enum bench_coll coll, size_t count,
+			  enum fi_datatype datatype, enum fi_op op, void *ctx)
+{
+	switch (coll) {
+	case BENCH_BARRIER:
+		return fi_barrier(ep, coll_addr, ctx);
+	case BENCH_ALLREDUCE:
+		return fi_allreduce(ep, send_buf, count, NULL, recv_buf, NULL,
+				    coll_addr, datatype, op, 0, ctx);
+	case BENCH_ALLGATHER:
+		return fi_allgather(ep, send_buf, count, NULL, recv_buf, NULL,
+				    coll_addr, datatype, 0, ctx);
+	case BENCH_BROADCAST:
+		return fi_broadcast(ep, pm_job.my_rank ? recv_buf : send_buf,
+				    count, NULL, coll_addr, 0, datatype, 0,
+				    ctx);
+	case BENCH_SCATTER:
+		return fi_scatter(ep, pm_job.my_rank ? NULL : send_buf, count,
+				  NULL, recv_buf, NULL, coll_addr, 0,
+				  datatype, 0, ctx);
+	default:
+		return -FI_EINVAL;
+	}
+}
+
+static int bench_sample_cmp(const void *a, const void *b)
+{
+	uint64_t sa = *(const uint64_t *) a, sb = *(const uint64_t *) b;
+
+	return sa < sb ? -1 : sa > sb;
+}
+
+static void bench_print_header(void)
+{
+	if (opts.machr || ft_check_opts(FT_OPT_JSON))
+		return;
+
+	printf("# %s, %zu ranks\n", fi->fabric_attr->prov_name,
+	       pm_job.num_ranks);
+	printf("%-10s %-12s %-7s %-8s %-8s %-10s %-10s %-10s %-10s %-10s "
+	       "%s\n", "coll", "datatype", "op", "bytes", "iters",
+	       "usec_avg", "usec_min", "usec_p50", "usec_p99", "usec_max",
+	       "algbw_MB/s");
+}
+
+/*
+ * Algorithmic bandwidth is the data each rank ends up with divided by the
+ * average latency: the whole gathered buffer for allgather, the message
+ * for the other collectives.
+ */
+static int bench_report(enum bench_coll coll, enum fi_datatype datatype,
+			enum fi_op op, size_t size, int iters)
+{
+	char size_buf[FT_STR_LEN], iters_buf[FT_STR_LEN];
+	char dt_str[32], op_str[32];
+	uint64_t sum = 0, *rank_samples;
+	size_t alg_size = size;
+	double avg, algbw;
+	size_t r;
+	int i, ret;
+
+	ret = pm_allgather(samples, all_samples, iters * sizeof(*samples));
+	if (ret)
+		return ret;
+
+	if (pm_job.my_rank)
+		return 0;
+
+	for (r = 1; r < pm_job.num_ranks; r++) {
+		rank_samples = &all_samples[r * iters];
+		for (i = 0; i < iters; i++) {
+			if (rank_samples[i] > all_samples[i])
+				all_samples[i] = rank_samples[i];
+		}
+	}
+	for (i = 0; i < iters; i++)
+		sum += all_samples[i];
+	qsort(all_samples, iters, sizeof(*all_samples), bench_sample_cmp);
+
+	avg = (double) sum / iters / 1000.0;
+	if (coll == BENCH_ALLGATHER)
+		alg_size *= pm_job.num_ranks;
+	algbw = avg > 0 ? alg_size / avg : 0;
+
+	if (coll == BENCH_ALLREDUCE) {
+		fi_tostr_r(dt_str, sizeof(dt_str), &datatype,
+			   FI_TYPE_ATOMIC_TYPE);
+		fi_tostr_r(op_str, sizeof(op_str), &op, FI_TYPE_ATOMIC_OP);
+	} else {
+		strcpy(dt_str, coll == BENCH_BARRIER ? "-" : "bytes");
+		strcpy(op_str, "-");
+	}
+
+	if (ft_check_opts(FT_OPT_JSON)) {
+		ft_json_begin(bench_colls[coll].name, size, iters);
+		ft_json_str("datatype", dt_str);
+		ft_json_str("op", op_str);
+		printf(", \"ranks\": %zu, \"latency_usec\": {\"avg\": %f, "
+		       "\"min\": %f, \"p50\": %f, \"p99\": %f, "
+		       "\"max\": %f}, \"algbw_MB_per_sec\": %f",
+		       pm_job.num_ranks, avg, all_samples[0] / 1000.0,
+		       ft_percentile(all_samples, iters, 50) / 1000.0,
+		       ft_percentile(all_samples, iters, 99) / 1000.0,
+		       all_samples[iters - 1] / 1000.0, algbw);
+		ft_json_end();
+	} else if (opts.machr) {
+		printf("- { coll: %s, datatype: %s, op: %s, ranks: %zu, "
+		       "xfer_size: %zu, iterations: %d, usec_avg: %f, "
+		       "usec_min: %f, usec_p50: %f, usec_p99: %f, "
+		       "usec_max: %f, algbw_MB/s: %f }\n",
+		       bench_colls[coll].name, dt_str, op_str,
+		       pm_job.num_ranks, size, iters, avg,
+		       all_samples[0] / 1000.0,
+		       ft_percentile(all_samples, iters, 50) / 1000.0,
+		       ft_percentile(all_samples, iters, 99) / 1000.0,
+		       all_samples[iters - 1] / 1000.0, algbw);
+	} else {
+		printf("%-10s %-12s %-7s %-8s %-8s %-10.2f %-10.2f %-10.2f "
+		       "%-10.2f %-10.2f %.2f\n", bench_colls[coll].name,
+		       dt_str, op_str, size_str(size_buf, size),
+		       cnt_str(iters_buf, iters),
+		       avg, all_samples[0] / 1000.0,
+		       ft_percentile(all_samples, iters, 50) / 1000.0,
+		       ft_percentile(all_samples, iters, 99) / 1000.0,
+		       all_samples[iters - 1] / 1000.0, algbw);
+	}
+	fflush(stdout);
+	return 0;
+}
+
+/*
+ * Iterations start together after an untimed barrier.  Otherwise the root
+ * of a broadcast or scatter could run ahead, and the other ranks would
+ * find their data already waiting.
+ */
+static int bench_run_size(enum bench_coll coll, enum fi_datatype datatype,
+			  enum fi_op op, size_t size)
+{
+	struct fi_context2 ctx;
+	size_t dt_size, count;
+	uint64_t start;
+	int i, iters, ret;
+
+	dt_size = datatype_to_size(datatype);
+	count = dt_size ? size / dt_size : 0;
+	iters = (opts.options & FT_OPT_ITER) ? opts.iterations :
+		size_to_count(size);
+	if (iters > max_iters)
+		iters = max_iters;
+
+	pm_barrier();
+	for (i = -opts.warmup_iterations; i < iters; i++) {
+		if (coll != BENCH_BARRIER) {
+			ret = (int) fi_barrier(ep, coll_addr, &ctx);
+			if (ret) {
+				FT_PRINTERR("fi_barrier", ret);
+				return ret;
+			}
+
+			ret = bench_wait_cq(&ctx);
+			if (ret)
+				return ret;
+		}
+
+		start = ft_gettime_ns();
+		ret = (int) bench_post(coll, count, datatype, op, &ctx);
+		if (ret) {
+			FT_PRINTERR("fi_collective", ret);
+			return ret;
+		}
+
+		ret = bench_wait_cq(&ctx);
+		if (ret)
+			return ret;
+
+		if (i >= 0)
+			samples[i] = ft_gettime_ns() - start;
+	}
+
+	return bench_report(coll, datatype, op, size, iters);
+}
+
+static int bench_sweep(enum bench_coll coll, enum fi_datatype datatype,
+		       enum fi_op op)
+{
+	struct fi_collective_attr attr = { 0 };
+	char dt_str[32], op_str[32];
+	size_t dt_size;
+	int i, ret;
+
+	attr.op = coll == BENCH_ALLREDUCE ? op : FI_NOOP;
+	attr.datatype = coll == BENCH_BARRIER ? FI_VOID : datatype;
+	ret = fi_query_collective(domain, bench_colls[coll].op, &attr, 0);
+	if (ret) {
+		if (!pm_job.my_rank && !opts.machr &&
+		    !ft_check_opts(FT_OPT_JSON)) {
+			fi_tostr_r(dt_str, sizeof(dt_str), &attr.datatype,
+				   FI_TYPE_ATOMIC_TYPE);
+			fi_tostr_r(op_str, sizeof(op_str), &attr.op,
+				   FI_TYPE_ATOMIC_OP);
+			printf("# %s %s %s not supported: %s\n",
+			       bench_colls[coll].name, dt_str, op_str,
+			       fi_strerror(-ret));
+		}
+		return 0;
+	}
+
+	if (attr.max_members < pm_job.num_ranks) {
+		FT_ERR("%s supports %zu members", bench_colls[coll].name,
+		       attr.max_members);
+		return -FI_EINVAL;
+	}
+
+	if (coll == BENCH_BARRIER)
+		return bench_run_size(coll, FI_VOID, FI_NOOP, 0);
+
+	if (opts.options & FT_OPT_SIZE)
+		return bench_run_size(coll, datatype, op, opts.transfer_size);
+
+	dt_size = datatype_to_size(datatype);
+	for (i = 0; i < TEST_CNT; i++) {
+		if (!ft_use_size(i, opts.sizes_enabled) ||
+		    test_size[i].size % dt_size)
+			continue;
+
+		ret = bench_run_size(coll, datatype, op, test_size[i].size);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int bench_allreduce(void)
+{
+	int first_dt, last_dt, first_op, last_op, dt, op, ret;
+
+	first_dt = last_dt = bench_datatype;
+	if (bench_datatype == BENCH_ALL) {
+		first_dt = FI_INT8;
+		last_dt = FI_UINT128;
+	}
+	first_op = last_op = bench_op;
+	if (bench_op == BENCH_ALL) {
+		first_op = FI_MIN;
+		last_op = FI_BXOR;
+	}
+
+	for (dt = first_dt; dt <= last_dt; dt++) {
+		for (op = first_op; op <= last_op; op++) {
+			ret = bench_sweep(BENCH_ALLREDUCE, dt, op);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
+static int bench_alloc(void)
+{
+	size_t gather_size;
+	int i;
+
+	if (opts.options & FT_OPT_SIZE) {
+		max_size = opts.transfer_size;
+	} else {
+		for (i = 0; i < TEST_CNT; i++) {
+			if (ft_use_size(i, opts.sizes_enabled))
+				max_size = test_size[i].size;
+		}
+	}
+	max_iters = (opts.options & FT_OPT_ITER) ? opts.iterations :
+		    size_to_count(1);
+
+	/* allgather and scatter need room for every rank's data */
+	gather_size = max_size * pm_job.num_ranks;
+	send_buf = calloc(1, gather_size);
+	recv_buf = calloc(1, gather_size);
+	samples = calloc(max_iters, sizeof(*samples));
+	all_samples = calloc(max_iters * pm_job.num_ranks,
+			     sizeof(*all_samples));
+	if (!send_buf || !recv_buf || !samples || !all_samples) {
+		FT_ERR("error allocating benchmark buffers");
+		return -FI_ENOMEM;
+	}
+	return 0;
+}
+
+static void bench_free(void)
+{
+	free(send_buf);
+	free(recv_buf);
+	free(samples);
+	free(all_samples);
+}
+
+static int bench_setup_fabric(void)
+{
+	char my_name[FT_MAX_CTRL_MSG];
+	size_t len;
+	int ret;
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->caps = FI_MSG | FI_COLLECTIVE;
+	hints->mode = FI_CONTEXT;
+	hints->domain_attr->control_progress = FI_PROGRESS_MANUAL;
+	hints->domain_attr->data_progress = FI_PROGRESS_MANUAL;
+	if (!hints->fabric_attr->prov_name)
+		hints->fabric_attr->prov_name = strdup("tcp");
+
+	ret = ft_getinfo(hints, &fi);
+	if (ret)
+		return ret;
+
+	ret = ft_open_fabric_res();
+	if (ret)
+		return ret;
+
+	opts.av_size = pm_job.num_ranks;
+	av_attr.type = FI_AV_TABLE;
+	ret = ft_alloc_active_res(fi);
+	if (ret)
+		return ret;
+
+	ret = ft_enable_ep(ep, eq, av, txcq, rxcq, txcntr, rxcntr);
+	if (ret)
+		return ret;
+
+	len = FT_MAX_CTRL_MSG;
+	ret = fi_getname(&ep->fid, (void *) my_name, &len);
+	if (ret) {
+		FT_PRINTERR("fi_getname", ret);
+		return ret;
+	}
+
+	pm_job.name_len = len;
+	pm_job.names = malloc(len * pm_job.num_ranks);
+	pm_job.fi_addrs = calloc(pm_job.num_ranks, sizeof(*pm_job.fi_addrs));
+	if (!pm_job.names || !pm_job.fi_addrs) {
+		FT_ERR("error allocating memory for address exchange");
+		return -FI_ENOMEM;
+	}
+
+	ret = pm_allgather(my_name, pm_job.names, pm_job.name_len);
+	if (ret) {
+		FT_PRINTERR("pm_allgather", ret);
+		return ret;
+	}
+
+	ret = fi_av_insert(av, pm_job.names, pm_job.num_ranks,
+			   pm_job.fi_addrs, 0, NULL);
+	if (ret != pm_job.num_ranks) {
+		FT_ERR("unable to insert all addresses into AV table: %d (%s)",
+		       ret, fi_strerror(-ret));
+		return -FI_EOTHER;
+	}
+	return 0;
+}
+
+int multinode_run_tests(int argc, char **argv)
+{
+	int coll, ret;
+
+	ret = bench_setup_fabric();
+	if (ret)
+		goto out;
+
+	ret = bench_alloc();
+	if (ret)
+		goto out;
+
+	ret = bench_join();
+	if (ret)
+		goto out;
+
+	if (!pm_job.my_rank)
+		bench_print_header();
+
+	for (coll = 0; coll < BENCH_COLL_MAX && !ret; coll++) {
+		if (!(coll_mask & (1 << coll)))
+			continue;
+
+		if (coll == BENCH_ALLREDUCE)
+			ret = bench_allreduce();
+		else
+			ret = bench_sweep(coll, FI_UINT8, FI_NOOP);
+	}
+
+	pm_barrier();
+out:
+	if (coll_mc)
+		fi_close(&coll_mc->fid);
+	if (av_set)
+		fi_close(&av_set->fid);
+	bench_free();
+	free(pm_job.names);
+	free(pm_job.fi_addrs);
+	ft_free_res();
+	return ft_exit_code(ret);
+}
@@ -62,6 +62,7 @@ struct fi_context2 *barrier_tx_ctx, *barrier_rx_ctx;
 struct pattern_ops *pattern;
 struct multinode_xfer_state state;
 struct multi_xfer_method method;
+struct multinode_opts multinode_opts;
 struct multi_xfer_method multi_xfer_methods[] = {
 	{
 		.name = "send/recv",
@@ -58,6 +58,7 @@ struct fid_av_set *av_set;
 fi_addr_t world_addr;
 fi_addr_t coll_addr;
 struct fid_mc *coll_mc;
+struct multinode_opts multinode_opts;
 
 // For the verification
 struct fi_av_set_attr av_set_attr;
@@ -292,10 +292,12 @@ int pm_get_oob_server_addr()
 int main(int argc, char **argv)
 {
 	extern char *optarg;
+	char optstr[128];
 	int c, ret;
 
 	opts = INIT_OPTS;
-	opts.options |= FT_OPT_SIZE;
+	if (!multinode_opts.size_sweep)
+		opts.options |= FT_OPT_SIZE;
 
 	pm_job.clients = NULL;
 
@@ -303,9 +305,21 @@ int main(int argc, char **argv)
 	if (!hints)
 		return EXIT_FAILURE;
 
-	while ((c = getopt(argc, argv, "n:C:h" CS_OPTS INFO_OPTS)) != -1) {
+	snprintf(optstr, sizeof(optstr), "n:C:h" CS_OPTS INFO_OPTS "%s",
+		 multinode_opts.optstr ? multinode_opts.optstr : "");
+
+	while ((c = getopt_long(argc, argv, optstr, long_opts,
+				&lopt_idx)) != -1) {
 		switch (c) {
 		default:
+			if (!ft_parse_long_opts(c, optarg))
+				continue;
+			if (multinode_opts.parse &&
+			    strchr(multinode_opts.optstr, c)) {
+				if (multinode_opts.parse(c, optarg))
+					return EXIT_FAILURE;
+				break;
+			}
 			ft_parse_addr_opts(c, optarg, &opts);
 			ft_parseinfo(c, optarg, hints, &opts);
 			ft_parsecsopts(c, optarg, &opts);
@@ -318,7 +332,12 @@ int main(int argc, char **argv)
 			break;
 		case '?':
 		case 'h':
-			ft_usage(argv[0], "A simple multinode test");
+			ft_usage(argv[0], multinode_opts.desc ?
+				 (char *) multinode_opts.desc :
+				 "A simple multinode test");
+			if (multinode_opts.usage)
+				multinode_opts.usage();
+			ft_longopts_usage();
 			return EXIT_FAILURE;
 		}
 	}
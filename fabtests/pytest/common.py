@@ -268,15 +268,18 @@ class ClientServerTest:
             client_process.terminate()
             client_timed_out = True
 
+        self._server_output = open(server_outfile).read()
+        self._client_output = open(client_outfile).read()
+        os.unlink(server_outfile)
+        os.unlink(client_outfile)
+
         print("")
         print("server_command: " + self._server_command)
         print("server_stdout:")
-        print(open(server_outfile).read())
-        os.unlink(server_outfile)
+        print(self._server_output)
         print("client_command: " + self._client_command)
         print("client_stdout:")
-        print(open(client_outfile).read())
-        os.unlink(client_outfile)
+        print(self._client_output)
 
         assert not server_timed_out, "server timed out"
         assert not client_timed_out, "client timed out"
@@ -357,3 +360,36 @@ class MultinodeTest:
 
         check_returncode_list(returncode_list, strict)
 
+class PerfTest(ClientServerTest):
+    """
+    Runs a benchmark with --json and collects the client's results.  When
+    --perf-results is given, the records are appended to that file, one
+    JSON object per line, for comparison with scripts/compare_perf.py.
+    """
+
+    def __init__(self, cmdline_args, executable, message_size=None,
+                 iteration_type=None):
+        super().__init__(cmdline_args, executable + " --json",
+                         iteration_type=iteration_type,
+                         message_size=message_size)
+
+    def run(self):
+        import json
+
+        super().run()
+
+        records = []
+        for line in self._client_output.splitlines():
+            line = line.strip()
+            if line.startswith("{"):
+                records.append(json.loads(line))
+
+        if not records:
+            pytest.fail("no JSON results in client output")
+
+        if self._cmdline_args.perf_results:
+            with open(self._cmdline_args.perf_results, "a") as results:
+                for record in records:
+                    results.write(json.dumps(record) + "\n")
+
+        return records
@@ -0,0 +1,16 @@
+import pytest
+
+# Each benchmark runs its default size sweep.  Use --perf-results to keep
+# the JSON records, and scripts/compare_perf.py to compare two runs.
+@pytest.mark.perf
+@pytest.mark.parametrize("executable", ["fi_rdm_pingpong",
+                                        "fi_rdm_tagged_pingpong",
+                                        "fi_rdm_tagged_bw",
+                                        "fi_msg_pingpong",
+                                        "fi_msg_bw",
+                                        "fi_rma_bw -e rdm -o write",
+                                        "fi_rma_bw -e rdm -o read"])
+def test_perf(cmdline_args, executable):
+    from common import PerfTest
+    test = PerfTest(cmdline_args, executable)
+    test.run()
@@ -0,0 +1 @@
+from default.test_perf import test_perf
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+#
+# Compare two sets of fabtests benchmark results written with --json.
+#
+# Each input file holds one JSON record per line; other lines, such as
+# those from a captured benchmark stdout, are ignored.  Records are matched
+# on the fields that describe the test (test, provider, ep_type, xfer_size,
+# and benchmark specific parameters such as threads or datatype).  When a
+# test was run more than once, the median of each metric is used.
+#
+# The exit status is 1 if any metric regressed by more than its threshold,
+# which makes the script usable as a gate:
+#
+#   runfabtests.py -t perf --perf-results base.json tcp server client
+#   <upgrade>
+#   runfabtests.py -t perf --perf-results new.json tcp server client
+#   compare_perf.py base.json new.json -t 5 -m latency_usec.p99=10
+#
+
+import sys
+import json
+import argparse
+from statistics import median
+
+# Metrics and whether a larger value is better
+METRICS = {
+    "MB_per_sec": True,
+    "Mxfers_per_sec": True,
+    "Mmsgs_per_sec": True,
+    "algbw_MB_per_sec": True,
+    "pair_min_Mmsgs_per_sec": True,
+    "fairness": True,
+    "scaling": True,
+    "usec_per_xfer": False,
+    "latency_usec.min": False,
+    "latency_usec.avg": False,
+    "latency_usec.p50": False,
+    "latency_usec.p90": False,
+    "latency_usec.p99": False,
+    "latency_usec.p99.9": False,
+    "latency_usec.max": False,
+}
+
+DEFAULT_METRICS = ["MB_per_sec", "usec_per_xfer", "Mmsgs_per_sec",
+                   "algbw_MB_per_sec", "latency_usec.p50",
+                   "latency_usec.p99"]
+
+# Fields that neither identify a test nor are compared
+IGNORED = {"fabric", "domain", "iterations", "time_sec", "total_bytes",
+           "pair_max_Mmsgs_per_sec"}
+
+def flatten(record, prefix=""):
+    flat = {}
+    for k, v in record.items():
+        if isinstance(v, dict):
+            flat.update(flatten(v, prefix + k + "."))
+        else:
+            flat[prefix + k] = v
+    return flat
+
+def record_key(flat):
+    key = []
+    for k in sorted(flat):
+        if k in METRICS or k in IGNORED or k.startswith("latency_usec."):
+            continue
+        if k.startswith("hints.") and k != "hints.provider":
+            continue
+        key.append((k, flat[k]))
+    return tuple(key)
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                flat = flatten(json.loads(line))
+            except ValueError as e:
+                print("{}:{}: {}".format(path, lineno, e), file=sys.stderr)
+                continue
+            runs = results.setdefault(record_key(flat), {})
+            for k, v in flat.items():
+                if k in METRICS and isinstance(v, (int, float)):
+                    runs.setdefault(k, []).append(v)
+    return {key: {k: median(v) for k, v in runs.items()}
+            for key, runs in results.items()}
+
+def key_str(key):
+    fields = dict(key)
+    name = fields.pop("test", "?")
+    for k in ("name", "provider", "hints.provider", "ep_type", "xfer_size"):
+        if k in fields:
+            name += " " + str(fields.pop(k))
+    name += "".join(" {}={}".format(k, v) for k, v in fields.items())
+    return name
+
+def parse_thresholds(args):
+    thresholds = {}
+    for spec in args.metric_threshold or []:
+        metric, _, pct = spec.partition("=")
+        if metric not in METRICS or not pct:
+            raise SystemExit("invalid metric threshold: " + spec)
+        thresholds[metric] = float(pct)
+    return thresholds
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare two sets of fabtests --json benchmark results.")
+    parser.add_argument("base", help="baseline results")
+    parser.add_argument("new", help="results to check against the baseline")
+    parser.add_argument("-t", "--threshold", type=float, default=5.0,
+                        help="allowed regression in percent (default 5)")
+    parser.add_argument("-m", "--metric-threshold", action="append",
+                        metavar="METRIC=PCT",
+                        help="threshold for one metric, may be repeated")
+    parser.add_argument("--metrics", default=",".join(DEFAULT_METRICS),
+                        help="comma separated metrics to compare "
+                             "(default: %(default)s)")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="show every comparison, not only regressions")
+    args = parser.parse_args()
+
+    metrics = args.metrics.split(",")
+    for metric in metrics:
+        if metric not in METRICS:
+            raise SystemExit("unknown metric: " + metric)
+    thresholds = parse_thresholds(args)
+
+    base = load(args.base)
+    new = load(args.new)
+
+    regressions = improvements = compared = 0
+    for key in sorted(set(base) & set(new), key=key_str):
+        for metric in metrics:
+            if metric not in base[key] or metric not in new[key]:
+                continue
+            old_val, new_val = base[key][metric], new[key][metric]
+            if not old_val:
+                continue
+
+            change = (new_val - old_val) / old_val * 100.0
+            if not METRICS[metric]:
+                change = -change
+            limit = thresholds.get(metric, args.threshold)
+            compared += 1
+
+            if change < -limit:
+                status = "REGRESSION"
+                regressions += 1
+            elif change > limit:
+                status = "improved"
+                improvements += 1
+            elif args.verbose:
+                status = "ok"
+            else:
+                continue
+
+            print("{:<10} {:<60} {:<20} {:>14.3f} {:>14.3f} {:>+8.1f}%".format(
+                  status, key_str(key), metric, old_val, new_val, change))
+
+    for key in sorted(set(base) - set(new), key=key_str):
+        print("missing    " + key_str(key))
+    for key in sorted(set(new) - set(base), key=key_str):
+        print("new        " + key_str(key))
+
+    print("{} comparisons, {} regressions, {} improvements "
+          "(change is positive when better)".format(
+          compared, regressions, improvements))
+    return 1 if regressions else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
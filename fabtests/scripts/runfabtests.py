@@ -287,7 +287,7 @@ def main():
     parser.add_argument("server_id", type=str, help="server ip or hostname")
     parser.add_argument("client_id", type=str, help="client ip or hostname")
     parser.add_argument("-t", dest="testsets", type=str, default="quick",
-                        help="test set(s): all,quick,unit,functional,standard,short,ubertest (default quick)")
+                        help="test set(s): all,quick,unit,functional,standard,short,ubertest,perf (default quick)")
     parser.add_argument("-v", dest="verbose", action="count", default=0,
                         help="verbosity level"
                              "-v: print extra info for failed test(s)"
@@ -303,6 +303,9 @@ def main():
     add_common_arguments(parser, shared_options)
 
     fabtests_args = parser.parse_args()
+    # pytest runs from its root directory
+    if fabtests_args.perf_results:
+        fabtests_args.perf_results = os.path.abspath(fabtests_args.perf_results)
     pytest_args = fabtests_args_to_pytest_args(fabtests_args, shared_options)
 
     os.chdir(pytest_root_dir)
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <limits.h>
+#include <time.h>
+
+#include <rdma/fi_cm.h>
+#include <rdma/fi_errno.h>
+#include <rdma/fi_tagged.h>
+
+#include "unit_common.h"
+#include "shared.h"
+
+
+static char err_buf[512];
+static size_t max_recvs = 100000;
+static int directed;
+
+static struct fid_cq *tm_cq;
+static struct fid_av *tm_av;
+static struct fid_ep *tm_rx_ep, *tm_tx_ep;
+static fi_addr_t tm_rx_addr, tm_tx_addr;
+static struct fi_context2 *tm_ctx;
+
+
+static int tm_open_ep(struct fid_ep **new_ep, fi_addr_t *addr)
+{
+	char name[256];
+	size_t len = sizeof(name);
+	int ret;
+
+	ret = fi_endpoint(domain, fi, new_ep, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_endpoint", ret);
+		return ret;
+	}
+
+	FT_EP_BIND(*new_ep, tm_av, 0);
+	FT_EP_BIND(*new_ep, tm_cq, FI_TRANSMIT | FI_RECV);
+
+	ret = fi_enable(*new_ep);
+	if (ret) {
+		FT_PRINTERR("fi_enable", ret);
+		return ret;
+	}
+
+	ret = fi_getname(&(*new_ep)->fid, name, &len);
+	if (ret) {
+		FT_PRINTERR("fi_getname", ret);
+		return ret;
+	}
+
+	ret = fi_av_insert(tm_av, name, 1, addr, 0, NULL);
+	if (ret != 1) {
+		FT_PRINTERR("fi_av_insert", ret);
+		return ret < 0 ? ret : -FI_EINVAL;
+	}
+	return 0;
+}
+
+static int tm_open_res(void)
+{
+	struct fi_cq_attr tm_cq_attr = {
+		.format = FI_CQ_FORMAT_TAGGED,
+		.size = max_recvs,
+	};
+	struct fi_av_attr tm_av_attr = {
+		.type = fi->domain_attr->av_type,
+		.count = 2,
+	};
+	int ret;
+
+	tm_ctx = calloc(max_recvs, sizeof(*tm_ctx));
+	if (!tm_ctx)
+		return -FI_ENOMEM;
+
+	ret = fi_cq_open(domain, &tm_cq_attr, &tm_cq, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_cq_open", ret);
+		return ret;
+	}
+
+	ret = fi_av_open(domain, &tm_av_attr, &tm_av, NULL);
+	if (ret) {
+		FT_PRINTERR("fi_av_open", ret);
+		return ret;
+	}
+
+	ret = tm_open_ep(&tm_rx_ep, &tm_rx_addr);
+	if (ret)
+		return ret;
+
+	return tm_open_ep(&tm_tx_ep, &tm_tx_addr);
+}
+
+static void tm_close_res(void)
+{
+	FT_CLOSE_FID(tm_tx_ep);
+	FT_CLOSE_FID(tm_rx_ep);
+	FT_CLOSE_FID(tm_av);
+	FT_CLOSE_FID(tm_cq);
+	free(tm_ctx);
+}
+
+/* Completions carry the tag of the message, and each receive is posted
+ * for a single tag, so every completion must be for the receive posted
+ * with that tag.
+ */
+static int tm_read_cq(size_t cnt, size_t *done)
+{
+	struct fi_cq_tagged_entry comp;
+	int ret;
+
+	ret = fi_cq_read(tm_cq, &comp, 1);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret < 0) {
+		FT_UNIT_STRERR(err_buf, "fi_cq_read failed", ret);
+		return ret;
+	}
+
+	if (comp.tag >= cnt || comp.op_context != &tm_ctx[comp.tag]) {
+		sprintf(err_buf, "tag %lu completed the wrong receive",
+			(unsigned long) comp.tag);
+		return -FI_EOTHER;
+	}
+	(*done)++;
+	return 0;
+}
+
+static int tm_post(size_t cnt)
+{
+	size_t i;
+	int ret;
+
+	for (i = 0; i < cnt; i++) {
+		do {
+			ret = fi_trecv(tm_rx_ep, NULL, 0, NULL,
+				       directed ? tm_tx_addr : FI_ADDR_UNSPEC,
+				       i, 0, &tm_ctx[i]);
+		} while (ret == -FI_EAGAIN);
+		if (ret) {
+			FT_UNIT_STRERR(err_buf, "fi_trecv failed", ret);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+static int tm_send(size_t cnt, int reverse)
+{
+	size_t i, done = 0;
+	uint64_t tag;
+	int ret;
+
+	for (i = 0; i < cnt; i++) {
+		tag = reverse ? cnt - 1 - i : i;
+		do {
+			ret = fi_tinject(tm_tx_ep, NULL, 0, tm_rx_addr, tag);
+			if (ret == -FI_EAGAIN && tm_read_cq(cnt, &done))
+				return -FI_EOTHER;
+		} while (ret == -FI_EAGAIN);
+		if (ret) {
+			FT_UNIT_STRERR(err_buf, "fi_tinject failed", ret);
+			return ret;
+		}
+	}
+
+	while (done < cnt) {
+		ret = tm_read_cq(cnt, &done);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static double tm_elapsed(struct timespec *start, struct timespec *end,
+			 size_t cnt)
+{
+	return ((end->tv_sec - start->tv_sec) * 1e9 +
+		(end->tv_nsec - start->tv_nsec)) / cnt;
+}
+
+/* Receives are posted for tags 0 to cnt - 1, and matched by messages sent
+ * in the same or in reverse order.  Matching in reverse order finds the
+ * receive for each message behind all receives posted before it, unless
+ * posted receives are indexed by tag.
+ */
+static int tm_run(int reverse)
+{
+	struct timespec start, posted, end;
+	size_t cnt;
+	int ret;
+
+	printf("\n");
+	for (cnt = 1000; cnt <= max_recvs; cnt *= 10) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ret = tm_post(cnt);
+		if (ret)
+			return FAIL;
+
+		clock_gettime(CLOCK_MONOTONIC, &posted);
+		ret = tm_send(cnt, reverse);
+		if (ret)
+			return FAIL;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		printf("  %7zu receives: post %8.1f ns/recv, match %8.1f ns/msg\n",
+		       cnt, tm_elapsed(&start, &posted, cnt),
+		       tm_elapsed(&posted, &end, cnt));
+	}
+	return PASS;
+}
+
+static int tag_match_fwd(void)
+{
+	return tm_run(0);
+}
+
+static int tag_match_rev(void)
+{
+	return tm_run(1);
+}
+
+struct test_entry test_array[] = {
+	TEST_ENTRY(tag_match_fwd, "Match messages in posting order"),
+	TEST_ENTRY(tag_match_rev, "Match messages in reverse posting order"),
+	{ NULL, "" }
+};
+
+static void usage(char *name)
+{
+	ft_unit_usage(name, "Benchmark matching of posted tagged receives");
+	FT_PRINT_OPTS_USAGE("-n <count>",
+		"largest number of posted receives (default: 100000)");
+	FT_PRINT_OPTS_USAGE("-r", "post receives for the sender's address");
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret;
+	int failed = 0;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, FAB_OPTS "hn:r")) != -1) {
+		switch (op) {
+		default:
+			ft_parseinfo(op, optarg, hints, &opts);
+			break;
+		case 'n':
+			max_recvs = strtoul(optarg, NULL, 10);
+			if (max_recvs < 1000 || max_recvs == ULONG_MAX) {
+				FT_PRINTERR("Invalid receive count", -FI_EINVAL);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			directed = 1;
+			break;
+		case '?':
+		case 'h':
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->caps = FI_TAGGED;
+	if (directed)
+		hints->caps |= FI_DIRECTED_RECV;
+	hints->mode = FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->mr_mode = FI_MR_LOCAL | OFI_MR_BASIC_MAP;
+
+	ret = fi_getinfo(FT_FIVERSION, NULL, 0, 0, hints, &fi);
+	if (ret) {
+		FT_PRINTERR("fi_getinfo", ret);
+		goto out;
+	}
+
+	ret = ft_open_fabric_res();
+	if (ret)
+		goto out;
+
+	ret = tm_open_res();
+	if (ret)
+		goto close;
+
+	printf("Testing tag matching on fabric %s provider %s\n",
+	       fi->fabric_attr->name, fi->fabric_attr->prov_name);
+
+	failed = run_tests(test_array, err_buf);
+	if (failed > 0)
+		printf("Summary: %d tests failed\n", failed);
+	else
+		printf("Summary: all tests passed\n");
+
+close:
+	tm_close_res();
+out:
+	ft_free_res();
+	return ret ? ft_exit_code(ret) : (failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
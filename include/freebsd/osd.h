@@ -90,6 +90,16 @@ static inline size_t ofi_process_vm_writev(pid_t pid,
 	return -FI_ENOSYS;
 }
 
+static inline int ofi_futex_wait(int *addr, int val, uint64_t timeout_ns)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_futex_wake(int *addr, int cnt)
+{
+	return -FI_ENOSYS;
+}
+
 static inline ssize_t ofi_read_socket(SOCKET fd, void *buf, size_t count)
 {
 	return read(fd, buf, count);
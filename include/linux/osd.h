@@ -47,6 +47,7 @@
 #include <sys/socket.h>
 
 #include <linux/errqueue.h>
+#include <linux/futex.h>
 #include <ifaddrs.h>
 #include "unix/osd.h"
 #include "rdma/fi_errno.h"
@@ -120,6 +121,26 @@ static inline size_t ofi_process_vm_writev(pid_t pid,
 		       remote_iov, riovcnt, flags);
 }
 
+/*
+ * Sleep while *addr == val, for at most timeout_ns.  The word may live in
+ * memory shared between processes.
+ */
+static inline int ofi_futex_wait(int *addr, int val, uint64_t timeout_ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = timeout_ns / 1000000000;
+	ts.tv_nsec = timeout_ns % 1000000000;
+	return syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0) ?
+	       -errno : 0;
+}
+
+static inline int ofi_futex_wake(int *addr, int cnt)
+{
+	return syscall(SYS_futex, addr, FUTEX_WAKE, cnt, NULL, NULL, 0) < 0 ?
+	       -errno : 0;
+}
+
 static inline ssize_t ofi_read_socket(SOCKET fd, void *buf, size_t count)
 {
 	return read(fd, buf, count);
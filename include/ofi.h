@@ -217,9 +217,25 @@ enum {
 	OFI_CLFLUSHOPT_BIT	= (1 << 23),
 	OFI_CLFLUSH_REG		= 3,
 	OFI_CLFLUSH_BIT		= (1 << 19),
+	OFI_OSXSAVE_REG		= 2,
+	OFI_OSXSAVE_BIT		= (1 << 27),
+	OFI_AVX2_REG		= 1,
+	OFI_AVX2_BIT		= (1 << 5),
+	OFI_AVX512F_REG		= 1,
+	OFI_AVX512F_BIT		= (1 << 16),
 };
 
-int ofi_cpu_supports(unsigned func, unsigned reg, unsigned bit);
+static inline int ofi_cpu_supports(unsigned func, unsigned reg, unsigned bit)
+{
+	unsigned cpuinfo[4] = { 0 };
+
+	ofi_cpuid(0, 0, cpuinfo);
+	if (cpuinfo[0] < func)
+		return 0;
+
+	ofi_cpuid(func, 0, cpuinfo);
+	return cpuinfo[reg] & bit;
+}
 
 
 enum ofi_prov_type {
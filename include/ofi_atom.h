@@ -359,6 +359,15 @@ typedef atomic_long	ofi_atomic_int64_t;
 
 #endif // HAVE_ATOMICS
 
+/* Full memory barrier, for ordering a store before a later load */
+#ifndef ofi_atomic_fence
+#ifdef HAVE_ATOMICS
+#define ofi_atomic_fence() atomic_thread_fence(memory_order_seq_cst)
+#else
+#define ofi_atomic_fence() __sync_synchronize()
+#endif
+#endif
+
 OFI_ATOMIC_DEFINE(32)
 OFI_ATOMIC_DEFINE(64)
 
@@ -40,6 +40,7 @@
 
 #include <rdma/fi_domain.h>
 #include <stdbool.h>
+#include <ofi_mem.h>
 
 extern bool ofi_hmem_disable_p2p;
 
@@ -215,7 +216,7 @@ bool synapseai_is_ipc_enabled(void);
 static inline int ofi_memcpy(uint64_t device, void *dest, const void *src,
 			     size_t size)
 {
-	memcpy(dest, src, size);
+	ofi_copy(dest, src, size);
 	return FI_SUCCESS;
 }
 
@@ -283,6 +283,7 @@ extern struct fi_ops_domain hook_domain_ops;
 extern struct fi_ops_cq hook_cq_ops;
 extern struct fi_ops_cntr hook_cntr_ops;
 
+extern struct fi_ops_ep hook_ep_ops;
 extern struct fi_ops_cm hook_cm_ops;
 extern struct fi_ops_msg hook_msg_ops;
 extern struct fi_ops_rma hook_rma_ops;
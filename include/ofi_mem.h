@@ -518,4 +518,53 @@ extern uint64_t OFI_RMA_PMEM;
 extern void (*ofi_pmem_commit)(const void *addr, size_t len);
 
 
+/*
+ * Memory copy engine.  Copies of at least ofi_copy_nt_size bytes use
+ * non-temporal stores, with the widest vector instructions available, so
+ * that they do not evict the working set from the cache.  Smaller copies
+ * use memcpy.
+ */
+struct ofi_copy_vec {
+	void		*dst;
+	const void	*src;
+	size_t		len;
+};
+
+#ifdef __GNUC__
+#define ofi_prefetch(addr)	__builtin_prefetch(addr)
+#else
+#define ofi_prefetch(addr)	do { } while (0)
+#endif
+
+void ofi_copy_init(void);
+int ofi_copy_select(const char *name, size_t nt_size);
+void ofi_copy_batch(const struct ofi_copy_vec *vec, size_t count);
+
+extern size_t ofi_copy_nt_size;
+extern void (*ofi_copy_nt)(void *dst, const void *src, size_t len);
+extern const char *ofi_copy_engine_name;
+
+static inline void ofi_copy(void *dst, const void *src, size_t len)
+{
+	if (len < ofi_copy_nt_size)
+		memcpy(dst, src, len);
+	else
+		ofi_copy_nt(dst, src, len);
+}
+
+/*
+ * Copy pool.  Helper threads share large copies with the calling thread.
+ * ofi_copy_pool_run splits size bytes into page aligned chunks and calls
+ * copy for each one, possibly in parallel, returning once all are done.
+ * If copy fails for any chunk, one of its errors is returned.
+ */
+struct ofi_copy_pool;
+
+int ofi_copy_pool_open(size_t thread_cnt, struct ofi_copy_pool **pool);
+void ofi_copy_pool_close(struct ofi_copy_pool *pool);
+int ofi_copy_pool_run(struct ofi_copy_pool *pool, size_t size,
+		      int (*copy)(void *arg, size_t offset, size_t len),
+		      void *arg);
+
+
 #endif /* _OFI_MEM_H_ */
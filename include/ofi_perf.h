@@ -166,6 +166,7 @@ int ofi_perfset_create(const struct fi_provider *prov,
 void ofi_perfset_close(struct ofi_perfset *set);
 
 void ofi_perfset_log(struct ofi_perfset *set, const char **names);
+const char *ofi_perf_name(void);
 
 static inline void ofi_perfset_start(struct ofi_perfset *set, size_t index)
 {
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#ifndef _OFI_PROBE_H_
+#define _OFI_PROBE_H_
+
+#include "config.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hot path probes
+ *
+ * Probes time named stages inside providers, such as matching or copying
+ * data, which the perf hook cannot see.  They are compiled to nothing unless
+ * libfabric is configured with --enable-probes.  Each thread accumulates its
+ * own counts.  When the library is unloaded, the totals are appended to the
+ * file named by FI_PROBE_FILE, which can be displayed using fi_probe.
+ *
+ * A stage is timed from OFI_PROBE_START to OFI_PROBE_END, or around a
+ * single statement with OFI_PROBE.  OFI_PROBE_START declares a local
+ * variable holding the start time, so the matching OFI_PROBE_END must be
+ * in the same scope.  Stages include the time of any stages nested inside
+ * them.  A stage nested inside itself, such as reading a util CQ while
+ * progressing another, is counted at each level.
+ *
+ * New stages are added to OFI_PROBE_FOREACH.
+ */
+
+#define OFI_PROBE_FOREACH(DECL)		\
+	DECL(util_cq_progress),		\
+	DECL(util_cq_read),		\
+	DECL(util_cq_write),		\
+	DECL(smr_select_proto),		\
+	DECL(smr_tx_proto),		\
+	DECL(smr_rx_match),		\
+	DECL(smr_rx_copy),		\
+	DECL(xnet_sendv),		\
+	DECL(xnet_recv_hdr),		\
+	DECL(xnet_recvv),		\
+	DECL(xnet_rx_match),		\
+	DECL(rxm_send),			\
+	DECL(rxm_msg_cq_read),		\
+	DECL(rxm_rx_match),		\
+	DECL(rxm_rx_copy)
+
+#define OFI_PROBE_ENUM(X) ofi_probe_##X
+#define OFI_PROBE_STR(X) #X
+
+enum ofi_probe_stage {
+	OFI_PROBE_FOREACH(OFI_PROBE_ENUM),
+	ofi_probe_max
+};
+
+#define OFI_PROBE_FILE_VERSION	1
+
+
+#if ENABLE_PROBES
+
+#include <ofi_perf.h>
+
+struct ofi_probe_data {
+	uint64_t	sum;
+	uint64_t	events;
+	uint64_t	min;
+	uint64_t	max;
+};
+
+/* Counters for one thread, written only by that thread */
+struct ofi_probe_thread {
+	struct ofi_probe_thread	*next;
+	struct ofi_perf_ctx	*ctx;
+	uint32_t		id;
+	struct ofi_probe_data	data[ofi_probe_max];
+};
+
+extern __thread struct ofi_probe_thread *ofi_probe_self;
+
+struct ofi_probe_thread *ofi_probe_register(void);
+uint64_t ofi_gettime_ns(void);
+
+static inline struct ofi_probe_thread *ofi_probe_thread(void)
+{
+	if (OFI_UNLIKELY(!ofi_probe_self))
+		ofi_probe_self = ofi_probe_register();
+	return ofi_probe_self;
+}
+
+/* CPU cycles if the PMU can be read, otherwise nanoseconds */
+static inline uint64_t ofi_probe_read(struct ofi_probe_thread *thread)
+{
+	return thread->ctx ? ofi_pmu_read(thread->ctx) : ofi_gettime_ns();
+}
+
+static inline uint64_t ofi_probe_start(void)
+{
+	return ofi_probe_read(ofi_probe_thread());
+}
+
+static inline void ofi_probe_end(enum ofi_probe_stage stage, uint64_t start)
+{
+	struct ofi_probe_thread *thread = ofi_probe_thread();
+	struct ofi_probe_data *data = &thread->data[stage];
+	uint64_t delta;
+
+	delta = ofi_probe_read(thread) - start;
+	if (!data->events || delta < data->min)
+		data->min = delta;
+	if (delta > data->max)
+		data->max = delta;
+	data->sum += delta;
+	data->events++;
+}
+
+#define OFI_PROBE_START(stage) \
+	uint64_t ofi_probe_start_##stage = ofi_probe_start()
+#define OFI_PROBE_END(stage) \
+	ofi_probe_end(ofi_probe_##stage, ofi_probe_start_##stage)
+#define OFI_PROBE(stage, ...)			\
+	do {					\
+		OFI_PROBE_START(stage);		\
+		__VA_ARGS__;			\
+		OFI_PROBE_END(stage);		\
+	} while (0)
+
+#else /* ENABLE_PROBES */
+
+#define OFI_PROBE_START(stage) do { } while (0)
+#define OFI_PROBE_END(stage) do { } while (0)
+#define OFI_PROBE(stage, ...) do { __VA_ARGS__; } while (0)
+
+#endif /* ENABLE_PROBES */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OFI_PROBE_H_ */
@@ -79,6 +79,7 @@ enum {
 	smr_src_mmap,	/* mmap-based fallback protocol */
 	smr_src_sar,	/* segmentation fallback protocol */
 	smr_src_ipc,	/* device IPC handle protocol */
+	smr_src_memfd,	/* persistent memfd region protocol */
 	smr_src_max,
 };
 
@@ -139,6 +140,9 @@ union smr_cmd_data {
 	struct {
 		uint64_t	sar;
 	};
+	struct {
+		uint64_t	memfd_offset;
+	};
 	struct ipc_info		ipc_info;
 };
 
@@ -358,9 +362,22 @@ int	smr_create(const struct fi_provider *prov, struct smr_map *map,
 		   const struct smr_attr *attr, struct smr_region *volatile *smr);
 void	smr_free(struct smr_region *smr);
 
+/*
+ * The signal word is also a futex.  An idle owner moves it from 0 to
+ * SMR_SIGNAL_SLEEP before sleeping on it, and the sender that replaces
+ * SMR_SIGNAL_SLEEP with 1 wakes it.  Senders skip the syscall otherwise.
+ */
+#define SMR_SIGNAL_SLEEP 2
+
 static inline void smr_signal(struct smr_region *smr)
 {
-	ofi_atomic_set32(&smr->signal, 1);
+	while (ofi_atomic_get32(&smr->signal) != 1 &&
+	       !ofi_atomic_cas_bool32(&smr->signal, 0, 1)) {
+		if (ofi_atomic_cas_bool32(&smr->signal, SMR_SIGNAL_SLEEP, 1)) {
+			(void) ofi_futex_wake((int *) &smr->signal, INT_MAX);
+			break;
+		}
+	}
 }
 
 #ifdef __cplusplus
@@ -42,6 +42,9 @@
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #include <ofi_file.h>
 #include <ofi_osd.h>
@@ -60,7 +63,42 @@ struct fd_signal {
 	int byte_avail;
 };
 
-static inline int fd_signal_init(struct fd_signal *signal)
+/* Where available, an eventfd serves as both ends of the signal.  It
+ * costs one descriptor instead of two, and reading it once clears any
+ * number of signals.
+ */
+#ifdef HAVE_SYS_EVENTFD_H
+static inline int fd_signal_open(struct fd_signal *signal)
+{
+	signal->fd[FI_READ_FD] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (signal->fd[FI_READ_FD] < 0)
+		return -errno;
+
+	signal->fd[FI_WRITE_FD] = signal->fd[FI_READ_FD];
+	return 0;
+}
+
+static inline void fd_signal_close(struct fd_signal *signal)
+{
+	close(signal->fd[FI_READ_FD]);
+}
+
+static inline int fd_signal_write(struct fd_signal *signal)
+{
+	uint64_t val = 1;
+
+	return write(signal->fd[FI_WRITE_FD], &val, sizeof val) == sizeof val;
+}
+
+static inline int fd_signal_read(struct fd_signal *signal)
+{
+	uint64_t val;
+
+	return read(signal->fd[FI_READ_FD], &val, sizeof val) == sizeof val ?
+	       signal->byte_avail : 0;
+}
+#else
+static inline int fd_signal_open(struct fd_signal *signal)
 {
 	int ret;
 
@@ -68,45 +106,70 @@ static inline int fd_signal_init(struct fd_signal *signal)
 	if (ret < 0)
 		return -ofi_sockerr();
 
-	signal->byte_avail = 0;
-	ret = ofi_mutex_init(&signal->lock);
-	if (ret)
-		goto err1;
-
 	/* The read fd is accessed directly by fd_signal users to add
 	 * it to epoll fd's and wait sets.
 	 */
 	ret = fi_fd_nonblock(signal->fd[FI_READ_FD]);
-	if (ret)
-		goto err2;
-
-	return 0;
+	if (ret) {
+		ofi_close_socket(signal->fd[0]);
+		ofi_close_socket(signal->fd[1]);
+	}
+	return ret;
+}
 
-err2:
-	ofi_mutex_destroy(&signal->lock);
-err1:
+static inline void fd_signal_close(struct fd_signal *signal)
+{
 	ofi_close_socket(signal->fd[0]);
 	ofi_close_socket(signal->fd[1]);
+}
+
+static inline int fd_signal_write(struct fd_signal *signal)
+{
+	char c = 0;
+
+	return ofi_write_socket(signal->fd[FI_WRITE_FD], &c, sizeof c) ==
+	       sizeof c;
+}
+
+static inline int fd_signal_read(struct fd_signal *signal)
+{
+	char c;
+
+	return ofi_read_socket(signal->fd[FI_READ_FD], &c, sizeof c) ==
+	       sizeof c;
+}
+#endif
+
+static inline int fd_signal_init(struct fd_signal *signal)
+{
+	int ret;
+
+	ret = fd_signal_open(signal);
+	if (ret)
+		return ret;
+
+	signal->byte_avail = 0;
+	ret = ofi_mutex_init(&signal->lock);
+	if (ret)
+		fd_signal_close(signal);
 	return ret;
 }
 
 static inline void fd_signal_free(struct fd_signal *signal)
 {
-	ofi_close_socket(signal->fd[0]);
-	ofi_close_socket(signal->fd[1]);
+	fd_signal_close(signal);
 	ofi_mutex_destroy(&signal->lock);
 }
 
 static inline void fd_signal_set(struct fd_signal *signal)
 {
-	char c = 0;
 	int ret;
 
 	ofi_mutex_lock(&signal->lock);
 	if (!signal->byte_avail) {
-		ret = ofi_write_socket(signal->fd[FI_WRITE_FD], &c, sizeof c);
-		assert(ret == sizeof c);
-		if (ret == sizeof c)
+		ret = fd_signal_write(signal);
+		assert(ret);
+		if (ret)
 			signal->byte_avail++;
 	}
 	ofi_mutex_unlock(&signal->lock);
@@ -131,14 +194,13 @@ static inline int fd_signal_poll(struct fd_signal *signal, int timeout)
  */
 static inline void fd_signal_reset(struct fd_signal *signal)
 {
-	char c;
 	int ret;
 
 	ofi_mutex_lock(&signal->lock);
 	while (signal->byte_avail) {
-		ret = ofi_read_socket(signal->fd[FI_READ_FD], &c, sizeof c);
-		if (ret == sizeof c) {
-			signal->byte_avail--;
+		ret = fd_signal_read(signal);
+		if (ret) {
+			signal->byte_avail -= ret;
 			continue;
 		}
 		if (!OFI_SOCK_TRY_SND_RCV_AGAIN(ofi_sockerr())) {
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef _OFI_TRACE_H_
+#define _OFI_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary trace file format, written by the perf hook and read by fi_trace.
+ *
+ * The file starts with an ofi_trace_hdr, followed by name_len bytes of
+ * NUL terminated names.  Record name fields index into that list.  The rest
+ * of the file is a sequence of ofi_trace_rec.  Records are grouped by the
+ * thread that generated them and are not sorted by time.  All fields are
+ * in host byte order; timestamps are CLOCK_MONOTONIC nanoseconds.
+ */
+
+#define OFI_TRACE_MAGIC		"OFITRACE"
+#define OFI_TRACE_VERSION	1
+
+enum ofi_trace_event {
+	OFI_TRACE_POST,		/* data transfer call, start to return */
+	OFI_TRACE_COMP,		/* completion read from a CQ */
+	OFI_TRACE_COMP_ERR,	/* error completion read from a CQ */
+};
+
+struct ofi_trace_hdr {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	pid;
+	uint32_t	name_cnt;
+	uint32_t	name_len;
+};
+
+struct ofi_trace_rec {
+	uint64_t	start;
+	uint64_t	end;
+	uint64_t	context;
+	uint64_t	len;
+	uint64_t	addr;
+	uint64_t	flags;
+	int32_t		ret;
+	uint16_t	name;
+	uint8_t		event;
+	uint8_t		reserved;
+	uint32_t	tid;
+	uint32_t	reserved2;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OFI_TRACE_H_ */
@@ -58,6 +58,7 @@
 #include <ofi_mr.h>
 #include <ofi_list.h>
 #include <ofi_mem.h>
+#include <ofi_probe.h>
 #include <ofi_rbuf.h>
 #include <ofi_signal.h>
 #include <ofi_enosys.h>
@@ -212,6 +213,12 @@ struct util_domain {
 	struct ofi_mr_map	mr_map;
 	enum fi_threading	threading;
 	enum fi_progress	data_progress;
+
+	/* Endpoints driven by FI_PROGRESS_OPS_1, split by recent activity */
+	ofi_mutex_t		progress_lock;
+	struct dlist_entry	progress_hot;
+	struct dlist_entry	progress_cold;
+	uint32_t		progress_cnt;
 };
 
 int ofi_domain_init(struct fid_fabric *fabric_fid, const struct fi_info *info,
@@ -219,6 +226,8 @@ int ofi_domain_init(struct fid_fabric *fabric_fid, const struct fi_info *info,
 		    enum ofi_lock_type lock_type);
 int ofi_domain_bind(struct fid *fid, struct fid *bfid, uint64_t flags);
 int ofi_domain_close(struct util_domain *domain);
+int ofi_domain_ops_open(struct fid *fid, const char *name, uint64_t flags,
+			void **ops, void *context);
 
 static const uint64_t ofi_rx_mr_flags[] = {
 	[ofi_op_msg] = FI_RECV,
@@ -304,6 +313,11 @@ struct util_ep {
 	ofi_mutex_lock_t	lock_acquire;
 	ofi_mutex_unlock_t	lock_release;
 
+	/* domain progress state, protected by domain->progress_lock */
+	struct dlist_entry	progress_entry;
+	uint64_t		progress_comps;
+	uint32_t		progress_idle;
+
 	struct bitmask		*coll_cid_mask;
 	struct slist		coll_ready_queue;
 };
@@ -318,6 +332,8 @@ int ofi_endpoint_init(struct fid_domain *domain, const struct util_prov *util_pr
 		      ofi_ep_progress_func progress);
 
 int ofi_endpoint_close(struct util_ep *util_ep);
+void ofi_domain_add_ep(struct util_domain *domain, struct util_ep *ep);
+void ofi_domain_remove_ep(struct util_domain *domain, struct util_ep *ep);
 
 static inline int
 ofi_ep_fid_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
@@ -423,6 +439,9 @@ struct util_wait {
 
 	struct dlist_entry	fid_list;
 	ofi_mutex_t		lock;
+
+	/* Time in microseconds fi_wait polls for events before blocking */
+	int			spin;
 };
 
 int ofi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
@@ -439,6 +458,13 @@ struct util_wait_fd {
 		struct ofi_pollfds	*pollfds;
 	};
 	uint64_t		change_index;
+
+	/* Threads blocked on the fd set.  The signal is only written while
+	 * there are any.  Once the fd is handed out through FI_GETWAIT, we
+	 * cannot know who waits on it, and it counts as a permanent sleeper.
+	 */
+	ofi_atomic32_t		sleepers;
+	bool			exported;
 };
 
 typedef int (*ofi_wait_try_func)(void *arg);
@@ -579,6 +605,7 @@ ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 {
 	int ret;
 
+	OFI_PROBE_START(util_cq_write);
 	ofi_genlock_lock(&cq->cq_lock);
 	if (ofi_cirque_freecnt(cq->cirq) > 1) {
 		ofi_cq_write_entry(cq, context, flags, len, buf, data, tag);
@@ -588,6 +615,7 @@ ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 					    buf, data, tag, FI_ADDR_NOTAVAIL);
 	}
 	ofi_genlock_unlock(&cq->cq_lock);
+	OFI_PROBE_END(util_cq_write);
 	return ret;
 }
 
@@ -597,6 +625,7 @@ ofi_cq_write_src(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 {
 	int ret;
 
+	OFI_PROBE_START(util_cq_write);
 	ofi_genlock_lock(&cq->cq_lock);
 	if (ofi_cirque_freecnt(cq->cirq) > 1) {
 		ofi_cq_write_src_entry(cq, context, flags, len, buf, data,
@@ -607,6 +636,7 @@ ofi_cq_write_src(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 					    buf, data, tag, src);
 	}
 	ofi_genlock_unlock(&cq->cq_lock);
+	OFI_PROBE_END(util_cq_write);
 	return ret;
 }
 
@@ -838,6 +868,7 @@ int ofi_ip_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 void *ofi_av_get_addr(struct util_av *av, fi_addr_t fi_addr);
 #define ofi_ip_av_get_addr ofi_av_get_addr
 void *ofi_av_addr_context(struct util_av *av, fi_addr_t fi_addr);
+void *ofi_av_addr_context_checked(struct util_av *av, fi_addr_t fi_addr);
 
 fi_addr_t ofi_ip_av_get_fi_addr(struct util_av *av, const void *addr);
 
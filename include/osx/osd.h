@@ -130,6 +130,16 @@ ofi_send_socket(SOCKET fd, const void *buf, size_t count, int flags)
 	return send(fd, buf, len, flags);
 }
 
+static inline int ofi_futex_wait(int *addr, int val, uint64_t timeout_ns)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_futex_wake(int *addr, int cnt)
+{
+	return -FI_ENOSYS;
+}
+
 static inline ssize_t ofi_read_socket(SOCKET fd, void *buf, size_t count)
 {
 	return ofi_recv_socket(fd, buf, count, 0);
@@ -65,6 +65,7 @@ extern "C" {
 
 #define FI_PROV_SPECIFIC_EFA   (0xefa << 16)
 #define FI_PROV_SPECIFIC_TCP   (0x7cb << 16)
+#define FI_PROV_SPECIFIC_RXM   (0x4d1 << 16)
 
 
 /* negative options are provider specific */
@@ -72,6 +73,33 @@ enum {
        FI_OPT_EFA_RNR_RETRY = -FI_PROV_SPECIFIC_EFA,
 };
 
+enum {
+	FI_OPT_RXM_CONNECT_WINDOW = -FI_PROV_SPECIFIC_RXM,	/* size_t */
+};
+
+/*
+ * rxm connection prewarming:
+ * Start connections to the given peers ahead of the first transfer.
+ * The call returns once the connections are queued; at most
+ * FI_OPT_RXM_CONNECT_WINDOW of them are in progress at any time.
+ */
+#define FI_RXM_PREWARM		FI_PROV_SPECIFIC_RXM
+
+struct fi_rxm_prewarm {
+	const fi_addr_t *addr;
+	size_t count;
+};
+
+static inline int
+fi_rxm_prewarm(struct fid_ep *ep, const fi_addr_t *addr, size_t count)
+{
+	struct fi_rxm_prewarm prewarm;
+
+	prewarm.addr = addr;
+	prewarm.count = count;
+	return fi_control(&ep->fid, FI_RXM_PREWARM, &prewarm);
+}
+
 struct fi_fid_export {
 	struct fid **fid;
 	uint64_t flags;
@@ -96,6 +124,19 @@ fi_import_fid(struct fid *fid, struct fid *expfid, uint64_t flags)
 	return fid->ops->bind(fid, expfid, flags);
 }
 
+/*
+ * Domain progress extension:
+ * Opened with fi_open_ops on a domain.  A single call progresses the
+ * endpoints of the domain that recently generated completions, and the
+ * idle ones at a lower rate, instead of reading every CQ.
+ */
+#define FI_PROGRESS_OPS_1 "fi_progress_ops_v1"
+
+struct fi_ops_progress {
+	size_t	size;
+	int	(*progress)(struct fid_domain *domain);
+};
+
 
 /*
  * System memory monitor import extension:
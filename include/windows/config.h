@@ -5,6 +5,10 @@
    */
 /* #define ENABLE_DEBUG 1 */
 
+/* defined to 1 if libfabric was configured with --enable-probes, 0 otherwise
+   */
+#define ENABLE_PROBES 0
+
 /* Define to 1 if the linker supports alias attribute. */
 /* #undef HAVE_ALIAS_ATTRIBUTE */
 
@@ -1025,6 +1025,7 @@ typedef LONGLONG ofi_atomic_int_64_t;
 #define ofi_atomic_sub_and_fetch(radix, ptr, val) InterlockedAdd##radix((ofi_atomic_int_##radix##_t volatile *)(ptr), -(ofi_atomic_int_##radix##_t)(val))
 #define ofi_atomic_cas_bool(radix, ptr, expected, desired)					\
 	(InterlockedCompareExchange##radix((ofi_atomic_int_##radix##_t volatile *)ptr, desired, expected) == expected)
+#define ofi_atomic_fence() MemoryBarrier()
 
 #endif /* HAVE_BUILTIN_ATOMICS */
 
@@ -36,14 +36,8 @@
 #include "ofi_hook.h"
 #include "ofi.h"
 #include "ofi_perf.h"
-
-
-struct perf_fabric {
-	struct hook_fabric fabric_hook;
-	struct ofi_perfset perf_set;
-};
-
-int hook_perf_destroy(struct fid *fabric);
+#include "ofi_iov.h"
+#include "ofi_lock.h"
 
 
 #define HOOK_FOREACH(DECL)		\
@@ -95,4 +89,205 @@ enum perf_counters {
 
 extern const char *perf_counters_str[];
 
+
+/*
+ * Latency histograms are log-linear: values below PERF_HIST_SUB_CNT get
+ * their own bucket, and every power of two above that is split into
+ * PERF_HIST_SUB_CNT linear sub-buckets.  Values are in units of the
+ * counter selected by FI_PERF_CNTR, and anything at or above
+ * 2^PERF_HIST_MAX_BITS lands in the last bucket.
+ */
+#define PERF_HIST_SUB_BITS	2
+#define PERF_HIST_SUB_CNT	(1 << PERF_HIST_SUB_BITS)
+#define PERF_HIST_MAX_BITS	48
+#define PERF_HIST_BUCKETS	((PERF_HIST_MAX_BITS - PERF_HIST_SUB_BITS + 1) * \
+				 PERF_HIST_SUB_CNT)
+
+/* Message sizes are binned by powers of 4, from <= 64 bytes to > 256 KiB */
+#define PERF_SIZE_CLASSES	8
+
+/* Threads beyond PERF_MAX_SHARDS share one more shard under a lock */
+#define PERF_MAX_SHARDS		64
+#define PERF_SHARD_CNT		(PERF_MAX_SHARDS + 1)
+
+struct perf_hist {
+	uint64_t		count;
+	uint64_t		sum;
+	uint64_t		min;
+	uint64_t		max;
+	uint64_t		bucket[PERF_HIST_BUCKETS];
+};
+
+struct perf_peer {
+	uint64_t		bytes;
+	struct perf_hist	hist;
+};
+
+/*
+ * Each thread that calls through the hook claims a shard, so the data path
+ * never writes to memory shared with another thread.  A shard is released
+ * when its thread exits.  Readers merge the shards.  Histograms and peer
+ * entries are allocated on first use under the fabric lock, which is also
+ * held by readers while merging.
+ */
+struct perf_shard {
+	ofi_atomic64_t		owner;
+	struct ofi_perf_data	data[perf_size];
+	struct perf_hist	*hist[perf_size][PERF_SIZE_CLASSES];
+	struct perf_peer	**peer;
+	struct perf_ring	*ring;
+	uint64_t		trace_cnt;
+};
+
+struct perf_dump;
+struct perf_trace;
+
+struct perf_fabric {
+	struct hook_fabric	fabric_hook;
+	struct ofi_perfset	perf_set;
+	struct perf_shard	*shards;
+#ifndef _WIN32
+	pthread_key_t		shard_key;
+#endif
+	ofi_spin_t		shared_lock;
+	ofi_mutex_t		lock;
+	bool			hist;
+	size_t			max_peers;
+	struct perf_dump	*dump;
+	bool			trace;
+	uint64_t		trace_sample;
+	struct perf_trace	*tracer;
+};
+
+/*
+ * State carried from perf_start to perf_end.  ts is the wall clock start
+ * of a call selected for tracing, or 0 if the call is not traced.  ep is
+ * the endpoint of a data transfer call.
+ */
+struct perf_call {
+	uint64_t		start;
+	uint64_t		ts;
+	struct hook_ep		*ep;
+};
+
+int hook_perf_destroy(struct fid *fabric);
+
+void perf_stats_init(void);
+int perf_stats_open(struct perf_fabric *fab);
+void perf_stats_close(struct perf_fabric *fab);
+void perf_hist_record(struct perf_fabric *fab, struct perf_shard *shard,
+		      enum perf_counters op, uint64_t value, size_t len,
+		      fi_addr_t addr);
+struct perf_shard *perf_shard_claim(struct perf_fabric *fab, uint64_t id);
+
+void perf_trace_init(void);
+int perf_trace_open(struct perf_fabric *fab);
+void perf_trace_close(struct perf_fabric *fab);
+void perf_trace_post(struct perf_fabric *fab, struct perf_shard *shard,
+		     struct hook_ep *ep, enum perf_counters op, uint64_t ts,
+		     ssize_t ret, size_t len, fi_addr_t addr, void *context);
+void perf_trace_cancel(struct perf_fabric *fab, void *context);
+void perf_trace_ep_close(struct perf_fabric *fab, struct hook_ep *ep);
+void perf_trace_comp(struct perf_fabric *fab, struct hook_cq *cq,
+		     enum perf_counters op, const void *buf, ssize_t count);
+void perf_trace_comp_err(struct perf_fabric *fab, enum perf_counters op,
+			 const struct fi_cq_err_entry *err);
+
+static inline uint64_t perf_thread_id(void)
+{
+	return (uint64_t) (uintptr_t) pthread_self();
+}
+
+static inline size_t perf_shard_hash(uint64_t id)
+{
+	return (size_t) ((id * 0x9E3779B97F4A7C15ULL) >> 32) % PERF_MAX_SHARDS;
+}
+
+static inline struct perf_shard *perf_shard(struct perf_fabric *fab)
+{
+	struct perf_shard *shard;
+	uint64_t id;
+
+	id = perf_thread_id();
+	shard = &fab->shards[perf_shard_hash(id)];
+	if ((uint64_t) ofi_atomic_get64(&shard->owner) == id)
+		return shard;
+
+	return perf_shard_claim(fab, id);
+}
+
+static inline bool
+perf_shard_shared(struct perf_fabric *fab, struct perf_shard *shard)
+{
+	return shard == &fab->shards[PERF_MAX_SHARDS];
+}
+
+static inline void
+perf_shard_lock(struct perf_fabric *fab, struct perf_shard *shard)
+{
+	if (OFI_UNLIKELY(perf_shard_shared(fab, shard)))
+		ofi_spin_lock(&fab->shared_lock);
+}
+
+static inline void
+perf_shard_unlock(struct perf_fabric *fab, struct perf_shard *shard)
+{
+	if (OFI_UNLIKELY(perf_shard_shared(fab, shard)))
+		ofi_spin_unlock(&fab->shared_lock);
+}
+
+/* Only 1 in trace_sample calls per thread is traced */
+static inline uint64_t perf_trace_start(struct perf_fabric *fab)
+{
+	struct perf_shard *shard;
+
+	shard = perf_shard(fab);
+	perf_shard_lock(fab, shard);
+	if (++shard->trace_cnt < fab->trace_sample) {
+		perf_shard_unlock(fab, shard);
+		return 0;
+	}
+
+	shard->trace_cnt = 0;
+	perf_shard_unlock(fab, shard);
+	return ofi_gettime_ns();
+}
+
+static inline void perf_start(struct perf_fabric *fab, struct perf_call *call)
+{
+	call->ts = 0;
+	call->ep = NULL;
+	call->start = ofi_pmu_read(fab->perf_set.ctx);
+}
+
+/* Data transfer calls may also be traced */
+static inline void
+perf_start_xfer(struct perf_fabric *fab, struct hook_ep *ep,
+		struct perf_call *call)
+{
+	call->ts = fab->trace ? perf_trace_start(fab) : 0;
+	call->ep = ep;
+	call->start = ofi_pmu_read(fab->perf_set.ctx);
+}
+
+static inline void perf_end(struct perf_fabric *fab, struct perf_call *call,
+			    enum perf_counters op, ssize_t ret, size_t len,
+			    fi_addr_t addr, void *context)
+{
+	struct perf_shard *shard;
+	uint64_t value;
+
+	value = ofi_pmu_read(fab->perf_set.ctx) - call->start;
+	shard = perf_shard(fab);
+	perf_shard_lock(fab, shard);
+	shard->data[op].sum += value;
+	shard->data[op].events++;
+	if (fab->hist)
+		perf_hist_record(fab, shard, op, value, len, addr);
+	if (call->ts)
+		perf_trace_post(fab, shard, call->ep, op, call->ts, ret, len,
+				addr, context);
+	perf_shard_unlock(fab, shard);
+}
+
 #endif /* _HOOK_PERF_H_ */
@@ -40,22 +40,22 @@ const char *perf_counters_str[] = {
 };
 
 
-static inline struct ofi_perfset *perf_set(struct hook_ep *ep)
+static inline struct perf_fabric *perf_fab(struct hook_ep *ep)
 {
-	return &container_of(ep->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	return container_of(ep->domain->fabric, struct perf_fabric,
+			    fabric_hook);
 }
 
-static inline struct ofi_perfset *perf_set_cq(struct hook_cq *cq)
+static inline struct perf_fabric *perf_fab_cq(struct hook_cq *cq)
 {
-	return &container_of(cq->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	return container_of(cq->domain->fabric, struct perf_fabric,
+			    fabric_hook);
 }
 
-static inline struct ofi_perfset *perf_set_cntr(struct hook_cntr *cntr)
+static inline struct perf_fabric *perf_fab_cntr(struct hook_cntr *cntr)
 {
-	return &container_of(cntr->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	return container_of(cntr->domain->fabric, struct perf_fabric,
+			    fabric_hook);
 }
 
 /*
@@ -267,11 +267,12 @@ perf_msg_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	      fi_addr_t src_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_recv(myep->hep, buf, len, desc, src_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_recv);
+	perf_end(perf_fab(myep), &call, perf_recv, ret, len, src_addr, context);
 	return ret;
 }
 
@@ -280,11 +281,13 @@ perf_msg_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       size_t count, fi_addr_t src_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recvv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_recvv(myep->hep, iov, desc, count, src_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_recvv);
+	perf_end(perf_fab(myep), &call, perf_recvv, ret,
+		 ofi_total_iov_len(iov, count), src_addr, context);
 	return ret;
 }
 
@@ -292,11 +295,14 @@ static ssize_t
 perf_msg_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recvmsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_recvmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_recvmsg);
+	perf_end(perf_fab(myep), &call, perf_recvmsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -305,11 +311,13 @@ perf_msg_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	      fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_send);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_send(myep->hep, buf, len, desc, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_send);
+	perf_end(perf_fab(myep), &call, perf_send, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -318,11 +326,13 @@ perf_msg_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       size_t count, fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_sendv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_sendv(myep->hep, iov, desc, count, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_sendv);
+	perf_end(perf_fab(myep), &call, perf_sendv, ret,
+		 ofi_total_iov_len(iov, count), dest_addr, context);
 	return ret;
 }
 
@@ -331,11 +341,14 @@ perf_msg_sendmsg(struct fid_ep *ep, const struct fi_msg *msg,
 		 uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_sendmsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_sendmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_sendmsg);
+	perf_end(perf_fab(myep), &call, perf_sendmsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -344,11 +357,12 @@ perf_msg_inject(struct fid_ep *ep, const void *buf, size_t len,
 		fi_addr_t dest_addr)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_inject(myep->hep, buf, len, dest_addr);
-	ofi_perfset_end(perf_set(myep), perf_inject);
+	perf_end(perf_fab(myep), &call, perf_inject, ret, len, dest_addr, NULL);
 	return ret;
 }
 
@@ -357,11 +371,13 @@ perf_msg_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		  uint64_t data, fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_senddata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_senddata(myep->hep, buf, len, desc, data, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_senddata);
+	perf_end(perf_fab(myep), &call, perf_senddata, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -370,11 +386,13 @@ perf_msg_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		    uint64_t data, fi_addr_t dest_addr)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_injectdata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_injectdata(myep->hep, buf, len, data, dest_addr);
-	ofi_perfset_end(perf_set(myep), perf_injectdata);
+	perf_end(perf_fab(myep), &call, perf_injectdata, ret, len, dest_addr,
+		 NULL);
 	return ret;
 }
 
@@ -397,11 +415,12 @@ perf_rma_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	      fi_addr_t src_addr, uint64_t addr, uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_read);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_read(myep->hep, buf, len, desc, src_addr, addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_read);
+	perf_end(perf_fab(myep), &call, perf_read, ret, len, src_addr, context);
 	return ret;
 }
 
@@ -411,12 +430,14 @@ perf_rma_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_readv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_readv(myep->hep, iov, desc, count, src_addr,
 		       addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_readv);
+	perf_end(perf_fab(myep), &call, perf_readv, ret,
+		 ofi_total_iov_len(iov, count), src_addr, context);
 	return ret;
 }
 
@@ -425,11 +446,14 @@ perf_rma_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 		 uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_readmsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_readmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_readmsg);
+	perf_end(perf_fab(myep), &call, perf_readmsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -438,12 +462,14 @@ perf_rma_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	       fi_addr_t dest_addr, uint64_t addr, uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_write);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_write(myep->hep, buf, len, desc, dest_addr,
 		       addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_write);
+	perf_end(perf_fab(myep), &call, perf_write, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -453,12 +479,14 @@ perf_rma_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writev);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_writev(myep->hep, iov, desc, count, dest_addr,
 			addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_writev);
+	perf_end(perf_fab(myep), &call, perf_writev, ret,
+		 ofi_total_iov_len(iov, count), dest_addr, context);
 	return ret;
 }
 
@@ -467,11 +495,14 @@ perf_rma_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 		  uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writemsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_writemsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_writemsg);
+	perf_end(perf_fab(myep), &call, perf_writemsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -480,11 +511,13 @@ perf_rma_inject(struct fid_ep *ep, const void *buf, size_t len,
 		fi_addr_t dest_addr, uint64_t addr, uint64_t key)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject_write);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_inject_write(myep->hep, buf, len, dest_addr, addr, key);
-	ofi_perfset_end(perf_set(myep), perf_inject_write);
+	perf_end(perf_fab(myep), &call, perf_inject_write, ret, len, dest_addr,
+		 NULL);
 	return ret;
 }
 
@@ -494,12 +527,14 @@ perf_rma_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		   uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writedata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_writedata(myep->hep, buf, len, desc, data,
 			   dest_addr, addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_writedata);
+	perf_end(perf_fab(myep), &call, perf_writedata, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -509,12 +544,14 @@ perf_rma_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		    uint64_t key)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject_writedata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_inject_writedata(myep->hep, buf, len, data, dest_addr,
 				  addr, key);
-	ofi_perfset_end(perf_set(myep), perf_inject_writedata);
+	perf_end(perf_fab(myep), &call, perf_inject_writedata, ret, len,
+		 dest_addr, NULL);
 	return ret;
 }
 
@@ -538,12 +575,14 @@ perf_tagged_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 		 void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_trecv(myep->hep, buf, len, desc, src_addr,
 		       tag, ignore, context);
-	ofi_perfset_end(perf_set(myep), perf_trecv);
+	perf_end(perf_fab(myep), &call, perf_trecv, ret, len, src_addr,
+		 context);
 	return ret;
 }
 
@@ -553,12 +592,14 @@ perf_tagged_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		  uint64_t ignore, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecvv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_trecvv(myep->hep, iov, desc, count, src_addr,
 			tag, ignore, context);
-	ofi_perfset_end(perf_set(myep), perf_trecvv);
+	perf_end(perf_fab(myep), &call, perf_trecvv, ret,
+		 ofi_total_iov_len(iov, count), src_addr, context);
 	return ret;
 }
 
@@ -567,11 +608,14 @@ perf_tagged_recvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 		    uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecvmsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_trecvmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_trecvmsg);
+	perf_end(perf_fab(myep), &call, perf_trecvmsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -580,11 +624,13 @@ perf_tagged_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		 fi_addr_t dest_addr, uint64_t tag, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsend);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tsend(myep->hep, buf, len, desc, dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsend);
+	perf_end(perf_fab(myep), &call, perf_tsend, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -594,11 +640,13 @@ perf_tagged_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		  void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsendv);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tsendv(myep->hep, iov, desc, count, dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsendv);
+	perf_end(perf_fab(myep), &call, perf_tsendv, ret,
+		 ofi_total_iov_len(iov, count), dest_addr, context);
 	return ret;
 }
 
@@ -607,11 +655,14 @@ perf_tagged_sendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 		    uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsendmsg);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tsendmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_tsendmsg);
+	perf_end(perf_fab(myep), &call, perf_tsendmsg, ret,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count), msg->addr,
+		 msg->context);
 	return ret;
 }
 
@@ -620,11 +671,13 @@ perf_tagged_inject(struct fid_ep *ep, const void *buf, size_t len,
 		   fi_addr_t dest_addr, uint64_t tag)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tinject);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tinject(myep->hep, buf, len, dest_addr, tag);
-	ofi_perfset_end(perf_set(myep), perf_tinject);
+	perf_end(perf_fab(myep), &call, perf_tinject, ret, len, dest_addr,
+		 NULL);
 	return ret;
 }
 
@@ -634,12 +687,14 @@ perf_tagged_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		     void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsenddata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tsenddata(myep->hep, buf, len, desc, data,
 			   dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsenddata);
+	perf_end(perf_fab(myep), &call, perf_tsenddata, ret, len, dest_addr,
+		 context);
 	return ret;
 }
 
@@ -648,11 +703,13 @@ perf_tagged_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		       uint64_t data, fi_addr_t dest_addr, uint64_t tag)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tinjectdata);
+	perf_start_xfer(perf_fab(myep), myep, &call);
 	ret = fi_tinjectdata(myep->hep, buf, len, data, dest_addr, tag);
-	ofi_perfset_end(perf_set(myep), perf_tinjectdata);
+	perf_end(perf_fab(myep), &call, perf_tinjectdata, ret, len, dest_addr,
+		 NULL);
 	return ret;
 }
 
@@ -673,11 +730,16 @@ static struct fi_ops_tagged perf_tagged_ops = {
 static ssize_t perf_cq_read_op(struct fid_cq *cq, void *buf, size_t count)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_read);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_read(mycq->hcq, buf, count);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_read);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_read, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
+	if (ret > 0 && perf_fab_cq(mycq)->trace)
+		perf_trace_comp(perf_fab_cq(mycq), mycq, perf_cq_read,
+				buf, ret);
 	return ret;
 }
 
@@ -685,11 +747,15 @@ static ssize_t
 perf_cq_readerr_op(struct fid_cq *cq, struct fi_cq_err_entry *buf, uint64_t flags)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_readerr);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_readerr(mycq->hcq, buf, flags);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_readerr);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_readerr, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
+	if (ret > 0 && perf_fab_cq(mycq)->trace)
+		perf_trace_comp_err(perf_fab_cq(mycq), perf_cq_readerr, buf);
 	return ret;
 }
 
@@ -697,11 +763,16 @@ static ssize_t
 perf_cq_readfrom_op(struct fid_cq *cq, void *buf, size_t count, fi_addr_t *src_addr)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_readfrom);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_readfrom(mycq->hcq, buf, count, src_addr);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_readfrom);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_readfrom, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
+	if (ret > 0 && perf_fab_cq(mycq)->trace)
+		perf_trace_comp(perf_fab_cq(mycq), mycq, perf_cq_readfrom,
+				buf, ret);
 	return ret;
 }
 
@@ -710,11 +781,16 @@ perf_cq_sread_op(struct fid_cq *cq, void *buf, size_t count,
 	      const void *cond, int timeout)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_sread);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_sread(mycq->hcq, buf, count, cond, timeout);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_sread);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_sread, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
+	if (ret > 0 && perf_fab_cq(mycq)->trace)
+		perf_trace_comp(perf_fab_cq(mycq), mycq, perf_cq_sread,
+				buf, ret);
 	return ret;
 }
 
@@ -723,22 +799,29 @@ perf_cq_sreadfrom_op(struct fid_cq *cq, void *buf, size_t count,
 		  fi_addr_t *src_addr, const void *cond, int timeout)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_sreadfrom);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_sreadfrom(mycq->hcq, buf, count, src_addr, cond, timeout);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_sreadfrom);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_sreadfrom, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
+	if (ret > 0 && perf_fab_cq(mycq)->trace)
+		perf_trace_comp(perf_fab_cq(mycq), mycq, perf_cq_sreadfrom,
+				buf, ret);
 	return ret;
 }
 
 static int perf_cq_signal_op(struct fid_cq *cq)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_signal);
+	perf_start(perf_fab_cq(mycq), &call);
 	ret = fi_cq_signal(mycq->hcq);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_signal);
+	perf_end(perf_fab_cq(mycq), &call, perf_cq_signal, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
@@ -757,77 +840,91 @@ struct fi_ops_cq perf_cq_ops = {
 static uint64_t perf_cntr_read_op(struct fid_cntr *cntr)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	uint64_t ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_read);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_read(mycntr->hcntr);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_read);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_read, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static uint64_t perf_cntr_readerr_op(struct fid_cntr *cntr)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	uint64_t ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_readerr);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_readerr(mycntr->hcntr);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_readerr);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_readerr, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static int perf_cntr_add_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_add);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_add(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_add);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_add, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static int perf_cntr_set_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_set);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_set(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_set);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_set, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static int perf_cntr_wait_op(struct fid_cntr *cntr, uint64_t threshold, int timeout)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_wait);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_wait(mycntr->hcntr, threshold, timeout);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_wait);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_wait, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static int perf_cntr_adderr_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_adderr);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_adderr(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_adderr);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_adderr, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
 static int perf_cntr_seterr_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	struct perf_call call;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_seterr);
+	perf_start(perf_fab_cntr(mycntr), &call);
 	ret = fi_cntr_seterr(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_seterr);
+	perf_end(perf_fab_cntr(mycntr), &call, perf_cntr_seterr, ret, 0,
+		 FI_ADDR_UNSPEC, NULL);
 	return ret;
 }
 
@@ -856,6 +953,8 @@ int hook_perf_destroy(struct fid *fid)
 	struct perf_fabric *fab;
 
 	fab = container_of(fid, struct perf_fabric, fabric_hook);
+	perf_trace_close(fab);
+	perf_stats_close(fab);
 	ofi_perfset_log(&fab->perf_set, perf_counters_str);
 	ofi_perfset_close(&fab->perf_set);
 	hook_close(fid);
@@ -884,6 +983,14 @@ static int hook_perf_fabric(struct fi_fabric_attr *attr,
 		return ret;
 	}
 
+	ret = perf_stats_open(fab);
+	if (ret)
+		goto err1;
+
+	ret = perf_trace_open(fab);
+	if (ret)
+		goto err2;
+
 	/*
 	 * TODO
 	 * comment from GitHub PR #5052:
@@ -894,6 +1001,13 @@ static int hook_perf_fabric(struct fi_fabric_attr *attr,
 			 &perf_fabric_fid_ops, &hook_perf_ctx);
 	*fabric = &fab->fabric_hook.fabric;
 	return 0;
+
+err2:
+	perf_stats_close(fab);
+err1:
+	ofi_perfset_close(&fab->perf_set);
+	free(fab);
+	return ret;
 }
 
 struct hook_prov_ctx hook_perf_ctx = {
@@ -922,20 +1036,49 @@ static int perf_cntr_init(struct fid *fid)
 	return 0;
 }
 
+static ssize_t perf_cancel(fid_t fid, void *context)
+{
+	struct hook_ep *myep = container_of(fid, struct hook_ep, ep.fid);
+	ssize_t ret;
+
+	ret = fi_cancel(&myep->hep->fid, context);
+	if (!ret && perf_fab(myep)->trace)
+		perf_trace_cancel(perf_fab(myep), context);
+	return ret;
+}
+
+static struct fi_ops_ep perf_ep_ops;
+
 static int perf_endpoint_init(struct fid *fid)
 {
 	struct fid_ep *ep = container_of(fid, struct fid_ep, fid);
+	ep->ops = &perf_ep_ops;
 	ep->msg = &perf_msg_ops;
 	ep->rma = &perf_rma_ops;
 	ep->tagged = &perf_tagged_ops;
 	return 0;
 }
 
+/* Sampled calls still pending on the endpoint will not complete */
+static int perf_endpoint_fini(struct fid *fid)
+{
+	struct hook_ep *myep = container_of(fid, struct hook_ep, ep.fid);
+
+	if (perf_fab(myep)->trace)
+		perf_trace_ep_close(perf_fab(myep), myep);
+	return 0;
+}
+
 
 HOOK_PERF_INI
 {
+	perf_stats_init();
+	perf_trace_init();
 	hook_perf_ctx.ini_fid[FI_CLASS_CQ] = perf_cq_init;
 	hook_perf_ctx.ini_fid[FI_CLASS_CNTR] = perf_cntr_init;
 	hook_perf_ctx.ini_fid[FI_CLASS_EP] = perf_endpoint_init;
+	hook_perf_ctx.fini_fid[FI_CLASS_EP] = perf_endpoint_fini;
+	perf_ep_ops = hook_ep_ops;
+	perf_ep_ops.cancel = perf_cancel;
 	return &hook_perf_ctx.prov;
 }
@@ -0,0 +1,780 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "ofi_perf.h"
+#include "ofi_prov.h"
+#include "hook_prov.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/un.h>
+#include "ofi_signal.h"
+#endif
+
+
+static int perf_hist_enable;
+static size_t perf_hist_peers = 128;
+static char *perf_dump_path;
+static char *perf_dump_sock_path;
+static int perf_dump_interval = 1000;
+
+/* Seconds a dump socket client gets to take a snapshot */
+#define PERF_DUMP_SEND_TIMEOUT 5
+
+static const char *perf_size_str[PERF_SIZE_CLASSES] = {
+	"<=64", "<=256", "<=1K", "<=4K", "<=16K", "<=64K", "<=256K", ">256K"
+};
+
+struct perf_dump {
+	pthread_t		thread;
+	char			*file;
+	char			*tmp_file;
+	char			*sock_path;
+#ifndef _WIN32
+	struct fd_signal	signal;
+	SOCKET			sock;
+#endif
+};
+
+
+void perf_stats_init(void)
+{
+	fi_param_define(NULL, "perf_hist", FI_PARAM_BOOL,
+			"Collect per-operation histograms, broken down by "
+			"message size and peer address, in the perf hook "
+			"(default: no).");
+	fi_param_define(NULL, "perf_hist_peers", FI_PARAM_SIZE_T,
+			"Number of peer addresses, starting at fi_addr 0, "
+			"tracked by the perf hook histograms (default: %zu).",
+			perf_hist_peers);
+	fi_param_define(NULL, "perf_dump_file", FI_PARAM_STRING,
+			"Periodically write perf hook statistics as JSON to "
+			"this file.  The process id is appended to the name.");
+	fi_param_define(NULL, "perf_dump_socket", FI_PARAM_STRING,
+			"Serve perf hook statistics as JSON to clients "
+			"connecting to this unix domain socket.  The process "
+			"id is appended to the path.");
+	fi_param_define(NULL, "perf_dump_interval", FI_PARAM_INT,
+			"Interval in milliseconds between writes to "
+			"FI_PERF_DUMP_FILE (default: %d).", perf_dump_interval);
+
+	fi_param_get_bool(NULL, "perf_hist", &perf_hist_enable);
+	fi_param_get_size_t(NULL, "perf_hist_peers", &perf_hist_peers);
+	fi_param_get_str(NULL, "perf_dump_file", &perf_dump_path);
+	fi_param_get_str(NULL, "perf_dump_socket", &perf_dump_sock_path);
+	fi_param_get_int(NULL, "perf_dump_interval", &perf_dump_interval);
+	if (perf_dump_interval <= 0)
+		perf_dump_interval = 1000;
+}
+
+#ifndef _WIN32
+
+static void perf_shard_release(void *arg)
+{
+	struct perf_shard *shard = arg;
+
+	ofi_atomic_set64(&shard->owner, 0);
+}
+
+static int perf_shard_key_create(struct perf_fabric *fab)
+{
+	return -pthread_key_create(&fab->shard_key, perf_shard_release);
+}
+
+static void perf_shard_key_delete(struct perf_fabric *fab)
+{
+	(void) pthread_key_delete(fab->shard_key);
+}
+
+static void perf_shard_key_set(struct perf_fabric *fab,
+			       struct perf_shard *shard)
+{
+	(void) pthread_setspecific(fab->shard_key, shard);
+}
+
+#else /* _WIN32 */
+
+/* Shards are not released when threads exit */
+static int perf_shard_key_create(struct perf_fabric *fab)
+{
+	return 0;
+}
+
+static void perf_shard_key_delete(struct perf_fabric *fab)
+{
+}
+
+static void perf_shard_key_set(struct perf_fabric *fab,
+			       struct perf_shard *shard)
+{
+}
+
+#endif /* _WIN32 */
+
+struct perf_shard *perf_shard_claim(struct perf_fabric *fab, uint64_t id)
+{
+	struct perf_shard *shard;
+	size_t i, home;
+	int64_t owner;
+
+	home = perf_shard_hash(id);
+	for (i = 0; i < PERF_MAX_SHARDS; i++) {
+		shard = &fab->shards[(home + i) % PERF_MAX_SHARDS];
+		owner = ofi_atomic_get64(&shard->owner);
+		if ((uint64_t) owner == id)
+			return shard;
+		if (!owner &&
+		    ofi_atomic_cas_bool64(&shard->owner, 0, (int64_t) id)) {
+			perf_shard_key_set(fab, shard);
+			return shard;
+		}
+	}
+
+	/* More live threads than shards.  The rest share the last shard,
+	 * which is updated under shared_lock.
+	 */
+	return &fab->shards[PERF_MAX_SHARDS];
+}
+
+
+static size_t perf_hist_index(uint64_t value)
+{
+	int shift;
+
+	if (value < PERF_HIST_SUB_CNT)
+		return (size_t) value;
+	if (value >> PERF_HIST_MAX_BITS)
+		return PERF_HIST_BUCKETS - 1;
+
+	shift = ofi_msb(value) - 1 - PERF_HIST_SUB_BITS;
+	return (size_t) (shift + 1) * PERF_HIST_SUB_CNT +
+	       (size_t) ((value >> shift) & (PERF_HIST_SUB_CNT - 1));
+}
+
+/* Largest value that maps to the given bucket */
+static uint64_t perf_hist_value(size_t index)
+{
+	size_t shift;
+
+	if (index < PERF_HIST_SUB_CNT)
+		return index;
+
+	shift = index / PERF_HIST_SUB_CNT - 1;
+	return ((uint64_t) (PERF_HIST_SUB_CNT + index % PERF_HIST_SUB_CNT + 1)
+		<< shift) - 1;
+}
+
+static size_t perf_size_class(size_t len)
+{
+	size_t cls;
+
+	if (len <= 64)
+		return 0;
+
+	cls = (ofi_msb(len - 1) - 5) / 2;
+	return MIN(cls, PERF_SIZE_CLASSES - 1);
+}
+
+static void perf_hist_add(struct perf_hist *hist, uint64_t value)
+{
+	if (!hist->count || value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+	hist->count++;
+	hist->sum += value;
+	hist->bucket[perf_hist_index(value)]++;
+}
+
+static void perf_hist_merge(struct perf_hist *dst, const struct perf_hist *src)
+{
+	size_t i;
+
+	if (!src->count)
+		return;
+
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (i = 0; i < PERF_HIST_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+}
+
+/* Returns an upper bound on the value at the given percentile. */
+static uint64_t perf_hist_pct(const struct perf_hist *hist, double pct)
+{
+	uint64_t target, total = 0;
+	double rank;
+	size_t i;
+
+	rank = hist->count * pct / 100.0;
+	target = (uint64_t) rank;
+	if (target < rank || !target)
+		target++;
+
+	for (i = 0; i < PERF_HIST_BUCKETS; i++) {
+		total += hist->bucket[i];
+		if (total >= target)
+			return MIN(perf_hist_value(i), hist->max);
+	}
+	return hist->max;
+}
+
+static struct perf_hist *
+perf_hist_get(struct perf_fabric *fab, struct perf_shard *shard,
+	      enum perf_counters op, size_t cls)
+{
+	struct perf_hist *hist;
+
+	hist = shard->hist[op][cls];
+	if (hist)
+		return hist;
+
+	ofi_mutex_lock(&fab->lock);
+	if (!shard->hist[op][cls])
+		shard->hist[op][cls] = calloc(1, sizeof(*hist));
+	hist = shard->hist[op][cls];
+	ofi_mutex_unlock(&fab->lock);
+	return hist;
+}
+
+static struct perf_peer *
+perf_peer_get(struct perf_fabric *fab, struct perf_shard *shard,
+	      fi_addr_t addr)
+{
+	struct perf_peer *peer;
+
+	if (shard->peer && shard->peer[addr])
+		return shard->peer[addr];
+
+	ofi_mutex_lock(&fab->lock);
+	if (!shard->peer)
+		shard->peer = calloc(fab->max_peers, sizeof(*shard->peer));
+	if (shard->peer && !shard->peer[addr])
+		shard->peer[addr] = calloc(1, sizeof(*peer));
+	peer = shard->peer ? shard->peer[addr] : NULL;
+	ofi_mutex_unlock(&fab->lock);
+	return peer;
+}
+
+void perf_hist_record(struct perf_fabric *fab, struct perf_shard *shard,
+		      enum perf_counters op, uint64_t value, size_t len,
+		      fi_addr_t addr)
+{
+	struct perf_hist *hist;
+	struct perf_peer *peer;
+
+	hist = perf_hist_get(fab, shard, op, perf_size_class(len));
+	if (hist)
+		perf_hist_add(hist, value);
+
+	/* Also filters out FI_ADDR_UNSPEC and FI_ADDR_NOTAVAIL */
+	if (addr >= fab->max_peers)
+		return;
+
+	peer = perf_peer_get(fab, shard, addr);
+	if (peer) {
+		peer->bytes += len;
+		perf_hist_add(&peer->hist, value);
+	}
+}
+
+
+/* Caller must hold fab->lock */
+static void perf_merge_data(struct perf_fabric *fab,
+			    struct ofi_perf_data *data)
+{
+	size_t i, op;
+
+	memset(data, 0, sizeof(*data) * perf_size);
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		for (op = 0; op < perf_size; op++) {
+			data[op].sum += fab->shards[i].data[op].sum;
+			data[op].events += fab->shards[i].data[op].events;
+		}
+	}
+}
+
+/* Caller must hold fab->lock */
+static void perf_merge_hist(struct perf_fabric *fab, enum perf_counters op,
+			    size_t cls, struct perf_hist *hist)
+{
+	size_t i;
+
+	memset(hist, 0, sizeof(*hist));
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		if (fab->shards[i].hist[op][cls])
+			perf_hist_merge(hist, fab->shards[i].hist[op][cls]);
+	}
+}
+
+/* Caller must hold fab->lock */
+static void perf_merge_peer(struct perf_fabric *fab, fi_addr_t addr,
+			    struct perf_peer *peer)
+{
+	struct perf_peer *src;
+	size_t i;
+
+	memset(peer, 0, sizeof(*peer));
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		if (!fab->shards[i].peer)
+			continue;
+
+		src = fab->shards[i].peer[addr];
+		if (src) {
+			peer->bytes += src->bytes;
+			perf_hist_merge(&peer->hist, &src->hist);
+		}
+	}
+}
+
+static void perf_write_hist(FILE *file, const struct perf_hist *hist)
+{
+	fprintf(file, "\"count\": %" PRIu64 ", \"avg\": %.1f, "
+		"\"min\": %" PRIu64 ", \"p50\": %" PRIu64 ", "
+		"\"p99\": %" PRIu64 ", \"p999\": %" PRIu64 ", "
+		"\"max\": %" PRIu64,
+		hist->count, (double) hist->sum / hist->count, hist->min,
+		perf_hist_pct(hist, 50.0), perf_hist_pct(hist, 99.0),
+		perf_hist_pct(hist, 99.9), hist->max);
+}
+
+static void perf_write_json(struct perf_fabric *fab, FILE *file)
+{
+	struct ofi_perf_data data[perf_size];
+	struct perf_hist hist;
+	struct perf_peer peer;
+	const char *sep, *size_sep;
+	size_t op, cls;
+	fi_addr_t addr;
+
+	ofi_mutex_lock(&fab->lock);
+	perf_merge_data(fab, data);
+
+	fprintf(file, "{\"pid\": %d, \"counter\": \"%s\", \"ops\": [",
+		(int) getpid(), ofi_perf_name());
+	for (op = 0, sep = ""; op < perf_size; op++) {
+		if (!data[op].events)
+			continue;
+
+		fprintf(file, "%s\n  {\"op\": \"%s\", \"events\": %" PRIu64
+			", \"avg\": %.1f, \"sizes\": [", sep,
+			perf_counters_str[op], data[op].events,
+			(double) data[op].sum / data[op].events);
+		sep = ",";
+
+		for (cls = 0, size_sep = ""; fab->hist &&
+		     cls < PERF_SIZE_CLASSES; cls++) {
+			perf_merge_hist(fab, op, cls, &hist);
+			if (!hist.count)
+				continue;
+
+			fprintf(file, "%s\n    {\"size\": \"%s\", ", size_sep,
+				perf_size_str[cls]);
+			perf_write_hist(file, &hist);
+			fprintf(file, "}");
+			size_sep = ",";
+		}
+		fprintf(file, "]}");
+	}
+
+	fprintf(file, "],\n \"peers\": [");
+	for (addr = 0, sep = ""; fab->hist && addr < fab->max_peers; addr++) {
+		perf_merge_peer(fab, addr, &peer);
+		if (!peer.hist.count)
+			continue;
+
+		fprintf(file, "%s\n  {\"addr\": %" PRIu64 ", \"bytes\": %"
+			PRIu64 ", ", sep, addr, peer.bytes);
+		perf_write_hist(file, &peer.hist);
+		fprintf(file, "}");
+		sep = ",";
+	}
+	fprintf(file, "]}\n");
+	ofi_mutex_unlock(&fab->lock);
+}
+
+static void perf_log_hist(struct perf_fabric *fab)
+{
+	const struct fi_provider *prov = fab->perf_set.prov;
+	struct perf_hist hist;
+	struct perf_peer peer;
+	size_t op, cls;
+	fi_addr_t addr;
+
+	FI_TRACE(prov, FI_LOG_CORE, "\n");
+	FI_TRACE(prov, FI_LOG_CORE, "\tPERF HISTOGRAM: %s\n", ofi_perf_name());
+	FI_TRACE(prov, FI_LOG_CORE, "\t%-20s%-8s%-12s%-10s%-10s%-10s%s\n",
+		 "Name", "Size", "Events", "p50", "p99", "p999", "Max");
+
+	ofi_mutex_lock(&fab->lock);
+	for (op = 0; op < perf_size; op++) {
+		for (cls = 0; cls < PERF_SIZE_CLASSES; cls++) {
+			perf_merge_hist(fab, op, cls, &hist);
+			if (!hist.count)
+				continue;
+
+			FI_TRACE(prov, FI_LOG_CORE, "\t%-20s%-8s%-12" PRIu64
+				 "%-10" PRIu64 "%-10" PRIu64 "%-10" PRIu64
+				 "%" PRIu64 "\n", perf_counters_str[op],
+				 perf_size_str[cls], hist.count,
+				 perf_hist_pct(&hist, 50.0),
+				 perf_hist_pct(&hist, 99.0),
+				 perf_hist_pct(&hist, 99.9), hist.max);
+		}
+	}
+
+	for (addr = 0; addr < fab->max_peers; addr++) {
+		perf_merge_peer(fab, addr, &peer);
+		if (!peer.hist.count)
+			continue;
+
+		FI_TRACE(prov, FI_LOG_CORE, "\tpeer %-15" PRIu64 "%-8s%-12"
+			 PRIu64 "%-10" PRIu64 "%-10" PRIu64 "%-10" PRIu64
+			 "%" PRIu64 "\n", addr, "", peer.hist.count,
+			 perf_hist_pct(&peer.hist, 50.0),
+			 perf_hist_pct(&peer.hist, 99.0),
+			 perf_hist_pct(&peer.hist, 99.9), peer.hist.max);
+	}
+	ofi_mutex_unlock(&fab->lock);
+}
+
+
+#ifndef _WIN32
+
+static void perf_dump_file(struct perf_fabric *fab)
+{
+	struct perf_dump *dump = fab->dump;
+	FILE *file;
+
+	/* Write and rename, so readers never see a partial snapshot */
+	file = fopen(dump->tmp_file, "w");
+	if (!file) {
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"unable to open %s: %s\n", dump->tmp_file,
+			strerror(errno));
+		return;
+	}
+
+	perf_write_json(fab, file);
+	fclose(file);
+	if (rename(dump->tmp_file, dump->file))
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"unable to rename %s: %s\n", dump->tmp_file,
+			strerror(errno));
+}
+
+/* The snapshot is formatted into memory under fab->lock and sent after
+ * the lock is dropped, so a slow or stalled client cannot hold up the
+ * data path.  A client that goes away only fails the send.
+ */
+static void perf_dump_client(struct perf_fabric *fab)
+{
+	struct timeval tv = { .tv_sec = PERF_DUMP_SEND_TIMEOUT };
+	char *buf = NULL;
+	size_t len = 0, off;
+	ssize_t ret;
+	FILE *file;
+	SOCKET sock;
+
+	sock = accept(fab->dump->sock, NULL, NULL);
+	if (sock == INVALID_SOCKET)
+		return;
+
+	file = open_memstream(&buf, &len);
+	if (!file)
+		goto close;
+
+	perf_write_json(fab, file);
+	if (fclose(file))
+		goto free;
+
+	(void) setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+	for (off = 0; off < len; off += ret) {
+		ret = ofi_send_socket(sock, buf + off, len - off, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			ret = 0;
+		else if (ret <= 0)
+			break;
+	}
+free:
+	free(buf);
+close:
+	ofi_close_socket(sock);
+}
+
+static void *perf_dump_handler(void *arg)
+{
+	struct perf_fabric *fab = arg;
+	struct perf_dump *dump = fab->dump;
+	struct pollfd fds[2];
+	uint64_t next, now;
+	int ret, nfds = 1, timeout = -1;
+
+	fds[0].fd = fd_signal_get(&dump->signal);
+	fds[0].events = POLLIN;
+	if (dump->sock != INVALID_SOCKET) {
+		fds[1].fd = dump->sock;
+		fds[1].events = POLLIN;
+		nfds++;
+	}
+
+	next = ofi_gettime_ms() + perf_dump_interval;
+	for (;;) {
+		if (dump->file) {
+			now = ofi_gettime_ms();
+			if (now >= next) {
+				perf_dump_file(fab);
+				next = now + perf_dump_interval;
+			}
+			timeout = (int) (next - now);
+		}
+
+		ret = poll(fds, nfds, timeout);
+		if (ret < 0 && errno != EINTR)
+			break;
+		if (ret <= 0)
+			continue;
+
+		if (fds[0].revents)
+			break;
+		if (nfds > 1 && fds[1].revents)
+			perf_dump_client(fab);
+	}
+	return NULL;
+}
+
+static int perf_dump_listen(struct perf_fabric *fab)
+{
+	struct perf_dump *dump = fab->dump;
+	struct sockaddr_un addr;
+	int ret;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(dump->sock_path) >= sizeof(addr.sun_path)) {
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"perf dump socket path too long: %s\n",
+			dump->sock_path);
+		return -FI_EINVAL;
+	}
+	strcpy(addr.sun_path, dump->sock_path);
+
+	dump->sock = ofi_socket(AF_UNIX, SOCK_STREAM, 0);
+	if (dump->sock == INVALID_SOCKET)
+		return -ofi_sockerr();
+
+	unlink(dump->sock_path);
+	ret = bind(dump->sock, (struct sockaddr *) &addr, sizeof addr);
+	if (!ret)
+		ret = listen(dump->sock, 8);
+	if (ret) {
+		ret = -ofi_sockerr();
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"unable to listen on %s: %s\n", dump->sock_path,
+			fi_strerror(-ret));
+		ofi_close_socket(dump->sock);
+		dump->sock = INVALID_SOCKET;
+	}
+	return ret;
+}
+
+static void perf_dump_free(struct perf_fabric *fab)
+{
+	struct perf_dump *dump = fab->dump;
+
+	if (dump->sock != INVALID_SOCKET) {
+		ofi_close_socket(dump->sock);
+		unlink(dump->sock_path);
+	}
+	fd_signal_free(&dump->signal);
+	free(dump->file);
+	free(dump->tmp_file);
+	free(dump->sock_path);
+	free(dump);
+	fab->dump = NULL;
+}
+
+static int perf_dump_start(struct perf_fabric *fab)
+{
+	struct perf_dump *dump;
+	int ret;
+
+	dump = calloc(1, sizeof(*dump));
+	if (!dump)
+		return -FI_ENOMEM;
+
+	dump->sock = INVALID_SOCKET;
+	ret = fd_signal_init(&dump->signal);
+	if (ret) {
+		free(dump);
+		return ret;
+	}
+	fab->dump = dump;
+
+	if (perf_dump_path &&
+	    (asprintf(&dump->file, "%s.%d", perf_dump_path, getpid()) < 0 ||
+	     asprintf(&dump->tmp_file, "%s.tmp", dump->file) < 0)) {
+		dump->file = NULL;
+		ret = -FI_ENOMEM;
+		goto err;
+	}
+
+	if (perf_dump_sock_path) {
+		if (asprintf(&dump->sock_path, "%s.%d", perf_dump_sock_path,
+			     getpid()) < 0) {
+			dump->sock_path = NULL;
+			ret = -FI_ENOMEM;
+			goto err;
+		}
+
+		ret = perf_dump_listen(fab);
+		if (ret)
+			goto err;
+	}
+
+	ret = -pthread_create(&dump->thread, NULL, perf_dump_handler, fab);
+	if (ret)
+		goto err;
+
+	return 0;
+err:
+	perf_dump_free(fab);
+	return ret;
+}
+
+static void perf_dump_stop(struct perf_fabric *fab)
+{
+	fd_signal_set(&fab->dump->signal);
+	(void) pthread_join(fab->dump->thread, NULL);
+
+	if (fab->dump->file)
+		perf_dump_file(fab);
+	perf_dump_free(fab);
+}
+
+#else /* _WIN32 */
+
+static int perf_dump_start(struct perf_fabric *fab)
+{
+	FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+		"perf dump is not supported on this platform\n");
+	return -FI_ENOSYS;
+}
+
+static void perf_dump_stop(struct perf_fabric *fab)
+{
+}
+
+#endif /* _WIN32 */
+
+
+int perf_stats_open(struct perf_fabric *fab)
+{
+	size_t i;
+	int ret;
+
+	fab->shards = calloc(PERF_SHARD_CNT, sizeof(*fab->shards));
+	if (!fab->shards)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < PERF_SHARD_CNT; i++)
+		ofi_atomic_initialize64(&fab->shards[i].owner, 0);
+
+	ret = perf_shard_key_create(fab);
+	if (ret)
+		goto err1;
+
+	ret = ofi_spin_init(&fab->shared_lock);
+	if (ret)
+		goto err2;
+
+	ret = ofi_mutex_init(&fab->lock);
+	if (ret)
+		goto err3;
+
+	fab->hist = perf_hist_enable;
+	fab->max_peers = perf_hist_peers;
+
+	/* The dump is a diagnostic aid; failing to start it is not fatal */
+	if (perf_dump_path || perf_dump_sock_path)
+		(void) perf_dump_start(fab);
+
+	return 0;
+err3:
+	ofi_spin_destroy(&fab->shared_lock);
+err2:
+	perf_shard_key_delete(fab);
+err1:
+	free(fab->shards);
+	return ret;
+}
+
+void perf_stats_close(struct perf_fabric *fab)
+{
+	struct perf_shard *shard;
+	size_t i, op, cls, addr;
+
+	if (fab->dump)
+		perf_dump_stop(fab);
+
+	/* Threads exiting from now on no longer touch the shards */
+	perf_shard_key_delete(fab);
+
+	ofi_mutex_lock(&fab->lock);
+	perf_merge_data(fab, fab->perf_set.data);
+	ofi_mutex_unlock(&fab->lock);
+	if (fab->hist)
+		perf_log_hist(fab);
+
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		shard = &fab->shards[i];
+		for (op = 0; op < perf_size; op++) {
+			for (cls = 0; cls < PERF_SIZE_CLASSES; cls++)
+				free(shard->hist[op][cls]);
+		}
+		if (shard->peer) {
+			for (addr = 0; addr < fab->max_peers; addr++)
+				free(shard->peer[addr]);
+			free(shard->peer);
+		}
+	}
+	free(fab->shards);
+	ofi_spin_destroy(&fab->shared_lock);
+	ofi_mutex_destroy(&fab->lock);
+}
@@ -0,0 +1,501 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "ofi_perf.h"
+#include "ofi_prov.h"
+#include "ofi_trace.h"
+#include "hook_prov.h"
+
+
+#define PERF_TRACE_FLUSH_MS	100
+#define PERF_TRACE_CTX_SLOTS	4096
+#define PERF_TRACE_CTX_PROBE	8
+
+static char *perf_trace_path;
+static size_t perf_trace_sample = 1;
+static size_t perf_trace_entries = 16384;
+static int perf_trace_seq;
+
+/*
+ * Single producer, single consumer ring.  Only the thread owning the shard
+ * advances head, or, for the shared shard, the thread holding shared_lock.
+ * Only the flush thread advances tail.  When the ring is full, new records
+ * are dropped rather than overwriting unread ones.
+ */
+struct perf_ring {
+	ofi_atomic64_t		head;
+	ofi_atomic64_t		tail;
+	uint64_t		drops;
+	uint64_t		size_mask;
+	uint32_t		tid;
+	struct ofi_trace_rec	rec[];
+};
+
+struct perf_trace {
+	pthread_t		thread;
+	ofi_atomic32_t		run;
+	FILE			*file;
+	char			*path;
+	/* Sampled contexts awaiting completion; NULL if every call is traced */
+	ofi_atomic64_t		*ctx;
+	/* Endpoint each sampled context was posted to */
+	struct hook_ep		**ctx_ep;
+};
+
+
+void perf_trace_init(void)
+{
+	fi_param_define(NULL, "perf_trace_file", FI_PARAM_STRING,
+			"Record data transfer calls and completions seen by "
+			"the perf hook to this binary trace file.  The process "
+			"id is appended to the name.  Convert the file with "
+			"fi_trace.");
+	fi_param_define(NULL, "perf_trace_sample", FI_PARAM_SIZE_T,
+			"Trace 1 of every N data transfer calls per thread, "
+			"along with their completions (default: %zu).",
+			perf_trace_sample);
+	fi_param_define(NULL, "perf_trace_entries", FI_PARAM_SIZE_T,
+			"Number of records buffered per thread between writes "
+			"to the trace file (default: %zu).", perf_trace_entries);
+
+	fi_param_get_str(NULL, "perf_trace_file", &perf_trace_path);
+	fi_param_get_size_t(NULL, "perf_trace_sample", &perf_trace_sample);
+	fi_param_get_size_t(NULL, "perf_trace_entries", &perf_trace_entries);
+	if (!perf_trace_sample)
+		perf_trace_sample = 1;
+	if (perf_trace_entries < 64)
+		perf_trace_entries = 64;
+}
+
+
+static size_t perf_trace_ctx_hash(void *context)
+{
+	return (size_t) (((uintptr_t) context * 0x9E3779B97F4A7C15ULL) >> 32) %
+	       PERF_TRACE_CTX_SLOTS;
+}
+
+/* A full neighborhood only means the completion is not traced */
+static void perf_trace_ctx_insert(struct perf_trace *tracer,
+				  struct hook_ep *ep, void *context)
+{
+	size_t i, slot;
+
+	slot = perf_trace_ctx_hash(context);
+	for (i = 0; i < PERF_TRACE_CTX_PROBE; i++) {
+		if (ofi_atomic_cas_bool64(&tracer->ctx[slot], 0,
+					  (int64_t) (uintptr_t) context)) {
+			tracer->ctx_ep[slot] = ep;
+			return;
+		}
+		slot = (slot + 1) % PERF_TRACE_CTX_SLOTS;
+	}
+}
+
+static bool perf_trace_ctx_remove(struct perf_trace *tracer, void *context)
+{
+	size_t i, slot;
+
+	slot = perf_trace_ctx_hash(context);
+	for (i = 0; i < PERF_TRACE_CTX_PROBE; i++) {
+		if (ofi_atomic_cas_bool64(&tracer->ctx[slot],
+					  (int64_t) (uintptr_t) context, 0))
+			return true;
+		slot = (slot + 1) % PERF_TRACE_CTX_SLOTS;
+	}
+	return false;
+}
+
+void perf_trace_cancel(struct perf_fabric *fab, void *context)
+{
+	if (fab->tracer->ctx && context)
+		(void) perf_trace_ctx_remove(fab->tracer, context);
+}
+
+void perf_trace_ep_close(struct perf_fabric *fab, struct hook_ep *ep)
+{
+	struct perf_trace *tracer = fab->tracer;
+	int64_t context;
+	size_t slot;
+
+	if (!tracer->ctx)
+		return;
+
+	for (slot = 0; slot < PERF_TRACE_CTX_SLOTS; slot++) {
+		context = ofi_atomic_get64(&tracer->ctx[slot]);
+		if (context && tracer->ctx_ep[slot] == ep)
+			(void) ofi_atomic_cas_bool64(&tracer->ctx[slot],
+						     context, 0);
+	}
+}
+
+
+static struct perf_ring *
+perf_ring_get(struct perf_fabric *fab, struct perf_shard *shard)
+{
+	struct perf_ring *ring;
+	size_t size;
+
+	if (shard->ring)
+		return shard->ring;
+
+	size = roundup_power_of_two(perf_trace_entries);
+	ofi_mutex_lock(&fab->lock);
+	if (!shard->ring) {
+		ring = calloc(1, sizeof(*ring) + size * sizeof(ring->rec[0]));
+		if (ring) {
+			ofi_atomic_initialize64(&ring->head, 0);
+			ofi_atomic_initialize64(&ring->tail, 0);
+			ring->size_mask = size - 1;
+			ring->tid = (uint32_t) (shard - fab->shards);
+			shard->ring = ring;
+		}
+	}
+	ring = shard->ring;
+	ofi_mutex_unlock(&fab->lock);
+	return ring;
+}
+
+static struct ofi_trace_rec *
+perf_ring_next(struct perf_fabric *fab, struct perf_shard *shard)
+{
+	struct perf_ring *ring;
+	uint64_t head;
+
+	ring = perf_ring_get(fab, shard);
+	if (!ring)
+		return NULL;
+
+	head = ofi_atomic_get64(&ring->head);
+	if (head - ofi_atomic_get64(&ring->tail) > ring->size_mask) {
+		ring->drops++;
+		return NULL;
+	}
+	return &ring->rec[head & ring->size_mask];
+}
+
+static void perf_ring_commit(struct perf_shard *shard)
+{
+	struct perf_ring *ring = shard->ring;
+
+	ofi_atomic_set64(&ring->head, ofi_atomic_get64(&ring->head) + 1);
+}
+
+void perf_trace_post(struct perf_fabric *fab, struct perf_shard *shard,
+		     struct hook_ep *ep, enum perf_counters op, uint64_t ts,
+		     ssize_t ret, size_t len, fi_addr_t addr, void *context)
+{
+	struct ofi_trace_rec *rec;
+
+	rec = perf_ring_next(fab, shard);
+	if (!rec)
+		return;
+
+	rec->start = ts;
+	rec->end = ofi_gettime_ns();
+	rec->context = (uint64_t) (uintptr_t) context;
+	rec->len = len;
+	rec->addr = addr;
+	rec->flags = 0;
+	rec->ret = (int32_t) ret;
+	rec->name = (uint16_t) op;
+	rec->event = OFI_TRACE_POST;
+	rec->tid = shard->ring->tid;
+	perf_ring_commit(shard);
+
+	if (fab->tracer->ctx && !ret && context)
+		perf_trace_ctx_insert(fab->tracer, ep, context);
+}
+
+static size_t perf_cq_entry_size(enum fi_cq_format format)
+{
+	switch (format) {
+	case FI_CQ_FORMAT_MSG:
+		return sizeof(struct fi_cq_msg_entry);
+	case FI_CQ_FORMAT_DATA:
+		return sizeof(struct fi_cq_data_entry);
+	case FI_CQ_FORMAT_TAGGED:
+		return sizeof(struct fi_cq_tagged_entry);
+	default:
+		return sizeof(struct fi_cq_entry);
+	}
+}
+
+static void
+perf_trace_comp_rec(struct perf_fabric *fab, struct perf_shard *shard,
+		    enum perf_counters op, uint64_t ts, void *context,
+		    size_t len, uint64_t flags, int err)
+{
+	struct ofi_trace_rec *rec;
+
+	rec = perf_ring_next(fab, shard);
+	if (!rec)
+		return;
+
+	rec->start = ts;
+	rec->end = ts;
+	rec->context = (uint64_t) (uintptr_t) context;
+	rec->len = len;
+	rec->addr = FI_ADDR_NOTAVAIL;
+	rec->flags = flags;
+	rec->ret = -err;
+	rec->name = (uint16_t) op;
+	rec->event = err ? OFI_TRACE_COMP_ERR : OFI_TRACE_COMP;
+	rec->tid = shard->ring->tid;
+	perf_ring_commit(shard);
+}
+
+void perf_trace_comp(struct perf_fabric *fab, struct hook_cq *cq,
+		     enum perf_counters op, const void *buf, ssize_t count)
+{
+	const struct fi_cq_msg_entry *entry;
+	struct perf_shard *shard;
+	uint64_t ts = 0;
+	size_t size;
+	ssize_t i;
+
+	shard = perf_shard(fab);
+	perf_shard_lock(fab, shard);
+	size = perf_cq_entry_size(cq->format);
+	for (i = 0; i < count; i++) {
+		entry = (const void *) ((const char *) buf + i * size);
+		if (fab->tracer->ctx && (!entry->op_context ||
+		    !perf_trace_ctx_remove(fab->tracer, entry->op_context)))
+			continue;
+
+		if (!ts)
+			ts = ofi_gettime_ns();
+		if (size >= sizeof(*entry))
+			perf_trace_comp_rec(fab, shard, op, ts,
+					    entry->op_context, entry->len,
+					    entry->flags, 0);
+		else
+			perf_trace_comp_rec(fab, shard, op, ts,
+					    entry->op_context, 0, 0, 0);
+	}
+	perf_shard_unlock(fab, shard);
+}
+
+void perf_trace_comp_err(struct perf_fabric *fab, enum perf_counters op,
+			 const struct fi_cq_err_entry *err)
+{
+	struct perf_shard *shard;
+
+	if (fab->tracer->ctx && (!err->op_context ||
+	    !perf_trace_ctx_remove(fab->tracer, err->op_context)))
+		return;
+
+	shard = perf_shard(fab);
+	perf_shard_lock(fab, shard);
+	perf_trace_comp_rec(fab, shard, op, ofi_gettime_ns(),
+			    err->op_context, err->len, err->flags,
+			    err->err ? err->err : FI_EOTHER);
+	perf_shard_unlock(fab, shard);
+}
+
+
+/* Caller must hold fab->lock */
+static void perf_ring_flush(struct perf_trace *tracer, struct perf_ring *ring)
+{
+	uint64_t head, tail, cnt;
+
+	head = ofi_atomic_get64(&ring->head);
+	tail = ofi_atomic_get64(&ring->tail);
+	while (tail != head) {
+		cnt = MIN(head - tail, ring->size_mask + 1 -
+			  (tail & ring->size_mask));
+		fwrite(&ring->rec[tail & ring->size_mask], sizeof(ring->rec[0]),
+		       cnt, tracer->file);
+		tail += cnt;
+	}
+	ofi_atomic_set64(&ring->tail, tail);
+}
+
+static void perf_trace_flush(struct perf_fabric *fab)
+{
+	size_t i;
+
+	ofi_mutex_lock(&fab->lock);
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		if (fab->shards[i].ring)
+			perf_ring_flush(fab->tracer, fab->shards[i].ring);
+	}
+	fflush(fab->tracer->file);
+	ofi_mutex_unlock(&fab->lock);
+}
+
+static void *perf_trace_handler(void *arg)
+{
+	struct perf_fabric *fab = arg;
+
+	while (ofi_atomic_get32(&fab->tracer->run)) {
+		usleep(PERF_TRACE_FLUSH_MS * 1000);
+		perf_trace_flush(fab);
+	}
+	return NULL;
+}
+
+static int perf_trace_write_hdr(struct perf_trace *tracer)
+{
+	struct ofi_trace_hdr hdr;
+	size_t i;
+
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, OFI_TRACE_MAGIC, sizeof hdr.magic);
+	hdr.version = OFI_TRACE_VERSION;
+	hdr.pid = (uint32_t) getpid();
+	hdr.name_cnt = perf_size;
+	for (i = 0; i < perf_size; i++)
+		hdr.name_len += (uint32_t) strlen(perf_counters_str[i]) + 1;
+
+	if (fwrite(&hdr, sizeof hdr, 1, tracer->file) != 1)
+		return -FI_EIO;
+
+	for (i = 0; i < perf_size; i++) {
+		if (fwrite(perf_counters_str[i],
+			   strlen(perf_counters_str[i]) + 1, 1,
+			   tracer->file) != 1)
+			return -FI_EIO;
+	}
+	return 0;
+}
+
+static void perf_trace_free(struct perf_fabric *fab)
+{
+	struct perf_trace *tracer = fab->tracer;
+
+	if (tracer->file)
+		fclose(tracer->file);
+	free(tracer->ctx);
+	free(tracer->ctx_ep);
+	free(tracer->path);
+	free(tracer);
+	fab->tracer = NULL;
+	fab->trace = false;
+}
+
+int perf_trace_open(struct perf_fabric *fab)
+{
+	struct perf_trace *tracer;
+	size_t i;
+	int ret;
+
+	if (!perf_trace_path)
+		return 0;
+
+	tracer = calloc(1, sizeof(*tracer));
+	if (!tracer)
+		return -FI_ENOMEM;
+	fab->tracer = tracer;
+
+	/* Later fabrics in the same process get a sequence number */
+	if (perf_trace_seq)
+		ret = asprintf(&tracer->path, "%s.%d.%d", perf_trace_path,
+			       getpid(), perf_trace_seq);
+	else
+		ret = asprintf(&tracer->path, "%s.%d", perf_trace_path,
+			       getpid());
+	perf_trace_seq++;
+	if (ret < 0) {
+		tracer->path = NULL;
+		ret = -FI_ENOMEM;
+		goto err;
+	}
+
+	if (perf_trace_sample > 1) {
+		tracer->ctx = calloc(PERF_TRACE_CTX_SLOTS, sizeof(*tracer->ctx));
+		tracer->ctx_ep = calloc(PERF_TRACE_CTX_SLOTS,
+					sizeof(*tracer->ctx_ep));
+		if (!tracer->ctx || !tracer->ctx_ep) {
+			ret = -FI_ENOMEM;
+			goto err;
+		}
+		for (i = 0; i < PERF_TRACE_CTX_SLOTS; i++)
+			ofi_atomic_initialize64(&tracer->ctx[i], 0);
+	}
+
+	tracer->file = fopen(tracer->path, "wb");
+	if (!tracer->file) {
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"unable to open %s: %s\n", tracer->path,
+			strerror(errno));
+		ret = -FI_EIO;
+		goto err;
+	}
+
+	ret = perf_trace_write_hdr(tracer);
+	if (ret)
+		goto err;
+
+	ofi_atomic_initialize32(&tracer->run, 1);
+	ret = -pthread_create(&tracer->thread, NULL, perf_trace_handler, fab);
+	if (ret)
+		goto err;
+
+	fab->trace_sample = perf_trace_sample;
+	fab->trace = true;
+	return 0;
+err:
+	perf_trace_free(fab);
+	return ret;
+}
+
+void perf_trace_close(struct perf_fabric *fab)
+{
+	uint64_t drops = 0;
+	size_t i;
+
+	if (!fab->tracer)
+		return;
+
+	ofi_atomic_set32(&fab->tracer->run, 0);
+	(void) pthread_join(fab->tracer->thread, NULL);
+	perf_trace_flush(fab);
+
+	for (i = 0; i < PERF_SHARD_CNT; i++) {
+		if (!fab->shards[i].ring)
+			continue;
+
+		drops += fab->shards[i].ring->drops;
+		free(fab->shards[i].ring);
+		fab->shards[i].ring = NULL;
+	}
+
+	if (drops)
+		FI_WARN(fab->perf_set.prov, FI_LOG_CORE,
+			"%" PRIu64 " trace records dropped, consider raising "
+			"FI_PERF_TRACE_ENTRIES or FI_PERF_TRACE_SAMPLE\n",
+			drops);
+	perf_trace_free(fab);
+}
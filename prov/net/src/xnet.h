@@ -69,7 +69,11 @@
 #define XNET_RDM_VERSION	0
 #define XNET_MAX_INJECT		128
 #define XNET_MAX_EVENTS		1024
+#define XNET_MIN_EVENTS		16
+#define XNET_MAX_FAIRNESS	1024
+#define XNET_DEF_FAIRNESS	16
 #define XNET_MIN_MULTI_RECV	16384
+#define XNET_SHM_WAIT_MS	1
 #define XNET_PORT_MAX_RANGE	(USHRT_MAX)
 
 extern struct fi_provider	xnet_prov;
@@ -86,7 +90,10 @@ extern size_t xnet_default_rx_size;
 extern size_t xnet_zerocopy_size;
 extern int xnet_poll_fairness;
 extern int xnet_poll_cooldown;
+extern int xnet_poll_adaptive;
 extern int xnet_disable_autoprog;
+extern int xnet_use_shm;
+extern size_t xnet_max_conns;
 
 struct xnet_xfer_entry;
 struct xnet_ep;
@@ -156,14 +163,36 @@ struct xnet_cur_tx {
 	struct xnet_xfer_entry	*entry;
 };
 
+/* Posted tagged receives without ignore bits, queued by tag and, with
+ * FI_DIRECTED_RECV, by source.
+ */
+struct xnet_tag_key {
+	fi_addr_t		src_addr;
+	uint64_t		tag;
+};
+
+struct xnet_tag_queue {
+	struct xnet_tag_key	key;
+	struct slist		queue;
+	UT_hash_handle		hh;
+};
+
 struct xnet_srx {
 	struct fid_ep		rx_fid;
 	struct xnet_domain	*domain;
 	struct slist		rx_queue;
+	/* Tagged receives with ignore bits are on tag_queue, or on the
+	 * src_tag_queues entry of their source.  All others are on the
+	 * tag_index queue for their key.  Every queue is ordered by
+	 * tag_seq_no, and a match takes the lowest one among the queues
+	 * that apply.
+	 */
 	struct slist		tag_queue;
 	struct ofi_dyn_arr	src_tag_queues;
+	struct xnet_tag_queue	*tag_index;
+	struct ofi_bufpool	*tag_pool;
 	struct xnet_xfer_entry	*(*match_tag_rx)(struct xnet_srx *srx,
-						 struct xnet_ep *ep,
+						 fi_addr_t src_addr,
 						 uint64_t tag);
 
 	uint64_t		tag_seq_no;
@@ -199,6 +228,8 @@ struct xnet_ep {
 	struct xnet_srx		*srx;
 
 	int			hit_cnt;
+	uint32_t		hit_rate;
+	uint32_t		rate_epoch;
 	enum xnet_state		state;
 	struct util_peer_addr	*peer;
 	struct xnet_conn_handle *conn;
@@ -219,6 +250,13 @@ struct xnet_event {
 
 enum {
 	XNET_CONN_INDEXED = BIT(0),
+	XNET_CONN_SHM = BIT(1),		/* peer is in the shm av */
+	XNET_CONN_SHM_TX = BIT(2),	/* we send to the peer over shm */
+	XNET_CONN_SHM_HELLO = BIT(3),	/* we sent our shm address */
+	XNET_CONN_SHM_READY = BIT(4),	/* peer has our shm address */
+	XNET_CONN_CLOSING = BIT(5),	/* close requested or acked */
+	XNET_CONN_CLOSE_ACKED = BIT(6),	/* we acked the peer's request */
+	XNET_CONN_UNUSED = BIT(7),	/* no transfer since connecting */
 };
 
 struct xnet_conn {
@@ -228,8 +266,19 @@ struct xnet_conn {
 	uint32_t		remote_pid;
 	int			flags;
 	struct dlist_entry	loopback_entry;
+	struct dlist_entry	lru_entry;
+
+	/* Used in place of ep for local peers, see xnet_shm.c */
+	struct fid_ep		shm_fid;
+	fi_addr_t		shm_addr;
 };
 
+static inline struct fid_ep *xnet_conn_ep(struct xnet_conn *conn)
+{
+	return (conn->flags & XNET_CONN_SHM_TX) ?
+	       &conn->shm_fid : &conn->ep->util_ep.ep_fid;
+}
+
 struct xnet_rdm {
 	struct util_ep		util_ep;
 
@@ -239,6 +288,29 @@ struct xnet_rdm {
 	struct index_map	conn_idx_map;
 	struct dlist_entry	loopback_list;
 	union ofi_sock_ip	addr;
+
+	/* Connected peers in least recently used order.  Once more than
+	 * max_conns are open, idle ones are closed, see xnet_rdm_cm.c.
+	 */
+	struct dlist_entry	lru_list;
+	struct dlist_entry	evict_entry;
+	size_t			conn_cnt;
+	size_t			closing_cnt;
+	size_t			max_conns;
+	uint64_t		evict_time;
+
+	/* Companion shm endpoint for local peers */
+	struct fid_ep		*shm_ep;
+	struct fid_cq		*shm_cq;
+	struct fid_av		*shm_av;
+	struct ofi_bufpool	*shm_buf_pool;
+	struct index_map	shm_idx_map;
+	struct dlist_entry	shm_unexp_list;
+	struct dlist_entry	shm_xfer_list;
+	struct slist		shm_queue;
+	struct dlist_entry	shm_entry;
+	size_t			shm_inject_size;
+	uint64_t		shm_seq;
 };
 
 int xnet_rdm_ep(struct fid_domain *domain, struct fi_info *info,
@@ -246,7 +318,38 @@ int xnet_rdm_ep(struct fid_domain *domain, struct fi_info *info,
 ssize_t xnet_get_conn(struct xnet_rdm *rdm, fi_addr_t dest_addr,
 		      struct xnet_conn **conn);
 struct xnet_ep *xnet_get_ep(struct xnet_rdm *rdm, fi_addr_t addr);
+struct xnet_conn *xnet_add_conn(struct xnet_rdm *rdm,
+				struct util_peer_addr *peer);
 void xnet_freeall_conns(struct xnet_rdm *rdm);
+int xnet_handle_close(struct xnet_conn *conn, uint8_t op_data);
+void xnet_evict_progress(struct xnet_progress *progress);
+
+/* Move a connection to the most recently used end of the lru list */
+static inline void xnet_touch_conn(struct xnet_conn *conn)
+{
+	if (dlist_empty(&conn->lru_entry))
+		return;
+
+	conn->flags &= ~XNET_CONN_UNUSED;
+	dlist_remove(&conn->lru_entry);
+	dlist_insert_tail(&conn->lru_entry, &conn->rdm->lru_list);
+}
+
+int xnet_shm_ep_open(struct xnet_rdm *rdm);
+void xnet_shm_ep_close(struct xnet_rdm *rdm);
+int xnet_shm_connect(struct xnet_conn *conn);
+ssize_t xnet_shm_ready(struct xnet_conn *conn);
+void xnet_shm_progress(struct xnet_progress *progress);
+void xnet_shm_progress_unexp(struct xnet_rdm *rdm);
+bool xnet_shm_peek(struct xnet_rdm *rdm, struct xnet_xfer_entry *recv_entry);
+
+struct xnet_poll_stats {
+	uint64_t		hot_polls;
+	uint64_t		all_polls;
+	uint64_t		idle_polls;
+	uint64_t		promotions;
+	uint64_t		demotions;
+};
 
 /* Serialization is handled at the progress instance level, using the
  * progress locks.  A progress instance has 2 locks, only one of which is
@@ -287,6 +390,8 @@ struct xnet_progress {
 	struct dlist_entry	unexp_msg_list;
 	struct dlist_entry	unexp_tag_list;
 	struct dlist_entry	hot_list;
+	struct dlist_entry	shm_list;
+	struct dlist_entry	evict_list;
 	struct fd_signal	signal;
 
 	struct slist		event_list;
@@ -299,6 +404,16 @@ struct xnet_progress {
 	int			poll_cooldown;
 	int			cooldown_cntr;
 
+	/* The active set is sampled every poll_cooldown polls of it, called
+	 * an epoch.  With poll_adaptive, sockets join and leave it based on
+	 * their rate of events per epoch, and poll_fairness and poll_batch
+	 * follow the events found by polling all sockets.
+	 */
+	bool			poll_adaptive;
+	uint32_t		epoch;
+	int			poll_batch;
+	struct xnet_poll_stats	stats;
+
 	bool			auto_progress;
 	pthread_t		thread;
 };
@@ -349,6 +464,9 @@ static inline void xnet_signal_progress(struct xnet_progress *progress)
 #define XNET_NEED_DYN_RBUF 	BIT(4)
 #define XNET_ASYNC		BIT(5)
 #define XNET_INJECT_OP		BIT(6)
+#define XNET_SHM_SEND_HDR	BIT(7)
+#define XNET_SHM_SEND_DATA	BIT(8)
+#define XNET_SHM_RECV_DATA	BIT(9)
 #define XNET_MULTI_RECV		FI_MULTI_RECV /* BIT(16) */
 
 struct xnet_xfer_entry {
@@ -376,13 +494,23 @@ struct xnet_xfer_entry {
 	// for RMA read requests, we need a way to track the request response
 	// so that we don't propagate multiple completions for the same operation
 	struct xnet_xfer_entry  *resp_entry;
+	/* transfers owned by the rdm shm endpoint */
+	struct dlist_entry	shm_entry;
 };
 
 struct xnet_domain {
 	struct util_domain		util_domain;
 	struct xnet_progress		progress;
+
+	struct fi_info			*shm_info;
+	struct fid_fabric		*shm_fabric;
+	struct fid_domain		*shm_domain;
+	uint64_t			shm_seed;
 };
 
+void xnet_shm_domain_open(struct xnet_domain *domain, struct fi_info *info);
+void xnet_shm_domain_close(struct xnet_domain *domain);
+
 static inline struct xnet_progress *xnet_ep2_progress(struct xnet_ep *ep)
 {
 	struct xnet_domain *domain;
@@ -472,6 +600,8 @@ int xnet_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 		 struct fid_cq **cq_fid, void *context);
 void xnet_report_success(struct xnet_ep *ep, struct util_cq *cq,
 			 struct xnet_xfer_entry *xfer_entry);
+void xnet_report_peer_success(struct util_peer_addr *peer, struct util_cq *cq,
+			      struct xnet_xfer_entry *xfer_entry);
 void xnet_cq_report_error(struct util_cq *cq,
 			  struct xnet_xfer_entry *xfer_entry,
 			  int err);
@@ -482,10 +612,14 @@ int xnet_cntr_open(struct fid_domain *fid_domain, struct fi_cntr_attr *attr,
 void xnet_report_cntr_success(struct xnet_ep *ep, struct util_cq *cq,
 			      struct xnet_xfer_entry *xfer_entry);
 void xnet_cntr_incerr(struct xnet_ep *ep, struct xnet_xfer_entry *xfer_entry);
+void xnet_util_cntr_incerr(struct util_ep *ep,
+			   struct xnet_xfer_entry *xfer_entry);
 
 void xnet_reset_rx(struct xnet_ep *ep);
 
 void xnet_progress_rx(struct xnet_ep *ep);
+int xnet_alter_mrecv(struct xnet_srx *srx, struct xnet_xfer_entry *xfer,
+		     size_t msg_len);
 void xnet_progress_async(struct xnet_ep *ep);
 
 void xnet_hdr_none(struct xnet_base_hdr *hdr);
@@ -493,6 +627,7 @@ void xnet_hdr_bswap(struct xnet_base_hdr *hdr);
 
 void xnet_tx_queue_insert(struct xnet_ep *ep,
 			  struct xnet_xfer_entry *tx_entry);
+int xnet_queue_ctrl(struct xnet_ep *ep, uint8_t op_data);
 
 int xnet_eq_create(struct fid_fabric *fabric_fid, struct fi_eq_attr *attr,
 		   struct fid_eq **eq_fid, void *context);
@@ -593,6 +728,8 @@ static inline bool xnet_has_unexp(struct xnet_ep *ep)
 	return ep->cur_rx.handler && !ep->cur_rx.entry;
 }
 
+bool xnet_warm_ep(struct xnet_progress *progress, struct xnet_ep *ep);
+
 static inline void xnet_active_ep(struct xnet_ep *ep)
 {
 	struct xnet_progress *progress;
@@ -605,9 +742,13 @@ static inline void xnet_active_ep(struct xnet_ep *ep)
 	if (!dlist_empty(&ep->hot_entry))
 		return;
 
+	if (progress->poll_adaptive && !xnet_warm_ep(progress, ep))
+		return;
+
 	(void) ofi_dynpoll_add(&progress->hotfds, ep->bsock.sock,
 			       ep->pollflags, &ep->util_ep.ep_fid.fid);
 	dlist_insert_tail(&ep->hot_entry, &progress->hot_list);
+	progress->stats.promotions++;
 }
 
 #define XNET_WARN_ERR(subsystem, log_str, err) \
@@ -125,8 +125,8 @@ void xnet_get_cq_info(struct xnet_xfer_entry *entry, uint64_t *flags,
 	}
 }
 
-void xnet_report_success(struct xnet_ep *ep, struct util_cq *cq,
-			 struct xnet_xfer_entry *xfer_entry)
+void xnet_report_peer_success(struct util_peer_addr *peer, struct util_cq *cq,
+			      struct xnet_xfer_entry *xfer_entry)
 {
 	uint64_t flags, data, tag;
 	size_t len;
@@ -151,10 +151,10 @@ void xnet_report_success(struct xnet_ep *ep, struct util_cq *cq,
 		tag = 0;
 	}
 
-	if (cq->src && ep->peer) {
+	if (cq->src && peer) {
 		ofi_cq_write_src(cq, xfer_entry->context, flags, len,
 				 xfer_entry->user_buf, data, tag,
-				 ep->peer->fi_addr);
+				 peer->fi_addr);
 	} else {
 		ofi_cq_write(cq, xfer_entry->context, flags, len,
 			     xfer_entry->user_buf, data, tag);
@@ -163,6 +163,12 @@ void xnet_report_success(struct xnet_ep *ep, struct util_cq *cq,
 		cq->wait->signal(cq->wait);
 }
 
+void xnet_report_success(struct xnet_ep *ep, struct util_cq *cq,
+			 struct xnet_xfer_entry *xfer_entry)
+{
+	xnet_report_peer_success(ep->peer, cq, xfer_entry);
+}
+
 void xnet_cq_report_error(struct util_cq *cq,
 			  struct xnet_xfer_entry *xfer_entry,
 			  int err)
@@ -296,22 +302,22 @@ static void xnet_cntr_progress(struct util_cntr *cntr)
 }
 
 static struct util_cntr *
-xnet_get_cntr(struct xnet_ep *ep, struct xnet_xfer_entry *xfer_entry)
+xnet_get_cntr(struct util_ep *ep, struct xnet_xfer_entry *xfer_entry)
 {
 	struct util_cntr *cntr;
 
 	if (xfer_entry->cq_flags & FI_RECV) {
-		cntr = ep->util_ep.rx_cntr;
+		cntr = ep->rx_cntr;
 	} else if (xfer_entry->cq_flags & FI_SEND) {
-		cntr = ep->util_ep.tx_cntr;
+		cntr = ep->tx_cntr;
 	} else if (xfer_entry->cq_flags & FI_WRITE) {
-		cntr = ep->util_ep.wr_cntr;
+		cntr = ep->wr_cntr;
 	} else if (xfer_entry->cq_flags & FI_READ) {
-		cntr = ep->util_ep.rd_cntr;
+		cntr = ep->rd_cntr;
 	} else if (xfer_entry->cq_flags & FI_REMOTE_WRITE) {
-		cntr = ep->util_ep.rem_wr_cntr;
+		cntr = ep->rem_wr_cntr;
 	} else if (xfer_entry->cq_flags & FI_REMOTE_READ) {
-		cntr = ep->util_ep.rem_rd_cntr;
+		cntr = ep->rem_rd_cntr;
 	} else {
 		assert(0);
 		cntr = NULL;
@@ -337,12 +343,12 @@ void xnet_report_cntr_success(struct xnet_ep *ep, struct util_cq *cq,
 	xnet_report_success(ep, cq, xfer_entry);
 }
 
-void xnet_cntr_incerr(struct xnet_ep *ep, struct xnet_xfer_entry *xfer_entry)
+void xnet_util_cntr_incerr(struct util_ep *ep,
+			   struct xnet_xfer_entry *xfer_entry)
 {
 	struct util_cntr *cntr;
 
-	if (ep->report_success == xnet_report_success ||
-	    xfer_entry->ctrl_flags & XNET_INTERNAL_XFER)
+	if (xfer_entry->ctrl_flags & XNET_INTERNAL_XFER)
 		return;
 
 	cntr = xnet_get_cntr(ep, xfer_entry);
@@ -350,6 +356,14 @@ void xnet_cntr_incerr(struct xnet_ep *ep, struct xnet_xfer_entry *xfer_entry)
 		fi_cntr_adderr(&cntr->cntr_fid, 1);
 }
 
+void xnet_cntr_incerr(struct xnet_ep *ep, struct xnet_xfer_entry *xfer_entry)
+{
+	if (ep->report_success == xnet_report_success)
+		return;
+
+	xnet_util_cntr_incerr(&ep->util_ep, xfer_entry);
+}
+
 static uint64_t xnet_cntr_read(struct fid_cntr *cntr_fid)
 {
 	struct util_cntr *cntr;
@@ -411,11 +425,13 @@ static int xnet_cntr_seterr(struct fid_cntr *cntr_fid, uint64_t value)
 static int
 xnet_cntr_wait(struct fid_cntr *cntr_fid, uint64_t threshold, int timeout)
 {
+	struct xnet_progress *progress;
 	struct util_cntr *cntr;
 	uint64_t endtime, errcnt;
 	int ret;
 
 	cntr = container_of(cntr_fid, struct util_cntr, cntr_fid);
+	progress = xnet_cntr2_progress(cntr);
 	errcnt = xnet_cntr_readerr(cntr_fid);
 	endtime = ofi_timeout_time(timeout);
 
@@ -429,11 +445,14 @@ xnet_cntr_wait(struct fid_cntr *cntr_fid, uint64_t threshold, int timeout)
 		if (ofi_adjust_timeout(endtime, &timeout))
 			return -FI_ETIMEDOUT;
 
-		ret = xnet_progress_wait(xnet_cntr2_progress(cntr), timeout);
+		/* shm completions do not wake the progress fds */
+		ret = xnet_progress_wait(progress,
+					 dlist_empty(&progress->shm_list) ?
+					 timeout : 0);
 		if (ret < 0)
 			break;
 
-		xnet_progress(xnet_cntr2_progress(cntr), true);
+		xnet_progress(progress, true);
 	} while (true);
 
 	return ret;
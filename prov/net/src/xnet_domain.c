@@ -145,17 +145,50 @@ static int xnet_domain_close(fid_t fid)
 	if (ret)
 		return ret;
 
+	xnet_shm_domain_close(domain);
 	xnet_close_progress(&domain->progress);
 	free(domain);
 	return FI_SUCCESS;
 }
 
+/* All endpoints of the domain share its progress object, which already
+ * keeps the active ones on a hot list.
+ */
+static int xnet_domain_progress(struct fid_domain *domain_fid)
+{
+	struct xnet_domain *domain;
+
+	domain = container_of(domain_fid, struct xnet_domain,
+			      util_domain.domain_fid);
+	xnet_progress(&domain->progress, false);
+	return 0;
+}
+
+static struct fi_ops_progress xnet_domain_progress_ops = {
+	.size = sizeof(struct fi_ops_progress),
+	.progress = xnet_domain_progress,
+};
+
+static int xnet_domain_ops_open(struct fid *fid, const char *name,
+				uint64_t flags, void **ops, void *context)
+{
+	if (flags)
+		return -FI_EBADFLAGS;
+
+	if (!strcasecmp(name, FI_PROGRESS_OPS_1)) {
+		*ops = &xnet_domain_progress_ops;
+		return 0;
+	}
+
+	return -FI_ENOSYS;
+}
+
 static struct fi_ops xnet_domain_fi_ops = {
 	.size = sizeof(struct fi_ops),
 	.close = xnet_domain_close,
 	.bind = ofi_domain_bind,
 	.control = fi_no_control,
-	.ops_open = fi_no_ops_open,
+	.ops_open = xnet_domain_ops_open,
 	.tostr = fi_no_tostr,
 	.ops_set = fi_no_ops_set,
 };
@@ -199,6 +232,8 @@ int xnet_domain_open(struct fid_fabric *fabric_fid, struct fi_info *info,
 			goto close_prog;
 	}
 
+	xnet_shm_domain_open(domain, info);
+
 	domain->util_domain.domain_fid.fid.ops = &xnet_domain_fi_ops;
 	domain->util_domain.domain_fid.ops = &xnet_domain_ops;
 	domain->util_domain.domain_fid.mr = &xnet_domain_fi_ops_mr;
@@ -153,6 +153,8 @@ static int xnet_monitor_ep(struct xnet_progress *progress, struct xnet_ep *ep)
 	if (progress->hotfds.type) {
 		assert(dlist_empty(&ep->hot_entry));
 		dlist_insert_tail(&ep->hot_entry, &progress->hot_list);
+		ep->hit_rate = 0;
+		ep->rate_epoch = progress->epoch;
 	}
 
 	return xnet_monitor_sock(progress, ep->bsock.sock, ep->pollflags,
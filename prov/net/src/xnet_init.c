@@ -65,7 +65,10 @@ size_t xnet_default_rx_size = 256;
 size_t xnet_zerocopy_size = SIZE_MAX;
 int xnet_poll_fairness = 0;
 int xnet_poll_cooldown = 0;
+int xnet_poll_adaptive;
 int xnet_disable_autoprog;
+int xnet_use_shm;
+size_t xnet_max_conns;
 
 
 static void xnet_init_env(void)
@@ -150,11 +153,33 @@ static void xnet_init_env(void)
 			"before being removed from the active set. "
 			"Default (%d)", xnet_poll_cooldown);
 	fi_param_get_int(&xnet_prov, "poll_cooldown", &xnet_poll_cooldown);
+	fi_param_define(&xnet_prov, "poll_adaptive", FI_PARAM_BOOL,
+			"Enables the active set and adapts it to the traffic. "
+			"Sockets join and leave the active set based on their "
+			"average rate of events, and the number of polls of the "
+			"active set per poll of all sockets follows how often "
+			"the latter finds inactive sockets.  poll_fairness "
+			"gives the initial ratio, and poll_cooldown the number "
+			"of polls over which rates are sampled (default: %d)",
+			xnet_poll_adaptive);
+	fi_param_get_bool(&xnet_prov, "poll_adaptive", &xnet_poll_adaptive);
 
 	fi_param_define(&xnet_prov, "disable_auto_progress", FI_PARAM_BOOL,
 			"prevent auto-progress thread from starting");
 	fi_param_get_bool(&xnet_prov, "disable_auto_progress",
 			&xnet_disable_autoprog);
+
+	fi_param_define(&xnet_prov, "use_shm", FI_PARAM_BOOL,
+			"exchange data with rdm peers on the same node through "
+			"the shm provider. Default (%d)", xnet_use_shm);
+	fi_param_get_bool(&xnet_prov, "use_shm", &xnet_use_shm);
+
+	fi_param_define(&xnet_prov, "max_conns", FI_PARAM_SIZE_T,
+			"number of connections an rdm endpoint keeps open "
+			"before closing the least recently used idle ones. "
+			"All peers must support closing connections. "
+			"Default (%zu, unlimited)", xnet_max_conns);
+	fi_param_get_size_t(&xnet_prov, "max_conns", &xnet_max_conns);
 }
 
 static void xnet_fini(void)
@@ -95,8 +95,9 @@ static ssize_t xnet_send_msg(struct xnet_ep *ep)
 	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
 	assert(ep->cur_tx.entry);
 	tx_entry = ep->cur_tx.entry;
-	ret = ofi_bsock_sendv(&ep->bsock, tx_entry->iov, tx_entry->iov_cnt,
-			      &len);
+	OFI_PROBE(xnet_sendv,
+		  ret = ofi_bsock_sendv(&ep->bsock, tx_entry->iov,
+					tx_entry->iov_cnt, &len));
 	if (ret < 0 && ret != -FI_EINPROGRESS)
 		return ret;
 
@@ -129,7 +130,9 @@ static ssize_t xnet_recv_msg_data(struct xnet_ep *ep)
 		return FI_SUCCESS;
 
 	rx_entry = ep->cur_rx.entry;
-	ret = ofi_bsock_recvv(&ep->bsock, rx_entry->iov, rx_entry->iov_cnt);
+	OFI_PROBE(xnet_recvv,
+		  ret = ofi_bsock_recvv(&ep->bsock, rx_entry->iov,
+					rx_entry->iov_cnt));
 	if (ret < 0)
 		return ret;
 
@@ -215,12 +218,13 @@ static void xnet_progress_tx(struct xnet_ep *ep)
 	xnet_update_pollflag(ep, POLLOUT, ofi_bsock_tosend(&ep->bsock));
 }
 
-static int xnet_queue_ack(struct xnet_xfer_entry *rx_entry)
+/* Queue a header only message, such as an ack */
+int xnet_queue_ctrl(struct xnet_ep *ep, uint8_t op_data)
 {
 	struct xnet_xfer_entry *resp;
 
-	assert(xnet_progress_locked(xnet_ep2_progress(rx_entry->ep)));
-	resp = xnet_alloc_xfer(xnet_ep2_progress(rx_entry->ep));
+	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
+	resp = xnet_alloc_xfer(xnet_ep2_progress(ep));
 	if (!resp)
 		return -FI_ENOMEM;
 
@@ -229,19 +233,24 @@ static int xnet_queue_ack(struct xnet_xfer_entry *rx_entry)
 	resp->iov_cnt = 1;
 
 	resp->hdr.base_hdr.version = XNET_HDR_VERSION;
-	resp->hdr.base_hdr.op_data = XNET_OP_ACK;
+	resp->hdr.base_hdr.op_data = op_data;
 	resp->hdr.base_hdr.op = ofi_op_msg;
 	resp->hdr.base_hdr.size = sizeof(resp->hdr.base_hdr);
 	resp->hdr.base_hdr.hdr_size = (uint8_t) sizeof(resp->hdr.base_hdr);
 
 	resp->ctrl_flags = XNET_INTERNAL_XFER;
 	resp->context = NULL;
-	resp->ep = rx_entry->ep;
+	resp->ep = ep;
 
-	xnet_tx_queue_insert(rx_entry->ep, resp);
+	xnet_tx_queue_insert(ep, resp);
 	return FI_SUCCESS;
 }
 
+static int xnet_queue_ack(struct xnet_xfer_entry *rx_entry)
+{
+	return xnet_queue_ctrl(rx_entry->ep, XNET_OP_ACK);
+}
+
 static ssize_t xnet_process_recv(struct xnet_ep *ep)
 {
 	struct xnet_xfer_entry *rx_entry;
@@ -365,15 +374,14 @@ static ssize_t xnet_process_remote_read(struct xnet_ep *ep)
 	return ret;
 }
 
-static int xnet_alter_mrecv(struct xnet_ep *ep, struct xnet_xfer_entry *xfer,
-			    size_t msg_len)
+int xnet_alter_mrecv(struct xnet_srx *srx, struct xnet_xfer_entry *xfer,
+		     size_t msg_len)
 {
 	struct xnet_xfer_entry *recv_entry;
 	size_t left;
 	int ret = FI_SUCCESS;
 
-	assert(ep->srx);
-	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
+	assert(xnet_progress_locked(xnet_srx2_progress(srx)));
 
 	if ((msg_len && !xfer->iov_cnt) || (msg_len > xfer->iov[0].iov_len)) {
 		ret = -FI_ETRUNC;
@@ -381,11 +389,11 @@ static int xnet_alter_mrecv(struct xnet_ep *ep, struct xnet_xfer_entry *xfer,
 	}
 
 	left = xfer->iov[0].iov_len - msg_len;
-	if (!xfer->iov_cnt || (left < ep->srx->min_multi_recv_size))
+	if (!xfer->iov_cnt || (left < srx->min_multi_recv_size))
 		goto complete;
 
 	/* If we can't repost the remaining buffer, return it to the user. */
-	recv_entry = xnet_alloc_xfer(xnet_ep2_progress(ep));
+	recv_entry = xnet_alloc_xfer(xnet_srx2_progress(srx));
 	if (!recv_entry)
 		goto complete;
 
@@ -399,7 +407,7 @@ static int xnet_alter_mrecv(struct xnet_ep *ep, struct xnet_xfer_entry *xfer,
 	recv_entry->iov[0].iov_base = recv_entry->user_buf;
 	recv_entry->iov[0].iov_len = left;
 
-	slist_insert_head(&recv_entry->entry, &ep->srx->rx_queue);
+	slist_insert_head(&recv_entry->entry, &srx->rx_queue);
 	return 0;
 
 complete:
@@ -453,6 +461,21 @@ static int xnet_handle_ack(struct xnet_ep *ep)
 	return FI_SUCCESS;
 }
 
+/* Only rdm endpoints, which record their peer, close idle connections */
+static ssize_t xnet_op_close(struct xnet_ep *ep)
+{
+	uint8_t op_data;
+
+	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
+	if (ep->cur_rx.hdr.base_hdr.size !=
+	    sizeof(ep->cur_rx.hdr.base_hdr) || !ep->peer)
+		return -FI_EIO;
+
+	op_data = ep->cur_rx.hdr.base_hdr.op_data;
+	xnet_reset_rx(ep);
+	return xnet_handle_close(ep->util_ep.ep_fid.fid.context, op_data);
+}
+
 static ssize_t
 xnet_start_recv(struct xnet_ep *ep, struct xnet_xfer_entry *rx_entry)
 {
@@ -475,7 +498,8 @@ xnet_start_recv(struct xnet_ep *ep, struct xnet_xfer_entry *rx_entry)
 
 	if (rx_entry->ctrl_flags & XNET_MULTI_RECV) {
 		assert(msg->hdr.base_hdr.op == ofi_op_msg);
-		ret = xnet_alter_mrecv(ep, rx_entry, msg_len);
+		assert(ep->srx);
+		ret = xnet_alter_mrecv(ep->srx, rx_entry, msg_len);
 		if (ret)
 			goto truncate_err;
 	}
@@ -506,8 +530,10 @@ static ssize_t xnet_op_msg(struct xnet_ep *ep)
 	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
 	if (msg->hdr.base_hdr.op_data == XNET_OP_ACK)
 		return xnet_handle_ack(ep);
+	if (msg->hdr.base_hdr.op_data >= XNET_OP_CLOSE_REQ)
+		return xnet_op_close(ep);
 
-	rx_entry = xnet_get_rx_entry(ep);
+	OFI_PROBE(xnet_rx_match, rx_entry = xnet_get_rx_entry(ep));
 	if (!rx_entry) {
 		if (dlist_empty(&ep->unexp_entry)) {
 			dlist_insert_tail(&ep->unexp_entry,
@@ -524,6 +550,7 @@ static ssize_t xnet_op_tagged(struct xnet_ep *ep)
 {
 	struct xnet_xfer_entry *rx_entry;
 	struct xnet_cur_rx *msg = &ep->cur_rx;
+	fi_addr_t src_addr;
 	uint64_t tag;
 
 	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
@@ -532,7 +559,9 @@ static ssize_t xnet_op_tagged(struct xnet_ep *ep)
 	tag = (msg->hdr.base_hdr.flags & XNET_REMOTE_CQ_DATA) ?
 	      msg->hdr.tag_data_hdr.tag : msg->hdr.tag_hdr.tag;
 
-	rx_entry = ep->srx->match_tag_rx(ep->srx, ep, tag);
+	src_addr = ep->peer ? ep->peer->fi_addr : FI_ADDR_UNSPEC;
+	OFI_PROBE(xnet_rx_match,
+		  rx_entry = ep->srx->match_tag_rx(ep->srx, src_addr, tag));
 	if (!rx_entry) {
 		if (dlist_empty(&ep->unexp_entry)) {
 			dlist_insert_tail(&ep->unexp_entry,
@@ -679,7 +708,7 @@ static ssize_t xnet_recv_hdr(struct xnet_ep *ep)
 next_hdr:
 	buf = (uint8_t *) &ep->cur_rx.hdr + ep->cur_rx.hdr_done;
 	len = ep->cur_rx.hdr_len - ep->cur_rx.hdr_done;
-	ret = ofi_bsock_recv(&ep->bsock, buf, len);
+	OFI_PROBE(xnet_recv_hdr, ret = ofi_bsock_recv(&ep->bsock, buf, len));
 	if (ret < 0)
 		return ret;
 
@@ -709,6 +738,9 @@ next_hdr:
 		return -FI_EIO;
 	}
 
+	if (ep->peer && ep->cur_rx.hdr.base_hdr.op_data < XNET_OP_CLOSE_REQ)
+		xnet_touch_conn(ep->util_ep.ep_fid.fid.context);
+
 	ep->cur_rx.data_left = ep->cur_rx.hdr.base_hdr.size -
 			       ep->cur_rx.hdr.base_hdr.hdr_size;
 	ep->cur_rx.handler = xnet_start_op[ep->cur_rx.hdr.base_hdr.op];
@@ -802,14 +834,16 @@ static void xnet_run_ep(struct xnet_ep *ep, bool pin, bool pout, bool perr)
 	};
 }
 
-static void
+/* Returns the number of events for sockets outside the active set */
+static int
 xnet_handle_events(struct xnet_progress *progress,
 		   struct ofi_epollfds_event *events, int nfds,
 		   bool clear_signal)
 {
+	struct xnet_ep *ep;
 	struct fid *fid;
 	bool pin, pout, perr;
-	int i;
+	int i, cold = 0;
 
 	assert(ofi_genlock_held(progress->active_lock));
 	for (i = 0; i < nfds; i++) {
@@ -822,12 +856,17 @@ xnet_handle_events(struct xnet_progress *progress,
 
 		switch (fid->fclass) {
 		case FI_CLASS_EP:
-			xnet_run_ep(events[i].data.ptr, pin, pout, perr);
+			ep = events[i].data.ptr;
+			if (dlist_empty(&ep->hot_entry))
+				cold++;
+			xnet_run_ep(ep, pin, pout, perr);
 			break;
 		case FI_CLASS_PEP:
+			cold++;
 			xnet_accept_sock(events[i].data.ptr);
 			break;
 		case FI_CLASS_CONNREQ:
+			cold++;
 			xnet_run_conn(events[i].data.ptr, pin, pout, perr);
 			break;
 		default:
@@ -839,6 +878,7 @@ xnet_handle_events(struct xnet_progress *progress,
 	}
 
 	xnet_handle_event_list(progress);
+	return cold;
 }
 
 void xnet_progress_unexp(struct xnet_progress *progress,
@@ -856,35 +896,109 @@ void xnet_progress_unexp(struct xnet_progress *progress,
 	}
 }
 
+/* Event rates are fixed point numbers of events per epoch, averaged with
+ * a weight of 1/2 for the last epoch.  A socket joins the active set once
+ * its rate, including the events of the current epoch, reaches
+ * XNET_HOT_RATE, and leaves it when its rate drops below XNET_COLD_RATE.
+ */
+#define XNET_RATE_SHIFT		4
+#define XNET_HOT_RATE		(2 << XNET_RATE_SHIFT)
+#define XNET_COLD_RATE		(1 << (XNET_RATE_SHIFT - 1))
+
+/* Rates are updated lazily for sockets outside the active set. */
+static void xnet_update_rate(struct xnet_progress *progress,
+			     struct xnet_ep *ep)
+{
+	uint32_t age;
+
+	age = progress->epoch - ep->rate_epoch;
+	if (!age)
+		return;
+
+	ep->hit_rate = (ep->hit_rate +
+			(MIN(ep->hit_cnt, UINT16_MAX) << XNET_RATE_SHIFT)) >> 1;
+	ep->hit_rate = (--age < 32) ? ep->hit_rate >> age : 0;
+	ep->hit_cnt = 0;
+	ep->rate_epoch = progress->epoch;
+}
+
+bool xnet_warm_ep(struct xnet_progress *progress, struct xnet_ep *ep)
+{
+	xnet_update_rate(progress, ep);
+	return ep->hit_rate + (ep->hit_cnt << XNET_RATE_SHIFT) >= XNET_HOT_RATE;
+}
+
+static bool xnet_cold_ep(struct xnet_progress *progress, struct xnet_ep *ep)
+{
+	if (!progress->poll_adaptive) {
+		if (ep->hit_cnt) {
+			ep->hit_cnt = 0;
+			return false;
+		}
+		return true;
+	}
+
+	xnet_update_rate(progress, ep);
+	return ep->hit_rate < XNET_COLD_RATE;
+}
+
 static void xnet_remove_inactives(struct xnet_progress *progress)
 {
 	struct dlist_entry *item, *tmp;
 	struct xnet_ep *ep;
 
 	assert(ofi_genlock_held(progress->active_lock));
+	progress->epoch++;
 	dlist_foreach_safe(&progress->hot_list, item, tmp) {
 		ep = container_of(item, struct xnet_ep, hot_entry);
-		if (ep->hit_cnt || ep->state != XNET_CONNECTED) {
-			ep->hit_cnt = 0;
+		if (!xnet_cold_ep(progress, ep) ||
+		    ep->state != XNET_CONNECTED)
 			continue;
-		}
 
 		assert(!dlist_empty(&ep->hot_entry));
 		dlist_remove_init(&ep->hot_entry);
 		ofi_dynpoll_del(&progress->hotfds, ep->bsock.sock);
+		progress->stats.demotions++;
 	}
 }
 
+/* Poll all sockets less often while doing so only finds active ones, and
+ * more often when it finds others.  The number of events read per poll
+ * follows the number returned.
+ */
+static void xnet_adapt_polling(struct xnet_progress *progress, int nfds,
+			       int cold)
+{
+	if (!nfds)
+		return;
+
+	if (cold) {
+		progress->poll_fairness = MAX(progress->poll_fairness / 2, 1);
+	} else {
+		progress->stats.idle_polls++;
+		if (progress->poll_fairness < XNET_MAX_FAIRNESS)
+			progress->poll_fairness++;
+	}
+
+	if (nfds >= progress->poll_batch)
+		progress->poll_batch = MIN(progress->poll_batch * 2,
+					   XNET_MAX_EVENTS);
+	else if (nfds < progress->poll_batch / 4)
+		progress->poll_batch = MAX(progress->poll_batch / 2,
+					   XNET_MIN_EVENTS);
+}
+
 void xnet_run_progress(struct xnet_progress *progress, bool clear_signal)
 {
 	struct ofi_epollfds_event events[XNET_MAX_EVENTS];
-	int nfds;
+	int nfds, cold;
 
 	assert(ofi_genlock_held(progress->active_lock));
 	if (progress->fairness_cntr) {
 		nfds = ofi_dynpoll_wait(&progress->hotfds, events,
 					   XNET_MAX_EVENTS, 0);
 		xnet_handle_events(progress, events, nfds, clear_signal);
+		progress->stats.hot_polls++;
 		progress->fairness_cntr--;
 		if (progress->cooldown_cntr-- <= 0) {
 			xnet_remove_inactives(progress);
@@ -892,11 +1006,20 @@ void xnet_run_progress(struct xnet_progress *progress, bool clear_signal)
 		}
 	} else {
 		nfds = ofi_dynpoll_wait(&progress->allfds, events,
-					XNET_MAX_EVENTS, 0);
-		xnet_handle_events(progress, events, nfds, clear_signal);
+					progress->poll_batch, 0);
+		cold = xnet_handle_events(progress, events, nfds,
+					  clear_signal);
+		progress->stats.all_polls++;
+		if (progress->poll_adaptive)
+			xnet_adapt_polling(progress, nfds, cold);
 		if (progress->poll_fairness)
 			progress->fairness_cntr = progress->poll_fairness;
 	}
+
+	if (!dlist_empty(&progress->shm_list))
+		xnet_shm_progress(progress);
+	if (!dlist_empty(&progress->evict_list))
+		xnet_evict_progress(progress);
 }
 
 void xnet_progress(struct xnet_progress *progress, bool clear_signal)
@@ -947,14 +1070,19 @@ int xnet_progress_wait(struct xnet_progress *progress, int timeout)
 static void *xnet_auto_progress(void *arg)
 {
 	struct xnet_progress *progress = arg;
-	int nfds;
+	int nfds, timeout;
 
 	FI_INFO(&xnet_prov, FI_LOG_DOMAIN, "progress thread starting\n");
 	ofi_genlock_lock(progress->active_lock);
 	while (progress->auto_progress) {
+		/* shm endpoints opened before the thread started are not
+		 * behind any of the polled fds, so they are polled instead.
+		 */
+		timeout = dlist_empty(&progress->shm_list) ?
+			  -1 : XNET_SHM_WAIT_MS;
 		ofi_genlock_unlock(progress->active_lock);
 
-		nfds = xnet_progress_wait(progress, -1);
+		nfds = xnet_progress_wait(progress, timeout);
 		ofi_genlock_lock(progress->active_lock);
 		if (nfds >= 0) {
 			progress->fairness_cntr = 0;
@@ -1102,6 +1230,8 @@ int xnet_init_progress(struct xnet_progress *progress, struct fi_info *info)
 	dlist_init(&progress->unexp_msg_list);
 	dlist_init(&progress->unexp_tag_list);
 	dlist_init(&progress->hot_list);
+	dlist_init(&progress->shm_list);
+	dlist_init(&progress->evict_list);
 	slist_init(&progress->event_list);
 
 	ret = fd_signal_init(&progress->signal);
@@ -1118,17 +1248,22 @@ int xnet_init_progress(struct xnet_progress *progress, struct fi_info *info)
 	if (ret)
 		goto err2;
 
-	if (xnet_poll_fairness) {
+	progress->poll_batch = XNET_MAX_EVENTS;
+	progress->epoch = 0;
+	memset(&progress->stats, 0, sizeof(progress->stats));
+	if (xnet_poll_fairness || xnet_poll_adaptive) {
 		/* We never block on the hotfds and are serialized by the
 		 * progress lock.  No lock is needed.
 		 */
 		ret = ofi_dynpoll_create(&progress->hotfds, OFI_DYNPOLL_POLL,
 					 OFI_LOCK_NOOP);
 		if (!ret) {
-			progress->poll_fairness = xnet_poll_fairness;
+			progress->poll_adaptive = xnet_poll_adaptive;
+			progress->poll_fairness = xnet_poll_fairness ?
+				xnet_poll_fairness : XNET_DEF_FAIRNESS;
 			progress->fairness_cntr = progress->poll_fairness;
 			progress->poll_cooldown = xnet_poll_cooldown ?
-				xnet_poll_cooldown : xnet_poll_fairness;
+				xnet_poll_cooldown : progress->poll_fairness;
 			progress->cooldown_cntr = progress->poll_cooldown;
 		}
 	}
@@ -1163,10 +1298,20 @@ void xnet_close_progress(struct xnet_progress *progress)
 	assert(dlist_empty(&progress->unexp_msg_list));
 	assert(dlist_empty(&progress->unexp_tag_list));
 	assert(dlist_empty(&progress->hot_list));
+	assert(dlist_empty(&progress->shm_list));
+	assert(dlist_empty(&progress->evict_list));
 	assert(slist_empty(&progress->event_list));
 	xnet_stop_progress(progress);
-	if (progress->hotfds.type)
+	if (progress->hotfds.type) {
+		FI_INFO(&xnet_prov, FI_LOG_DOMAIN, "polls: %" PRIu64
+			" active set, %" PRIu64 " all sockets, %" PRIu64
+			" finding only active ones; sockets: %" PRIu64
+			" activated, %" PRIu64 " deactivated\n",
+			progress->stats.hot_polls, progress->stats.all_polls,
+			progress->stats.idle_polls, progress->stats.promotions,
+			progress->stats.demotions);
 		ofi_dynpoll_close(&progress->hotfds);
+	}
 	ofi_dynpoll_close(&progress->allfds);
 	ofi_bufpool_destroy(progress->xfer_pool);
 	ofi_genlock_destroy(&progress->lock);
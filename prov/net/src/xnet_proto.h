@@ -69,6 +69,10 @@ enum {
 enum {
 	/* backward compatible value */
 	XNET_OP_ACK = 2, /* indicates ack message - should be a flag */
+	/* rdm connection closing handshake, see xnet_rdm_cm.c */
+	XNET_OP_CLOSE_REQ,
+	XNET_OP_CLOSE_ACK,
+	XNET_OP_CLOSE_NACK,
 };
 
 /* Flags */
@@ -81,7 +81,7 @@ xnet_rdm_send(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_send(&conn->ep->util_ep.ep_fid, buf, len, desc, 0, context);
+	ret = fi_send(xnet_conn_ep(conn), buf, len, desc, 0, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -101,7 +101,7 @@ xnet_rdm_sendv(struct fid_ep *ep_fid, const struct iovec *iov,
 	if (ret)
 		goto unlock;
 
-	ret = fi_sendv(&conn->ep->util_ep.ep_fid, iov, desc, count, 0, context);
+	ret = fi_sendv(xnet_conn_ep(conn), iov, desc, count, 0, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -121,7 +121,7 @@ xnet_rdm_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	if (ret)
 		goto unlock;
 
-	ret = fi_sendmsg(&conn->ep->util_ep.ep_fid, msg, flags);
+	ret = fi_sendmsg(xnet_conn_ep(conn), msg, flags);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -141,7 +141,7 @@ xnet_rdm_inject(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_inject(&conn->ep->util_ep.ep_fid, buf, len, 0);
+	ret = fi_inject(xnet_conn_ep(conn), buf, len, 0);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -161,7 +161,7 @@ xnet_rdm_senddata(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_senddata(&conn->ep->util_ep.ep_fid, buf, len, desc, data, 0,
+	ret = fi_senddata(xnet_conn_ep(conn), buf, len, desc, data, 0,
 			  context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -182,7 +182,7 @@ xnet_rdm_injectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_injectdata(&conn->ep->util_ep.ep_fid, buf, len, data, 0);
+	ret = fi_injectdata(xnet_conn_ep(conn), buf, len, data, 0);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -249,7 +249,7 @@ xnet_rdm_tsend(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tsend(&conn->ep->util_ep.ep_fid, buf, len, desc, 0, tag,
+	ret = fi_tsend(xnet_conn_ep(conn), buf, len, desc, 0, tag,
 		       context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -271,7 +271,7 @@ xnet_rdm_tsendv(struct fid_ep *ep_fid, const struct iovec *iov,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tsendv(&conn->ep->util_ep.ep_fid, iov, desc, count, 0, tag,
+	ret = fi_tsendv(xnet_conn_ep(conn), iov, desc, count, 0, tag,
 			context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -292,7 +292,7 @@ xnet_rdm_tsendmsg(struct fid_ep *ep_fid, const struct fi_msg_tagged *msg,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tsendmsg(&conn->ep->util_ep.ep_fid, msg, flags);
+	ret = fi_tsendmsg(xnet_conn_ep(conn), msg, flags);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -312,7 +312,7 @@ xnet_rdm_tinject(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tinject(&conn->ep->util_ep.ep_fid, buf, len, 0, tag);
+	ret = fi_tinject(xnet_conn_ep(conn), buf, len, 0, tag);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -333,7 +333,7 @@ xnet_rdm_tsenddata(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tsenddata(&conn->ep->util_ep.ep_fid, buf, len, desc, data, 0,
+	ret = fi_tsenddata(xnet_conn_ep(conn), buf, len, desc, data, 0,
 			   tag, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -354,7 +354,7 @@ xnet_rdm_tinjectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_tinjectdata(&conn->ep->util_ep.ep_fid, buf, len, data, 0, tag);
+	ret = fi_tinjectdata(xnet_conn_ep(conn), buf, len, data, 0, tag);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -388,7 +388,7 @@ xnet_rdm_read(struct fid_ep *ep_fid, void *buf, size_t len,
 	if (ret)
 		goto unlock;
 
-	ret = fi_read(&conn->ep->util_ep.ep_fid, buf, len, desc, src_addr, addr,
+	ret = fi_read(xnet_conn_ep(conn), buf, len, desc, src_addr, addr,
 		      key, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -410,7 +410,7 @@ xnet_rdm_readv(struct fid_ep *ep_fid, const struct iovec *iov,
 	if (ret)
 		goto unlock;
 
-	ret = fi_readv(&conn->ep->util_ep.ep_fid, iov, desc, count, src_addr, addr,
+	ret = fi_readv(xnet_conn_ep(conn), iov, desc, count, src_addr, addr,
 		       key, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -431,7 +431,7 @@ xnet_rdm_readmsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 	if (ret)
 		goto unlock;
 
-	ret = fi_readmsg(&conn->ep->util_ep.ep_fid, msg, flags);
+	ret = fi_readmsg(xnet_conn_ep(conn), msg, flags);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -452,7 +452,7 @@ xnet_rdm_write(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_write(&conn->ep->util_ep.ep_fid, buf, len, desc, dest_addr,
+	ret = fi_write(xnet_conn_ep(conn), buf, len, desc, dest_addr,
 		       addr, key, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -474,7 +474,7 @@ xnet_rdm_writev(struct fid_ep *ep_fid, const struct iovec *iov,
 	if (ret)
 		goto unlock;
 
-	ret = fi_writev(&conn->ep->util_ep.ep_fid, iov, desc, count, dest_addr,
+	ret = fi_writev(xnet_conn_ep(conn), iov, desc, count, dest_addr,
 			addr, key, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -495,7 +495,7 @@ xnet_rdm_writemsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 	if (ret)
 		goto unlock;
 
-	ret = fi_writemsg(&conn->ep->util_ep.ep_fid, msg, flags);
+	ret = fi_writemsg(xnet_conn_ep(conn), msg, flags);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 	return ret;
@@ -516,7 +516,7 @@ xnet_rdm_inject_write(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_inject_write(&conn->ep->util_ep.ep_fid, buf, len, dest_addr,
+	ret = fi_inject_write(xnet_conn_ep(conn), buf, len, dest_addr,
 			      addr, key);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -539,7 +539,7 @@ xnet_rdm_writedata(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_writedata(&conn->ep->util_ep.ep_fid, buf, len, desc, data,
+	ret = fi_writedata(xnet_conn_ep(conn), buf, len, desc, data,
 			   dest_addr, addr, key, context);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -561,7 +561,7 @@ xnet_rdm_inject_writedata(struct fid_ep *ep_fid, const void *buf,
 	if (ret)
 		goto unlock;
 
-	ret = fi_inject_writedata(&conn->ep->util_ep.ep_fid, buf, len, data,
+	ret = fi_inject_writedata(xnet_conn_ep(conn), buf, len, data,
 				  dest_addr, addr, key);
 unlock:
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
@@ -739,6 +739,12 @@ static int xnet_enable_rdm(struct xnet_rdm *rdm)
 	info->src_addrlen = len;
 	ofi_addr_set_port(info->src_addr, 0);
 
+	ret = xnet_shm_ep_open(rdm);
+	if (ret) {
+		XNET_WARN_ERR(FI_LOG_EP_CTRL, "xnet_shm_ep_open", ret);
+		ret = 0;
+	}
+
 unlock:
 	ofi_genlock_unlock(&progress->rdm_lock);
 	return ret;
@@ -779,6 +785,7 @@ static int xnet_rdm_close(struct fid *fid)
 	}
 
 	xnet_freeall_conns(rdm);
+	xnet_shm_ep_close(rdm);
 	ofi_genlock_unlock(&xnet_rdm2_progress(rdm)->rdm_lock);
 
 	ret = fi_close(&rdm->srx->rx_fid.fid);
@@ -847,6 +854,13 @@ static int xnet_init_rdm(struct xnet_rdm *rdm, struct fi_info *info)
 	}
 
 	dlist_init(&rdm->loopback_list);
+	dlist_init(&rdm->lru_list);
+	dlist_init(&rdm->evict_entry);
+	rdm->max_conns = xnet_max_conns;
+	dlist_init(&rdm->shm_unexp_list);
+	dlist_init(&rdm->shm_xfer_list);
+	dlist_init(&rdm->shm_entry);
+	slist_init(&rdm->shm_queue);
 	rdm->srx = container_of(srx, struct xnet_srx, rx_fid);
 	rdm->pep = container_of(pep, struct xnet_pep, util_pep);
 	return 0;
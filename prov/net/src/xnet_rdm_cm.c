@@ -71,6 +71,15 @@ static void xnet_close_conn(struct xnet_conn *conn)
 	assert(xnet_progress_locked(xnet_rdm2_progress(conn->rdm)));
 	dlist_remove_init(&conn->loopback_entry);
 
+	if (!dlist_empty(&conn->lru_entry)) {
+		if (conn->flags & XNET_CONN_CLOSING)
+			conn->rdm->closing_cnt--;
+		dlist_remove_init(&conn->lru_entry);
+		conn->rdm->conn_cnt--;
+	}
+	conn->flags &= ~(XNET_CONN_CLOSING | XNET_CONN_CLOSE_ACKED |
+			 XNET_CONN_UNUSED);
+
 	if (!conn->ep)
 		return;
 
@@ -242,6 +251,8 @@ static void xnet_free_conn(struct xnet_conn *conn)
 
 	if (conn->flags & XNET_CONN_INDEXED)
 		ofi_idm_clear(&conn->rdm->conn_idx_map, conn->peer->index);
+	if (conn->flags & XNET_CONN_SHM)
+		ofi_idm_clear(&conn->rdm->shm_idx_map, (int) conn->shm_addr);
 
 	util_put_peer(conn->peer);
 	av = container_of(conn->rdm->util_ep.av, struct rxm_av, util_av);
@@ -257,6 +268,7 @@ void xnet_freeall_conns(struct xnet_rdm *rdm)
 
 	av = container_of(rdm->util_ep.av, struct rxm_av, util_av);
 	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	dlist_remove_init(&rdm->evict_entry);
 
 	/* We can't have more connections than the current number of
 	 * possible peers.
@@ -295,6 +307,7 @@ xnet_alloc_conn(struct xnet_rdm *rdm, struct util_peer_addr *peer)
 	conn->rdm = rdm;
 	conn->flags = 0;
 	dlist_init(&conn->loopback_entry);
+	dlist_init(&conn->lru_entry);
 
 	conn->peer = peer;
 	rxm_ref_peer(peer);
@@ -303,7 +316,7 @@ xnet_alloc_conn(struct xnet_rdm *rdm, struct util_peer_addr *peer)
 	return conn;
 }
 
-static struct xnet_conn *
+struct xnet_conn *
 xnet_add_conn(struct xnet_rdm *rdm, struct util_peer_addr *peer)
 {
 	struct xnet_conn *conn;
@@ -343,15 +356,24 @@ ssize_t xnet_get_conn(struct xnet_rdm *rdm, fi_addr_t addr,
 	if (!*conn)
 		return -FI_ENOMEM;
 
+	if ((*conn)->flags & XNET_CONN_SHM_TX)
+		return xnet_shm_ready(*conn);
+
+	if (!(*conn)->ep && rdm->shm_ep && !xnet_shm_connect(*conn))
+		return xnet_shm_ready(*conn);
+
 	if (!(*conn)->ep) {
 		ret = xnet_rdm_connect(*conn);
 		if (ret)
 			return ret;
 	}
 
-	if ((*conn)->ep->state != XNET_CONNECTED)
+	/* A closing connection is reopened once it is gone */
+	if ((*conn)->ep->state != XNET_CONNECTED ||
+	    ((*conn)->flags & XNET_CONN_CLOSING))
 		return -FI_EAGAIN;
 
+	xnet_touch_conn(*conn);
 	return 0;
 }
 
@@ -367,6 +389,179 @@ struct xnet_ep *xnet_get_ep(struct xnet_rdm *rdm, fi_addr_t addr)
 		conn->ep : NULL;
 }
 
+/* Closing idle connections
+ *
+ * With max_conns set, connected peers are kept on the rdm's lru_list.
+ * While more than max_conns of them are open, the progress engine asks
+ * the peers of the least recently used idle connections to close them.
+ * The limit is soft: connections with transfers in flight are left
+ * alone, as are new ones until they carry a transfer, so that they are
+ * not closed before the transfer that opened them is retried.
+ *
+ * The requester stops using the connection and sends a close request.
+ * The peer stops as well and acks if nothing is outstanding on its side,
+ * otherwise it nacks.  As the socket delivers in order, everything the
+ * peer sent is received by the time its ack arrives, and the requester
+ * shuts down the socket.  Both sides free the connection on the
+ * resulting shutdown event and reconnect on the next transfer.
+ */
+#define XNET_EVICT_INTERVAL	10	/* ms */
+
+static bool xnet_conn_quiet(struct xnet_conn *conn)
+{
+	struct xnet_ep *ep = conn->ep;
+
+	return !ep->cur_tx.entry && !ep->cur_rx.handler &&
+	       !ep->cur_rx.hdr_done && !ofi_bsock_tosend(&ep->bsock) &&
+	       slist_empty(&ep->tx_queue) &&
+	       slist_empty(&ep->priority_queue) &&
+	       slist_empty(&ep->need_ack_queue) &&
+	       slist_empty(&ep->async_queue) &&
+	       slist_empty(&ep->rma_read_queue);
+}
+
+/* Connections not yet tracked, such as those whose connected event is
+ * still queued, are never idle.
+ */
+static bool xnet_conn_idle(struct xnet_conn *conn)
+{
+	if (conn->rdm->max_conns && dlist_empty(&conn->lru_entry))
+		return false;
+
+	return conn->ep && conn->ep->state == XNET_CONNECTED &&
+	       !(conn->flags & (XNET_CONN_CLOSING | XNET_CONN_UNUSED)) &&
+	       xnet_conn_quiet(conn);
+}
+
+static void xnet_check_evict(struct xnet_rdm *rdm)
+{
+	if (rdm->conn_cnt - rdm->closing_cnt > rdm->max_conns &&
+	    dlist_empty(&rdm->evict_entry))
+		dlist_insert_tail(&rdm->evict_entry,
+				  &xnet_rdm2_progress(rdm)->evict_list);
+}
+
+static void xnet_set_closing(struct xnet_conn *conn, bool closing)
+{
+	if (closing) {
+		conn->flags |= XNET_CONN_CLOSING;
+		if (!dlist_empty(&conn->lru_entry))
+			conn->rdm->closing_cnt++;
+	} else {
+		conn->flags &= ~(XNET_CONN_CLOSING | XNET_CONN_CLOSE_ACKED);
+		if (!dlist_empty(&conn->lru_entry)) {
+			conn->rdm->closing_cnt--;
+			xnet_check_evict(conn->rdm);
+		}
+	}
+}
+
+/* Loopback connections and local peers reached through shm are not
+ * counted against the limit.
+ */
+static void xnet_track_conn(struct xnet_conn *conn)
+{
+	struct xnet_rdm *rdm = conn->rdm;
+
+	if (!rdm->max_conns || !(conn->flags & XNET_CONN_INDEXED) ||
+	    (conn->flags & XNET_CONN_SHM) ||
+	    !ofi_addr_cmp(&xnet_prov, &conn->peer->addr.sa, &rdm->addr.sa))
+		return;
+
+	dlist_insert_tail(&conn->lru_entry, &rdm->lru_list);
+	conn->flags |= XNET_CONN_UNUSED;
+	rdm->conn_cnt++;
+	xnet_check_evict(rdm);
+}
+
+static void xnet_evict_conns(struct xnet_rdm *rdm)
+{
+	struct xnet_conn *conn;
+	struct dlist_entry *tmp;
+
+	dlist_foreach_container_safe(&rdm->lru_list, struct xnet_conn,
+				     conn, lru_entry, tmp) {
+		if (rdm->conn_cnt - rdm->closing_cnt <= rdm->max_conns)
+			break;
+
+		if (!xnet_conn_idle(conn))
+			continue;
+
+		FI_DBG(&xnet_prov, FI_LOG_EP_CTRL, "evicting conn %p\n", conn);
+		if (!xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_REQ))
+			xnet_set_closing(conn, true);
+	}
+}
+
+void xnet_evict_progress(struct xnet_progress *progress)
+{
+	struct xnet_rdm *rdm;
+	struct dlist_entry *tmp;
+	uint64_t now;
+
+	assert(xnet_progress_locked(progress));
+	now = ofi_gettime_ms();
+	dlist_foreach_container_safe(&progress->evict_list, struct xnet_rdm,
+				     rdm, evict_entry, tmp) {
+		if (rdm->conn_cnt - rdm->closing_cnt <= rdm->max_conns) {
+			dlist_remove_init(&rdm->evict_entry);
+			continue;
+		}
+
+		if (now - rdm->evict_time < XNET_EVICT_INTERVAL)
+			continue;
+
+		rdm->evict_time = now;
+		xnet_evict_conns(rdm);
+	}
+}
+
+int xnet_handle_close(struct xnet_conn *conn, uint8_t op_data)
+{
+	assert(xnet_progress_locked(xnet_rdm2_progress(conn->rdm)));
+	FI_DBG(&xnet_prov, FI_LOG_EP_CTRL, "close %d for conn %p\n",
+	       op_data, conn);
+
+	switch (op_data) {
+	case XNET_OP_CLOSE_REQ:
+		if (conn->flags & XNET_CONN_CLOSING) {
+			/* Both sides asked, each closes on the other's ack */
+			if (!xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_ACK))
+				conn->flags |= XNET_CONN_CLOSE_ACKED;
+		} else if (xnet_conn_idle(conn)) {
+			if (!xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_ACK)) {
+				xnet_set_closing(conn, true);
+				conn->flags |= XNET_CONN_CLOSE_ACKED;
+			}
+		} else {
+			(void) xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_NACK);
+		}
+		break;
+	case XNET_OP_CLOSE_ACK:
+		if (!(conn->flags & XNET_CONN_CLOSING)) {
+			/* Let the peer resume using the connection */
+			(void) xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_NACK);
+		} else if (xnet_conn_quiet(conn)) {
+			xnet_ep_disable(conn->ep, 0, NULL, 0);
+		} else {
+			/* Messages received after our request are pending */
+			xnet_set_closing(conn, false);
+			(void) xnet_queue_ctrl(conn->ep, XNET_OP_CLOSE_NACK);
+		}
+		break;
+	case XNET_OP_CLOSE_NACK:
+		if (conn->flags & XNET_CONN_CLOSING) {
+			xnet_set_closing(conn, false);
+			xnet_touch_conn(conn);
+		}
+		break;
+	default:
+		FI_WARN(&xnet_prov, FI_LOG_EP_CTRL, "unknown close op\n");
+		return -FI_EIO;
+	}
+	return 0;
+}
+
 static void xnet_process_connreq(struct fi_eq_cm_entry *cm_entry)
 {
 	struct xnet_rdm *rdm;
@@ -433,9 +628,12 @@ static void xnet_process_connreq(struct fi_eq_cm_entry *cm_entry)
 		/* If we have't set the remote_pid but we're already connected,
 		 * there's a CONNECTED event on the event list queued after this
 		 * CONNREQ event.  The peer has already accepted the current
-		 * connection.
+		 * connection.  If we acked the peer closing the connection,
+		 * the request may be stale, and the peer retries once our
+		 * side is gone.
 		 */
-		if (!conn->remote_pid || (conn->remote_pid == ntohl(msg->pid))) {
+		if (!conn->remote_pid || (conn->remote_pid == ntohl(msg->pid)) ||
+		    (conn->flags & XNET_CONN_CLOSE_ACKED)) {
 			FI_INFO(&xnet_prov, FI_LOG_EP_CTRL,
 				"simultaneous, reject peer\n");
 			goto put;
@@ -502,11 +700,14 @@ void xnet_handle_event_list(struct xnet_progress *progress)
 			conn = event->cm_entry.fid->context;
 			msg = (struct xnet_rdm_cm *) event->cm_entry.data;
 			conn->remote_pid = ntohl(msg->pid);
+			xnet_track_conn(conn);
 			break;
 		case FI_SHUTDOWN:
 			conn = event->cm_entry.fid->context;
 			xnet_close_conn(conn);
-			xnet_free_conn(conn);
+			/* The peer may still reach us through shm */
+			if (!(conn->flags & XNET_CONN_SHM))
+				xnet_free_conn(conn);
 			break;
 		default:
 			assert(0);
@@ -0,0 +1,1611 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <fasthash.h>
+#include <ofi_iov.h>
+#include "xnet.h"
+
+/* An rdm endpoint may own an shm endpoint, named after a hash of the rdm
+ * address, through which it exchanges data with rdm peers on the same
+ * node.  A peer is local if the shm region named after its address is
+ * visible to us.  The sender announces itself with a hello carrying its
+ * rdm address, and the receiver adds the sender to its shm av before it
+ * acks, so every later packet carries a known source address.
+ *
+ * Packets use the tcp protocol headers and are sent as shm injects into
+ * bounce buffers posted by the receiver.  Small payloads follow the
+ * header.  Larger payloads are sent as a tagged shm message, using a
+ * sequence number carried after the header as tag, which the receiver
+ * posts directly into the matched buffer.  Matching is done against the
+ * rdm srx, so shm and tcp peers share the posted receives and the cq.
+ */
+#define XNET_SHM_NAME_MAX	32
+#define XNET_SHM_PREPOST	64
+#define XNET_SHM_MAX_COMP	16
+#define XNET_SHM_READ_TAG	(1ULL << 63)
+
+/* base_hdr::op_data of shm packets */
+enum {
+	XNET_SHM_INLINE,	/* payload follows the header */
+	XNET_SHM_SEQ,		/* header is followed by the payload tag */
+	XNET_SHM_HELLO,		/* header is followed by the rdm address */
+	XNET_SHM_HELLO_ACK,
+};
+
+struct xnet_shm_buf {
+	struct dlist_entry	entry;
+	struct xnet_conn	*conn;
+	size_t			len;
+	uint8_t			data[];
+};
+
+struct xnet_shm_hello {
+	struct xnet_base_hdr	base_hdr;
+	union ofi_sock_ip	addr;
+};
+
+static inline struct xnet_domain *xnet_rdm2_domain(struct xnet_rdm *rdm)
+{
+	return container_of(rdm->util_ep.domain, struct xnet_domain,
+			    util_domain);
+}
+
+static inline struct xnet_base_hdr *xnet_shm_hdr(struct xnet_shm_buf *buf)
+{
+	return (struct xnet_base_hdr *) buf->data;
+}
+
+static inline uint64_t xnet_shm_seq(struct xnet_shm_buf *buf)
+{
+	uint64_t seq;
+
+	memcpy(&seq, buf->data + xnet_shm_hdr(buf)->hdr_size, sizeof(seq));
+	return seq;
+}
+
+static uint64_t xnet_shm_tag(struct xnet_base_hdr *hdr)
+{
+	return (hdr->flags & XNET_REMOTE_CQ_DATA) ?
+	       ((struct xnet_tag_data_hdr *) hdr)->tag :
+	       ((struct xnet_tag_hdr *) hdr)->tag;
+}
+
+static void xnet_shm_name(struct xnet_domain *domain,
+			  const union ofi_sock_ip *addr, char *name)
+{
+	uint64_t hash;
+	uint16_t port;
+
+	port = ofi_addr_get_port(&addr->sa);
+	hash = fasthash64(&port, sizeof(port), domain->shm_seed);
+	hash = fasthash64(ofi_get_ipaddr(&addr->sa), ofi_sizeofip(&addr->sa),
+			  hash);
+	snprintf(name, XNET_SHM_NAME_MAX, "fi_xnet_%016" PRIx64, hash);
+}
+
+/* The peer's shm endpoint must be visible to us, which is not the case
+ * for processes on another node or with a separate /dev/shm mount.
+ */
+static bool xnet_shm_visible(const char *name)
+{
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+static struct xnet_xfer_entry *xnet_shm_alloc_xfer(struct xnet_rdm *rdm)
+{
+	struct xnet_xfer_entry *xfer;
+
+	xfer = xnet_alloc_xfer(xnet_rdm2_progress(rdm));
+	if (xfer)
+		dlist_init(&xfer->shm_entry);
+	return xfer;
+}
+
+static void xnet_shm_free_xfer(struct xnet_rdm *rdm,
+			       struct xnet_xfer_entry *xfer)
+{
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	dlist_remove(&xfer->shm_entry);
+	xfer->hdr.base_hdr.flags = 0;
+	xfer->cq_flags = 0;
+	xfer->cntr_inc = NULL;
+	xfer->ctrl_flags = 0;
+	xfer->context = 0;
+	xfer->user_buf = NULL;
+	ofi_buf_free(xfer);
+}
+
+static struct util_peer_addr *
+xnet_shm_peer(struct xnet_rdm *rdm, struct xnet_xfer_entry *xfer)
+{
+	struct xnet_conn *conn;
+
+	if (!(xfer->cq_flags & (FI_RECV | FI_REMOTE_WRITE)))
+		return NULL;
+
+	conn = ofi_idm_lookup(&rdm->shm_idx_map, (int) xfer->src_addr);
+	return conn ? conn->peer : NULL;
+}
+
+static struct util_cq *
+xnet_shm_cq(struct xnet_rdm *rdm, struct xnet_xfer_entry *xfer)
+{
+	return (xfer->cq_flags & (FI_RECV | FI_REMOTE_WRITE)) ?
+	       rdm->util_ep.rx_cq : rdm->util_ep.tx_cq;
+}
+
+static void xnet_shm_complete(struct xnet_rdm *rdm,
+			      struct xnet_xfer_entry *xfer)
+{
+	if (!(xfer->ctrl_flags & XNET_INTERNAL_XFER) && xfer->cntr_inc)
+		xfer->cntr_inc(&rdm->util_ep);
+	xnet_report_peer_success(xnet_shm_peer(rdm, xfer),
+				 xnet_shm_cq(rdm, xfer), xfer);
+	xnet_shm_free_xfer(rdm, xfer);
+}
+
+static void xnet_shm_fail(struct xnet_rdm *rdm, struct xnet_xfer_entry *xfer,
+			  int err)
+{
+	xnet_util_cntr_incerr(&rdm->util_ep, xfer);
+	xnet_cq_report_error(xnet_shm_cq(rdm, xfer), xfer, err);
+	xnet_shm_free_xfer(rdm, xfer);
+}
+
+/* The peer matched the header of a payload that we failed to send and
+ * waits on its tag.  Queue an empty payload carrying the error in its
+ * place, as read responses do, so that the peer's receive fails.
+ */
+static void xnet_shm_abort(struct xnet_rdm *rdm, struct xnet_xfer_entry *xfer,
+			   int err)
+{
+	struct xnet_xfer_entry *abort;
+
+	if (!(xfer->ctrl_flags & XNET_SHM_SEND_DATA) ||
+	    (xfer->hdr.base_hdr.flags & XNET_REMOTE_CQ_DATA))
+		return;
+
+	abort = xnet_shm_alloc_xfer(rdm);
+	if (!abort) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"unable to abort shm payload\n");
+		return;
+	}
+
+	abort->ctrl_flags = XNET_SHM_SEND_DATA | XNET_INTERNAL_XFER;
+	abort->src_addr = xfer->src_addr;
+	abort->tag = xfer->tag;
+	abort->iov_cnt = 0;
+	abort->hdr.base_hdr.flags = XNET_REMOTE_CQ_DATA;
+	abort->hdr.cq_data_hdr.cq_data = (uint64_t) err;
+	dlist_insert_tail(&abort->shm_entry, &rdm->shm_xfer_list);
+	slist_insert_tail(&abort->entry, &rdm->shm_queue);
+}
+
+static ssize_t xnet_shm_start(struct xnet_rdm *rdm,
+			      struct xnet_xfer_entry *xfer)
+{
+	ssize_t ret;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	if (xfer->ctrl_flags & XNET_SHM_SEND_HDR) {
+		ret = fi_inject(rdm->shm_ep, &xfer->hdr,
+				(size_t) xfer->hdr.base_hdr.size,
+				xfer->src_addr);
+		if (!ret)
+			xnet_shm_free_xfer(rdm, xfer);
+	} else if (xfer->ctrl_flags & XNET_SHM_SEND_DATA) {
+		if (xfer->hdr.base_hdr.flags & XNET_REMOTE_CQ_DATA) {
+			ret = fi_tsenddata(rdm->shm_ep, NULL, 0, NULL,
+					   xfer->hdr.cq_data_hdr.cq_data,
+					   xfer->src_addr, xfer->tag, xfer);
+		} else {
+			ret = fi_tsendv(rdm->shm_ep, xfer->iov, NULL,
+					xfer->iov_cnt, xfer->src_addr,
+					xfer->tag, xfer);
+		}
+	} else {
+		assert(xfer->ctrl_flags & XNET_SHM_RECV_DATA);
+		ret = fi_trecvv(rdm->shm_ep, xfer->iov, NULL, xfer->iov_cnt,
+				xfer->src_addr, xfer->tag, 0, xfer);
+	}
+
+	if (ret && ret != -FI_EAGAIN) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"shm transfer failed (%zd)\n", ret);
+		xnet_shm_abort(rdm, xfer, (int) -ret);
+		xnet_shm_fail(rdm, xfer, (int) -ret);
+	}
+	return ret;
+}
+
+/* Ownership of the xfer passes to the shm endpoint.  Transfers which
+ * shm cannot accept yet are retried in order from progress.
+ */
+static void xnet_shm_post(struct xnet_rdm *rdm, struct xnet_xfer_entry *xfer)
+{
+	dlist_insert_tail(&xfer->shm_entry, &rdm->shm_xfer_list);
+	if (!slist_empty(&rdm->shm_queue) ||
+	    xnet_shm_start(rdm, xfer) == -FI_EAGAIN)
+		slist_insert_tail(&xfer->entry, &rdm->shm_queue);
+}
+
+static void xnet_shm_progress_queue(struct xnet_rdm *rdm)
+{
+	struct xnet_xfer_entry *xfer;
+
+	while (!slist_empty(&rdm->shm_queue)) {
+		xfer = container_of(slist_remove_head(&rdm->shm_queue),
+				    struct xnet_xfer_entry, entry);
+		if (xnet_shm_start(rdm, xfer) == -FI_EAGAIN) {
+			slist_insert_head(&xfer->entry, &rdm->shm_queue);
+			break;
+		}
+	}
+}
+
+/* Consume a payload that we could not place. */
+static void xnet_shm_drain(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	struct xnet_xfer_entry *xfer;
+
+	xfer = xnet_shm_alloc_xfer(rdm);
+	if (!xfer) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"unable to drain shm payload\n");
+		return;
+	}
+
+	xfer->ctrl_flags = XNET_SHM_RECV_DATA | XNET_INTERNAL_XFER;
+	xfer->cq_flags = FI_RECV;
+	xfer->iov_cnt = 0;
+	xfer->src_addr = buf->conn->shm_addr;
+	xfer->tag = xnet_shm_seq(buf);
+	xnet_shm_post(rdm, xfer);
+}
+
+static size_t
+xnet_shm_init_hdr(struct xnet_base_hdr *hdr, uint8_t op, uint64_t flags,
+		  uint64_t data, uint64_t tag, size_t rma_iov_cnt)
+{
+	size_t hdr_size;
+
+	hdr->version = XNET_HDR_VERSION;
+	hdr->op = op;
+	hdr->flags = 0;
+	hdr->rma_iov_cnt = (uint8_t) rma_iov_cnt;
+	hdr->id = 0;
+
+	if (flags & FI_REMOTE_CQ_DATA) {
+		hdr->flags |= XNET_REMOTE_CQ_DATA;
+		((struct xnet_cq_data_hdr *) hdr)->cq_data = data;
+		if (op == ofi_op_tagged) {
+			((struct xnet_tag_data_hdr *) hdr)->tag = tag;
+			hdr_size = sizeof(struct xnet_tag_data_hdr);
+		} else {
+			hdr_size = sizeof(struct xnet_cq_data_hdr);
+		}
+	} else if (op == ofi_op_tagged) {
+		((struct xnet_tag_hdr *) hdr)->tag = tag;
+		hdr_size = sizeof(struct xnet_tag_hdr);
+	} else {
+		hdr_size = sizeof(*hdr);
+	}
+
+	hdr_size += rma_iov_cnt * sizeof(struct ofi_rma_iov);
+	hdr->hdr_size = (uint8_t) hdr_size;
+	return hdr_size;
+}
+
+static void
+xnet_shm_init_rma(struct xnet_base_hdr *hdr, const struct fi_rma_iov *rma_iov,
+		  size_t rma_iov_cnt)
+{
+	struct ofi_rma_iov *rma;
+	size_t i;
+
+	rma = (struct ofi_rma_iov *) ((uint8_t *) hdr + hdr->hdr_size -
+				      rma_iov_cnt * sizeof(*rma));
+	for (i = 0; i < rma_iov_cnt; i++) {
+		rma[i].addr = rma_iov[i].addr;
+		rma[i].len = rma_iov[i].len;
+		rma[i].key = rma_iov[i].key;
+	}
+}
+
+static ssize_t
+xnet_shm_send(struct xnet_conn *conn, uint8_t op, const struct iovec *iov,
+	      size_t count, const struct fi_rma_iov *rma_iov, size_t rma_count,
+	      uint64_t data, uint64_t tag, void *context, uint64_t flags,
+	      uint64_t cq_flags, void (*cntr_inc)(struct util_ep *ep))
+{
+	struct xnet_rdm *rdm = conn->rdm;
+	struct xnet_xfer_entry *xfer;
+	struct xnet_shm_buf *buf;
+	struct xnet_base_hdr *hdr;
+	size_t hdr_size, len;
+	ssize_t ret;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	assert(count <= XNET_IOV_LIMIT && rma_count <= XNET_IOV_LIMIT);
+	xfer = xnet_shm_alloc_xfer(rdm);
+	if (!xfer)
+		return -FI_EAGAIN;
+
+	buf = ofi_buf_alloc(rdm->shm_buf_pool);
+	if (!buf) {
+		ret = -FI_EAGAIN;
+		goto free_xfer;
+	}
+
+	xfer->ctrl_flags = (cq_flags & FI_INJECT) ? XNET_INJECT_OP : 0;
+	xfer->cq_flags = cq_flags;
+	xfer->cntr_inc = cntr_inc;
+	xfer->context = context;
+	xfer->src_addr = conn->shm_addr;
+
+	hdr = xnet_shm_hdr(buf);
+	hdr_size = xnet_shm_init_hdr(hdr, op, flags, data, tag, rma_count);
+	xnet_shm_init_rma(hdr, rma_iov, rma_count);
+	len = ofi_total_iov_len(iov, count);
+	hdr->size = hdr_size + len;
+
+	if (hdr_size + len <= rdm->shm_inject_size) {
+		hdr->op_data = XNET_SHM_INLINE;
+		ofi_copy_from_iov(buf->data + hdr_size, len, iov, count, 0);
+		ret = fi_inject(rdm->shm_ep, buf->data, hdr_size + len,
+				conn->shm_addr);
+		if (ret)
+			goto free_buf;
+
+		xnet_shm_complete(rdm, xfer);
+		ofi_buf_free(buf);
+		return 0;
+	}
+
+	assert(!(cq_flags & FI_INJECT));
+	hdr->op_data = XNET_SHM_SEQ;
+	memcpy(buf->data + hdr_size, &rdm->shm_seq, sizeof(rdm->shm_seq));
+	ret = fi_inject(rdm->shm_ep, buf->data, hdr_size + sizeof(uint64_t),
+			conn->shm_addr);
+	if (ret)
+		goto free_buf;
+
+	ofi_buf_free(buf);
+	xfer->ctrl_flags |= XNET_SHM_SEND_DATA;
+	xfer->tag = rdm->shm_seq++;
+	xfer->iov_cnt = count;
+	memcpy(xfer->iov, iov, count * sizeof(*iov));
+	xnet_shm_post(rdm, xfer);
+	return 0;
+
+free_buf:
+	ofi_buf_free(buf);
+free_xfer:
+	xnet_shm_free_xfer(rdm, xfer);
+	return ret;
+}
+
+static ssize_t
+xnet_shm_read(struct xnet_conn *conn, const struct iovec *iov, size_t count,
+	      const struct fi_rma_iov *rma_iov, size_t rma_count,
+	      void *context, uint64_t flags)
+{
+	struct xnet_rdm *rdm = conn->rdm;
+	struct xnet_xfer_entry *xfer;
+	struct xnet_shm_buf *buf;
+	struct xnet_base_hdr *hdr;
+	size_t hdr_size;
+	uint64_t seq;
+	ssize_t ret;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	assert(count <= XNET_IOV_LIMIT && rma_count <= XNET_IOV_LIMIT);
+	xfer = xnet_shm_alloc_xfer(rdm);
+	if (!xfer)
+		return -FI_EAGAIN;
+
+	buf = ofi_buf_alloc(rdm->shm_buf_pool);
+	if (!buf) {
+		xnet_shm_free_xfer(rdm, xfer);
+		return -FI_EAGAIN;
+	}
+
+	hdr = xnet_shm_hdr(buf);
+	hdr_size = xnet_shm_init_hdr(hdr, ofi_op_read_req, 0, 0, 0, rma_count);
+	xnet_shm_init_rma(hdr, rma_iov, rma_count);
+	hdr->op_data = XNET_SHM_SEQ;
+	hdr->size = hdr_size;
+
+	seq = rdm->shm_seq | XNET_SHM_READ_TAG;
+	memcpy(buf->data + hdr_size, &seq, sizeof(seq));
+	ret = fi_inject(rdm->shm_ep, buf->data, hdr_size + sizeof(seq),
+			conn->shm_addr);
+	ofi_buf_free(buf);
+	if (ret) {
+		xnet_shm_free_xfer(rdm, xfer);
+		return ret;
+	}
+
+	rdm->shm_seq++;
+	xfer->ctrl_flags = XNET_SHM_RECV_DATA;
+	xfer->cq_flags = ((rdm->util_ep.tx_op_flags | flags) & FI_COMPLETION) |
+			 FI_RMA | FI_READ;
+	xfer->cntr_inc = ofi_ep_rd_cntr_inc;
+	xfer->context = context;
+	xfer->src_addr = conn->shm_addr;
+	xfer->tag = seq;
+	xfer->iov_cnt = count;
+	memcpy(xfer->iov, iov, count * sizeof(*iov));
+	xnet_shm_post(rdm, xfer);
+	return 0;
+}
+
+static void xnet_shm_start_recv(struct xnet_rdm *rdm, struct xnet_shm_buf *buf,
+				struct xnet_xfer_entry *rx_entry)
+{
+	struct xnet_base_hdr *hdr;
+	size_t msg_len;
+	int ret;
+
+	hdr = xnet_shm_hdr(buf);
+	msg_len = hdr->size - hdr->hdr_size;
+
+	rx_entry->cq_flags |= rdm->util_ep.rx_op_flags & FI_COMPLETION;
+	memcpy(&rx_entry->hdr, hdr, (size_t) hdr->hdr_size);
+	rx_entry->src_addr = buf->conn->shm_addr;
+	dlist_init(&rx_entry->shm_entry);
+
+	if (rx_entry->ctrl_flags & XNET_MULTI_RECV) {
+		assert(hdr->op == ofi_op_msg);
+		ret = xnet_alter_mrecv(rdm->srx, rx_entry, msg_len);
+		if (ret)
+			goto truncate_err;
+	}
+
+	ret = ofi_truncate_iov(rx_entry->iov, &rx_entry->iov_cnt, msg_len);
+	if (ret)
+		goto truncate_err;
+
+	if (hdr->op_data == XNET_SHM_INLINE) {
+		ofi_copy_to_iov(rx_entry->iov, rx_entry->iov_cnt, 0,
+				buf->data + hdr->hdr_size, msg_len);
+		xnet_shm_complete(rdm, rx_entry);
+	} else {
+		rx_entry->ctrl_flags |= XNET_SHM_RECV_DATA;
+		rx_entry->tag = xnet_shm_seq(buf);
+		xnet_shm_post(rdm, rx_entry);
+	}
+	return;
+
+truncate_err:
+	FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+		"posted rx buffer size is not big enough\n");
+	xnet_shm_fail(rdm, rx_entry, -ret);
+	if (hdr->op_data == XNET_SHM_SEQ)
+		xnet_shm_drain(rdm, buf);
+}
+
+static struct xnet_xfer_entry *
+xnet_shm_match(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	struct xnet_base_hdr *hdr;
+	struct xnet_srx *srx = rdm->srx;
+
+	hdr = xnet_shm_hdr(buf);
+	if (hdr->op == ofi_op_tagged) {
+		return srx->match_tag_rx(srx, buf->conn->peer->fi_addr,
+					 xnet_shm_tag(hdr));
+	}
+
+	if (slist_empty(&srx->rx_queue))
+		return NULL;
+
+	return container_of(slist_remove_head(&srx->rx_queue),
+			    struct xnet_xfer_entry, entry);
+}
+
+/* Returns true if the buffer was queued as unexpected. */
+static bool xnet_shm_recv(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	struct xnet_xfer_entry *rx_entry;
+
+	rx_entry = xnet_shm_match(rdm, buf);
+	if (!rx_entry) {
+		dlist_insert_tail(&buf->entry, &rdm->shm_unexp_list);
+		return true;
+	}
+
+	xnet_shm_start_recv(rdm, buf, rx_entry);
+	return false;
+}
+
+void xnet_shm_progress_unexp(struct xnet_rdm *rdm)
+{
+	struct xnet_xfer_entry *rx_entry;
+	struct xnet_shm_buf *buf;
+	struct dlist_entry *tmp;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	dlist_foreach_container_safe(&rdm->shm_unexp_list, struct xnet_shm_buf,
+				     buf, entry, tmp) {
+		rx_entry = xnet_shm_match(rdm, buf);
+		if (!rx_entry)
+			continue;
+
+		dlist_remove(&buf->entry);
+		xnet_shm_start_recv(rdm, buf, rx_entry);
+		ofi_buf_free(buf);
+	}
+}
+
+bool xnet_shm_peek(struct xnet_rdm *rdm, struct xnet_xfer_entry *recv_entry)
+{
+	struct xnet_base_hdr *hdr;
+	struct xnet_shm_buf *buf;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	dlist_foreach_container(&rdm->shm_unexp_list, struct xnet_shm_buf,
+				buf, entry) {
+		hdr = xnet_shm_hdr(buf);
+		if (hdr->op != ofi_op_tagged)
+			continue;
+
+		if ((rdm->util_ep.caps & FI_DIRECTED_RECV) &&
+		    (recv_entry->src_addr != FI_ADDR_UNSPEC) &&
+		    (recv_entry->src_addr != buf->conn->peer->fi_addr))
+			continue;
+
+		if (!ofi_match_tag(recv_entry->tag, recv_entry->ignore,
+				   xnet_shm_tag(hdr)))
+			continue;
+
+		memcpy(&recv_entry->hdr, hdr, (size_t) hdr->hdr_size);
+		recv_entry->cq_flags |= rdm->util_ep.rx_op_flags & FI_COMPLETION;
+		xnet_report_peer_success(buf->conn->peer,
+					 &rdm->srx->cq->util_cq, recv_entry);
+		return true;
+	}
+	return false;
+}
+
+static void xnet_shm_read_req(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	struct xnet_xfer_entry *resp;
+	struct xnet_base_hdr *hdr;
+	struct ofi_rma_iov *rma_iov;
+	int i, ret;
+
+	resp = xnet_shm_alloc_xfer(rdm);
+	if (!resp) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"unable to respond to shm read request\n");
+		return;
+	}
+
+	hdr = xnet_shm_hdr(buf);
+	rma_iov = (struct ofi_rma_iov *) ((uint8_t *) hdr + sizeof(*hdr));
+	resp->ctrl_flags = XNET_SHM_SEND_DATA | XNET_INTERNAL_XFER;
+	resp->cq_flags = FI_REMOTE_READ;
+	resp->src_addr = buf->conn->shm_addr;
+	resp->tag = xnet_shm_seq(buf);
+	resp->iov_cnt = hdr->rma_iov_cnt;
+	for (i = 0; i < hdr->rma_iov_cnt; i++) {
+		ret = ofi_mr_verify(&rdm->util_ep.domain->mr_map,
+				    rma_iov[i].len,
+				    (uintptr_t *) &rma_iov[i].addr,
+				    rma_iov[i].key, FI_REMOTE_READ);
+		if (ret) {
+			FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			       "invalid rma iov received\n");
+			/* The requester reports the error carried as data */
+			resp->hdr.base_hdr.flags = XNET_REMOTE_CQ_DATA;
+			resp->hdr.cq_data_hdr.cq_data = (uint64_t) -ret;
+			break;
+		}
+
+		resp->iov[i].iov_base = (void *) (uintptr_t) rma_iov[i].addr;
+		resp->iov[i].iov_len = rma_iov[i].len;
+	}
+
+	xnet_shm_post(rdm, resp);
+}
+
+static void xnet_shm_write(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	struct xnet_xfer_entry *rx_entry;
+	struct xnet_base_hdr *hdr;
+	struct ofi_rma_iov *rma_iov;
+	int i, ret;
+
+	hdr = xnet_shm_hdr(buf);
+	rx_entry = xnet_shm_alloc_xfer(rdm);
+	if (!rx_entry) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"unable to process shm write\n");
+		goto drain;
+	}
+
+	if (hdr->flags & XNET_REMOTE_CQ_DATA) {
+		rx_entry->cq_flags = (FI_COMPLETION | FI_REMOTE_WRITE |
+				      FI_REMOTE_CQ_DATA);
+		rma_iov = (struct ofi_rma_iov *) ((uint8_t *) hdr +
+			  sizeof(struct xnet_cq_data_hdr));
+	} else {
+		rx_entry->ctrl_flags = XNET_INTERNAL_XFER;
+		rx_entry->cq_flags = FI_REMOTE_WRITE;
+		rma_iov = (struct ofi_rma_iov *) ((uint8_t *) hdr +
+			  sizeof(*hdr));
+	}
+	rx_entry->cntr_inc = ofi_ep_rem_wr_cntr_inc;
+	memcpy(&rx_entry->hdr, hdr, (size_t) hdr->hdr_size);
+	rx_entry->src_addr = buf->conn->shm_addr;
+
+	rx_entry->iov_cnt = hdr->rma_iov_cnt;
+	for (i = 0; i < hdr->rma_iov_cnt; i++) {
+		ret = ofi_mr_verify(&rdm->util_ep.domain->mr_map,
+				    rma_iov[i].len,
+				    (uintptr_t *) &rma_iov[i].addr,
+				    rma_iov[i].key, FI_REMOTE_WRITE);
+		if (ret) {
+			FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			       "invalid rma iov received\n");
+			xnet_shm_free_xfer(rdm, rx_entry);
+			goto drain;
+		}
+		rx_entry->iov[i].iov_base = (void *) (uintptr_t)
+					    rma_iov[i].addr;
+		rx_entry->iov[i].iov_len = rma_iov[i].len;
+	}
+
+	if (hdr->op_data == XNET_SHM_INLINE) {
+		ofi_copy_to_iov(rx_entry->iov, rx_entry->iov_cnt, 0,
+				buf->data + hdr->hdr_size,
+				hdr->size - hdr->hdr_size);
+		xnet_shm_complete(rdm, rx_entry);
+	} else {
+		rx_entry->ctrl_flags |= XNET_SHM_RECV_DATA;
+		rx_entry->tag = xnet_shm_seq(buf);
+		xnet_shm_post(rdm, rx_entry);
+	}
+	return;
+
+drain:
+	if (hdr->op_data == XNET_SHM_SEQ)
+		xnet_shm_drain(rdm, buf);
+}
+
+static int xnet_shm_insert(struct xnet_conn *conn)
+{
+	struct xnet_rdm *rdm = conn->rdm;
+	char name[XNET_SHM_NAME_MAX];
+	int ret;
+
+	assert(!(conn->flags & XNET_CONN_SHM));
+	xnet_shm_name(xnet_rdm2_domain(rdm), &conn->peer->addr, name);
+	if (!xnet_shm_visible(name))
+		return -FI_ENOENT;
+
+	ret = fi_av_insert(rdm->shm_av, name, 1, &conn->shm_addr, 0, NULL);
+	if (ret != 1)
+		return ret < 0 ? ret : -FI_EADDRNOTAVAIL;
+
+	if (ofi_idm_set(&rdm->shm_idx_map, (int) conn->shm_addr, conn) < 0)
+		return -FI_ENOMEM;
+
+	conn->flags |= XNET_CONN_SHM;
+	FI_INFO(&xnet_prov, FI_LOG_EP_CTRL, "conn %p uses shm peer %s\n",
+		conn, name);
+	return 0;
+}
+
+static struct fi_ops_msg xnet_shm_msg_ops;
+static struct fi_ops_tagged xnet_shm_tagged_ops;
+static struct fi_ops_rma xnet_shm_rma_ops;
+
+static void xnet_shm_init_tx(struct xnet_conn *conn)
+{
+	conn->shm_fid.fid.fclass = FI_CLASS_EP;
+	conn->shm_fid.fid.context = conn;
+	conn->shm_fid.msg = &xnet_shm_msg_ops;
+	conn->shm_fid.tagged = &xnet_shm_tagged_ops;
+	conn->shm_fid.rma = &xnet_shm_rma_ops;
+	conn->flags |= XNET_CONN_SHM_TX;
+}
+
+static ssize_t xnet_shm_hello(struct xnet_conn *conn, uint8_t op_data)
+{
+	struct xnet_rdm *rdm = conn->rdm;
+	struct xnet_xfer_entry *xfer;
+	struct xnet_shm_hello msg;
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.base_hdr.version = XNET_HDR_VERSION;
+	msg.base_hdr.op = ofi_op_msg;
+	msg.base_hdr.op_data = op_data;
+	msg.base_hdr.hdr_size = (uint8_t) sizeof(msg.base_hdr);
+	msg.base_hdr.size = sizeof(msg);
+	memcpy(&msg.addr, &rdm->addr, sizeof(msg.addr));
+
+	ret = fi_inject(rdm->shm_ep, &msg, sizeof(msg), conn->shm_addr);
+	if (ret != -FI_EAGAIN || op_data != XNET_SHM_HELLO_ACK)
+		return ret;
+
+	/* The peer waits for the ack, queue it */
+	xfer = xnet_shm_alloc_xfer(rdm);
+	if (!xfer)
+		return -FI_ENOMEM;
+
+	xfer->ctrl_flags = XNET_SHM_SEND_HDR | XNET_INTERNAL_XFER;
+	xfer->src_addr = conn->shm_addr;
+	memcpy(&xfer->hdr, &msg, sizeof(msg));
+	xnet_shm_post(rdm, xfer);
+	return 0;
+}
+
+int xnet_shm_connect(struct xnet_conn *conn)
+{
+	int ret;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(conn->rdm)));
+	assert(!conn->ep && conn->rdm->shm_ep);
+	if (!(conn->flags & XNET_CONN_SHM)) {
+		ret = xnet_shm_insert(conn);
+		if (ret)
+			return ret;
+	}
+
+	xnet_shm_init_tx(conn);
+	return 0;
+}
+
+ssize_t xnet_shm_ready(struct xnet_conn *conn)
+{
+	ssize_t ret;
+
+	assert(conn->flags & XNET_CONN_SHM_TX);
+	if (conn->flags & XNET_CONN_SHM_READY)
+		return 0;
+
+	if (!(conn->flags & XNET_CONN_SHM_HELLO)) {
+		ret = xnet_shm_hello(conn, XNET_SHM_HELLO);
+		if (ret)
+			return ret;
+		conn->flags |= XNET_CONN_SHM_HELLO;
+	}
+	return -FI_EAGAIN;
+}
+
+static void xnet_shm_handle_hello(struct xnet_rdm *rdm,
+				  struct xnet_shm_buf *buf)
+{
+	struct xnet_shm_hello *msg;
+	struct util_peer_addr *peer;
+	struct xnet_conn *conn;
+	struct rxm_av *av;
+
+	msg = (struct xnet_shm_hello *) buf->data;
+	if (buf->len < sizeof(*msg)) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_CTRL, "invalid shm hello\n");
+		return;
+	}
+
+	av = container_of(rdm->util_ep.av, struct rxm_av, util_av);
+	peer = util_get_peer(av, &msg->addr);
+	if (!peer) {
+		XNET_WARN_ERR(FI_LOG_EP_CTRL, "util_get_peer", -FI_ENOMEM);
+		return;
+	}
+
+	conn = xnet_add_conn(rdm, peer);
+	util_put_peer(peer);
+	if (!conn)
+		return;
+
+	if (!(conn->flags & XNET_CONN_SHM) && xnet_shm_insert(conn)) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_CTRL,
+			"unable to add shm peer for conn %p\n", conn);
+		return;
+	}
+
+	conn->flags |= XNET_CONN_SHM_READY;
+	if (!conn->ep && !(conn->flags & XNET_CONN_SHM_TX))
+		xnet_shm_init_tx(conn);
+
+	if (msg->base_hdr.op_data == XNET_SHM_HELLO &&
+	    !(conn->flags & XNET_CONN_SHM_HELLO) &&
+	    !xnet_shm_hello(conn, XNET_SHM_HELLO_ACK))
+		conn->flags |= XNET_CONN_SHM_HELLO;
+}
+
+static int xnet_shm_post_buf(struct xnet_rdm *rdm, struct xnet_shm_buf *buf)
+{
+	int ret;
+
+	ret = (int) fi_recv(rdm->shm_ep, buf->data, rdm->shm_inject_size,
+			    NULL, FI_ADDR_UNSPEC, buf);
+	if (ret) {
+		XNET_WARN_ERR(FI_LOG_EP_DATA, "shm fi_recv", ret);
+		ofi_buf_free(buf);
+	}
+	return ret;
+}
+
+static void xnet_shm_handle_buf(struct xnet_rdm *rdm, struct xnet_shm_buf *buf,
+				size_t len, fi_addr_t src_addr)
+{
+	struct xnet_shm_buf *new_buf;
+	struct xnet_base_hdr *hdr;
+
+	hdr = xnet_shm_hdr(buf);
+	buf->len = len;
+	if (len < sizeof(*hdr) || len < hdr->hdr_size) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA, "invalid shm packet\n");
+		goto repost;
+	}
+
+	if (hdr->op_data == XNET_SHM_HELLO ||
+	    hdr->op_data == XNET_SHM_HELLO_ACK) {
+		xnet_shm_handle_hello(rdm, buf);
+		goto repost;
+	}
+
+	buf->conn = (src_addr == FI_ADDR_NOTAVAIL) ? NULL :
+		    ofi_idm_lookup(&rdm->shm_idx_map, (int) src_addr);
+	if (!buf->conn) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"shm packet from unknown peer\n");
+		goto repost;
+	}
+
+	switch (hdr->op) {
+	case ofi_op_msg:
+	case ofi_op_tagged:
+		if (!xnet_shm_recv(rdm, buf))
+			goto repost;
+
+		/* Keep the number of posted buffers constant */
+		new_buf = ofi_buf_alloc(rdm->shm_buf_pool);
+		if (new_buf)
+			(void) xnet_shm_post_buf(rdm, new_buf);
+		return;
+	case ofi_op_write:
+		xnet_shm_write(rdm, buf);
+		break;
+	case ofi_op_read_req:
+		xnet_shm_read_req(rdm, buf);
+		break;
+	default:
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"unknown shm op %d\n", hdr->op);
+		break;
+	}
+
+repost:
+	(void) xnet_shm_post_buf(rdm, buf);
+}
+
+static void xnet_shm_handle_comp(struct xnet_rdm *rdm,
+				 struct fi_cq_tagged_entry *comp,
+				 fi_addr_t src_addr)
+{
+	struct xnet_xfer_entry *xfer;
+
+	if ((comp->flags & (FI_MSG | FI_RECV)) == (FI_MSG | FI_RECV)) {
+		xnet_shm_handle_buf(rdm, comp->op_context, comp->len, src_addr);
+		return;
+	}
+
+	xfer = comp->op_context;
+	if ((xfer->ctrl_flags & XNET_SHM_RECV_DATA) &&
+	    (comp->flags & FI_REMOTE_CQ_DATA)) {
+		FI_WARN(&xnet_prov, FI_LOG_EP_DATA,
+			"shm payload failed by peer\n");
+		xnet_shm_fail(rdm, xfer, (int) comp->data);
+		return;
+	}
+
+	xnet_shm_complete(rdm, xfer);
+}
+
+static void xnet_shm_handle_err(struct xnet_rdm *rdm)
+{
+	struct fi_cq_err_entry err_entry;
+
+	memset(&err_entry, 0, sizeof(err_entry));
+	if (fi_cq_readerr(rdm->shm_cq, &err_entry, 0) <= 0)
+		return;
+
+	if ((err_entry.flags & (FI_MSG | FI_RECV)) == (FI_MSG | FI_RECV)) {
+		(void) xnet_shm_post_buf(rdm, err_entry.op_context);
+		return;
+	}
+
+	xnet_shm_abort(rdm, err_entry.op_context, err_entry.err);
+	xnet_shm_fail(rdm, err_entry.op_context, err_entry.err);
+}
+
+static void xnet_shm_progress_rdm(struct xnet_rdm *rdm)
+{
+	struct fi_cq_tagged_entry comp[XNET_SHM_MAX_COMP];
+	fi_addr_t src_addr[XNET_SHM_MAX_COMP];
+	ssize_t ret, i;
+
+	ret = fi_cq_readfrom(rdm->shm_cq, comp, XNET_SHM_MAX_COMP, src_addr);
+	if (ret == -FI_EAVAIL)
+		xnet_shm_handle_err(rdm);
+
+	for (i = 0; i < ret; i++)
+		xnet_shm_handle_comp(rdm, &comp[i], src_addr[i]);
+
+	if (!slist_empty(&rdm->shm_queue))
+		xnet_shm_progress_queue(rdm);
+}
+
+void xnet_shm_progress(struct xnet_progress *progress)
+{
+	struct xnet_rdm *rdm;
+
+	assert(ofi_genlock_held(progress->active_lock));
+	dlist_foreach_container(&progress->shm_list, struct xnet_rdm,
+				rdm, shm_entry)
+		xnet_shm_progress_rdm(rdm);
+}
+
+static inline uint64_t
+xnet_shm_tx_flag(struct xnet_conn *conn, uint64_t op_flags)
+{
+	return (conn->rdm->util_ep.tx_op_flags | op_flags) & FI_COMPLETION;
+}
+
+static ssize_t
+xnet_shm_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+		 uint64_t flags)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, msg->msg_iov, msg->iov_count,
+			     NULL, 0, msg->data, 0, msg->context, flags,
+			     xnet_shm_tx_flag(conn, flags) | FI_MSG | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_senddata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		  void *desc, uint64_t data, fi_addr_t dest_addr, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, &iov, 1, NULL, 0, data, 0,
+			     context, FI_REMOTE_CQ_DATA,
+			     xnet_shm_tx_flag(conn, 0) | FI_MSG | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_send_buf(struct fid_ep *ep_fid, const void *buf, size_t len,
+		  void *desc, fi_addr_t dest_addr, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, &iov, 1, NULL, 0, 0, 0,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_MSG | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_sendv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t dest_addr, void *context)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, iov, count, NULL, 0, 0, 0,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_MSG | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
+		fi_addr_t dest_addr)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, &iov, 1, NULL, 0, 0, 0,
+			     NULL, 0, FI_INJECT | FI_MSG | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_injectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		    uint64_t data, fi_addr_t dest_addr)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_msg, &iov, 1, NULL, 0, data, 0,
+			     NULL, FI_REMOTE_CQ_DATA,
+			     FI_INJECT | FI_MSG | FI_SEND, ofi_ep_tx_cntr_inc);
+}
+
+static struct fi_ops_msg xnet_shm_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = fi_no_msg_recv,
+	.recvv = fi_no_msg_recvv,
+	.recvmsg = fi_no_msg_recvmsg,
+	.send = xnet_shm_send_buf,
+	.sendv = xnet_shm_sendv,
+	.sendmsg = xnet_shm_sendmsg,
+	.inject = xnet_shm_inject,
+	.senddata = xnet_shm_senddata,
+	.injectdata = xnet_shm_injectdata,
+};
+
+static ssize_t
+xnet_shm_tsendmsg(struct fid_ep *ep_fid, const struct fi_msg_tagged *msg,
+		  uint64_t flags)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, msg->msg_iov,
+			     msg->iov_count, NULL, 0, msg->data, msg->tag,
+			     msg->context, flags,
+			     xnet_shm_tx_flag(conn, flags) | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_tsend(struct fid_ep *ep_fid, const void *buf, size_t len,
+	       void *desc, fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, &iov, 1, NULL, 0, 0, tag,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_tsendv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+		size_t count, fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, iov, count, NULL, 0, 0, tag,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_tinject(struct fid_ep *ep_fid, const void *buf, size_t len,
+		 fi_addr_t dest_addr, uint64_t tag)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, &iov, 1, NULL, 0, 0, tag,
+			     NULL, 0, FI_INJECT | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_tsenddata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		   void *desc, uint64_t data, fi_addr_t dest_addr,
+		   uint64_t tag, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, &iov, 1, NULL, 0, data, tag,
+			     context, FI_REMOTE_CQ_DATA,
+			     xnet_shm_tx_flag(conn, 0) | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_tinjectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		     uint64_t data, fi_addr_t dest_addr, uint64_t tag)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_tagged, &iov, 1, NULL, 0, data, tag,
+			     NULL, FI_REMOTE_CQ_DATA,
+			     FI_INJECT | FI_TAGGED | FI_SEND,
+			     ofi_ep_tx_cntr_inc);
+}
+
+static struct fi_ops_tagged xnet_shm_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = fi_no_tagged_recv,
+	.recvv = fi_no_tagged_recvv,
+	.recvmsg = fi_no_tagged_recvmsg,
+	.send = xnet_shm_tsend,
+	.sendv = xnet_shm_tsendv,
+	.sendmsg = xnet_shm_tsendmsg,
+	.inject = xnet_shm_tinject,
+	.senddata = xnet_shm_tsenddata,
+	.injectdata = xnet_shm_tinjectdata,
+};
+
+static ssize_t
+xnet_shm_readmsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
+		 uint64_t flags)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_read(conn, msg->msg_iov, msg->iov_count, msg->rma_iov,
+			     msg->rma_iov_count, msg->context, flags);
+}
+
+static ssize_t
+xnet_shm_rma_read(struct fid_ep *ep_fid, void *buf, size_t len, void *desc,
+		  fi_addr_t src_addr, uint64_t addr, uint64_t key,
+		  void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = buf,
+		.iov_len = len,
+	};
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = len,
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_read(conn, &iov, 1, &rma_iov, 1, context, 0);
+}
+
+static ssize_t
+xnet_shm_readv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t src_addr, uint64_t addr, uint64_t key,
+	       void *context)
+{
+	struct xnet_conn *conn;
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = ofi_total_iov_len(iov, count),
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_read(conn, iov, count, &rma_iov, 1, context, 0);
+}
+
+static ssize_t
+xnet_shm_writemsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
+		  uint64_t flags)
+{
+	struct xnet_conn *conn;
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, msg->msg_iov, msg->iov_count,
+			     msg->rma_iov, msg->rma_iov_count, msg->data, 0,
+			     msg->context, flags,
+			     xnet_shm_tx_flag(conn, flags) | FI_RMA | FI_WRITE,
+			     ofi_ep_wr_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_rma_write(struct fid_ep *ep_fid, const void *buf, size_t len,
+		   void *desc, fi_addr_t dest_addr, uint64_t addr,
+		   uint64_t key, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = len,
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, &iov, 1, &rma_iov, 1, 0, 0,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_RMA | FI_WRITE,
+			     ofi_ep_wr_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_writev(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+		size_t count, fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+		void *context)
+{
+	struct xnet_conn *conn;
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = ofi_total_iov_len(iov, count),
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, iov, count, &rma_iov, 1, 0, 0,
+			     context, 0,
+			     xnet_shm_tx_flag(conn, 0) | FI_RMA | FI_WRITE,
+			     ofi_ep_wr_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_inject_write(struct fid_ep *ep_fid, const void *buf, size_t len,
+		      fi_addr_t dest_addr, uint64_t addr, uint64_t key)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = len,
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, &iov, 1, &rma_iov, 1, 0, 0,
+			     NULL, 0, FI_INJECT | FI_WRITE, ofi_ep_wr_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_writedata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		   void *desc, uint64_t data, fi_addr_t dest_addr,
+		   uint64_t addr, uint64_t key, void *context)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = len,
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, &iov, 1, &rma_iov, 1, data, 0,
+			     context, FI_REMOTE_CQ_DATA,
+			     xnet_shm_tx_flag(conn, 0) | FI_RMA | FI_WRITE,
+			     ofi_ep_wr_cntr_inc);
+}
+
+static ssize_t
+xnet_shm_inject_writedata(struct fid_ep *ep_fid, const void *buf, size_t len,
+			  uint64_t data, fi_addr_t dest_addr, uint64_t addr,
+			  uint64_t key)
+{
+	struct xnet_conn *conn;
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = len,
+		.key = key,
+	};
+
+	conn = container_of(ep_fid, struct xnet_conn, shm_fid);
+	return xnet_shm_send(conn, ofi_op_write, &iov, 1, &rma_iov, 1, data, 0,
+			     NULL, FI_REMOTE_CQ_DATA, FI_INJECT | FI_WRITE,
+			     ofi_ep_wr_cntr_inc);
+}
+
+static struct fi_ops_rma xnet_shm_rma_ops = {
+	.size = sizeof(struct fi_ops_rma),
+	.read = xnet_shm_rma_read,
+	.readv = xnet_shm_readv,
+	.readmsg = xnet_shm_readmsg,
+	.write = xnet_shm_rma_write,
+	.writev = xnet_shm_writev,
+	.writemsg = xnet_shm_writemsg,
+	.inject = xnet_shm_inject_write,
+	.writedata = xnet_shm_writedata,
+	.injectdata = xnet_shm_inject_writedata,
+};
+
+/* Endpoints driven by the progress thread only wake up on socket events,
+ * so they do not use shm.  The shm cq has no fd to wait on, so blocking
+ * counter waits, and a progress thread started after the endpoint, poll
+ * the shm endpoints instead of sleeping on the progress fds.
+ */
+int xnet_shm_ep_open(struct xnet_rdm *rdm)
+{
+	struct xnet_domain *domain;
+	struct xnet_progress *progress;
+	struct xnet_shm_buf *buf;
+	struct fi_cq_attr cq_attr = {
+		.format = FI_CQ_FORMAT_TAGGED,
+		.wait_obj = FI_WAIT_NONE,
+	};
+	struct fi_av_attr av_attr = {
+		.type = FI_AV_TABLE,
+	};
+	struct fi_info *info;
+	char name[XNET_SHM_NAME_MAX];
+	int i, ret;
+
+	domain = xnet_rdm2_domain(rdm);
+	progress = xnet_rdm2_progress(rdm);
+	assert(xnet_progress_locked(progress));
+	if (!domain->shm_domain || progress->auto_progress)
+		return 0;
+
+	info = fi_dupinfo(domain->shm_info);
+	if (!info)
+		return -FI_ENOMEM;
+
+	xnet_shm_name(domain, &rdm->addr, name);
+	free(info->src_addr);
+	info->src_addr = strdup(name);
+	if (!info->src_addr) {
+		ret = -FI_ENOMEM;
+		goto free;
+	}
+	info->src_addrlen = strlen(name) + 1;
+
+	ret = fi_endpoint(domain->shm_domain, info, &rdm->shm_ep, NULL);
+	if (ret)
+		goto free;
+
+	cq_attr.size = info->rx_attr->size + info->tx_attr->size;
+	ret = fi_cq_open(domain->shm_domain, &cq_attr, &rdm->shm_cq, NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_av_open(domain->shm_domain, &av_attr, &rdm->shm_av, NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_ep_bind(rdm->shm_ep, &rdm->shm_cq->fid, FI_TRANSMIT | FI_RECV);
+	if (ret)
+		goto err;
+
+	ret = fi_ep_bind(rdm->shm_ep, &rdm->shm_av->fid, 0);
+	if (ret)
+		goto err;
+
+	ret = fi_enable(rdm->shm_ep);
+	if (ret)
+		goto err;
+
+	rdm->shm_inject_size = info->tx_attr->inject_size;
+	ret = ofi_bufpool_create(&rdm->shm_buf_pool,
+				 sizeof(*buf) + rdm->shm_inject_size, 16, 0,
+				 XNET_SHM_PREPOST, OFI_BUFPOOL_NO_TRACK);
+	if (ret)
+		goto err;
+
+	for (i = 0; i < XNET_SHM_PREPOST; i++) {
+		buf = ofi_buf_alloc(rdm->shm_buf_pool);
+		if (!buf) {
+			ret = -FI_ENOMEM;
+			goto err;
+		}
+
+		ret = xnet_shm_post_buf(rdm, buf);
+		if (ret)
+			goto err;
+	}
+
+	dlist_insert_tail(&rdm->shm_entry, &progress->shm_list);
+	FI_INFO(&xnet_prov, FI_LOG_EP_CTRL, "shm endpoint %s\n", name);
+	fi_freeinfo(info);
+	return 0;
+
+err:
+	xnet_shm_ep_close(rdm);
+free:
+	fi_freeinfo(info);
+	return ret;
+}
+
+void xnet_shm_ep_close(struct xnet_rdm *rdm)
+{
+	struct xnet_xfer_entry *xfer;
+	struct xnet_shm_buf *buf;
+
+	assert(xnet_progress_locked(xnet_rdm2_progress(rdm)));
+	dlist_remove_init(&rdm->shm_entry);
+	if (rdm->shm_ep) {
+		fi_close(&rdm->shm_ep->fid);
+		rdm->shm_ep = NULL;
+	}
+	if (rdm->shm_av) {
+		fi_close(&rdm->shm_av->fid);
+		rdm->shm_av = NULL;
+	}
+	if (rdm->shm_cq) {
+		fi_close(&rdm->shm_cq->fid);
+		rdm->shm_cq = NULL;
+	}
+
+	/* Transfers owned by the shm endpoint will not complete */
+	slist_init(&rdm->shm_queue);
+	while (!dlist_empty(&rdm->shm_xfer_list)) {
+		xfer = container_of(rdm->shm_xfer_list.next,
+				    struct xnet_xfer_entry, shm_entry);
+		xnet_shm_fail(rdm, xfer, FI_ECANCELED);
+	}
+
+	while (!dlist_empty(&rdm->shm_unexp_list)) {
+		dlist_pop_front(&rdm->shm_unexp_list, struct xnet_shm_buf,
+				buf, entry);
+		ofi_buf_free(buf);
+	}
+
+	if (rdm->shm_buf_pool) {
+		ofi_bufpool_destroy(rdm->shm_buf_pool);
+		rdm->shm_buf_pool = NULL;
+	}
+	ofi_idm_reset(&rdm->shm_idx_map, NULL);
+}
+
+static uint64_t xnet_shm_host(void)
+{
+	char hostname[256];
+	uint64_t host;
+
+	if (gethostname(hostname, sizeof(hostname)))
+		return 0;
+
+	hostname[sizeof(hostname) - 1] = '\0';
+	host = fasthash64(hostname, strlen(hostname), getuid());
+	return host ? host : 1;
+}
+
+void xnet_shm_domain_open(struct xnet_domain *domain, struct fi_info *info)
+{
+	struct fi_info *hints;
+	int ret;
+
+	if (!xnet_use_shm || (info->caps & FI_HMEM) ||
+	    (info->ep_attr && info->ep_attr->type == FI_EP_MSG))
+		return;
+
+	domain->shm_seed = xnet_shm_host();
+	if (!domain->shm_seed)
+		return;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return;
+
+	hints->caps = FI_MSG | FI_TAGGED | FI_SEND | FI_RECV |
+		      FI_DIRECTED_RECV | FI_SOURCE;
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->domain_attr->av_type = FI_AV_TABLE;
+	hints->tx_attr->msg_order = FI_ORDER_SAS;
+	hints->rx_attr->msg_order = FI_ORDER_SAS;
+	hints->fabric_attr->prov_name = strdup("shm");
+
+	ret = fi_getinfo(domain->util_domain.fabric->fabric_fid.api_version,
+			 NULL, NULL, OFI_GETINFO_HIDDEN, hints,
+			 &domain->shm_info);
+	fi_freeinfo(hints);
+	if (ret)
+		goto err;
+
+	ret = fi_fabric(domain->shm_info->fabric_attr, &domain->shm_fabric,
+			NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_domain(domain->shm_fabric, domain->shm_info,
+			&domain->shm_domain, NULL);
+	if (ret)
+		goto err;
+
+	FI_INFO(&xnet_prov, FI_LOG_DOMAIN, "shm enabled for local peers\n");
+	return;
+err:
+	XNET_WARN_ERR(FI_LOG_DOMAIN, "shm open", ret);
+	xnet_shm_domain_close(domain);
+}
+
+void xnet_shm_domain_close(struct xnet_domain *domain)
+{
+	if (domain->shm_domain) {
+		fi_close(&domain->shm_domain->fid);
+		domain->shm_domain = NULL;
+	}
+	if (domain->shm_fabric) {
+		fi_close(&domain->shm_fabric->fid);
+		domain->shm_fabric = NULL;
+	}
+	fi_freeinfo(domain->shm_info);
+	domain->shm_info = NULL;
+	domain->shm_seed = 0;
+}
@@ -40,7 +40,53 @@
 
 
 static struct xnet_xfer_entry *
-xnet_match_tag(struct xnet_srx *srx, struct xnet_ep *ep, uint64_t tag);
+xnet_match_tag(struct xnet_srx *srx, fi_addr_t src_addr, uint64_t tag);
+
+
+static struct xnet_tag_queue *
+xnet_find_tag_queue(struct xnet_srx *srx, fi_addr_t src_addr, uint64_t tag)
+{
+	struct xnet_tag_queue *tag_queue;
+	struct xnet_tag_key key;
+
+	memset(&key, 0, sizeof(key));
+	key.src_addr = src_addr;
+	key.tag = tag;
+	HASH_FIND(hh, srx->tag_index, &key, sizeof(key), tag_queue);
+	return tag_queue;
+}
+
+static struct xnet_tag_queue *
+xnet_get_tag_queue(struct xnet_srx *srx, fi_addr_t src_addr, uint64_t tag)
+{
+	struct xnet_tag_queue *tag_queue;
+
+	tag_queue = xnet_find_tag_queue(srx, src_addr, tag);
+	if (tag_queue)
+		return tag_queue;
+
+	tag_queue = ofi_buf_alloc(srx->tag_pool);
+	if (!tag_queue)
+		return NULL;
+
+	memset(&tag_queue->key, 0, sizeof(tag_queue->key));
+	tag_queue->key.src_addr = src_addr;
+	tag_queue->key.tag = tag;
+	slist_init(&tag_queue->queue);
+	HASH_ADD(hh, srx->tag_index, key, sizeof(tag_queue->key), tag_queue);
+	return tag_queue;
+}
+
+/* Queues in the index are never empty */
+static void
+xnet_put_tag_queue(struct xnet_srx *srx, struct xnet_tag_queue *tag_queue)
+{
+	if (!slist_empty(&tag_queue->queue))
+		return;
+
+	HASH_DEL(srx->tag_index, tag_queue);
+	ofi_buf_free(tag_queue);
+}
 
 
 /* The rdm ep calls directly through to the srx calls, so we need to use the
@@ -63,6 +109,9 @@ xnet_srx_msg(struct xnet_srx *srx, struct xnet_xfer_entry *recv_entry)
 				  struct xnet_ep, unexp_entry);
 		xnet_progress_rx(ep);
 	}
+
+	if (srx->rdm && !dlist_empty(&srx->rdm->shm_unexp_list))
+		xnet_shm_progress_unexp(srx->rdm);
 }
 
 static ssize_t
@@ -238,6 +287,9 @@ xnet_srx_peek(struct xnet_srx *srx, struct xnet_xfer_entry *recv_entry)
 	return;
 
 nomatch:
+	if (xnet_shm_peek(srx->rdm, recv_entry))
+		return;
+
 	memset(&err_entry, 0, sizeof(err_entry));
 	err_entry.op_context = recv_entry->context;
 	err_entry.flags = FI_RECV | FI_TAGGED;
@@ -259,31 +311,42 @@ static ssize_t
 xnet_srx_tag(struct xnet_srx *srx, struct xnet_xfer_entry *recv_entry)
 {
 	struct xnet_progress *progress;
+	struct xnet_tag_queue *tag_queue;
 	struct xnet_ep *ep;
 	struct slist *queue;
+	fi_addr_t src_addr;
 
 	progress = xnet_srx2_progress(srx);
 	assert(xnet_progress_locked(progress));
 	assert(srx->rdm);
 
-	/* Always set and bump the tag_seq_no to help debugging */
+	/* The tag_seq_no orders receives across queues when matching */
 	recv_entry->tag_seq_no = srx->tag_seq_no++;
 
-	if ((srx->match_tag_rx == xnet_match_tag) ||
-	    (recv_entry->src_addr == FI_ADDR_UNSPEC)) {
-		slist_insert_tail(&recv_entry->entry, &srx->tag_queue);
+	src_addr = (srx->match_tag_rx == xnet_match_tag) ?
+		   FI_ADDR_UNSPEC : recv_entry->src_addr;
+	if (!recv_entry->ignore) {
+		tag_queue = xnet_get_tag_queue(srx, src_addr, recv_entry->tag);
+		if (!tag_queue)
+			return -FI_EAGAIN;
+		queue = &tag_queue->queue;
+	} else if (src_addr == FI_ADDR_UNSPEC) {
+		queue = &srx->tag_queue;
+	} else {
+		queue = ofi_array_at(&srx->src_tag_queues, src_addr);
+		if (!queue)
+			return -FI_EAGAIN;
+	}
+	slist_insert_tail(&recv_entry->entry, queue);
 
+	if (src_addr == FI_ADDR_UNSPEC) {
 		/* The message could match any endpoint waiting. */
 		if (!dlist_empty(&progress->unexp_tag_list))
 			xnet_progress_unexp(progress, &progress->unexp_tag_list);
+		if (!dlist_empty(&srx->rdm->shm_unexp_list))
+			xnet_shm_progress_unexp(srx->rdm);
 	} else {
-		queue = ofi_array_at(&srx->src_tag_queues, recv_entry->src_addr);
-		if (!queue)
-			return -FI_EAGAIN;
-
-		slist_insert_tail(&recv_entry->entry, queue);
-
-		ep = xnet_get_ep(srx->rdm, recv_entry->src_addr);
+		ep = xnet_get_ep(srx->rdm, src_addr);
 		if (ep) {
 			xnet_active_ep(ep);
 			if (xnet_has_unexp(ep)) {
@@ -291,6 +354,8 @@ xnet_srx_tag(struct xnet_srx *srx, struct xnet_xfer_entry *recv_entry)
 				xnet_progress_rx(ep);
 			}
 		}
+		if (!dlist_empty(&srx->rdm->shm_unexp_list))
+			xnet_shm_progress_unexp(srx->rdm);
 	}
 
 	return 0;
@@ -432,69 +497,103 @@ static struct fi_ops_tagged xnet_srx_tag_ops = {
 	.injectdata = fi_no_tagged_injectdata,
 };
 
-static struct xnet_xfer_entry *
-xnet_match_tag(struct xnet_srx *srx, struct xnet_ep *ep, uint64_t tag)
+struct xnet_tag_match {
+	struct xnet_xfer_entry	*rx_entry;
+	struct slist		*queue;
+	struct slist_entry	*prev;
+	struct xnet_tag_queue	*tag_queue;
+};
+
+/* Receives on an indexed queue match the tag of the queue, so only its
+ * head can be the oldest match.
+ */
+static void
+xnet_match_index(struct xnet_tag_match *match, struct xnet_tag_queue *tag_queue)
+{
+	struct xnet_xfer_entry *rx_entry;
+
+	if (!tag_queue)
+		return;
+
+	rx_entry = container_of(tag_queue->queue.head, struct xnet_xfer_entry,
+				entry);
+	if (match->rx_entry &&
+	    match->rx_entry->tag_seq_no < rx_entry->tag_seq_no)
+		return;
+
+	match->rx_entry = rx_entry;
+	match->queue = &tag_queue->queue;
+	match->prev = NULL;
+	match->tag_queue = tag_queue;
+}
+
+/* Receives with ignore bits must be searched, but only up to the oldest
+ * match found so far.
+ */
+static void
+xnet_match_ignore(struct xnet_tag_match *match, struct slist *queue,
+		  uint64_t tag)
 {
 	struct xnet_xfer_entry *rx_entry;
 	struct slist_entry *item, *prev;
 
-	assert(xnet_progress_locked(xnet_srx2_progress(srx)));
-	slist_foreach(&srx->tag_queue, item, prev) {
+	slist_foreach(queue, item, prev) {
 		rx_entry = container_of(item, struct xnet_xfer_entry, entry);
+		if (match->rx_entry &&
+		    match->rx_entry->tag_seq_no < rx_entry->tag_seq_no)
+			return;
+
 		if (ofi_match_tag(rx_entry->tag, rx_entry->ignore, tag)) {
-			slist_remove(&srx->tag_queue, item, prev);
-			return rx_entry;
+			match->rx_entry = rx_entry;
+			match->queue = queue;
+			match->prev = prev;
+			match->tag_queue = NULL;
+			return;
 		}
 	}
-	return NULL;
 }
 
-/* A matching receive could be found on either the any source queue or the
- * source matched queue.  However, most apps going through this path will
- * use source matching, with the any source queue being empty.  We optimize
- * for this case.
- */
 static struct xnet_xfer_entry *
-xnet_match_tag_addr(struct xnet_srx *srx, struct xnet_ep *ep, uint64_t tag)
+xnet_take_match(struct xnet_srx *srx, struct xnet_tag_match *match)
 {
-	struct xnet_xfer_entry *rx_entry, *any_entry;
-	struct slist *queue;
-	struct slist_entry *any_item, *any_prev;
-	struct slist_entry *item, *prev;
+	if (!match->rx_entry)
+		return NULL;
 
-	assert(xnet_progress_locked(xnet_srx2_progress(srx)));
-	queue = ofi_array_at(&srx->src_tag_queues, ep->peer->fi_addr);
-	if (!queue)
-		return xnet_match_tag(srx, ep, tag);
+	slist_remove(match->queue, &match->rx_entry->entry, match->prev);
+	if (match->tag_queue)
+		xnet_put_tag_queue(srx, match->tag_queue);
+	return match->rx_entry;
+}
 
-	slist_foreach(queue, item, prev) {
-		rx_entry = container_of(item, struct xnet_xfer_entry, entry);
-		if (ofi_match_tag(rx_entry->tag, rx_entry->ignore, tag))
-			goto found;
-	}
+static struct xnet_xfer_entry *
+xnet_match_tag(struct xnet_srx *srx, fi_addr_t src_addr, uint64_t tag)
+{
+	struct xnet_tag_match match = {0};
 
-	return xnet_match_tag(srx, ep, tag);
-
-found:
-	/* We select from the any source queue if it matches and was posted
-	 * earlier than our source based match.
-	 */
-	slist_foreach(&srx->tag_queue, any_item, any_prev) {
-		any_entry = container_of(any_item, struct xnet_xfer_entry, entry);
-		if (any_entry->tag_seq_no > rx_entry->tag_seq_no)
-			break;
-
-		if (ofi_match_tag(any_entry->tag, any_entry->ignore, tag)) {
-			queue = &srx->tag_queue;
-			rx_entry = any_entry;
-			item = any_item;
-			prev = any_prev;
-			break;
-		}
-	}
+	assert(xnet_progress_locked(xnet_srx2_progress(srx)));
+	xnet_match_index(&match, xnet_find_tag_queue(srx, FI_ADDR_UNSPEC, tag));
+	xnet_match_ignore(&match, &srx->tag_queue, tag);
+	return xnet_take_match(srx, &match);
+}
 
-	slist_remove(queue, item, prev);
-	return rx_entry;
+/* A matching receive could be on any of the any source and source
+ * matched queues, indexed or not.  We take the one posted first.
+ */
+static struct xnet_xfer_entry *
+xnet_match_tag_addr(struct xnet_srx *srx, fi_addr_t src_addr, uint64_t tag)
+{
+	struct xnet_tag_match match = {0};
+	struct slist *queue;
+
+	assert(xnet_progress_locked(xnet_srx2_progress(srx)));
+	xnet_match_index(&match, xnet_find_tag_queue(srx, src_addr, tag));
+	xnet_match_index(&match, xnet_find_tag_queue(srx, FI_ADDR_UNSPEC, tag));
+
+	queue = ofi_array_at(&srx->src_tag_queues, src_addr);
+	if (queue)
+		xnet_match_ignore(&match, queue, tag);
+	xnet_match_ignore(&match, &srx->tag_queue, tag);
+	return xnet_take_match(srx, &match);
 }
 
 static bool
@@ -528,6 +627,19 @@ xnet_srx_cancel_src(struct ofi_dyn_arr *arr, void *list, void *context)
 	return (int) xnet_srx_cancel_rx(srx, queue, context);
 }
 
+static bool xnet_srx_cancel_index(struct xnet_srx *srx, void *context)
+{
+	struct xnet_tag_queue *tag_queue, *tmp;
+
+	HASH_ITER(hh, srx->tag_index, tag_queue, tmp) {
+		if (xnet_srx_cancel_rx(srx, &tag_queue->queue, context)) {
+			xnet_put_tag_queue(srx, tag_queue);
+			return true;
+		}
+	}
+	return false;
+}
+
 static ssize_t xnet_srx_cancel(fid_t fid, void *context)
 {
 	struct xnet_srx *srx;
@@ -541,6 +653,9 @@ static ssize_t xnet_srx_cancel(fid_t fid, void *context)
 	if (xnet_srx_cancel_rx(srx, &srx->rx_queue, context))
 		goto unlock;
 
+	if (xnet_srx_cancel_index(srx, context))
+		goto unlock;
+
 	ofi_array_iter(&srx->src_tag_queues, context, xnet_srx_cancel_src);
 unlock:
 	ofi_genlock_unlock(xnet_srx2_progress(srx)->active_lock);
@@ -615,6 +730,7 @@ xnet_srx_cleanup_arr(struct ofi_dyn_arr *arr, void *list, void *context)
 static int xnet_srx_close(struct fid *fid)
 {
 	struct xnet_srx *srx;
+	struct xnet_tag_queue *tag_queue, *tmp;
 
 	srx = container_of(fid, struct xnet_srx, rx_fid.fid);
 
@@ -622,6 +738,12 @@ static int xnet_srx_close(struct fid *fid)
 	xnet_srx_cleanup(srx, &srx->tag_queue);
 	ofi_array_iter(&srx->src_tag_queues, srx, xnet_srx_cleanup_arr);
 	ofi_array_destroy(&srx->src_tag_queues);
+	HASH_ITER(hh, srx->tag_index, tag_queue, tmp) {
+		xnet_srx_cleanup(srx, &tag_queue->queue);
+		HASH_DEL(srx->tag_index, tag_queue);
+		ofi_buf_free(tag_queue);
+	}
+	ofi_bufpool_destroy(srx->tag_pool);
 
 	if (srx->cq)
 		ofi_atomic_dec32(&srx->cq->util_cq.ref);
@@ -642,11 +764,19 @@ int xnet_srx_context(struct fid_domain *domain, struct fi_rx_attr *attr,
 		     struct fid_ep **rx_ep, void *context)
 {
 	struct xnet_srx *srx;
+	int ret;
 
 	srx = calloc(1, sizeof(*srx));
 	if (!srx)
 		return -FI_ENOMEM;
 
+	ret = ofi_bufpool_create(&srx->tag_pool, sizeof(struct xnet_tag_queue),
+				 16, 0, 1024, 0);
+	if (ret) {
+		free(srx);
+		return ret;
+	}
+
 	srx->rx_fid.fid.fclass = FI_CLASS_SRX_CTX;
 	srx->rx_fid.fid.context = context;
 	srx->rx_fid.fid.ops = &xnet_srx_fid_ops;
@@ -85,17 +85,21 @@ union rxm_cm_data {
 		uint8_t op_version;
 		uint16_t port;
 		uint8_t flow_ctrl;
-		uint8_t padding;
+		/* 0 for the primary msg ep, else the stripe it opens */
+		uint8_t stripe;
 		uint32_t eager_limit;
 		uint32_t rx_size; /* used? */
 		uint64_t client_conn_id;
+		/* only sent if the shm bypass is enabled */
+		uint64_t shm_host;
 	} connect;
 
 	struct _accept {
 		uint64_t server_conn_id;
 		uint32_t rx_size; /* used? */
 		uint8_t flow_ctrl;
-		uint8_t align_pad[3];
+		uint8_t shm;
+		uint8_t align_pad[2];
 	} accept;
 
 	struct _reject {
@@ -126,6 +130,8 @@ extern size_t rxm_packet_size;
 #define RXM_SAR_RX_INIT		UINT64_MAX
 
 #define RXM_IOV_LIMIT 4
+#define RXM_MAX_STRIPES 8
+#define RXM_STRIPE_CHUNK_SIZE (1 << 20)
 
 #define RXM_MR_MODES	(OFI_MR_BASIC_MAP | FI_MR_LOCAL)
 
@@ -200,9 +206,15 @@ extern size_t rxm_msg_tx_size;
 extern size_t rxm_msg_rx_size;
 extern size_t rxm_cm_progress_interval;
 extern size_t rxm_cq_eq_fairness;
+extern size_t rxm_connect_window;
+extern size_t rxm_max_conns;
+extern size_t rxm_rndv_chunk_size;
+extern size_t rxm_rndv_chunks;
+extern size_t rxm_stripes;
 extern int rxm_passthru;
 extern int force_auto_progress;
 extern int rxm_use_write_rndv;
+extern int rxm_use_shm;
 extern enum fi_wait_obj def_wait_obj, def_tcp_wait_obj;
 
 struct rxm_ep;
@@ -218,6 +230,11 @@ enum rxm_cm_state {
 
 enum {
 	RXM_CONN_INDEXED = BIT(0),
+	RXM_CONN_SHM = BIT(1),
+	RXM_CONN_CLOSING = BIT(2),
+	RXM_CONN_CLOSE_ACKED = BIT(3),
+	RXM_CONN_CLOSE_REQ = BIT(4),
+	RXM_CONN_UNUSED = BIT(5),
 };
 
 /* Each local rxm ep will have at most 1 connection to a single
@@ -230,6 +247,12 @@ struct rxm_conn {
 	struct fid_ep *msg_ep;
 	struct rxm_ep *ep;
 
+	/* When the peer is on the same node, msg_ep is replaced once
+	 * connected by an endpoint that forwards transfers to the rxm ep's
+	 * shm endpoint.  core_ep then holds the connected msg ep.
+	 */
+	struct fid_ep *core_ep;
+
 	/* Prior versions of libfabric did not guarantee that all connections
 	 * from the same peer would have the same conn_id.  For compatibility
 	 * we need to store the remote_index per connection, rather than with
@@ -246,6 +269,23 @@ struct rxm_conn {
 	struct dlist_entry deferred_sar_msgs;
 	struct dlist_entry deferred_sar_segments;
 	struct dlist_entry loopback_entry;
+	struct dlist_entry prewarm_entry;
+
+	/* Position in the endpoint's lru_list while connected, and the
+	 * number of application transfers holding a tx buffer.  Both are
+	 * used to pick idle connections to close when max_conns is set.
+	 */
+	struct dlist_entry lru_entry;
+	size_t tx_cnt;
+
+	/* Additional msg eps to the peer opened by the connecting side.
+	 * Either side spreads its rendezvous reads over the connected ones.
+	 */
+	struct fid_ep *stripe_ep[RXM_MAX_STRIPES - 1];
+	uint8_t stripe_connected;
+	uint8_t next_stripe;
+	/* Receives with rendezvous reads outstanding */
+	struct dlist_entry rndv_reads;
 };
 
 void rxm_freeall_conns(struct rxm_ep *ep);
@@ -266,6 +306,12 @@ struct rxm_domain {
 	struct ofi_ops_flow_ctrl *flow_ctrl_ops;
 	struct ofi_bufpool *amo_bufpool;
 	ofi_mutex_t amo_bufpool_lock;
+
+	/* shm bypass for peers on the same node */
+	struct fi_info *shm_info;
+	struct fid_fabric *shm_fabric;
+	struct fid_domain *shm_domain;
+	uint64_t shm_host;
 };
 
 
@@ -280,6 +326,7 @@ struct rxm_cntr {
 struct rxm_mr {
 	struct fid_mr mr_fid;
 	struct fid_mr *msg_mr;
+	struct fid_mr *shm_mr;
 	struct rxm_domain *domain;
 	enum fi_hmem_iface iface;
 	uint64_t device;
@@ -357,7 +404,8 @@ struct rxm_atomic_resp_hdr {
 	FUNC(RXM_RNDV_WRITE_DONE_RECVD),\
 	FUNC(RXM_RNDV_FINISH), /* not needed */	\
 	FUNC(RXM_ATOMIC_RESP_WAIT),	\
-	FUNC(RXM_ATOMIC_RESP_SENT)
+	FUNC(RXM_ATOMIC_RESP_SENT),	\
+	FUNC(RXM_CLOSE_TX)
 
 enum rxm_proto_state {
 	RXM_PROTO_STATES(OFI_ENUM_VAL)
@@ -374,7 +422,17 @@ enum {
 	rxm_ctrl_atomic_resp,
 	rxm_ctrl_credit,
 	rxm_ctrl_rndv_wr_data,
-	rxm_ctrl_rndv_wr_done
+	rxm_ctrl_rndv_wr_done,
+	rxm_ctrl_close
+};
+
+/* ctrl_data of rxm_ctrl_close messages.  A connection is only closed
+ * once both peers agree that it is idle.
+ */
+enum {
+	RXM_CLOSE_REQ,
+	RXM_CLOSE_ACK,
+	RXM_CLOSE_NACK,
 };
 
 struct rxm_pkt {
@@ -434,6 +492,18 @@ struct rxm_buf {
 	void *desc;
 };
 
+/* Context of the rendezvous reads a receive has outstanding on one msg ep
+ * of its connection, so that reads discarded when a stripe is closed can
+ * be accounted for.  Slot 0 is the primary msg ep, slot i + 1 stripe i.
+ */
+struct rxm_rndv_read_ctx {
+	/* Must stay at top */
+	struct rxm_buf hdr;
+
+	struct rxm_rx_buf *rx_buf;
+	size_t inflight;
+};
+
 struct rxm_rx_buf {
 	/* Must stay at top */
 	struct rxm_buf hdr;
@@ -454,6 +524,15 @@ struct rxm_rx_buf {
 	struct dlist_entry rndv_wait_entry;
 	struct rxm_rndv_hdr *remote_rndv_hdr;
 	size_t rndv_rma_index;
+	/* Progress of chunked rendezvous reads */
+	size_t rndv_rma_offset;
+	size_t rndv_local_index;
+	size_t rndv_local_offset;
+	size_t rndv_remain;
+	size_t rndv_inflight;
+	int rndv_err;
+	struct dlist_entry rndv_read_entry;
+	struct rxm_rndv_read_ctx rndv_ctx[RXM_MAX_STRIPES];
 	struct fid_mr *mr[RXM_IOV_LIMIT];
 
 	/* Only differs from pkt.data for unexpected messages */
@@ -467,6 +546,7 @@ struct rxm_tx_buf {
 	struct rxm_buf hdr;
 
 	OFI_DBG_VAR(bool, user_tx)
+	struct rxm_conn *conn;
 	void *app_context;
 	uint64_t flags;
 
@@ -476,6 +556,10 @@ struct rxm_tx_buf {
 			uint8_t count;
 		} rma;
 		struct rxm_iov atomic_result;
+		/* Set in the first segment, shm may complete them in any
+		 * order.
+		 */
+		size_t sar_pending;
 	};
 
 	struct {
@@ -493,7 +577,7 @@ struct rxm_tx_buf {
 };
 
 /* Used for application transmits, provides credit check */
-struct rxm_tx_buf *rxm_get_tx_buf(struct rxm_ep *ep);
+struct rxm_tx_buf *rxm_get_tx_buf(struct rxm_ep *ep, struct rxm_conn *conn);
 void rxm_free_tx_buf(struct rxm_ep *ep, struct rxm_tx_buf *buf);
 
 enum rxm_deferred_tx_entry_type {
@@ -504,6 +588,7 @@ enum rxm_deferred_tx_entry_type {
 	RXM_DEFERRED_TX_SAR_SEG,
 	RXM_DEFERRED_TX_ATOMIC_RESP,
 	RXM_DEFERRED_TX_CREDIT_SEND,
+	RXM_DEFERRED_TX_CLOSE_SEND,
 };
 
 struct rxm_deferred_tx_entry {
@@ -557,6 +642,9 @@ struct rxm_deferred_tx_entry {
 		struct {
 			struct rxm_tx_buf *tx_buf;
 		} credit_msg;
+		struct {
+			struct rxm_tx_buf *tx_buf;
+		} close_msg;
 	};
 };
 
@@ -633,6 +721,15 @@ struct rxm_ep {
 
 	int			connecting_cnt;
 	struct index_map	conn_idx_map;
+	struct dlist_entry	prewarm_queue;
+	size_t			connect_window;
+	struct dlist_entry	lru_list;
+	size_t			conn_cnt;
+	size_t			closing_cnt;
+	size_t			max_conns;
+	size_t			rndv_chunk_size;
+	size_t			rndv_chunks;
+	size_t			stripes;
 	struct dlist_entry	loopback_list;
 	union ofi_sock_ip	addr;
 
@@ -676,11 +773,54 @@ struct rxm_ep {
 
 	struct rxm_eager_ops	*eager_ops;
 	struct rxm_rndv_ops	*rndv_ops;
+
+	struct fid_ep		*shm_ep;
+	struct fid_av		*shm_av;
+	struct fid_cq		*shm_cq;
 };
 
 int rxm_start_listen(struct rxm_ep *ep);
+
+void rxm_shm_domain_open(struct rxm_domain *domain, struct fi_info *info,
+			 struct fi_info *msg_info);
+void rxm_shm_domain_close(struct rxm_domain *domain);
+int rxm_shm_ep_open(struct rxm_ep *ep);
+void rxm_shm_ep_close(struct rxm_ep *ep);
+int rxm_shm_conn_open(struct rxm_conn *conn);
+void rxm_shm_progress(struct rxm_ep *ep);
+
+static inline uint64_t rxm_ep_shm_host(struct rxm_ep *ep)
+{
+	return container_of(ep->util_ep.domain, struct rxm_domain,
+			    util_domain)->shm_host;
+}
 void rxm_stop_listen(struct rxm_ep *ep);
 void rxm_conn_progress(struct rxm_ep *ep);
+int rxm_prewarm_conns(struct rxm_ep *ep, const fi_addr_t *addr, size_t count);
+ssize_t rxm_handle_close(struct rxm_ep *ep, struct rxm_rx_buf *rx_buf);
+void rxm_touch_rx_conn(struct rxm_rx_buf *rx_buf);
+
+/* Rotate over the primary msg ep (slot 0) and the connected stripes */
+static inline uint8_t rxm_conn_next_stripe(struct rxm_conn *conn)
+{
+	uint8_t i;
+
+	if (!conn->stripe_connected)
+		return 0;
+
+	do {
+		i = conn->next_stripe;
+		conn->next_stripe = (i + 1) % RXM_MAX_STRIPES;
+	} while (i && !(conn->stripe_connected & BIT(i - 1)));
+
+	return i;
+}
+
+static inline struct fid_ep *
+rxm_conn_stripe_ep(struct rxm_conn *conn, uint8_t slot)
+{
+	return slot ? conn->stripe_ep[slot - 1] : conn->msg_ep;
+}
 
 
 extern struct fi_provider rxm_prov;
@@ -711,6 +851,7 @@ void rxm_cq_write_error(struct util_cq *cq, struct util_cntr *cntr,
 			void *op_context, int err);
 void rxm_cq_write_error_all(struct rxm_ep *rxm_ep, int err);
 void rxm_handle_comp_error(struct rxm_ep *rxm_ep);
+void rxm_handle_cq_error(struct rxm_ep *rxm_ep, struct fid_cq *msg_cq);
 ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp);
 void rxm_thru_comp_error(struct rxm_ep *rxm_ep);
 ssize_t rxm_thru_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp);
@@ -725,12 +866,14 @@ void rxm_finish_eager_send(struct rxm_ep *rxm_ep,
 void rxm_finish_coll_eager_send(struct rxm_ep *rxm_ep,
 				struct rxm_tx_buf *tx_eager_buf);
 
-int rxm_prepost_recv(struct rxm_ep *rxm_ep, struct fid_ep *rx_ep);
+int rxm_prepost_recv(struct rxm_ep *rxm_ep, struct fid_ep *rx_ep,
+		     size_t count);
 
 int rxm_ep_query_atomic(struct fid_domain *domain, enum fi_datatype datatype,
 			enum fi_op op, struct fi_atomic_attr *attr,
 			uint64_t flags);
 ssize_t rxm_rndv_read(struct rxm_rx_buf *rx_buf);
+void rxm_rndv_read_fail(struct rxm_rx_buf *rx_buf, int err);
 ssize_t rxm_rndv_send_wr_data(struct rxm_rx_buf *rx_buf);
 void rxm_rndv_hdr_init(struct rxm_ep *rxm_ep, void *buf,
 			      const struct iovec *iov, size_t count,
@@ -898,6 +1041,12 @@ ssize_t rxm_handle_unexp_sar(struct rxm_recv_queue *recv_queue,
 			     struct rxm_rx_buf *rx_buf);
 int rxm_post_recv(struct rxm_rx_buf *rx_buf);
 
+/* Buffers posted to the srx or the shm ep are not tied to a connection */
+static inline bool rxm_rx_buf_shared(struct rxm_rx_buf *rx_buf)
+{
+	return rx_buf->ep->srx_ctx || rx_buf->rx_ep == rx_buf->ep->shm_ep;
+}
+
 static inline void
 rxm_free_rx_buf(struct rxm_rx_buf *rx_buf)
 {
@@ -907,7 +1056,8 @@ rxm_free_rx_buf(struct rxm_rx_buf *rx_buf)
 	}
 
 	/* Discard rx buffer if its msg_ep was closed */
-	if (rx_buf->repost && (rx_buf->ep->srx_ctx || rx_buf->conn->msg_ep)) {
+	if (rx_buf->repost &&
+	    (rxm_rx_buf_shared(rx_buf) || rx_buf->conn->msg_ep)) {
 		rxm_post_recv(rx_buf);
 	} else {
 		ofi_buf_free(rx_buf);
@@ -39,6 +39,8 @@
 #include <ofi_util.h>
 #include "rxm.h"
 
+/* Maximum number of CM events handled by the CM thread per lock hold */
+#define RXM_CM_BATCH 64
 
 static void *rxm_cm_progress(void *arg);
 static void *rxm_cm_atomic_progress(void *arg);
@@ -55,11 +57,65 @@ struct rxm_eq_cm_entry {
 };
 
 
+/* Fail the rendezvous reads a connection had outstanding on the msg ep in
+ * the given slot, after that ep was closed.  Reads the core provider
+ * flushed to the msg cq on close have been accounted for by then, the
+ * others were discarded without a completion.
+ */
+static void rxm_fail_rndv_reads(struct rxm_conn *conn, int slot)
+{
+	struct rxm_rndv_read_ctx *read_ctx;
+	struct rxm_rx_buf *rx_buf;
+	struct dlist_entry *tmp;
+
+	dlist_foreach_container_safe(&conn->rndv_reads, struct rxm_rx_buf,
+				     rx_buf, rndv_read_entry, tmp) {
+		read_ctx = &rx_buf->rndv_ctx[slot];
+		if (!read_ctx->inflight)
+			continue;
+
+		rx_buf->rndv_inflight -= read_ctx->inflight;
+		read_ctx->inflight = 0;
+		rxm_rndv_read_fail(rx_buf, -FI_ECONNABORTED);
+	}
+}
+
+static void rxm_close_stripe_ep(struct rxm_conn *conn, int i)
+{
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "closing stripe %d of conn %p\n",
+	       i + 1, conn);
+	conn->stripe_connected &= ~BIT(i);
+	fi_close(&conn->stripe_ep[i]->fid);
+	conn->stripe_ep[i] = NULL;
+}
+
+/* The connection keeps running without the stripe.  Receives that had
+ * reads outstanding on it are failed.
+ */
+static void rxm_close_stripe(struct rxm_conn *conn, int i)
+{
+	rxm_close_stripe_ep(conn, i);
+	rxm_flush_msg_cq(conn->ep);
+	rxm_fail_rndv_reads(conn, i + 1);
+}
+
+static int rxm_stripe_index(struct rxm_conn *conn, fid_t fid)
+{
+	int i;
+
+	for (i = 0; i < RXM_MAX_STRIPES - 1; i++) {
+		if (conn->stripe_ep[i] && &conn->stripe_ep[i]->fid == fid)
+			return i;
+	}
+	return -1;
+}
+
 static void rxm_close_conn(struct rxm_conn *conn)
 {
 	struct rxm_deferred_tx_entry *tx_entry;
 	struct rxm_recv_entry *rx_entry;
 	struct rxm_rx_buf *buf;
+	int i;
 
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "closing conn %p\n", conn);
 
@@ -69,6 +125,8 @@ static void rxm_close_conn(struct rxm_conn *conn)
 		tx_entry = container_of(conn->deferred_tx_queue.next,
 				     struct rxm_deferred_tx_entry, entry);
 		rxm_dequeue_deferred_tx(tx_entry);
+		if (tx_entry->type == RXM_DEFERRED_TX_CLOSE_SEND)
+			ofi_buf_free(tx_entry->close_msg.tx_buf);
 		free(tx_entry);
 	}
 
@@ -85,11 +143,32 @@ static void rxm_close_conn(struct rxm_conn *conn)
 		dlist_remove(&rx_entry->entry);
 		rxm_recv_entry_release(rx_entry);
 	}
+	for (i = 0; i < RXM_MAX_STRIPES - 1; i++) {
+		if (conn->stripe_ep[i])
+			rxm_close_stripe_ep(conn, i);
+	}
+	conn->next_stripe = 0;
 	fi_close(&conn->msg_ep->fid);
+	if (conn->core_ep) {
+		fi_close(&conn->core_ep->fid);
+		conn->core_ep = NULL;
+	}
 	rxm_flush_msg_cq(conn->ep);
+	for (i = 0; i < RXM_MAX_STRIPES; i++)
+		rxm_fail_rndv_reads(conn, i);
 	dlist_remove_init(&conn->loopback_entry);
 	conn->msg_ep = NULL;
 
+	if (!dlist_empty(&conn->lru_entry)) {
+		if (conn->flags & RXM_CONN_CLOSING)
+			conn->ep->closing_cnt--;
+		dlist_remove_init(&conn->lru_entry);
+		conn->ep->conn_cnt--;
+	}
+	conn->flags &= ~(RXM_CONN_SHM | RXM_CONN_CLOSING |
+			 RXM_CONN_CLOSE_ACKED | RXM_CONN_CLOSE_REQ |
+			 RXM_CONN_UNUSED);
+
 	if (conn->state == RXM_CM_CONNECTING || conn->state == RXM_CM_ACCEPTING)
 		conn->ep->connecting_cnt--;
 	assert(conn->ep->connecting_cnt >= 0);
@@ -227,7 +306,8 @@ static int rxm_open_conn(struct rxm_conn *conn, struct fi_info *msg_info)
 	conn->flow_ctrl = domain->flow_ctrl_ops->available(msg_ep);
 
 	if (!ep->srx_ctx) {
-		ret = rxm_prepost_recv(ep, msg_ep);
+		ret = rxm_prepost_recv(ep, msg_ep,
+				       ep->msg_info->rx_attr->size);
 		if (ret)
 			goto err;
 	}
@@ -239,11 +319,56 @@ err:
 	return ret;
 }
 
+/* Stripes only carry rendezvous reads, which consume no receive
+ * buffers, so nothing is posted to them.
+ */
+static int rxm_open_stripe(struct rxm_conn *conn, struct fi_info *msg_info,
+			   int i)
+{
+	struct rxm_domain *domain;
+	struct fid_ep *msg_ep;
+	int ret;
+
+	assert(ofi_ep_lock_held(&conn->ep->util_ep));
+	assert(!conn->stripe_ep[i]);
+	domain = container_of(conn->ep->util_ep.domain, struct rxm_domain,
+			      util_domain);
+	ret = fi_endpoint(domain->msg_domain, msg_info, &msg_ep, conn);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_endpoint", ret);
+		return ret;
+	}
+
+	ret = fi_ep_bind(msg_ep, &conn->ep->msg_eq->fid, 0);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_ep_bind", ret);
+		goto err;
+	}
+
+	ret = rxm_bind_comp(conn->ep, msg_ep);
+	if (ret)
+		goto err;
+
+	ret = fi_enable(msg_ep);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_enable", ret);
+		goto err;
+	}
+
+	conn->stripe_ep[i] = msg_ep;
+	return 0;
+err:
+	fi_close(&msg_ep->fid);
+	return ret;
+}
+
 /* We send passive endpoint's port to the server as connection request
- * would be from a different one.
+ * would be from a different one.  The shm host id is only appended when
+ * the shm bypass is enabled, so peers that do not know it still receive
+ * the CM data size they expect.
  */
 static int rxm_init_connect_data(struct rxm_conn *conn,
-				 union rxm_cm_data *cm_data)
+				 union rxm_cm_data *cm_data, size_t *size)
 {
 	size_t cm_data_size = 0;
 	size_t opt_size = sizeof(cm_data_size);
@@ -274,6 +399,13 @@ static int rxm_init_connect_data(struct rxm_conn *conn,
 
 	cm_data->connect.port = ofi_addr_get_port(&conn->ep->addr.sa);
 	cm_data->connect.client_conn_id = rxm_conn_id(conn->peer->index);
+
+	if (conn->ep->shm_ep) {
+		cm_data->connect.shm_host = rxm_ep_shm_host(conn->ep);
+		*size = sizeof(cm_data->connect);
+	} else {
+		*size = offsetof(struct _connect, shm_host);
+	}
 	return 0;
 }
 
@@ -281,6 +413,7 @@ static int rxm_send_connect(struct rxm_conn *conn)
 {
 	union rxm_cm_data cm_data;
 	struct fi_info *info;
+	size_t cm_data_size;
 	int ret;
 
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "connecting %p\n", conn);
@@ -298,12 +431,12 @@ static int rxm_send_connect(struct rxm_conn *conn)
 	if (ret)
 		return ret;
 
-	ret = rxm_init_connect_data(conn, &cm_data);
+	ret = rxm_init_connect_data(conn, &cm_data, &cm_data_size);
 	if (ret)
 		goto err;
 
 	ret = fi_connect(conn->msg_ep, info->dest_addr, &cm_data,
-			 sizeof(cm_data));
+			 cm_data_size);
 	if (ret) {
 		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_connect", ret);
 		goto err;
@@ -344,6 +477,45 @@ static int rxm_connect(struct rxm_conn *conn)
 	return -FI_EAGAIN;
 }
 
+/* Called once our connection request is accepted.  A stripe that
+ * cannot be connected is closed, and the connection runs without it.
+ */
+static void rxm_connect_stripes(struct rxm_conn *conn)
+{
+	union rxm_cm_data cm_data;
+	struct fi_info *info;
+	size_t cm_data_size;
+	int i, ret;
+
+	assert(ofi_ep_lock_held(&conn->ep->util_ep));
+	info = conn->ep->msg_info;
+	free(info->dest_addr);
+	info->dest_addr = mem_dup(&conn->peer->addr, info->dest_addrlen);
+	if (!info->dest_addr)
+		return;
+
+	for (i = 0; i < (int) conn->ep->stripes - 1; i++) {
+		ret = rxm_open_stripe(conn, info, i);
+		if (ret)
+			return;
+
+		ret = rxm_init_connect_data(conn, &cm_data, &cm_data_size);
+		if (ret)
+			goto err;
+
+		cm_data.connect.stripe = (uint8_t) (i + 1);
+		ret = fi_connect(conn->stripe_ep[i], info->dest_addr, &cm_data,
+				 cm_data_size);
+		if (ret) {
+			RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_connect", ret);
+			goto err;
+		}
+	}
+	return;
+err:
+	rxm_close_stripe(conn, i);
+}
+
 static void rxm_free_conn(struct rxm_conn *conn)
 {
 	struct rxm_av *av;
@@ -353,6 +525,7 @@ static void rxm_free_conn(struct rxm_conn *conn)
 
 	if (conn->flags & RXM_CONN_INDEXED)
 		ofi_idm_clear(&conn->ep->conn_idx_map, conn->peer->index);
+	dlist_remove(&conn->prewarm_entry);
 
 	util_put_peer(conn->peer);
 	av = container_of(conn->ep->util_ep.av, struct rxm_av, util_av);
@@ -410,11 +583,19 @@ rxm_alloc_conn(struct rxm_ep *ep, struct util_peer_addr *peer)
 	conn->state = RXM_CM_IDLE;
 	conn->remote_index = -1;
 	conn->flags = 0;
+	conn->core_ep = NULL;
 	dlist_init(&conn->deferred_entry);
 	dlist_init(&conn->deferred_tx_queue);
 	dlist_init(&conn->deferred_sar_msgs);
 	dlist_init(&conn->deferred_sar_segments);
 	dlist_init(&conn->loopback_entry);
+	dlist_init(&conn->prewarm_entry);
+	dlist_init(&conn->lru_entry);
+	conn->tx_cnt = 0;
+	memset(conn->stripe_ep, 0, sizeof(conn->stripe_ep));
+	conn->stripe_connected = 0;
+	conn->next_stripe = 0;
+	dlist_init(&conn->rndv_reads);
 
 	conn->peer = peer;
 	rxm_ref_peer(peer);
@@ -447,6 +628,28 @@ rxm_add_conn(struct rxm_ep *ep, struct util_peer_addr *peer)
 	return conn;
 }
 
+/* Move a connection to the most recently used end of the lru list */
+static void rxm_touch_conn(struct rxm_conn *conn)
+{
+	if (dlist_empty(&conn->lru_entry))
+		return;
+
+	conn->flags &= ~RXM_CONN_UNUSED;
+	dlist_remove(&conn->lru_entry);
+	dlist_insert_tail(&conn->lru_entry, &conn->ep->lru_list);
+}
+
+void rxm_touch_rx_conn(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_conn *conn;
+
+	conn = rx_buf->conn ? rx_buf->conn :
+	       ofi_idm_at(&rx_buf->ep->conn_idx_map,
+			  (int) rx_buf->pkt.ctrl_hdr.conn_id);
+	if (conn)
+		rxm_touch_conn(conn);
+}
+
 /* The returned conn is only valid if the function returns success. */
 ssize_t rxm_get_conn(struct rxm_ep *ep, fi_addr_t addr, struct rxm_conn **conn)
 {
@@ -460,6 +663,16 @@ ssize_t rxm_get_conn(struct rxm_ep *ep, fi_addr_t addr, struct rxm_conn **conn)
 		return -FI_ENOMEM;
 
 	if ((*conn)->state == RXM_CM_CONNECTED) {
+		/* The connection is being closed, wait until it is gone
+		 * and reconnect.
+		 */
+		if ((*conn)->flags & RXM_CONN_CLOSING) {
+			rxm_ep_do_progress(&ep->util_ep);
+			rxm_conn_progress(ep);
+			return -FI_EAGAIN;
+		}
+		if (ep->max_conns)
+			rxm_touch_conn(*conn);
 		if (!dlist_empty(&(*conn)->deferred_tx_queue)) {
 			rxm_ep_do_progress(&ep->util_ep);
 			if (!dlist_empty(&(*conn)->deferred_tx_queue))
@@ -479,6 +692,269 @@ ssize_t rxm_get_conn(struct rxm_ep *ep, fi_addr_t addr, struct rxm_conn **conn)
 	return ret;
 }
 
+/* Start queued connections while fewer than connect_window are in
+ * progress.  Pacing keeps a large prewarm from flooding the listeners
+ * of its peers and the msg eq with connection requests.
+ */
+static void rxm_prewarm_progress(struct rxm_ep *ep)
+{
+	struct rxm_conn *conn;
+	int ret;
+
+	assert(ofi_ep_lock_held(&ep->util_ep));
+	while (!dlist_empty(&ep->prewarm_queue) &&
+	       (size_t) ep->connecting_cnt < ep->connect_window) {
+		dlist_pop_front(&ep->prewarm_queue, struct rxm_conn,
+				conn, prewarm_entry);
+		dlist_init(&conn->prewarm_entry);
+		if (conn->state != RXM_CM_IDLE)
+			continue;
+
+		ret = rxm_send_connect(conn);
+		if (ret)
+			RXM_WARN_ERR(FI_LOG_EP_CTRL, "rxm_send_connect", ret);
+	}
+}
+
+int rxm_prewarm_conns(struct rxm_ep *ep, const fi_addr_t *addr, size_t count)
+{
+	struct util_peer_addr **peer;
+	struct rxm_conn *conn;
+	size_t i;
+	int ret = 0;
+
+	ofi_ep_lock_acquire(&ep->util_ep);
+	for (i = 0; i < count; i++) {
+		/* The rxm av clears the context of removed addresses */
+		peer = ofi_av_addr_context_checked(ep->util_ep.av, addr[i]);
+		if (!peer || !*peer) {
+			FI_WARN(&rxm_prov, FI_LOG_EP_CTRL,
+				"prewarm address %zu is not in the av\n", i);
+			ret = -FI_EINVAL;
+			break;
+		}
+
+		conn = rxm_add_conn(ep, *peer);
+		if (!conn) {
+			ret = -FI_ENOMEM;
+			break;
+		}
+
+		if (conn->state == RXM_CM_IDLE &&
+		    dlist_empty(&conn->prewarm_entry))
+			dlist_insert_tail(&conn->prewarm_entry,
+					  &ep->prewarm_queue);
+	}
+
+	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "prewarming %zu connections\n", i);
+	rxm_prewarm_progress(ep);
+	ofi_ep_lock_release(&ep->util_ep);
+	return ret;
+}
+
+static void rxm_set_closing(struct rxm_conn *conn, bool closing)
+{
+	if (closing) {
+		conn->flags |= RXM_CONN_CLOSING;
+		if (!dlist_empty(&conn->lru_entry))
+			conn->ep->closing_cnt++;
+	} else {
+		conn->flags &= ~(RXM_CONN_CLOSING | RXM_CONN_CLOSE_ACKED);
+		if (!dlist_empty(&conn->lru_entry))
+			conn->ep->closing_cnt--;
+	}
+}
+
+static bool
+rxm_conn_has_unexp(struct rxm_recv_queue *recv_queue, struct rxm_conn *conn)
+{
+	struct rxm_rx_buf *rx_buf;
+
+	dlist_foreach_container(&recv_queue->unexp_msg_list, struct rxm_rx_buf,
+				rx_buf, unexp_msg.entry) {
+		if (rx_buf->conn == conn ||
+		    (!rx_buf->conn &&
+		     rx_buf->pkt.ctrl_hdr.conn_id == (uint64_t) conn->peer->index))
+			return true;
+	}
+	return false;
+}
+
+/* A connection is quiet when no transfer in either direction still
+ * needs it: no application transmits waiting for completion, nothing
+ * deferred, and no unexpected or partially reassembled messages that
+ * were received over it.
+ */
+static bool rxm_conn_quiet(struct rxm_conn *conn)
+{
+	return !conn->tx_cnt &&
+	       dlist_empty(&conn->deferred_tx_queue) &&
+	       dlist_empty(&conn->deferred_sar_msgs) &&
+	       dlist_empty(&conn->deferred_sar_segments) &&
+	       !rxm_conn_has_unexp(&conn->ep->recv_queue, conn) &&
+	       !rxm_conn_has_unexp(&conn->ep->trecv_queue, conn);
+}
+
+/* A new connection is kept until it has carried a transfer.  Otherwise,
+ * with more active peers than the limit, connections would be closed
+ * before the transfers that opened them are retried.
+ */
+static bool rxm_conn_idle(struct rxm_conn *conn)
+{
+	return conn->state == RXM_CM_CONNECTED &&
+	       !(conn->flags & (RXM_CONN_CLOSING | RXM_CONN_SHM |
+				RXM_CONN_UNUSED)) &&
+	       rxm_conn_quiet(conn);
+}
+
+static int rxm_send_close(struct rxm_conn *conn, uint64_t type)
+{
+	struct rxm_deferred_tx_entry *def_tx_entry;
+	struct rxm_tx_buf *tx_buf;
+	ssize_t ret;
+
+	tx_buf = ofi_buf_alloc(conn->ep->tx_pool);
+	if (!tx_buf)
+		return -FI_ENOMEM;
+
+	tx_buf->hdr.state = RXM_CLOSE_TX;
+	rxm_ep_format_tx_buf_pkt(conn, 0, ofi_op_msg, 0, 0, 0, &tx_buf->pkt);
+	tx_buf->pkt.ctrl_hdr.type = rxm_ctrl_close;
+	tx_buf->pkt.ctrl_hdr.ctrl_data = type;
+
+	if (dlist_empty(&conn->deferred_tx_queue)) {
+		ret = fi_send(conn->msg_ep, &tx_buf->pkt, sizeof(tx_buf->pkt),
+			      tx_buf->hdr.desc, 0, tx_buf);
+		if (!ret)
+			return 0;
+
+		if (ret != -FI_EAGAIN) {
+			RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_send", ret);
+			ofi_buf_free(tx_buf);
+			return (int) ret;
+		}
+	}
+
+	def_tx_entry = rxm_ep_alloc_deferred_tx_entry(conn->ep, conn,
+						RXM_DEFERRED_TX_CLOSE_SEND);
+	if (!def_tx_entry) {
+		ofi_buf_free(tx_buf);
+		return -FI_ENOMEM;
+	}
+
+	def_tx_entry->close_msg.tx_buf = tx_buf;
+	rxm_queue_deferred_tx(def_tx_entry, OFI_LIST_TAIL);
+	return 0;
+}
+
+/* Ask the peers of the least recently used idle connections to close
+ * them until at most max_conns remain open.  The limit is soft: busy
+ * connections are left alone, and a connection is only closed once its
+ * peer confirms that it is idle as well.
+ */
+static void rxm_evict_conns(struct rxm_ep *ep)
+{
+	struct rxm_conn *conn;
+	struct dlist_entry *tmp;
+
+	assert(ofi_ep_lock_held(&ep->util_ep));
+	dlist_foreach_container_safe(&ep->lru_list, struct rxm_conn,
+				     conn, lru_entry, tmp) {
+		if (ep->conn_cnt - ep->closing_cnt <= ep->max_conns)
+			break;
+
+		if (!rxm_conn_idle(conn))
+			continue;
+
+		FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "evicting conn %p\n", conn);
+		if (!rxm_send_close(conn, RXM_CLOSE_REQ))
+			rxm_set_closing(conn, true);
+	}
+}
+
+static void rxm_handle_close_req(struct rxm_conn *conn)
+{
+	if (conn->flags & RXM_CONN_CLOSING) {
+		/* Both sides asked, each closes on the other's ack */
+		if (!rxm_send_close(conn, RXM_CLOSE_ACK))
+			conn->flags |= RXM_CONN_CLOSE_ACKED;
+	} else if (rxm_conn_idle(conn)) {
+		if (!rxm_send_close(conn, RXM_CLOSE_ACK)) {
+			rxm_set_closing(conn, true);
+			conn->flags |= RXM_CONN_CLOSE_ACKED;
+		}
+	} else {
+		(void) rxm_send_close(conn, RXM_CLOSE_NACK);
+	}
+}
+
+/* Closing handshake.  The side closing a connection stops issuing
+ * transfers on it and sends a request.  The peer stops as well and
+ * acknowledges the request if it has nothing outstanding on the
+ * connection, otherwise it refuses.  Because the connection delivers
+ * messages in order, everything the peer sent has been received by the
+ * time its ack arrives, and the requester closes the msg ep.  The peer
+ * frees its side on the resulting shutdown event.  Both sides reconnect
+ * on the next transfer.
+ */
+ssize_t rxm_handle_close(struct rxm_ep *ep, struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_conn *conn;
+	uint64_t type;
+
+	assert(ofi_ep_lock_held(&ep->util_ep));
+	conn = rx_buf->conn ? rx_buf->conn :
+	       ofi_idm_at(&ep->conn_idx_map,
+			  (int) rx_buf->pkt.ctrl_hdr.conn_id);
+	type = rx_buf->pkt.ctrl_hdr.ctrl_data;
+	rxm_free_rx_buf(rx_buf);
+	if (!conn)
+		return 0;
+
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "close %" PRIu64 " for conn %p\n",
+	       type, conn);
+
+	/* Data may arrive before our connected event is processed.  The
+	 * request is then answered once the connection is established.
+	 */
+	if (conn->state != RXM_CM_CONNECTED) {
+		if (type == RXM_CLOSE_REQ &&
+		    (conn->state == RXM_CM_CONNECTING ||
+		     conn->state == RXM_CM_ACCEPTING))
+			conn->flags |= RXM_CONN_CLOSE_REQ;
+		return 0;
+	}
+
+	switch (type) {
+	case RXM_CLOSE_REQ:
+		rxm_handle_close_req(conn);
+		break;
+	case RXM_CLOSE_ACK:
+		if (!(conn->flags & RXM_CONN_CLOSING)) {
+			/* Let the peer resume using the connection */
+			(void) rxm_send_close(conn, RXM_CLOSE_NACK);
+		} else if (rxm_conn_quiet(conn)) {
+			rxm_close_conn(conn);
+			rxm_free_conn(conn);
+		} else {
+			/* Messages received after our request are pending */
+			rxm_set_closing(conn, false);
+			(void) rxm_send_close(conn, RXM_CLOSE_NACK);
+		}
+		break;
+	case RXM_CLOSE_NACK:
+		if (conn->flags & RXM_CONN_CLOSING) {
+			rxm_set_closing(conn, false);
+			rxm_touch_conn(conn);
+		}
+		break;
+	default:
+		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "unknown close type\n");
+		break;
+	}
+	return 0;
+}
+
 static void rxm_set_peer_flow_ctrl(struct rxm_conn *conn, int cm_flow_ctrl_flag)
 {
 	switch (cm_flow_ctrl_flag) {
@@ -505,18 +981,27 @@ void rxm_process_connect(struct rxm_eq_cm_entry *cm_entry)
 {
 	struct rxm_conn *conn;
 	struct rxm_domain *domain;
+	int i;
 
 	conn = cm_entry->fid->context;
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL,
 	       "processing connected for handle: %p\n", conn);
 
 	assert(ofi_ep_lock_held(&conn->ep->util_ep));
+	i = rxm_stripe_index(conn, cm_entry->fid);
+	if (i >= 0) {
+		conn->stripe_connected |= BIT(i);
+		return;
+	}
+
 	if (conn->state == RXM_CM_CONNECTING) {
 		conn->remote_index = rxm_peer_index(cm_entry->data.accept.
 						    server_conn_id);
 		conn->remote_pid = rxm_peer_pid(cm_entry->data.accept.
 						server_conn_id);
 		rxm_set_peer_flow_ctrl(conn, cm_entry->data.accept.flow_ctrl);
+		if (cm_entry->data.accept.shm && conn->ep->shm_ep)
+			conn->flags |= RXM_CONN_SHM;
 	}
 
 	if (conn->flow_ctrl & conn->peer_flow_ctrl) {
@@ -526,9 +1011,36 @@ void rxm_process_connect(struct rxm_eq_cm_entry *cm_entry)
 					      conn->ep->msg_info->rx_attr->size / 2);
 	}
 
+	/* Fall back to the msg ep if the peer's shm ep is not reachable */
+	if ((conn->flags & RXM_CONN_SHM) && rxm_shm_conn_open(conn)) {
+		FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
+			"unable to reach shm peer, conn %p uses msg ep\n",
+			conn);
+		conn->flags &= ~RXM_CONN_SHM;
+	}
+
+	if (conn->state == RXM_CM_CONNECTING && conn->ep->stripes > 1 &&
+	    (conn->flags & RXM_CONN_INDEXED) && !(conn->flags & RXM_CONN_SHM))
+		rxm_connect_stripes(conn);
+
 	conn->ep->connecting_cnt--;
 	assert(conn->ep->connecting_cnt >= 0);
 	conn->state = RXM_CM_CONNECTED;
+
+	/* Loopback connections and those replaced by shm are not counted */
+	if (conn->ep->max_conns && (conn->flags & RXM_CONN_INDEXED) &&
+	    !(conn->flags & RXM_CONN_SHM) &&
+	    ofi_addr_cmp(&rxm_prov, &conn->peer->addr.sa,
+			 &conn->ep->addr.sa)) {
+		dlist_insert_tail(&conn->lru_entry, &conn->ep->lru_list);
+		conn->flags |= RXM_CONN_UNUSED;
+		conn->ep->conn_cnt++;
+	}
+
+	if (conn->flags & RXM_CONN_CLOSE_REQ) {
+		conn->flags &= ~RXM_CONN_CLOSE_REQ;
+		rxm_handle_close_req(conn);
+	}
 }
 
 /* For simultaneous connection requests, if the peer won the coin
@@ -627,7 +1139,8 @@ rxm_reject_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry,
 }
 
 static int
-rxm_accept_connreq(struct rxm_conn *conn, struct rxm_eq_cm_entry *cm_entry)
+rxm_accept_connreq(struct rxm_conn *conn, struct fid_ep *msg_ep,
+		   struct rxm_eq_cm_entry *cm_entry)
 {
 	union rxm_cm_data cm_data;
 	int ret;
@@ -636,18 +1149,50 @@ rxm_accept_connreq(struct rxm_conn *conn, struct rxm_eq_cm_entry *cm_entry)
 	cm_data.accept.rx_size = (uint32_t) cm_entry->info->rx_attr->size;
 	cm_data.accept.flow_ctrl = conn->flow_ctrl ? RXM_CM_FLOW_CTRL_PEER_ON :
 						     RXM_CM_FLOW_CTRL_PEER_OFF;
+	cm_data.accept.shm = !!(conn->flags & RXM_CONN_SHM);
 	cm_data.accept.align_pad[0] = 0;
 	cm_data.accept.align_pad[1] = 0;
-	cm_data.accept.align_pad[2] = 0;
 
-	ret = fi_accept(conn->msg_ep, &cm_data.accept, sizeof(cm_data.accept));
+	ret = fi_accept(msg_ep, &cm_data.accept, sizeof(cm_data.accept));
 	if (ret)
 		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_accept", ret);
 	return ret;
 }
 
+/* Stripes are accepted for the connection they belong to, whether or
+ * not we open stripes ourselves.
+ */
+static int
+rxm_accept_stripe(struct rxm_ep *ep, struct util_peer_addr *peer,
+		  struct rxm_eq_cm_entry *cm_entry)
+{
+	struct rxm_conn *conn;
+	int i, ret;
+
+	i = cm_entry->data.connect.stripe - 1;
+	conn = ofi_idm_lookup(&ep->conn_idx_map, peer->index);
+	if (!conn || i >= RXM_MAX_STRIPES - 1 || conn->stripe_ep[i] ||
+	    (conn->state != RXM_CM_ACCEPTING &&
+	     conn->state != RXM_CM_CONNECTED) ||
+	    (conn->flags & RXM_CONN_CLOSING) || conn->remote_pid !=
+	    rxm_peer_pid(cm_entry->data.connect.client_conn_id)) {
+		FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "reject stripe %d\n", i + 1);
+		return -FI_ECONNREFUSED;
+	}
+
+	ret = rxm_open_stripe(conn, cm_entry->info, i);
+	if (ret)
+		return ret;
+
+	ret = rxm_accept_connreq(conn, conn->stripe_ep[i], cm_entry);
+	if (ret)
+		rxm_close_stripe(conn, i);
+	return ret;
+}
+
 static void
-rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
+rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry,
+		    size_t len)
 {
 	union ofi_sock_ip peer_addr;
 	struct util_peer_addr *peer;
@@ -671,6 +1216,12 @@ rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 		goto reject;
 	}
 
+	if (cm_entry->data.connect.stripe) {
+		if (rxm_accept_stripe(ep, peer, cm_entry))
+			goto remove;
+		goto put;
+	}
+
 	conn = rxm_add_conn(ep, peer);
 	if (!conn)
 		goto remove;
@@ -708,9 +1259,13 @@ rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 		break;
 	case RXM_CM_ACCEPTING:
 	case RXM_CM_CONNECTED:
-		if (conn->remote_pid &&
-		    (conn->remote_pid == rxm_peer_pid(cm_entry->data.connect.
-		    				      client_conn_id))) {
+		/* A request from the peer of a connection we acked closing
+		 * may be stale, so it is rejected until the shutdown arrives.
+		 * The peer then retries.
+		 */
+		if (conn->remote_pid && ((conn->flags & RXM_CONN_CLOSE_ACKED) ||
+		    conn->remote_pid == rxm_peer_pid(cm_entry->data.connect.
+						     client_conn_id))) {
 			FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
 				"simultaneous, reject peer\n");
 			rxm_reject_connreq(ep, cm_entry,
@@ -734,8 +1289,11 @@ rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 		goto free;
 
 	rxm_set_peer_flow_ctrl(conn, cm_entry->data.connect.flow_ctrl);
+	if (ep->shm_ep && len >= sizeof(*cm_entry) &&
+	    cm_entry->data.connect.shm_host == rxm_ep_shm_host(ep))
+		conn->flags |= RXM_CONN_SHM;
 
-	ret = rxm_accept_connreq(conn, cm_entry);
+	ret = rxm_accept_connreq(conn, conn->msg_ep, cm_entry);
 	if (ret)
 		goto close;
 
@@ -778,10 +1336,23 @@ void rxm_process_shutdown(struct rxm_conn *conn)
 	}
 }
 
+static void rxm_process_shutdown_event(struct rxm_eq_cm_entry *cm_entry)
+{
+	struct rxm_conn *conn = cm_entry->fid->context;
+	int i;
+
+	i = rxm_stripe_index(conn, cm_entry->fid);
+	if (i >= 0)
+		rxm_close_stripe(conn, i);
+	else
+		rxm_process_shutdown(conn);
+}
+
 static void rxm_handle_error(struct rxm_ep *ep)
 {
 	struct fi_eq_err_entry entry = {0};
 	ssize_t ret;
+	int i;
 
 	assert(ofi_ep_lock_held(&ep->util_ep));
 	ret = fi_eq_readerr(ep->msg_eq, &entry, 0);
@@ -810,7 +1381,10 @@ static void rxm_handle_error(struct rxm_ep *ep)
 	if (!entry.fid || entry.fid->fclass != FI_CLASS_EP)
 		return;
 
-	if (entry.err == ECONNREFUSED) {
+	i = rxm_stripe_index(entry.fid->context, entry.fid);
+	if (i >= 0) {
+		rxm_close_stripe(entry.fid->context, i);
+	} else if (entry.err == ECONNREFUSED) {
 		rxm_process_reject(entry.fid->context, &entry);
 	} else {
 		rxm_process_shutdown(entry.fid->context);
@@ -826,13 +1400,13 @@ rxm_handle_event(struct rxm_ep *ep, uint32_t event,
 	case FI_NOTIFY:
 		break;
 	case FI_CONNREQ:
-		rxm_process_connreq(ep, cm_entry);
+		rxm_process_connreq(ep, cm_entry, len);
 		break;
 	case FI_CONNECTED:
 		rxm_process_connect(cm_entry);
 		break;
 	case FI_SHUTDOWN:
-		rxm_process_shutdown(cm_entry->fid->context);
+		rxm_process_shutdown_event(cm_entry);
 		break;
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL,
@@ -858,6 +1432,12 @@ void rxm_conn_progress(struct rxm_ep *ep)
 			ret = 1;
 		}
 	} while (ret > 0);
+
+	if (!dlist_empty(&ep->prewarm_queue))
+		rxm_prewarm_progress(ep);
+
+	if (ep->max_conns && ep->conn_cnt - ep->closing_cnt > ep->max_conns)
+		rxm_evict_conns(ep);
 }
 
 void rxm_stop_listen(struct rxm_ep *ep)
@@ -916,6 +1496,7 @@ static void *rxm_cm_progress(void *arg)
 	struct rxm_eq_cm_entry cm_entry;
 	uint32_t event;
 	ssize_t ret;
+	int cnt;
 
 	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "Starting auto-progress thread\n");
 
@@ -937,18 +1518,25 @@ static void *rxm_cm_progress(void *arg)
 				  sizeof(cm_entry), -1, FI_PEEK);
 
 		ofi_ep_lock_acquire(&ep->util_ep);
-		if (ret > 0) {
+		/* Handle the events that queued up behind the first one
+		 * under a single lock acquisition.  Connection storms
+		 * otherwise pay a wakeup and a lock round trip per event.
+		 */
+		for (cnt = 0; ret > 0 && cnt < RXM_CM_BATCH; cnt++) {
 			ret = fi_eq_read(ep->msg_eq, &event, &cm_entry,
 					 sizeof(cm_entry), 0);
+			if (ret > 0)
+				rxm_handle_event(ep, event, &cm_entry, ret);
 		}
-		if (ret > 0) {
-			rxm_handle_event(ep, event, &cm_entry, ret);
-		} else if (ret == -FI_EAVAIL) {
+		if (ret == -FI_EAVAIL) {
 			rxm_handle_error(ep);
-		} else if (ret && ret != -FI_EAGAIN) {
+		} else if (ret < 0 && ret != -FI_EAGAIN) {
 			RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_eq_read", ret);
 			break;
 		}
+
+		if (!dlist_empty(&ep->prewarm_queue))
+			rxm_prewarm_progress(ep);
 	}
 	ofi_ep_lock_release(&ep->util_ep);
 
@@ -229,21 +229,20 @@ static bool rxm_complete_sar(struct rxm_ep *rxm_ep,
 	struct rxm_tx_buf *first_tx_buf;
 
 	assert(ofi_tx_cq_flags(tx_buf->pkt.hdr.op) & FI_SEND);
-	switch (rxm_sar_get_seg_type(&tx_buf->pkt.ctrl_hdr)) {
-	case RXM_SAR_SEG_FIRST:
-		break;
-	case RXM_SAR_SEG_MIDDLE:
-		rxm_free_tx_buf(rxm_ep, tx_buf);
-		break;
-	case RXM_SAR_SEG_LAST:
+	if (rxm_sar_get_seg_type(&tx_buf->pkt.ctrl_hdr) == RXM_SAR_SEG_FIRST) {
+		first_tx_buf = tx_buf;
+	} else {
 		first_tx_buf = ofi_bufpool_get_ibuf(rxm_ep->tx_pool,
 						tx_buf->pkt.ctrl_hdr.msg_id);
-		rxm_free_tx_buf(rxm_ep, first_tx_buf);
 		rxm_free_tx_buf(rxm_ep, tx_buf);
-		return true;
 	}
 
-	return false;
+	assert(first_tx_buf->sar_pending);
+	if (--first_tx_buf->sar_pending)
+		return false;
+
+	rxm_free_tx_buf(rxm_ep, first_tx_buf);
+	return true;
 }
 
 static void rxm_handle_sar_comp(struct rxm_ep *rxm_ep,
@@ -503,27 +502,134 @@ static ssize_t rxm_rndv_xfer(struct rxm_ep *rxm_ep, struct fid_ep *msg_ep,
 	return ret;
 }
 
-ssize_t rxm_rndv_read(struct rxm_rx_buf *rx_buf)
+/*
+ * Stop issuing reads for a rendezvous receive that hit an error.  The
+ * receive is completed in error and released once its outstanding reads
+ * have drained, as their completions still reference the rx_buf.
+ */
+void rxm_rndv_read_fail(struct rxm_rx_buf *rx_buf, int err)
 {
+	struct rxm_ep *ep = rx_buf->ep;
+
+	if (!rx_buf->rndv_err)
+		rx_buf->rndv_err = err;
+	rx_buf->rndv_remain = 0;
+	if (rx_buf->rndv_inflight)
+		return;
+
+	RXM_UPDATE_STATE(FI_LOG_CQ, rx_buf, RXM_RNDV_FINISH);
+	dlist_remove(&rx_buf->rndv_read_entry);
+	rxm_cq_write_error(ep->util_ep.rx_cq, ep->util_ep.rx_cntr,
+			   rx_buf->recv_entry->context, rx_buf->rndv_err);
+
+	if (!ep->rdm_mr_local)
+		rxm_msg_mr_closev(rx_buf->mr,
+				  rx_buf->recv_entry->rxm_iov.count);
+
+	rxm_recv_entry_release(rx_buf->recv_entry);
+	rxm_free_rx_buf(rx_buf);
+}
+
+/*
+ * Issue reads until the message is covered or rndv_chunks of them are
+ * outstanding.  A read never crosses a sender buffer and is at most
+ * rndv_chunk_size bytes long.  Further reads are issued as earlier ones
+ * complete.
+ */
+static ssize_t rxm_rndv_read_chunks(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_ep *ep = rx_buf->ep;
+	struct rxm_rndv_hdr *remote_hdr = rx_buf->remote_rndv_hdr;
+	struct rxm_iov *rxm_iov = &rx_buf->recv_entry->rxm_iov;
+	struct rxm_deferred_tx_entry *def_tx_entry;
+	struct iovec iov[RXM_IOV_LIMIT];
+	void *desc[RXM_IOV_LIMIT];
+	size_t i, count, len;
+	uint8_t slot;
 	ssize_t ret;
-	size_t total_len;
 
-	total_len = MIN(rx_buf->recv_entry->total_len, rx_buf->pkt.hdr.size);
-	RXM_UPDATE_STATE(FI_LOG_CQ, rx_buf, RXM_RNDV_READ);
+	while (rx_buf->rndv_remain && rx_buf->rndv_inflight < ep->rndv_chunks) {
+		i = rx_buf->rndv_rma_index;
+		assert(i < remote_hdr->count);
+		len = MIN(remote_hdr->iov[i].len - rx_buf->rndv_rma_offset,
+			  rx_buf->rndv_remain);
+		len = MIN(len, ep->rndv_chunk_size);
+
+		ret = ofi_copy_iov_desc(iov, desc, &count, rxm_iov->iov,
+					rxm_iov->desc, rxm_iov->count,
+					&rx_buf->rndv_local_index,
+					&rx_buf->rndv_local_offset, len);
+		if (ret)
+			goto err;
+
+		slot = rxm_conn_next_stripe(rx_buf->conn);
+		ret = ep->rndv_ops->xfer(rxm_conn_stripe_ep(rx_buf->conn, slot),
+					 iov, desc, count, 0,
+					 remote_hdr->iov[i].addr +
+					 rx_buf->rndv_rma_offset,
+					 remote_hdr->iov[i].key,
+					 &rx_buf->rndv_ctx[slot]);
+		if (ret == -FI_EAGAIN) {
+			/* Deferred reads are posted to the primary msg ep */
+			slot = 0;
+			ret = ep->rndv_ops->defer_xfer(&def_tx_entry, i, iov,
+						       desc, count, rx_buf);
+			if (ret)
+				goto err;
+			rxm_queue_deferred_tx(def_tx_entry, OFI_LIST_TAIL);
+			ret = -FI_EAGAIN;
+		} else if (ret) {
+			goto err;
+		}
 
-	ret = rxm_rndv_xfer(rx_buf->ep, rx_buf->conn->msg_ep,
-			    rx_buf->remote_rndv_hdr,
-			    rx_buf->recv_entry->rxm_iov.iov,
-			    rx_buf->recv_entry->rxm_iov.desc,
-			    rx_buf->recv_entry->rxm_iov.count, total_len,
-			    rx_buf);
-	if (ret) {
-		rxm_cq_write_error(rx_buf->ep->util_ep.rx_cq,
-				   rx_buf->ep->util_ep.rx_cntr, rx_buf, (int) ret);
+		rx_buf->rndv_ctx[slot].inflight++;
+		rx_buf->rndv_inflight++;
+		rx_buf->rndv_remain -= len;
+		rx_buf->rndv_rma_offset += len;
+		if (rx_buf->rndv_rma_offset == remote_hdr->iov[i].len) {
+			rx_buf->rndv_rma_index++;
+			rx_buf->rndv_rma_offset = 0;
+		}
+
+		/* Let the deferred queue drain before adding to it */
+		if (ret == -FI_EAGAIN)
+			break;
 	}
+	return 0;
+err:
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "unable to issue rendezvous read: %s\n",
+		fi_strerror((int) -ret));
 	return ret;
 }
 
+ssize_t rxm_rndv_read(struct rxm_rx_buf *rx_buf)
+{
+	size_t i;
+	ssize_t ret;
+
+	RXM_UPDATE_STATE(FI_LOG_CQ, rx_buf, RXM_RNDV_READ);
+
+	rx_buf->rndv_rma_offset = 0;
+	rx_buf->rndv_local_index = 0;
+	rx_buf->rndv_local_offset = 0;
+	rx_buf->rndv_inflight = 0;
+	rx_buf->rndv_err = 0;
+	rx_buf->rndv_remain = MIN(rx_buf->recv_entry->total_len,
+				  rx_buf->pkt.hdr.size);
+	for (i = 0; i < RXM_MAX_STRIPES; i++) {
+		rx_buf->rndv_ctx[i].hdr.state = RXM_RNDV_READ;
+		rx_buf->rndv_ctx[i].rx_buf = rx_buf;
+		rx_buf->rndv_ctx[i].inflight = 0;
+	}
+	dlist_insert_tail(&rx_buf->rndv_read_entry, &rx_buf->conn->rndv_reads);
+
+	/* A failure is reported through the receive, which owns the rx_buf */
+	ret = rxm_rndv_read_chunks(rx_buf);
+	if (ret)
+		rxm_rndv_read_fail(rx_buf, (int) ret);
+	return 0;
+}
+
 static ssize_t rxm_rndv_handle_wr_data(struct rxm_rx_buf *rx_buf)
 {
 	int i;
@@ -576,7 +682,7 @@ static ssize_t rxm_handle_rndv(struct rxm_rx_buf *rx_buf)
 	rxm_replace_rx_buf(rx_buf);
 
 	if (!rx_buf->conn) {
-		assert(rx_buf->ep->srx_ctx);
+		assert(rxm_rx_buf_shared(rx_buf));
 		rx_buf->conn = ofi_idm_at(&rx_buf->ep->conn_idx_map,
 					  (int) rx_buf->pkt.ctrl_hdr.conn_id);
 		if (!rx_buf->conn)
@@ -633,10 +739,11 @@ void rxm_handle_eager(struct rxm_rx_buf *rx_buf)
 					      rx_buf->recv_entry->rxm_iov.count,
 					      &device);
 
-	done_len = ofi_copy_to_hmem_iov(iface, device,
+	OFI_PROBE(rxm_rx_copy,
+		  done_len = ofi_copy_to_hmem_iov(iface, device,
 					rx_buf->recv_entry->rxm_iov.iov,
 					rx_buf->recv_entry->rxm_iov.count, 0,
-					rx_buf->data, rx_buf->pkt.hdr.size);
+					rx_buf->data, rx_buf->pkt.hdr.size));
 	assert((size_t) done_len == rx_buf->pkt.hdr.size);
 
 	rxm_finish_recv(rx_buf, done_len);
@@ -737,8 +844,10 @@ rxm_match_rx_buf(struct rxm_rx_buf *rx_buf,
 	if (recv_queue->dyn_rbuf_unexp_cnt)
 		recv_queue->dyn_rbuf_unexp_cnt--;
 
-	entry = dlist_remove_first_match(&recv_queue->recv_list,
-					 recv_queue->match_recv, match_attr);
+	OFI_PROBE(rxm_rx_match,
+		  entry = dlist_remove_first_match(&recv_queue->recv_list,
+						   recv_queue->match_recv,
+						   match_attr));
 	if (entry) {
 		rx_buf->recv_entry = container_of(entry, struct rxm_recv_entry, entry);
 
@@ -767,7 +876,7 @@ static ssize_t rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 	};
 
 	if (rx_buf->ep->rxm_info->caps & (FI_SOURCE | FI_DIRECTED_RECV)) {
-		if (rx_buf->ep->srx_ctx)
+		if (!rx_buf->conn)
 			rx_buf->conn = ofi_idm_at(&rx_buf->ep->conn_idx_map,
 					(int) rx_buf->pkt.ctrl_hdr.conn_id);
 		if (!rx_buf->conn)
@@ -775,6 +884,9 @@ static ssize_t rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 		match_attr.addr = rx_buf->conn->peer->fi_addr;
 	}
 
+	if (rx_buf->ep->max_conns)
+		rxm_touch_rx_conn(rx_buf);
+
 	if (rx_buf->ep->rxm_info->mode & FI_BUFFERED_RECV) {
 		rxm_finish_buf_recv(rx_buf);
 		return 0;
@@ -1169,7 +1281,7 @@ static ssize_t rxm_handle_atomic_req(struct rxm_ep *rxm_ep,
 	assert(op == ofi_op_atomic || op == ofi_op_atomic_fetch ||
 	       op == ofi_op_atomic_compare);
 
-	if (rx_buf->ep->srx_ctx)
+	if (!rx_buf->conn)
 		rx_buf->conn = ofi_idm_at(&rx_buf->ep->conn_idx_map,
 					  (int) rx_buf->pkt.ctrl_hdr.conn_id);
 	if (!rx_buf->conn)
@@ -1353,8 +1465,10 @@ void rxm_finish_coll_eager_send(struct rxm_ep *rxm_ep,
 
 ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 {
+	struct rxm_rndv_read_ctx *read_ctx;
 	struct rxm_rx_buf *rx_buf;
 	struct rxm_tx_buf *tx_buf;
+	ssize_t ret;
 
 	/* Remote write events may not consume a posted recv so op context
 	 * and hence state would be NULL */
@@ -1371,6 +1485,7 @@ ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 		rxm_free_tx_buf(rxm_ep, tx_buf);
 		return 0;
 	case RXM_CREDIT_TX:
+	case RXM_CLOSE_TX:
 		tx_buf = comp->op_context;
 		assert(comp->flags & FI_SEND);
 		ofi_buf_free(tx_buf);
@@ -1406,6 +1521,8 @@ ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 			return rxm_handle_atomic_resp(rxm_ep, rx_buf);
 		case rxm_ctrl_credit:
 			return rxm_handle_credit(rxm_ep, rx_buf);
+		case rxm_ctrl_close:
+			return rxm_handle_close(rxm_ep, rx_buf);
 		default:
 			FI_WARN(&rxm_prov, FI_LOG_CQ, "Unknown message type\n");
 			assert(0);
@@ -1431,11 +1548,26 @@ ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 		assert(0);
 		return 0;
 	case RXM_RNDV_READ:
-		rx_buf = comp->op_context;
+		read_ctx = comp->op_context;
+		rx_buf = read_ctx->rx_buf;
 		assert(comp->flags & FI_READ);
-		if (++rx_buf->rndv_rma_index < rx_buf->remote_rndv_hdr->count)
+		assert(read_ctx->inflight);
+		read_ctx->inflight--;
+		rx_buf->rndv_inflight--;
+		if (rx_buf->rndv_err) {
+			rxm_rndv_read_fail(rx_buf, rx_buf->rndv_err);
+			return 0;
+		}
+		if (rx_buf->rndv_remain) {
+			ret = rxm_rndv_read_chunks(rx_buf);
+			if (ret)
+				rxm_rndv_read_fail(rx_buf, (int) ret);
+			return 0;
+		}
+		if (rx_buf->rndv_inflight)
 			return 0;
 
+		dlist_remove(&rx_buf->rndv_read_entry);
 		rxm_rndv_send_rd_done(rx_buf);
 		return 0;
 	case RXM_RNDV_WRITE:
@@ -1634,6 +1766,7 @@ ssize_t rxm_get_dyn_rbuf(struct ofi_cq_rbuf_entry *entry, struct iovec *iov,
 	case rxm_ctrl_rndv_wr_done:
 	case rxm_ctrl_rndv_rd_done:
 	case rxm_ctrl_credit:
+	case rxm_ctrl_close:
 		*count = 1;
 		iov[0].iov_base = &rx_buf->pkt.data;
 		iov[0].iov_len = rxm_buffer_size;
@@ -1704,8 +1837,9 @@ void rxm_cq_write_error_all(struct rxm_ep *rxm_ep, int err)
 		rxm_cntr_incerr(rxm_ep->util_ep.rd_cntr);
 }
 
-void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
+void rxm_handle_cq_error(struct rxm_ep *rxm_ep, struct fid_cq *msg_cq)
 {
+	struct rxm_rndv_read_ctx *read_ctx;
 	struct rxm_tx_buf *tx_buf;
 	struct rxm_rx_buf *rx_buf;
 	struct util_cq *cq;
@@ -1713,7 +1847,7 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 	struct fi_cq_err_entry err_entry = {0};
 	ssize_t ret;
 
-	ret = fi_cq_readerr(rxm_ep->msg_cq, &err_entry, 0);
+	ret = fi_cq_readerr(msg_cq, &err_entry, 0);
 	if ((ret) < 0) {
 		FI_WARN(&rxm_prov, FI_LOG_CQ,
 			"unable to fi_cq_readerr on msg cq\n");
@@ -1725,7 +1859,7 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 		FI_WARN(&rxm_prov, FI_LOG_CQ,
 			"fi_cq_readerr: err: %s (%d), prov_err: %s (%d)\n",
 			fi_strerror(err_entry.err), err_entry.err,
-			fi_cq_strerror(rxm_ep->msg_cq, err_entry.prov_errno,
+			fi_cq_strerror(msg_cq, err_entry.prov_errno,
 					err_entry.err_data, NULL, 0),
 			err_entry.prov_errno);
 	}
@@ -1757,6 +1891,7 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 			rxm_cntr_incerr(cntr);
 		return;
 	case RXM_CREDIT_TX:
+	case RXM_CLOSE_TX:
 	case RXM_ATOMIC_RESP_SENT: /* BUG: should have consumed tx credit */
 		tx_buf = err_entry.op_context;
 		ofi_buf_free(tx_buf);
@@ -1784,6 +1919,14 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 		err_entry.flags = ofi_tx_cq_flags(tx_buf->pkt.hdr.op);
 		break;
 
+	case RXM_RNDV_READ:
+		read_ctx = err_entry.op_context;
+		assert(read_ctx->inflight);
+		read_ctx->inflight--;
+		read_ctx->rx_buf->rndv_inflight--;
+		rxm_rndv_read_fail(read_ctx->rx_buf, -err_entry.err);
+		return;
+
 	/* Incoming application data error */
 	case RXM_RX:
 		/* Silently drop MSG CQ error entries for internal receive
@@ -1800,7 +1943,6 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 		/* fall through */
 	case RXM_RNDV_READ_DONE_SENT:
 	case RXM_RNDV_WRITE_DATA_SENT: /* BUG: should fail initial send */
-	case RXM_RNDV_READ:
 		rx_buf = (struct rxm_rx_buf *) err_entry.op_context;
 		assert(rx_buf->recv_entry);
 		err_entry.op_context = rx_buf->recv_entry->context;
@@ -1811,7 +1953,7 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 		break;
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "Invalid state!\nmsg cq error info: %s\n",
-			fi_cq_strerror(rxm_ep->msg_cq, err_entry.prov_errno,
+			fi_cq_strerror(msg_cq, err_entry.prov_errno,
 				       err_entry.err_data, NULL, 0));
 		rxm_cq_write_error_all(rxm_ep, -FI_EOPBADSTATE);
 		return;
@@ -1828,6 +1970,11 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 	}
 }
 
+void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
+{
+	rxm_handle_cq_error(rxm_ep, rxm_ep->msg_cq);
+}
+
 ssize_t rxm_thru_comp(struct rxm_ep *ep, struct fi_cq_data_entry *comp)
 {
 	struct util_cq *cq;
@@ -1875,7 +2022,7 @@ int rxm_post_recv(struct rxm_rx_buf *rx_buf)
 	struct rxm_domain *domain;
 	int ret;
 
-	if (rx_buf->ep->srx_ctx)
+	if (rxm_rx_buf_shared(rx_buf))
 		rx_buf->conn = NULL;
 	rx_buf->hdr.state = RXM_RX;
 	rx_buf->recv_entry = NULL;
@@ -1883,7 +2030,9 @@ int rxm_post_recv(struct rxm_rx_buf *rx_buf)
 	domain = container_of(rx_buf->ep->util_ep.domain,
 			      struct rxm_domain, util_domain);
 	ret = (int) fi_recv(rx_buf->rx_ep, &rx_buf->pkt,
-			    domain->rx_post_size, rx_buf->hdr.desc,
+			    domain->rx_post_size,
+			    rx_buf->rx_ep == rx_buf->ep->shm_ep ?
+			    NULL : rx_buf->hdr.desc,
 			    FI_ADDR_UNSPEC, rx_buf);
 	if (!ret)
 		return 0;
@@ -1895,13 +2044,13 @@ int rxm_post_recv(struct rxm_rx_buf *rx_buf)
 	return ret;
 }
 
-int rxm_prepost_recv(struct rxm_ep *ep, struct fid_ep *rx_ep)
+int rxm_prepost_recv(struct rxm_ep *ep, struct fid_ep *rx_ep, size_t count)
 {
 	struct rxm_rx_buf *rx_buf;
 	int ret;
 	size_t i;
 
-	for (i = 0; i < ep->msg_info->rx_attr->size; i++) {
+	for (i = 0; i < count; i++) {
 		rx_buf = rxm_rx_buf_alloc(ep, rx_ep);
 		if (!rx_buf)
 			return -FI_ENOMEM;
@@ -1925,8 +2074,12 @@ void rxm_ep_do_progress(struct util_ep *util_ep)
 	uint64_t timestamp;
 	ssize_t ret, i, err;
 
+	if (rxm_ep->shm_ep)
+		rxm_shm_progress(rxm_ep);
+
 	do {
-		ret = fi_cq_read(rxm_ep->msg_cq, &comp, 32);
+		OFI_PROBE(rxm_msg_cq_read,
+			  ret = fi_cq_read(rxm_ep->msg_cq, &comp, 32));
 		if (ret > 0) {
 			comp_read += ret;
 			for (i = 0; i < ret; i++) {
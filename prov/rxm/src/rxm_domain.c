@@ -278,6 +278,7 @@ static int rxm_domain_close(fid_t fid)
 
 	ofi_mutex_destroy(&rxm_domain->amo_bufpool_lock);
 	ofi_bufpool_destroy(rxm_domain->amo_bufpool);
+	rxm_shm_domain_close(rxm_domain);
 
 	ret = fi_close(&rxm_domain->msg_domain->fid);
 	if (ret)
@@ -296,7 +297,7 @@ static struct fi_ops rxm_domain_fi_ops = {
 	.close = rxm_domain_close,
 	.bind = fi_no_bind,
 	.control = fi_no_control,
-	.ops_open = fi_no_ops_open,
+	.ops_open = ofi_domain_ops_open,
 };
 
 static int rxm_mr_close(fid_t fid)
@@ -309,6 +310,9 @@ static int rxm_mr_close(fid_t fid)
 	if (rxm_mr->domain->util_domain.info_domain_caps & FI_ATOMIC)
 		rxm_mr_remove_map_entry(rxm_mr);
 
+	if (rxm_mr->shm_mr)
+		fi_close(&rxm_mr->shm_mr->fid);
+
 	ret = fi_close(&rxm_mr->msg_mr->fid);
 	if (ret)
 		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to close MSG MR\n");
@@ -409,6 +413,24 @@ static void rxm_mr_init(struct rxm_mr *rxm_mr, struct rxm_domain *domain,
 	ofi_atomic_inc32(&domain->util_domain.ref);
 }
 
+/* Local peers access the region through shm with the same key */
+static int rxm_mr_reg_shm(struct rxm_domain *domain, struct rxm_mr *rxm_mr,
+			  struct fi_mr_attr *attr)
+{
+	int ret;
+
+	if (!domain->shm_domain)
+		return 0;
+
+	attr->requested_key = fi_mr_key(rxm_mr->msg_mr);
+	ret = fi_mr_regattr(domain->shm_domain, attr, 0, &rxm_mr->shm_mr);
+	if (ret) {
+		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to register shm MR\n");
+		fi_close(&rxm_mr->msg_mr->fid);
+	}
+	return ret;
+}
+
 static int rxm_mr_regattr(struct fid *fid, const struct fi_mr_attr *attr,
 			  uint64_t flags, struct fid_mr **mr)
 {
@@ -445,6 +467,11 @@ static int rxm_mr_regattr(struct fid *fid, const struct fi_mr_attr *attr,
 		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to register MSG MR\n");
 		goto err;
 	}
+
+	ret = rxm_mr_reg_shm(rxm_domain, rxm_mr, &msg_attr);
+	if (ret)
+		goto err;
+
 	rxm_mr_init(rxm_mr, rxm_domain, attr->context);
 	ofi_mutex_init(&rxm_mr->amo_lock);
 	rxm_mr->iface = msg_attr.iface;
@@ -500,6 +527,11 @@ static int rxm_mr_regv(struct fid *fid, const struct iovec *iov, size_t count,
 		FI_WARN(&rxm_prov, FI_LOG_DOMAIN, "Unable to register MSG MR\n");
 		goto err;
 	}
+
+	ret = rxm_mr_reg_shm(rxm_domain, rxm_mr, &msg_attr);
+	if (ret)
+		goto err;
+
 	rxm_mr_init(rxm_mr, rxm_domain, context);
 	*mr = &rxm_mr->mr_fid;
 
@@ -696,10 +728,12 @@ static void rxm_config_dyn_rbuf(struct rxm_domain *domain, struct fi_info *info,
 	 * messages, collective support is mostly for development purposes.
 	 * So, fallback to bounce buffers when enabled.
 	 * We also can't pass through HMEM buffers, unless the lower layer
-	 * can handle them.
+	 * can handle them.  Local peers that use shm only exchange rxm
+	 * packets, which dynamic receive buffers do not handle.
 	 */
 	if (domain->passthru || (info->caps & FI_COLLECTIVE) ||
-	    ((info->caps & FI_HMEM) && !(msg_info->caps & FI_HMEM)))
+	    ((info->caps & FI_HMEM) && !(msg_info->caps & FI_HMEM)) ||
+	    domain->shm_domain)
 		return;
 
 	fi_param_get_bool(&rxm_prov, "enable_dyn_rbuf", &ret);
@@ -777,6 +811,7 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 	if (ret)
 		goto err4;
 
+	rxm_shm_domain_open(rxm_domain, info, msg_info);
 	rxm_config_dyn_rbuf(rxm_domain, info, msg_info);
 
 	fi_freeinfo(msg_info);
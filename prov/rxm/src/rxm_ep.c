@@ -480,6 +480,10 @@ static int rxm_ep_getopt(fid_t fid, int level, int optname, void *optval,
 		*(size_t *)optval = rxm_ep->buffered_limit;
 		*optlen = sizeof(size_t);
 		break;
+	case FI_OPT_RXM_CONNECT_WINDOW:
+		*(size_t *)optval = rxm_ep->connect_window;
+		*optlen = sizeof(size_t);
+		break;
 	default:
 		return -FI_ENOPROTOOPT;
 	}
@@ -540,6 +544,18 @@ static int rxm_ep_setopt(fid_t fid, int level, int optname,
 				rxm_ep->buffered_limit);
 		}
 		break;
+	case FI_OPT_RXM_CONNECT_WINDOW:
+		if (!*(size_t *)optval) {
+			ret = -FI_EINVAL;
+			break;
+		}
+		ofi_ep_lock_acquire(&rxm_ep->util_ep);
+		rxm_ep->connect_window = *(size_t *)optval;
+		ofi_ep_lock_release(&rxm_ep->util_ep);
+		FI_INFO(&rxm_prov, FI_LOG_CORE,
+			"FI_OPT_RXM_CONNECT_WINDOW set to %zu\n",
+			rxm_ep->connect_window);
+		break;
 	default:
 		ret = -FI_ENOPROTOOPT;
 	}
@@ -650,7 +666,7 @@ rxm_multi_recv_entry_get(struct rxm_ep *rxm_ep, const struct iovec *iov,
 	return recv_entry;
 }
 
-struct rxm_tx_buf *rxm_get_tx_buf(struct rxm_ep *ep)
+struct rxm_tx_buf *rxm_get_tx_buf(struct rxm_ep *ep, struct rxm_conn *conn)
 {
 	struct rxm_tx_buf *buf;
 
@@ -662,6 +678,8 @@ struct rxm_tx_buf *rxm_get_tx_buf(struct rxm_ep *ep)
 	if (buf) {
 		OFI_DBG_SET(buf->user_tx, true);
 		ep->tx_credit--;
+		buf->conn = conn;
+		conn->tx_cnt++;
 	}
 	return buf;
 }
@@ -672,6 +690,8 @@ void rxm_free_tx_buf(struct rxm_ep *ep, struct rxm_tx_buf *buf)
 	assert(buf->user_tx);
 	OFI_DBG_SET(buf->user_tx, false);
 	ep->tx_credit++;
+	assert(buf->conn->tx_cnt);
+	buf->conn->tx_cnt--;
 	ofi_buf_free(buf);
 }
 
@@ -802,6 +822,7 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 				    struct rxm_conn *rxm_conn)
 {
 	struct rxm_deferred_tx_entry *def_tx_entry;
+	struct rxm_rx_buf *rx_buf;
 	struct iovec iov;
 	struct fi_msg msg;
 	ssize_t ret = 0;
@@ -858,6 +879,7 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 					 RXM_RNDV_WRITE_DONE_SENT);
 			break;
 		case RXM_DEFERRED_TX_RNDV_READ:
+			rx_buf = def_tx_entry->rndv_read.rx_buf;
 			ret = rxm_ep->rndv_ops->xfer(
 				def_tx_entry->rxm_conn->msg_ep,
 				def_tx_entry->rndv_read.rxm_iov.iov,
@@ -865,14 +887,13 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 				def_tx_entry->rndv_read.rxm_iov.count, 0,
 				def_tx_entry->rndv_read.rma_iov.addr,
 				def_tx_entry->rndv_read.rma_iov.key,
-				def_tx_entry->rndv_read.rx_buf);
+				&rx_buf->rndv_ctx[0]);
 			if (ret) {
 				if (ret == -FI_EAGAIN)
 					return;
-				rxm_cq_write_error(def_tx_entry->rxm_ep->util_ep.rx_cq,
-						   def_tx_entry->rxm_ep->util_ep.rx_cntr,
-						   def_tx_entry->rndv_read.rx_buf->
-							recv_entry->context, (int) ret);
+				rx_buf->rndv_ctx[0].inflight--;
+				rx_buf->rndv_inflight--;
+				rxm_rndv_read_fail(rx_buf, (int) ret);
 			}
 			break;
 		case RXM_DEFERRED_TX_RNDV_WRITE:
@@ -929,6 +950,18 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 				return;
 			}
 			break;
+		case RXM_DEFERRED_TX_CLOSE_SEND:
+			ret = fi_send(def_tx_entry->rxm_conn->msg_ep,
+				      &def_tx_entry->close_msg.tx_buf->pkt,
+				      sizeof(def_tx_entry->close_msg.tx_buf->pkt),
+				      def_tx_entry->close_msg.tx_buf->hdr.desc,
+				      0, def_tx_entry->close_msg.tx_buf);
+			if (ret) {
+				if (ret == -FI_EAGAIN)
+					return;
+				ofi_buf_free(def_tx_entry->close_msg.tx_buf);
+			}
+			break;
 		}
 
 		rxm_dequeue_deferred_tx(def_tx_entry);
@@ -1007,6 +1040,7 @@ static int rxm_ep_close(struct fid *fid)
 	if (ret)
 		return ret;
 
+	rxm_shm_ep_close(ep);
 	rxm_ep_txrx_res_close(ep);
 	if (ep->srx_ctx) {
 		ret = fi_close(&ep->srx_ctx->fid);
@@ -1322,10 +1356,14 @@ static int rxm_ep_enable_check(struct rxm_ep *rxm_ep)
 
 static int rxm_ep_ctrl(struct fid *fid, int command, void *arg)
 {
+	struct fi_rxm_prewarm *prewarm;
+	struct rxm_domain *domain;
 	struct rxm_ep *ep;
 	int ret;
 
 	ep = container_of(fid, struct rxm_ep, util_ep.ep_fid.fid);
+	domain = container_of(ep->util_ep.domain, struct rxm_domain,
+			      util_domain);
 
 	switch (command) {
 	case FI_ENABLE:
@@ -1359,7 +1397,8 @@ static int rxm_ep_ctrl(struct fid *fid, int command, void *arg)
 			return ret;
 
 		if (ep->srx_ctx && !rxm_passthru_info(ep->rxm_info)) {
-			ret = rxm_prepost_recv(ep, ep->srx_ctx);
+			ret = rxm_prepost_recv(ep, ep->srx_ctx,
+					       ep->msg_info->rx_attr->size);
 			if (ret)
 				goto err;
 		}
@@ -1368,7 +1407,26 @@ static int rxm_ep_ctrl(struct fid *fid, int command, void *arg)
 		if (ret)
 			goto err;
 
+		/* The shm ep has no fd to wait on, so it is only used when
+		 * the app polls for completions.
+		 */
+		if (domain->shm_domain && !rxm_msg_cq_fd_needed(ep)) {
+			ofi_ep_lock_acquire(&ep->util_ep);
+			ret = rxm_shm_ep_open(ep);
+			ofi_ep_lock_release(&ep->util_ep);
+			if (ret)
+				RXM_WARN_ERR(FI_LOG_EP_CTRL, "rxm_shm_ep_open",
+					     ret);
+		}
 		break;
+	case FI_RXM_PREWARM:
+		if (rxm_passthru_info(ep->rxm_info))
+			return -FI_ENOSYS;
+		if (!ep->msg_cq)
+			return -FI_EOPBADSTATE;
+
+		prewarm = arg;
+		return rxm_prewarm_conns(ep, prewarm->addr, prewarm->count);
 	default:
 		return -FI_ENOSYS;
 	}
@@ -1481,7 +1539,8 @@ rxm_prepare_deferred_rndv_read(struct rxm_deferred_tx_entry **def_tx_entry,
 
 	(*def_tx_entry)->rndv_read.rx_buf = rx_buf;
 	(*def_tx_entry)->rndv_read.rma_iov.addr =
-			rx_buf->remote_rndv_hdr->iov[index].addr;
+			rx_buf->remote_rndv_hdr->iov[index].addr +
+			rx_buf->rndv_rma_offset;
 	(*def_tx_entry)->rndv_read.rma_iov.key =
 			rx_buf->remote_rndv_hdr->iov[index].key;
 
@@ -1625,6 +1684,19 @@ int rxm_endpoint(struct fid_domain *domain, struct fi_info *info,
 		(*ep_fid)->atomic = &rxm_ops_atomic;
 
 	dlist_init(&rxm_ep->loopback_list);
+	dlist_init(&rxm_ep->prewarm_queue);
+	rxm_ep->connect_window = rxm_connect_window;
+	dlist_init(&rxm_ep->lru_list);
+	rxm_ep->max_conns = rxm_max_conns;
+	rxm_ep->stripes = rxm_stripes;
+	/* Striping needs reads to be split to have any effect */
+	if (rxm_rndv_chunk_size)
+		rxm_ep->rndv_chunk_size = rxm_rndv_chunk_size;
+	else if (rxm_ep->stripes > 1)
+		rxm_ep->rndv_chunk_size = RXM_STRIPE_CHUNK_SIZE;
+	else
+		rxm_ep->rndv_chunk_size = SIZE_MAX;
+	rxm_ep->rndv_chunks = MAX(rxm_rndv_chunks, rxm_ep->stripes);
 
 	return 0;
 err2:
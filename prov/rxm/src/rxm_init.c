@@ -59,6 +59,12 @@ size_t rxm_packet_size;
 int rxm_passthru = 0; /* disable by default, need to analyze performance */
 int force_auto_progress;
 int rxm_use_write_rndv;
+int rxm_use_shm;
+size_t rxm_connect_window = 64;
+size_t rxm_max_conns;
+size_t rxm_rndv_chunk_size;
+size_t rxm_rndv_chunks = RXM_IOV_LIMIT;
+size_t rxm_stripes = 1;
 enum fi_wait_obj def_wait_obj = FI_WAIT_FD, def_tcp_wait_obj = FI_WAIT_UNSPEC;
 
 char *rxm_proto_state_str[] = {
@@ -700,6 +706,44 @@ RXM_INI
 			"RMA writes rather than RMA reads during Rendezvous "
 			"transactions. (default: false/no).");
 
+	fi_param_define(&rxm_prov, "use_shm", FI_PARAM_BOOL,
+			"Exchange messages and RMA with peers on the same node "
+			"through the shm provider instead of the msg provider.  "
+			"Connections are still established through the msg "
+			"provider.  Only used by endpoints that are not bound "
+			"to wait objects.  (default: false/no)");
+
+	fi_param_define(&rxm_prov, "connect_window", FI_PARAM_SIZE_T,
+			"Maximum number of connections started by a prewarm "
+			"request (fi_rxm_prewarm) that may be in progress at "
+			"once.  The remaining connections are started as "
+			"earlier ones complete.  (default: %zu)",
+			rxm_connect_window);
+
+	fi_param_define(&rxm_prov, "max_conns", FI_PARAM_SIZE_T,
+			"Number of connections an endpoint keeps open before "
+			"it starts closing the least recently used idle ones.  "
+			"Closed connections are re-established on their next "
+			"use.  The limit is exceeded while no connection is "
+			"idle.  All peers must support closing connections.  "
+			"(default: 0, unlimited)");
+
+	fi_param_define(&rxm_prov, "rndv_chunk_size", FI_PARAM_SIZE_T,
+			"Largest RMA read issued by the receiver of a "
+			"rendezvous message.  Larger transfers are split into "
+			"chunks of this size.  (default: 0, one read per "
+			"sender buffer)");
+
+	fi_param_define(&rxm_prov, "rndv_chunks", FI_PARAM_SIZE_T,
+			"Maximum number of rendezvous read chunks outstanding "
+			"per message.  (default: %zu)", rxm_rndv_chunks);
+
+	fi_param_define(&rxm_prov, "stripes", FI_PARAM_SIZE_T,
+			"Number of msg endpoints opened to each peer, at most "
+			"%d.  Rendezvous reads are spread over all of them, "
+			"while other transfers use the first one.  "
+			"(default: 1)", RXM_MAX_STRIPES);
+
 	fi_param_define(&rxm_prov, "enable_dyn_rbuf", FI_PARAM_BOOL,
 			"Enable support for dynamic receive buffering, if "
 			"available by the message endpoint provider. "
@@ -740,6 +784,17 @@ RXM_INI
 		rxm_cq_eq_fairness = 128;
 	fi_param_get_bool(&rxm_prov, "data_auto_progress", &force_auto_progress);
 	fi_param_get_bool(&rxm_prov, "use_rndv_write", &rxm_use_write_rndv);
+	fi_param_get_bool(&rxm_prov, "use_shm", &rxm_use_shm);
+	fi_param_get_size_t(&rxm_prov, "connect_window", &rxm_connect_window);
+	if (!rxm_connect_window)
+		rxm_connect_window = 1;
+	fi_param_get_size_t(&rxm_prov, "max_conns", &rxm_max_conns);
+	fi_param_get_size_t(&rxm_prov, "rndv_chunk_size", &rxm_rndv_chunk_size);
+	fi_param_get_size_t(&rxm_prov, "rndv_chunks", &rxm_rndv_chunks);
+	if (!rxm_rndv_chunks)
+		rxm_rndv_chunks = 1;
+	fi_param_get_size_t(&rxm_prov, "stripes", &rxm_stripes);
+	rxm_stripes = MIN(MAX(rxm_stripes, 1), RXM_MAX_STRIPES);
 
 	rxm_get_def_wait();
 
@@ -290,7 +290,7 @@ rxm_alloc_rndv_buf(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 	size_t len, i;
 	ssize_t ret;
 
-	*rndv_buf = rxm_get_tx_buf(rxm_ep);
+	*rndv_buf = rxm_get_tx_buf(rxm_ep, rxm_conn);
 	if (!*rndv_buf)
 		return -FI_EAGAIN;
 
@@ -395,7 +395,7 @@ rxm_init_segment(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 {
 	struct rxm_tx_buf *tx_buf;
 
-	tx_buf = rxm_get_tx_buf(rxm_ep);
+	tx_buf = rxm_get_tx_buf(rxm_ep, rxm_conn);
 	if (!tx_buf)
 		return NULL;
 
@@ -482,6 +482,7 @@ rxm_send_sar(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 	if (!first_tx_buf)
 		return -FI_EAGAIN;
 
+	first_tx_buf->sar_pending = segs_cnt;
 	ret = ofi_copy_from_hmem_iov(first_tx_buf->pkt.data, rxm_buffer_size,
 				     iface, device, iov, count, iov_offset);
 	assert((size_t) ret == rxm_buffer_size);
@@ -556,7 +557,7 @@ rxm_emulate_inject(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 	struct rxm_tx_buf *tx_buf;
 	ssize_t ret;
 
-	tx_buf = rxm_get_tx_buf(rxm_ep);
+	tx_buf = rxm_get_tx_buf(rxm_ep, rxm_conn);
 	if (!tx_buf)
 		return -FI_EAGAIN;
 
@@ -737,7 +738,7 @@ rxm_send_eager(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 	uint64_t device;
 	ssize_t ret;
 
-	eager_buf = rxm_get_tx_buf(rxm_ep);
+	eager_buf = rxm_get_tx_buf(rxm_ep, rxm_conn);
 	if (!eager_buf)
 		return -FI_EAGAIN;
 
@@ -799,11 +800,16 @@ rxm_send_common(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 		(data_len > rxm_ep->rxm_info->tx_attr->inject_size)) ||
 	       (data_len <= rxm_ep->rxm_info->tx_attr->inject_size));
 
+	OFI_PROBE_START(rxm_send);
 	if (data_len <= rxm_ep->eager_limit) {
 		ret = rxm_send_eager(rxm_ep, rxm_conn, iov, desc, count,
 				     context, data, flags, tag, op,
 				     data_len, total_len);
-	} else if (data_len <= rxm_ep->sar_limit) {
+	} else if (data_len <= rxm_ep->sar_limit ||
+		   (rxm_conn->flags & RXM_CONN_SHM)) {
+		/* Rendezvous buffers are only registered with the msg
+		 * provider, so shm peers segment all large messages.
+		 */
 		ret = rxm_send_sar(rxm_ep, rxm_conn, iov, desc, (uint8_t) count,
 				   context, data, flags, tag, op, data_len,
 				   rxm_ep_sar_calc_segs_cnt(rxm_ep, data_len));
@@ -817,6 +823,7 @@ rxm_send_common(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 		if (ret >= 0)
 			ret = rxm_send_rndv(rxm_ep, rxm_conn, rndv_buf, ret);
 	}
+	OFI_PROBE_END(rxm_send);
 
 	return ret;
 }
@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <fasthash.h>
+#include "rxm.h"
+
+/* Peers on the same node exchange rxm packets through an shm endpoint
+ * owned by the rxm endpoint.  Connections are still set up through the
+ * msg provider, whose CM data tells both sides that they share a node.
+ * Once connected, the connection's msg_ep is replaced by an endpoint that
+ * forwards sends and RMA operations to the shm endpoint, so the rxm
+ * protocol, including message matching, runs unchanged on top of it.
+ */
+#define RXM_SHM_NAME_MAX 64
+
+struct rxm_shm_conn_ep {
+	struct fid_ep ep_fid;
+	struct fid_ep *shm_ep;
+	fi_addr_t addr;
+};
+
+static void rxm_shm_name(char *name, uint32_t pid, uint16_t port)
+{
+	snprintf(name, RXM_SHM_NAME_MAX, "fi_rxm_%u_%u", pid, port);
+}
+
+static ssize_t
+rxm_shm_send(struct fid_ep *ep_fid, const void *buf, size_t len, void *desc,
+	     fi_addr_t dest_addr, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_send(ep->shm_ep, buf, len, NULL, ep->addr, context);
+}
+
+static ssize_t
+rxm_shm_sendv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+	      size_t count, fi_addr_t dest_addr, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_sendv(ep->shm_ep, iov, NULL, count, ep->addr, context);
+}
+
+static ssize_t
+rxm_shm_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+		uint64_t flags)
+{
+	struct rxm_shm_conn_ep *ep;
+	struct fi_msg shm_msg = *msg;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	shm_msg.desc = NULL;
+	shm_msg.addr = ep->addr;
+	return fi_sendmsg(ep->shm_ep, &shm_msg, flags);
+}
+
+static ssize_t
+rxm_shm_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
+	       fi_addr_t dest_addr)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_inject(ep->shm_ep, buf, len, ep->addr);
+}
+
+static ssize_t
+rxm_shm_senddata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		 void *desc, uint64_t data, fi_addr_t dest_addr, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_senddata(ep->shm_ep, buf, len, NULL, data, ep->addr,
+			   context);
+}
+
+static ssize_t
+rxm_shm_injectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		   uint64_t data, fi_addr_t dest_addr)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_injectdata(ep->shm_ep, buf, len, data, ep->addr);
+}
+
+static struct fi_ops_msg rxm_shm_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = fi_no_msg_recv,
+	.recvv = fi_no_msg_recvv,
+	.recvmsg = fi_no_msg_recvmsg,
+	.send = rxm_shm_send,
+	.sendv = rxm_shm_sendv,
+	.sendmsg = rxm_shm_sendmsg,
+	.inject = rxm_shm_inject,
+	.senddata = rxm_shm_senddata,
+	.injectdata = rxm_shm_injectdata,
+};
+
+static ssize_t
+rxm_shm_read(struct fid_ep *ep_fid, void *buf, size_t len, void *desc,
+	     fi_addr_t src_addr, uint64_t addr, uint64_t key, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_read(ep->shm_ep, buf, len, NULL, ep->addr, addr, key,
+		       context);
+}
+
+static ssize_t
+rxm_shm_readv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+	      size_t count, fi_addr_t src_addr, uint64_t addr, uint64_t key,
+	      void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_readv(ep->shm_ep, iov, NULL, count, ep->addr, addr, key,
+			context);
+}
+
+static ssize_t
+rxm_shm_readmsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
+		uint64_t flags)
+{
+	struct rxm_shm_conn_ep *ep;
+	struct fi_msg_rma shm_msg = *msg;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	shm_msg.desc = NULL;
+	shm_msg.addr = ep->addr;
+	return fi_readmsg(ep->shm_ep, &shm_msg, flags);
+}
+
+static ssize_t
+rxm_shm_write(struct fid_ep *ep_fid, const void *buf, size_t len, void *desc,
+	      fi_addr_t dest_addr, uint64_t addr, uint64_t key, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_write(ep->shm_ep, buf, len, NULL, ep->addr, addr, key,
+			context);
+}
+
+static ssize_t
+rxm_shm_writev(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
+	       size_t count, fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+	       void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_writev(ep->shm_ep, iov, NULL, count, ep->addr, addr, key,
+			 context);
+}
+
+static ssize_t
+rxm_shm_writemsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
+		 uint64_t flags)
+{
+	struct rxm_shm_conn_ep *ep;
+	struct fi_msg_rma shm_msg = *msg;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	shm_msg.desc = NULL;
+	shm_msg.addr = ep->addr;
+	return fi_writemsg(ep->shm_ep, &shm_msg, flags);
+}
+
+static ssize_t
+rxm_shm_rma_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
+		   fi_addr_t dest_addr, uint64_t addr, uint64_t key)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_inject_write(ep->shm_ep, buf, len, ep->addr, addr, key);
+}
+
+static ssize_t
+rxm_shm_writedata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		  void *desc, uint64_t data, fi_addr_t dest_addr,
+		  uint64_t addr, uint64_t key, void *context)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_writedata(ep->shm_ep, buf, len, NULL, data, ep->addr,
+			    addr, key, context);
+}
+
+static ssize_t
+rxm_shm_rma_injectdata(struct fid_ep *ep_fid, const void *buf, size_t len,
+		       uint64_t data, fi_addr_t dest_addr, uint64_t addr,
+		       uint64_t key)
+{
+	struct rxm_shm_conn_ep *ep;
+
+	ep = container_of(ep_fid, struct rxm_shm_conn_ep, ep_fid);
+	return fi_inject_writedata(ep->shm_ep, buf, len, data, ep->addr,
+				   addr, key);
+}
+
+static struct fi_ops_rma rxm_shm_rma_ops = {
+	.size = sizeof(struct fi_ops_rma),
+	.read = rxm_shm_read,
+	.readv = rxm_shm_readv,
+	.readmsg = rxm_shm_readmsg,
+	.write = rxm_shm_write,
+	.writev = rxm_shm_writev,
+	.writemsg = rxm_shm_writemsg,
+	.inject = rxm_shm_rma_inject,
+	.writedata = rxm_shm_writedata,
+	.injectdata = rxm_shm_rma_injectdata,
+};
+
+static struct fi_ops_tagged rxm_shm_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = fi_no_tagged_recv,
+	.recvv = fi_no_tagged_recvv,
+	.recvmsg = fi_no_tagged_recvmsg,
+	.send = fi_no_tagged_send,
+	.sendv = fi_no_tagged_sendv,
+	.sendmsg = fi_no_tagged_sendmsg,
+	.inject = fi_no_tagged_inject,
+	.senddata = fi_no_tagged_senddata,
+	.injectdata = fi_no_tagged_injectdata,
+};
+
+static struct fi_ops_ep rxm_shm_ep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = fi_no_cancel,
+	.getopt = fi_no_getopt,
+	.setopt = fi_no_setopt,
+	.tx_ctx = fi_no_tx_ctx,
+	.rx_ctx = fi_no_rx_ctx,
+	.rx_size_left = fi_no_rx_size_left,
+	.tx_size_left = fi_no_tx_size_left,
+};
+
+static int rxm_shm_conn_ep_close(struct fid *fid)
+{
+	free(container_of(fid, struct rxm_shm_conn_ep, ep_fid.fid));
+	return 0;
+}
+
+static struct fi_ops rxm_shm_conn_ep_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = rxm_shm_conn_ep_close,
+	.bind = fi_no_bind,
+	.control = fi_no_control,
+	.ops_open = fi_no_ops_open,
+};
+
+/* The peer's shm endpoint must be visible to us, which is not the case
+ * for processes with the same host name but separate /dev/shm mounts.
+ */
+static bool rxm_shm_peer_visible(const char *name)
+{
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+int rxm_shm_conn_open(struct rxm_conn *conn)
+{
+	struct rxm_shm_conn_ep *shm_conn;
+	char name[RXM_SHM_NAME_MAX];
+	fi_addr_t addr;
+	int ret;
+
+	assert(ofi_ep_lock_held(&conn->ep->util_ep));
+	rxm_shm_name(name, conn->remote_pid,
+		     ofi_addr_get_port(&conn->peer->addr.sa));
+	if (!rxm_shm_peer_visible(name))
+		return -FI_ENOENT;
+
+	ret = fi_av_insert(conn->ep->shm_av, name, 1, &addr, 0, NULL);
+	if (ret != 1)
+		return ret < 0 ? ret : -FI_EADDRNOTAVAIL;
+
+	shm_conn = calloc(1, sizeof(*shm_conn));
+	if (!shm_conn)
+		return -FI_ENOMEM;
+
+	shm_conn->ep_fid.fid.fclass = FI_CLASS_EP;
+	shm_conn->ep_fid.fid.context = conn;
+	shm_conn->ep_fid.fid.ops = &rxm_shm_conn_ep_fi_ops;
+	shm_conn->ep_fid.ops = &rxm_shm_ep_ops;
+	shm_conn->ep_fid.msg = &rxm_shm_msg_ops;
+	shm_conn->ep_fid.rma = &rxm_shm_rma_ops;
+	shm_conn->ep_fid.tagged = &rxm_shm_tagged_ops;
+	shm_conn->shm_ep = conn->ep->shm_ep;
+	shm_conn->addr = addr;
+
+	conn->core_ep = conn->msg_ep;
+	conn->msg_ep = &shm_conn->ep_fid;
+	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "conn %p uses shm peer %s\n",
+		conn, name);
+	return 0;
+}
+
+int rxm_shm_ep_open(struct rxm_ep *ep)
+{
+	struct rxm_domain *domain;
+	struct fi_cq_attr cq_attr = {
+		.format = FI_CQ_FORMAT_DATA,
+		.wait_obj = FI_WAIT_NONE,
+	};
+	struct fi_av_attr av_attr = {
+		.type = FI_AV_TABLE,
+	};
+	struct fi_info *info;
+	char name[RXM_SHM_NAME_MAX];
+	int ret;
+
+	domain = container_of(ep->util_ep.domain, struct rxm_domain,
+			      util_domain);
+	assert(domain->shm_domain);
+
+	info = fi_dupinfo(domain->shm_info);
+	if (!info)
+		return -FI_ENOMEM;
+
+	rxm_shm_name(name, (uint32_t) getpid(),
+		     ofi_addr_get_port(&ep->addr.sa));
+	free(info->src_addr);
+	info->src_addr = strdup(name);
+	if (!info->src_addr) {
+		ret = -FI_ENOMEM;
+		goto free;
+	}
+	info->src_addrlen = strlen(name) + 1;
+
+	ret = fi_endpoint(domain->shm_domain, info, &ep->shm_ep, NULL);
+	if (ret)
+		goto free;
+
+	cq_attr.size = info->rx_attr->size + info->tx_attr->size;
+	ret = fi_cq_open(domain->shm_domain, &cq_attr, &ep->shm_cq, NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_av_open(domain->shm_domain, &av_attr, &ep->shm_av, NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_ep_bind(ep->shm_ep, &ep->shm_cq->fid, FI_TRANSMIT | FI_RECV);
+	if (ret)
+		goto err;
+
+	ret = fi_ep_bind(ep->shm_ep, &ep->shm_av->fid, 0);
+	if (ret)
+		goto err;
+
+	ret = fi_enable(ep->shm_ep);
+	if (ret)
+		goto err;
+
+	ret = rxm_prepost_recv(ep, ep->shm_ep, info->rx_attr->size);
+	if (ret)
+		goto err;
+
+	fi_freeinfo(info);
+	return 0;
+
+err:
+	rxm_shm_ep_close(ep);
+free:
+	fi_freeinfo(info);
+	return ret;
+}
+
+void rxm_shm_ep_close(struct rxm_ep *ep)
+{
+	if (ep->shm_ep) {
+		fi_close(&ep->shm_ep->fid);
+		ep->shm_ep = NULL;
+	}
+	if (ep->shm_av) {
+		fi_close(&ep->shm_av->fid);
+		ep->shm_av = NULL;
+	}
+	if (ep->shm_cq) {
+		fi_close(&ep->shm_cq->fid);
+		ep->shm_cq = NULL;
+	}
+}
+
+void rxm_shm_progress(struct rxm_ep *ep)
+{
+	struct fi_cq_data_entry comp[32];
+	size_t comp_read = 0;
+	ssize_t ret, i, err;
+
+	do {
+		ret = fi_cq_read(ep->shm_cq, &comp, 32);
+		if (ret > 0) {
+			comp_read += ret;
+			for (i = 0; i < ret; i++) {
+				err = ep->handle_comp(ep, &comp[i]);
+				if (err)
+					rxm_cq_write_error_all(ep, (int) err);
+			}
+		} else if (ret == -FI_EAVAIL) {
+			rxm_handle_cq_error(ep, ep->shm_cq);
+		} else if (ret != -FI_EAGAIN) {
+			rxm_cq_write_error_all(ep, (int) ret);
+		}
+	} while (ret > 0 && comp_read < ep->comp_per_progress);
+}
+
+static uint64_t rxm_shm_host(void)
+{
+	char hostname[256];
+	uint64_t host;
+
+	if (gethostname(hostname, sizeof(hostname)))
+		return 0;
+
+	hostname[sizeof(hostname) - 1] = '\0';
+	host = fasthash64(hostname, strlen(hostname), getuid());
+	return host ? host : 1;
+}
+
+void rxm_shm_domain_open(struct rxm_domain *domain, struct fi_info *info,
+			 struct fi_info *msg_info)
+{
+	struct fi_info *hints;
+	int ret;
+
+	if (!rxm_use_shm || domain->passthru || (info->caps & FI_HMEM))
+		return;
+
+	domain->shm_host = rxm_shm_host();
+	if (!domain->shm_host)
+		return;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return;
+
+	hints->caps = FI_MSG | FI_RMA | FI_SEND | FI_RECV | FI_READ |
+		      FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE;
+	hints->ep_attr->type = FI_EP_RDM;
+	hints->domain_attr->av_type = FI_AV_TABLE;
+	hints->domain_attr->mr_mode = msg_info->domain_attr->mr_mode &
+				      FI_MR_VIRT_ADDR;
+	hints->tx_attr->msg_order = FI_ORDER_SAS;
+	hints->rx_attr->msg_order = FI_ORDER_SAS;
+	hints->fabric_attr->prov_name = strdup("shm");
+
+	ret = fi_getinfo(domain->util_domain.fabric->fabric_fid.api_version,
+			 NULL, NULL, OFI_GETINFO_HIDDEN, hints,
+			 &domain->shm_info);
+	fi_freeinfo(hints);
+	if (ret)
+		goto err;
+
+	ret = fi_fabric(domain->shm_info->fabric_attr, &domain->shm_fabric,
+			NULL);
+	if (ret)
+		goto err;
+
+	ret = fi_domain(domain->shm_fabric, domain->shm_info,
+			&domain->shm_domain, NULL);
+	if (ret)
+		goto err;
+
+	FI_INFO(&rxm_prov, FI_LOG_DOMAIN, "shm enabled for local peers\n");
+	return;
+err:
+	RXM_WARN_ERR(FI_LOG_DOMAIN, "shm open", ret);
+	rxm_shm_domain_close(domain);
+}
+
+void rxm_shm_domain_close(struct rxm_domain *domain)
+{
+	if (domain->shm_domain) {
+		fi_close(&domain->shm_domain->fid);
+		domain->shm_domain = NULL;
+	}
+	if (domain->shm_fabric) {
+		fi_close(&domain->shm_fabric->fid);
+		domain->shm_fabric = NULL;
+	}
+	fi_freeinfo(domain->shm_info);
+	domain->shm_info = NULL;
+	domain->shm_host = 0;
+}
@@ -21,6 +21,8 @@ AC_DEFUN([FI_SHM_CONFIGURE],[
 				    [cma_happy=0])]
 	       )
 
+	       AC_CHECK_FUNCS([memfd_create])
+
 	       # check if SHM support are present
 	       AC_CHECK_FUNC([shm_open],
 			     [shm_happy=1],
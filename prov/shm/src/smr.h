@@ -70,6 +70,11 @@
 struct smr_env {
 	size_t sar_threshold;
 	int disable_cma;
+	size_t copy_threads;
+	size_t parallel_copy_size;
+	size_t memfd_size;
+	int wait_spin_usec;
+	int wait_sleep_usec;
 };
 
 extern struct smr_env smr_env;
@@ -214,6 +219,8 @@ struct smr_domain {
 	int			fast_rma;
 	/* cache for use with hmem ipc */
 	struct ofi_mr_cache	*ipc_cache;
+	/* helpers for copies of at least smr_env.parallel_copy_size */
+	struct ofi_copy_pool	*copy_pool;
 };
 
 #define SMR_PREFIX	"fi_shm://"
@@ -251,8 +258,28 @@ enum smr_cmap_state {
 struct smr_cmap_entry {
 	enum smr_cmap_state	state;
 	int			device_fds[ZE_MAX_DEVICES];
+	/* peer's memfd region, mapped on first use */
+	int			memfd;
+	void			*memfd_ptr;
+	size_t			memfd_size;
+	/* memfd received from the peer, replaces memfd during progress */
+	ofi_atomic32_t		new_memfd;
 };
 
+static inline int smr_swap_peer_memfd(struct smr_cmap_entry *peer, int fd)
+{
+	int old;
+
+	do {
+		old = ofi_atomic_get32(&peer->new_memfd);
+	} while (!ofi_atomic_cas_bool32(&peer->new_memfd, old, fd));
+	return old;
+}
+
+/*
+ * my_fds holds the ZE device fds, followed by the endpoint's memfd when
+ * it has one.  Both are sent to each peer in a single message.
+ */
 struct smr_sock_info {
 	char			name[SMR_SOCK_NAME_MAX];
 	int			listen_sock;
@@ -261,9 +288,12 @@ struct smr_sock_info {
 	pthread_t		listener_thread;
 	int			*my_fds;
 	int			nfds;
+	int			ndev_fds;
 	struct smr_cmap_entry	peers[SMR_MAX_PEERS];
 };
 
+#define SMR_MEMFD_SLOTS	8
+
 struct smr_ep {
 	struct util_ep		util_ep;
 	smr_rx_comp_func	rx_comp;
@@ -286,6 +316,16 @@ struct smr_ep {
 
 	int			ep_idx;
 	struct smr_sock_info	*sock_info;
+
+	/* staging region shared with peers, split into SMR_MEMFD_SLOTS
+	 * slots; memfd_free is protected by the tx cq lock */
+	int			memfd;
+	void			*memfd_ptr;
+	size_t			memfd_slot_size;
+	uint64_t		memfd_free;
+
+	/* start of the current idle period in a blocking wait, 0 if busy */
+	uint64_t		idle_start;
 };
 
 #define smr_ep_rx_flags(smr_ep) ((smr_ep)->util_ep.rx_op_flags)
@@ -301,6 +341,7 @@ static inline int smr_mmap_name(char *shm_name, const char *ep_name,
 int smr_endpoint(struct fid_domain *domain, struct fi_info *info,
 		  struct fid_ep **ep, void *context);
 void smr_ep_exchange_fds(struct smr_ep *ep, int64_t id);
+void smr_unmap_peer_memfd(struct smr_cmap_entry *peer);
 
 int smr_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 		struct fid_cq **cq_fid, void *context);
@@ -403,6 +444,11 @@ static inline int smr_cma_loop(pid_t pid, struct iovec *local,
 	}
 }
 
+int smr_cma_copy(struct smr_domain *domain, pid_t pid,
+		 const struct iovec *local, size_t local_cnt,
+		 const struct iovec *remote, size_t remote_cnt,
+		 size_t total, bool write);
+
 int smr_progress_unexp_queue(struct smr_ep *ep, struct smr_rx_entry *entry,
 			     struct smr_queue *unexp_queue);
 
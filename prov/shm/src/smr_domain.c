@@ -63,6 +63,8 @@ static int smr_domain_close(fid_t fid)
 	if (ret)
 		return ret;
 
+	if (domain->copy_pool)
+		ofi_copy_pool_close(domain->copy_pool);
 	free(domain);
 	return 0;
 }
@@ -72,7 +74,7 @@ static struct fi_ops smr_domain_fi_ops = {
 	.close = smr_domain_close,
 	.bind = fi_no_bind,
 	.control = fi_no_control,
-	.ops_open = fi_no_ops_open,
+	.ops_open = ofi_domain_ops_open,
 };
 
 static struct fi_ops_mr smr_mr_ops = {
@@ -117,6 +119,16 @@ int smr_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 		return ret;
 	}
 
+	if (smr_env.copy_threads) {
+		ret = ofi_copy_pool_open(smr_env.copy_threads,
+					 &smr_domain->copy_pool);
+		if (ret) {
+			FI_WARN(&smr_prov, FI_LOG_DOMAIN,
+				"unable to start copy threads: %s\n",
+				fi_strerror(-ret));
+		}
+	}
+
 	*domain = &smr_domain->util_domain.domain_fid;
 	(*domain)->fid.ops = &smr_domain_fi_ops;
 	(*domain)->ops = &smr_domain_ops;
@@ -572,6 +572,72 @@ size_t smr_copy_from_sar(struct smr_sar_msg *sar_msg, struct smr_resp *resp,
 	return *bytes_done - start;
 }
 
+struct smr_cma_job {
+	pid_t			pid;
+	const struct iovec	*local;
+	size_t			local_cnt;
+	const struct iovec	*remote;
+	size_t			remote_cnt;
+	bool			write;
+};
+
+static size_t smr_iov_slice(const struct iovec *iov, size_t iov_cnt,
+			    size_t offset, size_t len, struct iovec *slice)
+{
+	size_t i, cnt = 0;
+
+	for (i = 0; i < iov_cnt && len; i++) {
+		if (offset >= iov[i].iov_len) {
+			offset -= iov[i].iov_len;
+			continue;
+		}
+		slice[cnt].iov_base = (char *) iov[i].iov_base + offset;
+		slice[cnt].iov_len = MIN(iov[i].iov_len - offset, len);
+		len -= slice[cnt++].iov_len;
+		offset = 0;
+	}
+	return cnt;
+}
+
+static int smr_cma_chunk(void *arg, size_t offset, size_t len)
+{
+	struct smr_cma_job *job = arg;
+	struct iovec local[SMR_IOV_LIMIT], remote[SMR_IOV_LIMIT];
+	size_t local_cnt, remote_cnt;
+
+	local_cnt = smr_iov_slice(job->local, job->local_cnt, offset, len,
+				  local);
+	remote_cnt = smr_iov_slice(job->remote, job->remote_cnt, offset, len,
+				   remote);
+	return smr_cma_loop(job->pid, local, local_cnt, remote, remote_cnt, 0,
+			    len, job->write);
+}
+
+/*
+ * Copies of at least smr_env.parallel_copy_size are split into chunks
+ * that the domain's copy threads transfer in parallel.
+ */
+int smr_cma_copy(struct smr_domain *domain, pid_t pid,
+		 const struct iovec *local, size_t local_cnt,
+		 const struct iovec *remote, size_t remote_cnt,
+		 size_t total, bool write)
+{
+	struct smr_cma_job job = {
+		.pid = pid,
+		.local = local,
+		.local_cnt = local_cnt,
+		.remote = remote,
+		.remote_cnt = remote_cnt,
+		.write = write,
+	};
+
+	if (!domain->copy_pool || total < smr_env.parallel_copy_size)
+		return smr_cma_chunk(&job, 0, total);
+
+	return ofi_copy_pool_run(domain->copy_pool, total, smr_cma_chunk,
+				 &job);
+}
+
 int smr_format_sar(struct smr_cmd *cmd, enum fi_hmem_iface iface, uint64_t device,
 		   const struct iovec *iov, size_t count,
 		   size_t total_len, struct smr_region *smr,
@@ -611,6 +677,9 @@ int smr_select_proto(bool use_ipc, bool cma_avail, enum fi_hmem_iface iface,
 			return smr_src_ipc;
 		if (cma_avail && FI_HMEM_SYSTEM)
 			return smr_src_iov;
+		if (smr_env.memfd_size && iface == FI_HMEM_SYSTEM &&
+		    total_len > SMR_INJECT_SIZE)
+			return smr_src_memfd;
 		return smr_src_sar;
 	}
 
@@ -636,6 +705,9 @@ int smr_select_proto(bool use_ipc, bool cma_avail, enum fi_hmem_iface iface,
 	if (total_len <= SMR_INJECT_SIZE)
 		return smr_src_inject;
 
+	if (smr_env.memfd_size && iface == FI_HMEM_SYSTEM)
+		return smr_src_memfd;
+
 	if (total_len <= smr_env.sar_threshold || iface != FI_HMEM_SYSTEM)
 		return smr_src_sar;
 
@@ -826,6 +898,69 @@ static ssize_t smr_do_mmap(struct smr_ep *ep, struct smr_region *peer_smr, int64
 	return FI_SUCCESS;
 }
 
+/*
+ * The payload is staged in one of our memfd slots, which the peer mapped
+ * when fds were exchanged, so each message costs two copies but no
+ * mmap/munmap or page faults.  Messages that do not fit, or peers that
+ * could not exchange fds, use the protocol that would otherwise apply.
+ */
+static ssize_t smr_do_memfd(struct smr_ep *ep, struct smr_region *peer_smr, int64_t id,
+			    int64_t peer_id, uint32_t op, uint64_t tag, uint64_t data,
+			    uint64_t op_flags, enum fi_hmem_iface iface, uint64_t device,
+			    const struct iovec *iov, size_t iov_count, size_t total_len,
+			    void *context)
+{
+	struct smr_cmd *cmd;
+	struct smr_resp *resp;
+	struct smr_tx_entry *pend;
+	size_t offset;
+	int proto, slot;
+
+	if (ep->sock_info && ep->memfd >= 0 &&
+	    ep->sock_info->peers[id].state == SMR_CMAP_INIT)
+		smr_ep_exchange_fds(ep, id);
+
+	if (!ep->sock_info || ep->memfd < 0 ||
+	    ep->sock_info->peers[id].state != SMR_CMAP_SUCCESS ||
+	    total_len > ep->memfd_slot_size || !ep->memfd_free) {
+		proto = (op == ofi_op_read_req ||
+			 total_len <= smr_env.sar_threshold) ?
+			smr_src_sar : smr_src_mmap;
+		return smr_proto_ops[proto](ep, peer_smr, id, peer_id, op, tag,
+					    data, op_flags, iface, device, iov,
+					    iov_count, total_len, context);
+	}
+
+	if (ofi_cirque_isfull(smr_resp_queue(ep->region)))
+		return -FI_EAGAIN;
+
+	slot = ofi_lsb(ep->memfd_free) - 1;
+	offset = slot * ep->memfd_slot_size;
+	if (op != ofi_op_read_req)
+		ofi_copy_from_iov((char *) ep->memfd_ptr + offset, total_len,
+				  iov, iov_count, 0);
+	ep->memfd_free &= ~(1ULL << slot);
+
+	cmd = ofi_cirque_next(smr_cmd_queue(peer_smr));
+	resp = ofi_cirque_next(smr_resp_queue(ep->region));
+	pend = ofi_freestack_pop(ep->pend_fs);
+
+	smr_generic_format(cmd, peer_id, op, tag, data, op_flags);
+	cmd->msg.hdr.op_src = smr_src_memfd;
+	cmd->msg.hdr.src_data = smr_get_offset(ep->region, resp);
+	cmd->msg.hdr.size = total_len;
+	cmd->msg.data.memfd_offset = offset;
+
+	smr_format_pend_resp(pend, cmd, context, iface, device, iov,
+			     iov_count, op_flags, id, resp);
+	ofi_cirque_commit(smr_resp_queue(ep->region));
+
+	ofi_cirque_commit(smr_cmd_queue(peer_smr));
+	peer_smr->cmd_cnt--;
+
+	return FI_SUCCESS;
+}
+
 smr_proto_func smr_proto_ops[smr_src_max] = {
 	[smr_src_inline] = &smr_do_inline,
 	[smr_src_inject] = &smr_do_inject,
@@ -833,8 +968,21 @@ smr_proto_func smr_proto_ops[smr_src_max] = {
 	[smr_src_mmap] = &smr_do_mmap,
 	[smr_src_sar] = &smr_do_sar,
 	[smr_src_ipc] = &smr_do_ipc,
+	[smr_src_memfd] = &smr_do_memfd,
 };
 
+void smr_unmap_peer_memfd(struct smr_cmap_entry *peer)
+{
+	if (peer->memfd_ptr) {
+		munmap(peer->memfd_ptr, peer->memfd_size);
+		peer->memfd_ptr = NULL;
+	}
+	if (peer->memfd >= 0) {
+		close(peer->memfd);
+		peer->memfd = -1;
+	}
+}
+
 static void smr_cleanup_epoll(struct smr_sock_info *sock_info)
 {
 	fd_signal_free(&sock_info->signal);
@@ -844,6 +992,7 @@ static void smr_cleanup_epoll(struct smr_sock_info *sock_info)
 static int smr_ep_close(struct fid *fid)
 {
 	struct smr_ep *ep;
+	int i, fd;
 
 	ep = container_of(fid, struct smr_ep, util_ep.ep_fid.fid);
 
@@ -853,9 +1002,21 @@ static int smr_ep_close(struct fid *fid)
 		close(ep->sock_info->listen_sock);
 		unlink(ep->sock_info->name);
 		smr_cleanup_epoll(ep->sock_info);
+		for (i = 0; i < SMR_MAX_PEERS; i++) {
+			smr_unmap_peer_memfd(&ep->sock_info->peers[i]);
+			fd = smr_swap_peer_memfd(&ep->sock_info->peers[i], -1);
+			if (fd >= 0)
+				close(fd);
+		}
+		free(ep->sock_info->my_fds);
 		free(ep->sock_info);
 	}
 
+	if (ep->memfd >= 0) {
+		munmap(ep->memfd_ptr, ep->memfd_slot_size * SMR_MEMFD_SLOTS);
+		close(ep->memfd);
+	}
+
 	ofi_endpoint_close(&ep->util_ep);
 
 	if (ep->region)
@@ -870,12 +1031,46 @@ static int smr_ep_close(struct fid *fid)
 	return 0;
 }
 
+/*
+ * Called when a blocking wait found the endpoint's region unsignaled.
+ * After polling for wait_spin_usec, sleep on the signal word until a peer
+ * signals the region or wait_sleep_usec passes.  The bounded sleep covers
+ * completions that are not signaled through the region, such as those
+ * from other endpoints bound to the same wait set.
+ */
+static void smr_ep_idle(struct smr_ep *ep)
+{
+	uint64_t now = ofi_gettime_ns();
+
+	if (!ep->idle_start) {
+		ep->idle_start = now;
+		return;
+	}
+
+	if (now - ep->idle_start < (uint64_t) smr_env.wait_spin_usec * 1000 ||
+	    !ofi_atomic_cas_bool32(&ep->region->signal, 0, SMR_SIGNAL_SLEEP))
+		return;
+
+	(void) ofi_futex_wait((int *) &ep->region->signal, SMR_SIGNAL_SLEEP,
+			      (uint64_t) smr_env.wait_sleep_usec * 1000);
+
+	if (!ofi_atomic_cas_bool32(&ep->region->signal, SMR_SIGNAL_SLEEP, 0))
+		ep->idle_start = 0;
+}
+
 static int smr_ep_trywait(void *arg)
 {
 	struct smr_ep *ep;
 
 	ep = container_of(arg, struct smr_ep, util_ep.ep_fid.fid);
 
+	if (smr_env.wait_spin_usec >= 0) {
+		if (ofi_atomic_get32(&ep->region->signal) == 1)
+			ep->idle_start = 0;
+		else
+			smr_ep_idle(ep);
+	}
+
 	smr_ep_progress(&ep->util_ep);
 
 	return FI_SUCCESS;
@@ -1046,24 +1241,49 @@ static int smr_recvmsg_fd(int sock, int64_t *peer_id, int *fds, int nfds)
 		goto out;
 	}
 
-	assert(!(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)));
+	/* Peers disagree on the fd count if only one enabled memfd */
 	cmsg = CMSG_FIRSTHDR(&msg);
-	assert(cmsg && cmsg->cmsg_len == CMSG_LEN(ctrl_size) &&
-	       cmsg->cmsg_level == SOL_SOCKET &&
-	       cmsg->cmsg_type == SCM_RIGHTS && CMSG_DATA(cmsg));
+	if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || !cmsg ||
+	    cmsg->cmsg_len != CMSG_LEN(ctrl_size) ||
+	    cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS) {
+		FI_WARN(&smr_prov, FI_LOG_EP_CTRL,
+			"peer sent unexpected fds\n");
+		ret = -FI_EIO;
+		goto out;
+	}
 	memcpy(fds, CMSG_DATA(cmsg), ctrl_size);
 out:
 	free(ctrl_buf);
 	return ret;
 }
 
+/*
+ * This may run on the listener thread while progress copies from the
+ * peer's current memfd region, so a new memfd is only handed over here.
+ * Progress unmaps the old region before it maps the new one.
+ */
+static void smr_set_peer_fds(struct smr_sock_info *sock_info, int64_t id,
+			     int *fds)
+{
+	struct smr_cmap_entry *peer = &sock_info->peers[id];
+	int fd;
+
+	memcpy(peer->device_fds, fds, sizeof(*fds) * sock_info->ndev_fds);
+	if (sock_info->nfds > sock_info->ndev_fds) {
+		fd = smr_swap_peer_memfd(peer, fds[sock_info->ndev_fds]);
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
 static void *smr_start_listener(void *args)
 {
 	struct smr_ep *ep = (struct smr_ep *) args;
 	struct sockaddr_un sockaddr;
 	struct ofi_epollfds_event events[SMR_MAX_PEERS + 1];
 	int i, ret, poll_fds, sock = -1;
-	int peer_fds[ZE_MAX_DEVICES];
+	int peer_fds[ZE_MAX_DEVICES + 1];
 	socklen_t len = sizeof(sockaddr);
 	int64_t id, peer_id;
 
@@ -1097,9 +1317,7 @@ static void *smr_start_listener(void *args)
 			ret = smr_recvmsg_fd(sock, &id, peer_fds,
 					     ep->sock_info->nfds);
 			if (!ret) {
-				memcpy(ep->sock_info->peers[id].device_fds,
-				       peer_fds, sizeof(*peer_fds) *
-				       ep->sock_info->nfds);
+				smr_set_peer_fds(ep->sock_info, id, peer_fds);
 
 				peer_id = smr_peer_data(ep->region)[id].addr.id;
 				ret = smr_sendmsg_fd(sock, id, peer_id,
@@ -1158,7 +1376,7 @@ void smr_ep_exchange_fds(struct smr_ep *ep, int64_t id)
 	char *name1, *name2;
 	int ret = -1, sock = -1;
 	int64_t peer_id;
-	int peer_fds[ZE_MAX_DEVICES];
+	int peer_fds[ZE_MAX_DEVICES + 1];
 
 	if (peer_smr->pid == ep->region->pid ||
 	    !(peer_smr->flags & SMR_FLAG_IPC_SOCK))
@@ -1212,8 +1430,7 @@ void smr_ep_exchange_fds(struct smr_ep *ep, int64_t id)
 	if (ret)
 		goto cleanup;
 
-	memcpy(ep->sock_info->peers[id].device_fds, peer_fds,
-	       sizeof(*peer_fds) * ep->sock_info->nfds);
+	smr_set_peer_fds(ep->sock_info, id, peer_fds);
 
 cleanup:
 	close(sock);
@@ -1223,6 +1440,31 @@ out:
 		SMR_CMAP_FAILED : SMR_CMAP_SUCCESS;
 }
 
+static int smr_init_sock_fds(struct smr_ep *ep)
+{
+	struct smr_sock_info *sock_info = ep->sock_info;
+	int *dev_fds;
+	int i;
+
+	dev_fds = ze_hmem_get_dev_fds(&sock_info->ndev_fds);
+	sock_info->nfds = sock_info->ndev_fds + (ep->memfd >= 0);
+	sock_info->my_fds = calloc(sock_info->nfds + 1,
+				   sizeof(*sock_info->my_fds));
+	if (!sock_info->my_fds)
+		return -FI_ENOMEM;
+
+	memcpy(sock_info->my_fds, dev_fds,
+	       sizeof(*dev_fds) * sock_info->ndev_fds);
+	if (ep->memfd >= 0)
+		sock_info->my_fds[sock_info->ndev_fds] = ep->memfd;
+
+	for (i = 0; i < SMR_MAX_PEERS; i++) {
+		sock_info->peers[i].memfd = -1;
+		ofi_atomic_initialize32(&sock_info->peers[i].new_memfd, -1);
+	}
+	return 0;
+}
+
 static void smr_init_ipc_socket(struct smr_ep *ep)
 {
 	struct smr_sock_name *sock_name;
@@ -1272,14 +1514,19 @@ static void smr_init_ipc_socket(struct smr_ep *ep)
 	dlist_insert_tail(&sock_name->entry, &sock_name_list);
 	pthread_mutex_unlock(&sock_list_lock);
 
-	ep->sock_info->my_fds = ze_hmem_get_dev_fds(&ep->sock_info->nfds);
+	ret = smr_init_sock_fds(ep);
+	if (ret)
+		goto remove;
+
 	ret = pthread_create(&ep->sock_info->listener_thread, NULL,
 			     &smr_start_listener, ep);
 	if (ret)
-		goto remove;
+		goto free_fds;
 
 	return;
 
+free_fds:
+	free(ep->sock_info->my_fds);
 remove:
 	pthread_mutex_lock(&sock_list_lock);
 	dlist_remove(&sock_name->entry);
@@ -1298,6 +1545,45 @@ err_out:
 		"Defaulting to SAR for device transfers\n");
 }
 
+static int smr_init_memfd(struct smr_ep *ep)
+{
+#if HAVE_MEMFD_CREATE
+	size_t size;
+	int fd;
+
+	ep->memfd_slot_size = ofi_get_aligned_size(smr_env.memfd_size /
+						   SMR_MEMFD_SLOTS,
+						   ofi_get_page_size());
+	size = ep->memfd_slot_size * SMR_MEMFD_SLOTS;
+
+	fd = memfd_create("fi_shm", MFD_CLOEXEC);
+	if (fd < 0)
+		goto err;
+
+	if (ftruncate(fd, size))
+		goto close;
+
+	ep->memfd_ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			     fd, 0);
+	if (ep->memfd_ptr == MAP_FAILED)
+		goto close;
+
+	ep->memfd = fd;
+	ep->memfd_free = (1ULL << SMR_MEMFD_SLOTS) - 1;
+	return 0;
+
+close:
+	close(fd);
+err:
+	FI_WARN(&smr_prov, FI_LOG_EP_CTRL, "unable to create memfd region: %s\n",
+		strerror(errno));
+	return -errno;
+#else
+	FI_WARN(&smr_prov, FI_LOG_EP_CTRL, "memfd_create is not available\n");
+	return -FI_ENOSYS;
+#endif
+}
+
 static int smr_ep_ctrl(struct fid *fid, int command, void *arg)
 {
 	struct smr_attr attr;
@@ -1326,12 +1612,16 @@ static int smr_ep_ctrl(struct fid *fid, int command, void *arg)
 		if (ep->util_ep.caps & FI_HMEM || smr_env.disable_cma) {
 			ep->region->cma_cap_peer = SMR_CMA_CAP_OFF;
 			ep->region->cma_cap_self = SMR_CMA_CAP_OFF;
-			if (ep->util_ep.caps & FI_HMEM) {
-				if (ze_hmem_p2p_enabled())
-					smr_init_ipc_socket(ep);
-			}
 		}
 
+		/* The memfd must exist before the socket, which sends it */
+		if (smr_env.memfd_size)
+			smr_init_memfd(ep);
+
+		if ((ep->util_ep.caps & FI_HMEM && ze_hmem_p2p_enabled()) ||
+		    ep->memfd >= 0)
+			smr_init_ipc_socket(ep);
+
 		smr_exchange_all_peers(ep->region);
 		break;
 	default:
@@ -1401,6 +1691,7 @@ int smr_endpoint(struct fid_domain *domain, struct fi_info *info,
 	ep = calloc(1, sizeof(*ep));
 	if (!ep)
 		return -FI_ENOMEM;
+	ep->memfd = -1;
 
 	ret = smr_endpoint_name(ep, name, info->src_addr, info->src_addrlen);
 	if (ret)
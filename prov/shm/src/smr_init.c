@@ -42,6 +42,11 @@ struct sigaction *old_action = NULL;
 struct smr_env smr_env = {
 	.sar_threshold = SIZE_MAX,
 	.disable_cma = false,
+	.copy_threads = 0,
+	.parallel_copy_size = 8 * 1024 * 1024,
+	.memfd_size = 0,
+	.wait_spin_usec = 100,
+	.wait_sleep_usec = 1000,
 };
 
 static void smr_init_env(void)
@@ -50,6 +55,13 @@ static void smr_init_env(void)
 	fi_param_get_size_t(&smr_prov, "tx_size", &smr_info.tx_attr->size);
 	fi_param_get_size_t(&smr_prov, "rx_size", &smr_info.rx_attr->size);
 	fi_param_get_bool(&smr_prov, "disable_cma", &smr_env.disable_cma);
+	fi_param_get_size_t(&smr_prov, "copy_threads", &smr_env.copy_threads);
+	fi_param_get_size_t(&smr_prov, "parallel_copy_size",
+			    &smr_env.parallel_copy_size);
+	fi_param_get_size_t(&smr_prov, "memfd_size", &smr_env.memfd_size);
+	fi_param_get_int(&smr_prov, "wait_spin_usec", &smr_env.wait_spin_usec);
+	fi_param_get_int(&smr_prov, "wait_sleep_usec",
+			 &smr_env.wait_sleep_usec);
 }
 
 static void smr_resolve_addr(const char *node, const char *service,
@@ -210,6 +222,25 @@ SHM_INI
 			 Default: 1024");
 	fi_param_define(&smr_prov, "disable_cma", FI_PARAM_BOOL,
 			"Manually disables CMA. Default: false");
+	fi_param_define(&smr_prov, "copy_threads", FI_PARAM_SIZE_T,
+			"Number of helper threads per domain that share large \
+			 CMA and mmap copies with the progress thread. \
+			 Default: 0 (disabled)");
+	fi_param_define(&smr_prov, "parallel_copy_size", FI_PARAM_SIZE_T,
+			"Copies of at least this many bytes are split across \
+			 the copy threads. Default: 8388608");
+	fi_param_define(&smr_prov, "memfd_size", FI_PARAM_SIZE_T,
+			"Size of a memfd region per endpoint that peers map \
+			 once, used for large messages when CMA is not \
+			 available. Default: 0 (disabled)");
+	fi_param_define(&smr_prov, "wait_spin_usec", FI_PARAM_INT,
+			"Time an idle endpoint polls in a blocking CQ or \
+			 counter wait before sleeping until a peer signals \
+			 it. -1 disables sleeping. Default: 100");
+	fi_param_define(&smr_prov, "wait_sleep_usec", FI_PARAM_INT,
+			"Longest single sleep of an idle endpoint, which \
+			 bounds the delay for events that do not signal the \
+			 endpoint. Default: 1000");
 
 	smr_init_env();
 
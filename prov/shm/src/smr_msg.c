@@ -198,11 +198,15 @@ static ssize_t smr_generic_sendmsg(struct smr_ep *ep, const struct iovec *iov,
 		  desc && (smr_get_mr_flags(desc) & FI_HMEM_DEVICE_ONLY) &&
 		  !(op_flags & FI_INJECT);
 
+	OFI_PROBE_START(smr_select_proto);
 	proto = smr_select_proto(use_ipc, smr_cma_enabled(ep, peer_smr), iface,
 				 op, total_len, op_flags);
+	OFI_PROBE_END(smr_select_proto);
 
+	OFI_PROBE_START(smr_tx_proto);
 	ret = smr_proto_ops[proto](ep, peer_smr, id, peer_id, op, tag, data, op_flags,
 				   iface, device, iov, iov_count, total_len, context);
+	OFI_PROBE_END(smr_tx_proto);
 	if (ret)
 		goto unlock_cq;
 
@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
 
 #include "ofi_iov.h"
@@ -73,6 +74,7 @@ static int smr_progress_resp_entry(struct smr_ep *ep, struct smr_resp *resp,
 	struct smr_inject_buf *tx_buf = NULL;
 	struct smr_sar_msg *sar_msg = NULL;
 	uint8_t *src;
+	char *map_ptr;
 	ssize_t hmem_copy_ret;
 
 	peer_smr = smr_peer_region(ep->region, pending->peer_id);
@@ -140,6 +142,22 @@ static int smr_progress_resp_entry(struct smr_ep *ep, struct smr_resp *resp,
 		free(pending->map_name);
 		pending->map_name = NULL;
 		break;
+	case smr_src_memfd:
+		map_ptr = (char *) ep->memfd_ptr +
+			  pending->cmd.msg.data.memfd_offset;
+		if (pending->cmd.msg.hdr.op == ofi_op_read_req && !*err) {
+			pending->bytes_done = ofi_copy_to_iov(pending->iov,
+						pending->iov_count, 0, map_ptr,
+						pending->cmd.msg.hdr.size);
+			if (pending->bytes_done != pending->cmd.msg.hdr.size) {
+				FI_WARN(&smr_prov, FI_LOG_EP_CTRL,
+					"Incomplete copy from memfd region\n");
+				*err = -FI_ETRUNC;
+			}
+		}
+		ep->memfd_free |= 1ULL << (pending->cmd.msg.data.memfd_offset /
+					   ep->memfd_slot_size);
+		break;
 	case smr_src_inject:
 		inj_offset = (size_t) pending->cmd.msg.hdr.src_data;
 		tx_buf = smr_get_ptr(peer_smr, inj_offset);
@@ -301,6 +319,7 @@ static int smr_progress_iov(struct smr_cmd *cmd, struct iovec *iov,
 			    size_t iov_count, size_t *total_len,
 			    struct smr_ep *ep, int err)
 {
+	struct smr_domain *domain;
 	struct smr_region *peer_smr;
 	struct smr_resp *resp;
 	int ret;
@@ -313,9 +332,11 @@ static int smr_progress_iov(struct smr_cmd *cmd, struct iovec *iov,
 		goto out;
 	}
 
-	ret = smr_cma_loop(peer_smr->pid, iov, iov_count, cmd->msg.data.iov,
-			   cmd->msg.data.iov_count, 0, cmd->msg.hdr.size,
-			   cmd->msg.hdr.op == ofi_op_read_req);
+	domain = container_of(ep->util_ep.domain, struct smr_domain,
+			      util_domain);
+	ret = smr_cma_copy(domain, peer_smr->pid, iov, iov_count,
+			   cmd->msg.data.iov, cmd->msg.data.iov_count,
+			   cmd->msg.hdr.size, cmd->msg.hdr.op == ofi_op_read_req);
 	if (!ret)
 		*total_len = cmd->msg.hdr.size;
 
@@ -327,12 +348,49 @@ out:
 	return -ret;
 }
 
+struct smr_mmap_job {
+	char		*buf;
+	struct iovec	*iov;
+	size_t		iov_count;
+	bool		read;
+};
+
+static int smr_mmap_chunk(void *arg, size_t offset, size_t len)
+{
+	struct smr_mmap_job *job = arg;
+
+	if (job->read)
+		ofi_copy_from_iov(job->buf + offset, len, job->iov,
+				  job->iov_count, offset);
+	else
+		ofi_copy_to_iov(job->iov, job->iov_count, offset,
+				job->buf + offset, len);
+	return 0;
+}
+
+/* Copies between host memory mapped from a peer and iov */
+static size_t smr_copy_mapped(struct smr_domain *domain, char *buf,
+			      struct iovec *iov, size_t iov_count,
+			      size_t size, bool read)
+{
+	struct smr_mmap_job job = { buf, iov, iov_count, read };
+
+	size = MIN(size, ofi_total_iov_len(iov, iov_count));
+	if (domain->copy_pool && size >= smr_env.parallel_copy_size)
+		(void) ofi_copy_pool_run(domain->copy_pool, size,
+					 smr_mmap_chunk, &job);
+	else
+		(void) smr_mmap_chunk(&job, 0, size);
+	return size;
+}
+
 static int smr_mmap_peer_copy(struct smr_ep *ep, struct smr_cmd *cmd,
 			      enum fi_hmem_iface iface, uint64_t device,
 			      struct iovec *iov, size_t iov_count,
 			      size_t *total_len)
 {
 	char shm_name[SMR_NAME_MAX];
+	struct smr_domain *domain;
 	void *mapped_ptr;
 	int fd, num;
 	int ret = 0;
@@ -360,7 +418,13 @@ static int smr_mmap_peer_copy(struct smr_ep *ep, struct smr_cmd *cmd,
 		goto unlink_close;
 	}
 
-	if (cmd->msg.hdr.op == ofi_op_read_req) {
+	domain = container_of(ep->util_ep.domain, struct smr_domain,
+			      util_domain);
+	if (iface == FI_HMEM_SYSTEM) {
+		hmem_copy_ret = smr_copy_mapped(domain, mapped_ptr, iov,
+					iov_count, cmd->msg.hdr.size,
+					cmd->msg.hdr.op == ofi_op_read_req);
+	} else if (cmd->msg.hdr.op == ofi_op_read_req) {
 		hmem_copy_ret = ofi_copy_from_hmem_iov(mapped_ptr,
 						    cmd->msg.hdr.size, iface,
 						    device, iov, iov_count, 0);
@@ -412,6 +476,85 @@ static int smr_progress_mmap(struct smr_cmd *cmd, enum fi_hmem_iface iface,
 	return ret;
 }
 
+static void *smr_map_peer_memfd(struct smr_ep *ep, int64_t id,
+				size_t *size)
+{
+	struct smr_cmap_entry *peer;
+	struct stat st;
+	void *ptr;
+	int fd;
+
+	if (!ep->sock_info)
+		return NULL;
+
+	peer = &ep->sock_info->peers[id];
+	fd = smr_swap_peer_memfd(peer, -1);
+	if (fd >= 0) {
+		smr_unmap_peer_memfd(peer);
+		peer->memfd = fd;
+	}
+
+	if (!peer->memfd_ptr) {
+		if (peer->memfd < 0 || fstat(peer->memfd, &st))
+			return NULL;
+
+		ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED, peer->memfd, 0);
+		if (ptr == MAP_FAILED) {
+			FI_WARN(&smr_prov, FI_LOG_EP_CTRL,
+				"mmap error %s\n", strerror(errno));
+			return NULL;
+		}
+		peer->memfd_size = st.st_size;
+		peer->memfd_ptr = ptr;
+	}
+
+	*size = peer->memfd_size;
+	return peer->memfd_ptr;
+}
+
+static int smr_progress_memfd(struct smr_cmd *cmd, struct iovec *iov,
+			      size_t iov_count, size_t *total_len,
+			      struct smr_ep *ep)
+{
+	struct smr_domain *domain;
+	struct smr_region *peer_smr;
+	struct smr_resp *resp;
+	size_t map_size = 0;
+	char *map;
+	int ret = 0;
+
+	peer_smr = smr_peer_region(ep->region, cmd->msg.hdr.id);
+	resp = smr_get_ptr(peer_smr, cmd->msg.hdr.src_data);
+
+	map = smr_map_peer_memfd(ep, cmd->msg.hdr.id, &map_size);
+	if (!map || cmd->msg.data.memfd_offset + cmd->msg.hdr.size >
+		    map_size) {
+		FI_WARN(&smr_prov, FI_LOG_EP_CTRL,
+			"peer memfd region is not mapped\n");
+		ret = -FI_EIO;
+		goto out;
+	}
+
+	domain = container_of(ep->util_ep.domain, struct smr_domain,
+			      util_domain);
+	*total_len = smr_copy_mapped(domain, map + cmd->msg.data.memfd_offset,
+				     iov, iov_count, cmd->msg.hdr.size,
+				     cmd->msg.hdr.op == ofi_op_read_req);
+	if (*total_len != cmd->msg.hdr.size) {
+		FI_WARN(&smr_prov, FI_LOG_EP_CTRL,
+			"memfd copy iov truncated\n");
+		ret = -FI_ETRUNC;
+	}
+
+out:
+	//Status must be set last (signals peer: op done, valid resp entry)
+	resp->status = ret;
+	smr_signal(peer_smr);
+
+	return ret;
+}
+
 static struct smr_sar_entry *smr_progress_sar(struct smr_cmd *cmd,
 			struct smr_rx_entry *rx_entry, enum fi_hmem_iface iface,
 			uint64_t device, struct iovec *iov, size_t iov_count,
@@ -663,6 +806,7 @@ static int smr_progress_msg_common(struct smr_ep *ep, struct smr_cmd *cmd,
 	int ret;
 	bool free_entry = true;
 
+	OFI_PROBE_START(smr_rx_copy);
 	switch (cmd->msg.hdr.op_src) {
 	case smr_src_inline:
 		entry->err = smr_progress_inline(cmd, entry->iface, entry->device,
@@ -685,6 +829,11 @@ static int smr_progress_msg_common(struct smr_ep *ep, struct smr_cmd *cmd,
 					       entry->iov, entry->iov_count,
 					       &total_len, ep);
 		break;
+	case smr_src_memfd:
+		entry->err = smr_progress_memfd(cmd, entry->iov,
+						entry->iov_count, &total_len,
+						ep);
+		break;
 	case smr_src_sar:
 		sar = smr_progress_sar(cmd, entry, entry->iface, entry->device,
 				       entry->iov, entry->iov_count, &total_len, ep);
@@ -699,6 +848,7 @@ static int smr_progress_msg_common(struct smr_ep *ep, struct smr_cmd *cmd,
 			"unidentified operation type\n");
 		entry->err = -FI_EINVAL;
 	}
+	OFI_PROBE_END(smr_rx_copy);
 
 	comp_buf = entry->iov[0].iov_base;
 	comp_flags = (cmd->msg.hdr.op_flags | entry->flags) & ~SMR_MULTI_RECV;
@@ -784,9 +934,11 @@ static int smr_progress_cmd_msg(struct smr_ep *ep, struct smr_cmd *cmd)
 	match_attr.id = cmd->msg.hdr.id;
 	match_attr.tag = cmd->msg.hdr.tag;
 
+	OFI_PROBE_START(smr_rx_match);
 	dlist_entry = dlist_find_first_match(&recv_queue->list,
 					     recv_queue->match_func,
 					     &match_attr);
+	OFI_PROBE_END(smr_rx_match);
 	if (!dlist_entry) {
 		if (ofi_freestack_isempty(ep->unexp_fs))
 			return -FI_EAGAIN;
@@ -888,6 +1040,9 @@ static int smr_progress_cmd_rma(struct smr_ep *ep, struct smr_cmd *cmd)
 		err = smr_progress_mmap(cmd, iface, device, iov,
 					iov_count, &total_len, ep);
 		break;
+	case smr_src_memfd:
+		err = smr_progress_memfd(cmd, iov, iov_count, &total_len, ep);
+		break;
 	case smr_src_sar:
 		if (smr_progress_sar(cmd, NULL, iface, device, iov, iov_count,
 				     &total_len, ep))
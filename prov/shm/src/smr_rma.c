@@ -61,17 +61,17 @@ static void smr_format_rma_resp(struct smr_cmd *cmd, fi_addr_t peer_id,
 	cmd->msg.hdr.size = total_len;
 }
 
-static ssize_t smr_rma_fast(struct smr_region *peer_smr, const struct iovec *iov,
+static ssize_t smr_rma_fast(struct smr_domain *domain,
+			struct smr_region *peer_smr, const struct iovec *iov,
 			size_t iov_count, const struct fi_rma_iov *rma_iov,
 			size_t rma_count, void **desc, int peer_id, void *context,
 			uint32_t op, uint64_t op_flags)
 {
-	struct iovec cma_iovec[SMR_IOV_LIMIT], rma_iovec[SMR_IOV_LIMIT];
+	struct iovec rma_iovec[SMR_IOV_LIMIT];
 	struct smr_cmd *cmd;
 	size_t total_len;
 	int ret, i;
 
-	memcpy(cma_iovec, iov, sizeof(*iov) * iov_count);
 	for (i = 0; i < rma_count; i++) {
 		rma_iovec[i].iov_base = (void *) rma_iov[i].addr;
 		rma_iovec[i].iov_len = rma_iov[i].len;
@@ -79,8 +79,8 @@ static ssize_t smr_rma_fast(struct smr_region *peer_smr, const struct iovec *iov
 
 	total_len = ofi_total_iov_len(iov, iov_count);
 
-	ret = smr_cma_loop(peer_smr->pid, cma_iovec, iov_count, rma_iovec,
-			   rma_count, 0, total_len, op == ofi_op_write);
+	ret = smr_cma_copy(domain, peer_smr->pid, iov, iov_count,
+			   rma_iovec, rma_count, total_len, op == ofi_op_write);
 
 	if (ret)
 		return ret;
@@ -142,7 +142,7 @@ ssize_t smr_generic_rma(struct smr_ep *ep, const struct iovec *iov,
 	}
 
 	if (cmds == 1) {
-		err = smr_rma_fast(peer_smr, iov, iov_count, rma_iov,
+		err = smr_rma_fast(domain, peer_smr, iov, iov_count, rma_iov,
 				   rma_count, desc, peer_id,  context, op,
 				   op_flags);
 		goto signal_comp;
@@ -334,7 +334,7 @@ ssize_t smr_generic_rma_inject(struct fid_ep *ep_fid, const void *buf,
 	rma_iov.key = key;
 
 	if (cmds == 1) {
-		ret = smr_rma_fast(peer_smr, &iov, 1, &rma_iov, 1, NULL,
+		ret = smr_rma_fast(domain, peer_smr, &iov, 1, &rma_iov, 1, NULL,
 				   peer_id, NULL, ofi_op_write, flags);
 		if (ret)
 			goto unlock_region;
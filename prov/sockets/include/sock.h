@@ -87,8 +87,10 @@
 #define SOCK_DOMAIN_MR_CNT (65535)
 
 #define SOCK_PE_POLL_TIMEOUT (100000)
-#define SOCK_PE_MAX_ENTRIES (128)
+#define SOCK_PE_CHUNK_ENTRIES (128)
+#define SOCK_PE_MAX_ENTRIES (UINT16_MAX + 1)
 #define SOCK_PE_WAITTIME (10)
+#define SOCK_PE_DEF_THREADS (1)
 
 #define SOCK_EQ_DEF_SZ (1<<8)
 #define SOCK_CQ_DEF_SZ (1<<8)
@@ -130,7 +132,6 @@
 #define SOCK_USE_OP_FLAGS (1ULL << 61)
 #define SOCK_TRIGGERED_OP (1ULL << 62)
 #define SOCK_PE_COMM_BUFF_SZ (1024)
-#define SOCK_PE_OVERFLOW_COMM_BUFF_SZ (128)
 
 /* it must be adjusted if error data size in CQ/EQ
  * will be larger than SOCK_EP_MAX_CM_DATA_SZ */
@@ -237,6 +238,9 @@ struct sock_domain {
 	enum fi_progress	progress_mode;
 	struct ofi_mr_map	mr_map;
 	struct sock_pe		*pe;
+	struct sock_pe		**pe_array;
+	size_t			pe_cnt;
+	ofi_mutex_t		atomic_lock;
 	struct dlist_entry	dom_list_entry;
 	struct fi_domain_attr	attr;
 	struct sock_conn_listener conn_listener;
@@ -548,6 +552,7 @@ struct sock_ep_attr {
 	struct sock_av *av;
 	struct sock_domain *domain;
 
+	struct sock_pe *pe;
 	struct sock_rx_ctx *rx_ctx;
 	struct sock_tx_ctx *tx_ctx;
 
@@ -825,9 +830,8 @@ struct sock_pe_entry {
 	uint8_t is_complete;
 	uint8_t is_error;
 	uint8_t mr_checked;
-	uint8_t is_pool_entry;
 	uint8_t completion_reported;
-	uint8_t reserved[3];
+	uint8_t reserved[4];
 
 	uint64_t done_len;
 	uint64_t total_len;
@@ -847,7 +851,8 @@ struct sock_pe_entry {
 struct sock_pe {
 	struct sock_domain *domain;
 	int num_free_entries;
-	struct sock_pe_entry pe_table[SOCK_PE_MAX_ENTRIES];
+	size_t num_entries;
+	ofi_atomic32_t ep_cnt;
 	ofi_mutex_t lock;
 	ofi_mutex_t signal_lock;
 	pthread_mutex_t list_lock;
@@ -855,11 +860,10 @@ struct sock_pe {
 	int signal_fds[2];
 	uint64_t waittime;
 
-	struct ofi_bufpool *pe_rx_pool;
+	struct ofi_bufpool *pe_pool;
 	struct ofi_bufpool *atomic_rx_pool;
 	struct dlist_entry free_list;
 	struct dlist_entry busy_list;
-	struct dlist_entry pool_list;
 
 	struct dlist_entry tx_list;
 	struct dlist_entry rx_list;
@@ -1141,6 +1145,8 @@ int fd_set_nonblock(int fd);
 int sock_conn_map_init(struct sock_ep *ep, int init_size);
 
 struct sock_pe *sock_pe_init(struct sock_domain *domain);
+struct sock_pe *sock_pe_get(struct sock_domain *domain);
+void sock_pe_put(struct sock_pe *pe);
 void sock_pe_add_tx_ctx(struct sock_pe *pe, struct sock_tx_ctx *ctx);
 void sock_pe_add_rx_ctx(struct sock_pe *pe, struct sock_rx_ctx *ctx);
 void sock_pe_signal(struct sock_pe *pe);
@@ -1176,6 +1182,8 @@ void sock_rx_release_entry(struct sock_rx_entry *rx_entry);
 
 ssize_t sock_comm_send(struct sock_pe_entry *pe_entry, const void *buf, size_t len);
 ssize_t sock_comm_recv(struct sock_pe_entry *pe_entry, void *buf, size_t len);
+ssize_t sock_comm_recvv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt);
 ssize_t sock_comm_peek(struct sock_conn *conn, void *buf, size_t len);
 ssize_t sock_comm_discard(struct sock_pe_entry *pe_entry, size_t len);
 int sock_comm_tx_done(struct sock_pe_entry *pe_entry);
@@ -1219,6 +1227,17 @@ static inline size_t sock_rx_avail_len(struct sock_rx_entry *rx_entry)
 	return rx_entry->total_len - rx_entry->used;
 }
 
+/* Shared contexts have no owning endpoint and use the domain's first PE */
+static inline struct sock_pe *sock_tx_ctx_pe(struct sock_tx_ctx *tx_ctx)
+{
+	return tx_ctx->ep_attr ? tx_ctx->ep_attr->pe : tx_ctx->domain->pe;
+}
+
+static inline struct sock_pe *sock_rx_ctx_pe(struct sock_rx_ctx *rx_ctx)
+{
+	return rx_ctx->ep_attr ? rx_ctx->ep_attr->pe : rx_ctx->domain->pe;
+}
+
 int sock_ep_cm_start_thread(struct sock_ep_cm_head *cm_head);
 void sock_ep_cm_signal(struct sock_ep_cm_head *cm_head);
 void sock_ep_cm_stop_thread(struct sock_ep_cm_head *cm_head);
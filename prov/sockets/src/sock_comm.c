@@ -186,6 +186,39 @@ ssize_t sock_comm_recv(struct sock_pe_entry *pe_entry, void *buf, size_t len)
 	return read_len;
 }
 
+/*
+ * Receive straight into a scatter list.  Anything already staged in the
+ * comm buffer (typically payload pulled in together with the header) is
+ * handed out first; after that the socket is read with a single readv()
+ * so that the payload lands directly in the caller's buffers.
+ */
+ssize_t sock_comm_recvv(struct sock_pe_entry *pe_entry,
+			struct iovec *iov, size_t iov_cnt)
+{
+	ssize_t ret;
+
+	if (!ofi_rbempty(&pe_entry->comm_buf))
+		return sock_comm_recv(pe_entry, iov[0].iov_base,
+				      iov[0].iov_len);
+
+	ret = ofi_readv_socket(pe_entry->conn->sock_fd, iov, (int) iov_cnt);
+	if (ret == 0) {
+		pe_entry->conn->connected = 0;
+		SOCK_LOG_DBG("Disconnected: port %d\n",
+			     ofi_addr_get_port(&pe_entry->conn->addr.sa));
+		return ret;
+	}
+
+	if (ret < 0) {
+		SOCK_LOG_DBG("readv %s\n", strerror(ofi_sockerr()));
+		ret = 0;
+	}
+
+	if (ret > 0)
+		SOCK_LOG_DBG("readv from network: %lu\n", ret);
+	return ret;
+}
+
 ssize_t sock_comm_peek(struct sock_conn *conn, void *buf, size_t len)
 {
 	ssize_t ret;
@@ -46,6 +46,38 @@
 
 extern struct fi_ops_mr sock_dom_mr_ops;
 
+static void sock_dom_finalize_pe(struct sock_domain *dom)
+{
+	size_t i;
+
+	for (i = 0; i < dom->pe_cnt; i++) {
+		if (dom->pe_array[i])
+			sock_pe_finalize(dom->pe_array[i]);
+	}
+	free(dom->pe_array);
+}
+
+static int sock_dom_init_pe(struct sock_domain *dom)
+{
+	size_t i;
+
+	dom->pe_cnt = MAX(sock_pe_threads, 1);
+	dom->pe_array = calloc(dom->pe_cnt, sizeof(*dom->pe_array));
+	if (!dom->pe_array)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < dom->pe_cnt; i++) {
+		dom->pe_array[i] = sock_pe_init(dom);
+		if (!dom->pe_array[i]) {
+			sock_dom_finalize_pe(dom);
+			return -FI_ENOMEM;
+		}
+	}
+
+	/* shared contexts always run on the first engine */
+	dom->pe = dom->pe_array[0];
+	return 0;
+}
 
 static int sock_dom_close(struct fid *fid)
 {
@@ -57,7 +89,8 @@ static int sock_dom_close(struct fid *fid)
 	sock_conn_stop_listener_thread(&dom->conn_listener);
 	sock_ep_cm_stop_thread(&dom->cm_head);
 
-	sock_pe_finalize(dom->pe);
+	sock_dom_finalize_pe(dom);
+	ofi_mutex_destroy(&dom->atomic_lock);
 	ofi_mutex_destroy(&dom->lock);
 	ofi_mr_map_close(&dom->mr_map);
 	sock_dom_remove_from_list(dom);
@@ -163,6 +196,7 @@ int sock_domain(struct fid_fabric *fabric, struct fi_info *info,
 		return -FI_ENOMEM;
 
 	ofi_mutex_init(&sock_domain->lock);
+	ofi_mutex_init(&sock_domain->atomic_lock);
 	ofi_atomic_initialize32(&sock_domain->ref, 0);
 
 	sock_domain->info = *info;
@@ -179,8 +213,7 @@ int sock_domain(struct fid_fabric *fabric, struct fi_info *info,
 	else
 		sock_domain->progress_mode = info->domain_attr->data_progress;
 
-	sock_domain->pe = sock_pe_init(sock_domain);
-	if (!sock_domain->pe) {
+	if (sock_dom_init_pe(sock_domain)) {
 		SOCK_LOG_ERROR("Failed to init PE\n");
 		goto err1;
 	}
@@ -209,8 +242,9 @@ int sock_domain(struct fid_fabric *fabric, struct fi_info *info,
 err3:
 	sock_conn_stop_listener_thread(&sock_domain->conn_listener);
 err2:
-	sock_pe_finalize(sock_domain->pe);
+	sock_dom_finalize_pe(sock_domain);
 err1:
+	ofi_mutex_destroy(&sock_domain->atomic_lock);
 	ofi_mutex_destroy(&sock_domain->lock);
 	free(sock_domain);
 	return -FI_EINVAL;
@@ -263,7 +263,7 @@ static int sock_ctx_enable(struct fid_ep *ep)
 	switch (ep->fid.fclass) {
 	case FI_CLASS_RX_CTX:
 		rx_ctx = container_of(ep, struct sock_rx_ctx, ctx.fid);
-		sock_pe_add_rx_ctx(rx_ctx->domain->pe, rx_ctx);
+		sock_pe_add_rx_ctx(rx_ctx->ep_attr->pe, rx_ctx);
 
 		if (!rx_ctx->ep_attr->conn_handle.do_listen &&
 		    sock_conn_listen(rx_ctx->ep_attr)) {
@@ -274,7 +274,7 @@ static int sock_ctx_enable(struct fid_ep *ep)
 
 	case FI_CLASS_TX_CTX:
 		tx_ctx = container_of(ep, struct sock_tx_ctx, fid.ctx.fid);
-		sock_pe_add_tx_ctx(tx_ctx->domain->pe, tx_ctx);
+		sock_pe_add_tx_ctx(tx_ctx->ep_attr->pe, tx_ctx);
 
 		if (!tx_ctx->ep_attr->conn_handle.do_listen &&
 		    sock_conn_listen(tx_ctx->ep_attr)) {
@@ -664,7 +664,7 @@ static int sock_ep_close(struct fid *fid)
 		ofi_mutex_unlock(&sock_ep->attr->av->list_lock);
 	}
 
-	pthread_mutex_lock(&sock_ep->attr->domain->pe->list_lock);
+	pthread_mutex_lock(&sock_ep->attr->pe->list_lock);
 	if (sock_ep->attr->tx_shared) {
 		ofi_mutex_lock(&sock_ep->attr->tx_ctx->lock);
 		dlist_remove(&sock_ep->attr->tx_ctx_entry);
@@ -676,7 +676,7 @@ static int sock_ep_close(struct fid *fid)
 		dlist_remove(&sock_ep->attr->rx_ctx_entry);
 		ofi_mutex_unlock(&sock_ep->attr->rx_ctx->lock);
 	}
-	pthread_mutex_unlock(&sock_ep->attr->domain->pe->list_lock);
+	pthread_mutex_unlock(&sock_ep->attr->pe->list_lock);
 
 	if (sock_ep->attr->conn_handle.do_listen) {
 		ofi_mutex_lock(&sock_ep->attr->domain->conn_listener.signal_lock);
@@ -725,11 +725,12 @@ static int sock_ep_close(struct fid *fid)
 	if (sock_ep->attr->dest_addr)
 		free(sock_ep->attr->dest_addr);
 
-	ofi_mutex_lock(&sock_ep->attr->domain->pe->lock);
+	ofi_mutex_lock(&sock_ep->attr->pe->lock);
 	ofi_idm_reset(&sock_ep->attr->av_idm, NULL);
 	sock_conn_map_destroy(sock_ep->attr);
-	ofi_mutex_unlock(&sock_ep->attr->domain->pe->lock);
+	ofi_mutex_unlock(&sock_ep->attr->pe->lock);
 
+	sock_pe_put(sock_ep->attr->pe);
 	ofi_atomic_dec32(&sock_ep->attr->domain->ref);
 	ofi_mutex_destroy(&sock_ep->attr->lock);
 	free(sock_ep->attr);
@@ -737,6 +738,18 @@ static int sock_ep_close(struct fid *fid)
 	return 0;
 }
 
+/* Shared contexts are progressed by the domain's first engine, and so must
+ * be every endpoint whose connections they poll. */
+static void sock_ep_use_shared_pe(struct sock_ep_attr *attr)
+{
+	if (attr->pe == attr->domain->pe)
+		return;
+
+	sock_pe_put(attr->pe);
+	attr->pe = attr->domain->pe;
+	ofi_atomic_inc32(&attr->pe->ep_cnt);
+}
+
 static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 {
 	int ret;
@@ -884,6 +897,7 @@ static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 
 		ep->attr->tx_ctx->use_shared = 1;
 		ep->attr->tx_ctx->stx_ctx = tx_ctx;
+		sock_ep_use_shared_pe(ep->attr);
 		break;
 
 	case FI_CLASS_SRX_CTX:
@@ -894,6 +908,7 @@ static int sock_ep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
 
 		ep->attr->rx_ctx->use_shared = 1;
 		ep->attr->rx_ctx->srx_ctx = rx_ctx;
+		sock_ep_use_shared_pe(ep->attr);
 		break;
 
 	default:
@@ -992,7 +1007,7 @@ int sock_ep_enable(struct fid_ep *ep)
 					tx_ctx->stx_ctx->enabled = 1;
 				}
 			} else {
-				sock_pe_add_tx_ctx(tx_ctx->domain->pe, tx_ctx);
+				sock_pe_add_tx_ctx(sock_ep->attr->pe, tx_ctx);
 			}
 		}
 	}
@@ -1007,7 +1022,7 @@ int sock_ep_enable(struct fid_ep *ep)
 					rx_ctx->srx_ctx->enabled = 1;
 				}
 			} else {
-				sock_pe_add_rx_ctx(rx_ctx->domain->pe, rx_ctx);
+				sock_pe_add_rx_ctx(sock_ep->attr->pe, rx_ctx);
 			}
 		}
 	}
@@ -1774,6 +1789,7 @@ int sock_alloc_endpoint(struct fid_domain *domain, struct fi_info *info,
 		goto err2;
 	}
 
+	sock_ep->attr->pe = sock_pe_get(sock_dom);
 	ofi_atomic_inc32(&sock_dom->ref);
 	return 0;
 
@@ -1792,7 +1808,7 @@ void sock_ep_remove_conn(struct sock_ep_attr *attr, struct sock_conn *conn)
 {
 	if (attr->cmap.used <= 0 || conn->sock_fd == -1)
 		return;
-	sock_pe_poll_del(attr->domain->pe, conn->sock_fd);
+	sock_pe_poll_del(attr->pe, conn->sock_fd);
 	sock_conn_release_entry(&attr->cmap, conn);
 }
 
@@ -63,7 +63,7 @@
 #define SOCK_LOG_DBG(...) _SOCK_LOG_DBG(FI_LOG_EP_DATA, __VA_ARGS__)
 #define SOCK_LOG_ERROR(...) _SOCK_LOG_ERROR(FI_LOG_EP_DATA, __VA_ARGS__)
 
-#define PE_INDEX(_pe, _e) (_e - &_pe->pe_table[0])
+#define PE_INDEX(_pe, _e) ofi_buf_index(_e)
 #define SOCK_GET_RX_ID(_addr, _bits) (((_bits) == 0) ? 0 : \
 		(((uint64_t)_addr) >> (64 - _bits)))
 
@@ -165,13 +165,6 @@ static void sock_pe_release_entry(struct sock_pe *pe,
 		ofi_buf_free(pe_entry->pe.rx.atomic_src);
 	}
 
-	if (pe_entry->is_pool_entry) {
-		ofi_rbfree(&pe_entry->comm_buf);
-		dlist_remove(&pe_entry->entry);
-		ofi_buf_free(pe_entry);
-		return;
-	}
-
 	if (pe_entry->type == SOCK_PE_TX)
 		ofi_rbreset(&pe_entry->comm_buf);
 
@@ -200,33 +193,69 @@ static void sock_pe_release_entry(struct sock_pe *pe,
 	SOCK_LOG_DBG("progress entry %p released\n", pe_entry);
 }
 
+/*
+ * PE entries are carved out of an indexed buffer pool on demand and are
+ * recycled through the free list afterwards.  The pool index doubles as the
+ * pe_entry_id carried on the wire, so it must fit in 16 bits.
+ */
+static struct sock_pe_entry *sock_pe_grow_entry(struct sock_pe *pe)
+{
+	struct sock_pe_entry *pe_entry;
+
+	if (pe->num_entries >= SOCK_PE_MAX_ENTRIES)
+		return NULL;
+
+	pe_entry = ofi_ibuf_alloc(pe->pe_pool);
+	if (!pe_entry)
+		return NULL;
+
+	memset(pe_entry, 0, sizeof(*pe_entry));
+	pe_entry->cache_sz = SOCK_PE_COMM_BUFF_SZ;
+	if (ofi_rbinit(&pe_entry->comm_buf, SOCK_PE_COMM_BUFF_SZ)) {
+		SOCK_LOG_ERROR("failed to init comm-cache\n");
+		ofi_ibuf_free(pe_entry);
+		return NULL;
+	}
+
+	dlist_init(&pe_entry->entry);
+	pe->num_entries++;
+	SOCK_LOG_DBG("PE table grown to %zu entries\n", pe->num_entries);
+	return pe_entry;
+}
+
+static inline int sock_pe_entry_avail(struct sock_pe *pe)
+{
+	return !dlist_empty(&pe->free_list) ||
+	       pe->num_entries < SOCK_PE_MAX_ENTRIES;
+}
+
+static inline struct sock_pe_entry *
+sock_pe_lookup_entry(struct sock_pe *pe, uint16_t pe_entry_id)
+{
+	assert(pe_entry_id < pe->num_entries);
+	return ofi_bufpool_get_ibuf(pe->pe_pool, pe_entry_id);
+}
+
 static struct sock_pe_entry *sock_pe_acquire_entry(struct sock_pe *pe)
 {
 	struct dlist_entry *entry;
 	struct sock_pe_entry *pe_entry;
 
 	if (dlist_empty(&pe->free_list)) {
-		pe_entry = ofi_buf_alloc(pe->pe_rx_pool);
-		SOCK_LOG_DBG("Getting rx pool entry\n");
-		if (pe_entry) {
-			memset(pe_entry, 0, sizeof(*pe_entry));
-			pe_entry->is_pool_entry = 1;
-			if (ofi_rbinit(&pe_entry->comm_buf, SOCK_PE_OVERFLOW_COMM_BUFF_SZ))
-				SOCK_LOG_ERROR("failed to init comm-cache\n");
-			pe_entry->cache_sz = SOCK_PE_OVERFLOW_COMM_BUFF_SZ;
-			dlist_insert_tail(&pe_entry->entry, &pe->pool_list);
-		}
+		pe_entry = sock_pe_grow_entry(pe);
+		if (!pe_entry)
+			return NULL;
 	} else {
 		pe->num_free_entries--;
 		entry = pe->free_list.next;
 		pe_entry = container_of(entry, struct sock_pe_entry, entry);
-
 		assert(ofi_rbempty(&pe_entry->comm_buf));
 		dlist_remove(&pe_entry->entry);
-		dlist_insert_tail(&pe_entry->entry, &pe->busy_list);
-		SOCK_LOG_DBG("progress entry %p acquired : %lu\n", pe_entry,
-			     PE_INDEX(pe, pe_entry));
 	}
+
+	dlist_insert_tail(&pe_entry->entry, &pe->busy_list);
+	SOCK_LOG_DBG("progress entry %p acquired : %lu\n", pe_entry,
+		     PE_INDEX(pe, pe_entry));
 	return pe_entry;
 }
 
@@ -579,8 +608,7 @@ static int sock_pe_handle_ack(struct sock_pe *pe,
 		return 0;
 
 	response = &pe_entry->response;
-	assert(response->pe_entry_id <= SOCK_PE_MAX_ENTRIES);
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	SOCK_LOG_DBG("Received ack for PE entry %p (index: %d)\n",
 		      waiting_entry, response->pe_entry_id);
 
@@ -601,8 +629,7 @@ static int sock_pe_handle_error(struct sock_pe *pe,
 		return 0;
 
 	response = &pe_entry->response;
-	assert(response->pe_entry_id <= SOCK_PE_MAX_ENTRIES);
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	SOCK_LOG_ERROR("Received error for PE entry %p (index: %d)\n",
 		      waiting_entry, response->pe_entry_id);
 
@@ -637,12 +664,11 @@ static int sock_pe_handle_read_complete(struct sock_pe *pe,
 		return 0;
 
 	response = &pe_entry->response;
-	assert(response->pe_entry_id <= SOCK_PE_MAX_ENTRIES);
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	SOCK_LOG_DBG("Received read complete for PE entry %p (index: %d)\n",
 		      waiting_entry, response->pe_entry_id);
 
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	assert(waiting_entry->type == SOCK_PE_TX);
 
 	len = sizeof(struct sock_msg_response);
@@ -671,8 +697,7 @@ static int sock_pe_handle_write_complete(struct sock_pe *pe,
 		return 0;
 
 	response = &pe_entry->response;
-	assert(response->pe_entry_id <= SOCK_PE_MAX_ENTRIES);
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	SOCK_LOG_DBG("Received ack for PE entry %p (index: %d)\n",
 		      waiting_entry, response->pe_entry_id);
 
@@ -695,12 +720,11 @@ static int sock_pe_handle_atomic_complete(struct sock_pe *pe,
 		return 0;
 
 	response = &pe_entry->response;
-	assert(response->pe_entry_id <= SOCK_PE_MAX_ENTRIES);
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	SOCK_LOG_DBG("Received atomic complete for PE entry %p (index: %d)\n",
 		      waiting_entry, response->pe_entry_id);
 
-	waiting_entry = &pe->pe_table[response->pe_entry_id];
+	waiting_entry = sock_pe_lookup_entry(pe, response->pe_entry_id);
 	assert(waiting_entry->type == SOCK_PE_TX);
 
 	len = sizeof(struct sock_msg_response);
@@ -979,6 +1003,8 @@ static int sock_pe_process_rx_atomic(struct sock_pe *pe,
 		pe->pe_atomic = pe_entry;
 	}
 
+	/* targets may be shared with endpoints progressed by other PEs */
+	ofi_mutex_lock(&rx_ctx->domain->atomic_lock);
 	offset = 0;
 	for (i = 0; i < pe_entry->pe.rx.rx_op.dest_iov_len; i++) {
 		sock_pe_do_atomic(pe_entry->pe.rx.atomic_cmp + offset,
@@ -990,6 +1016,7 @@ static int sock_pe_process_rx_atomic(struct sock_pe *pe,
 			pe_entry->pe.rx.rx_op.atomic.res_iov_len);
 		offset += datatype_sz * pe_entry->pe.rx.rx_iov[i].ioc.count;
 	}
+	ofi_mutex_unlock(&rx_ctx->domain->atomic_lock);
 
 	pe_entry->buf = pe_entry->pe.rx.rx_iov[0].iov.addr;
 	pe_entry->data_len = offset;
@@ -1253,10 +1280,12 @@ static int sock_pe_progress_buffered_rx(struct sock_rx_ctx *rx_ctx,
 			      rx_posted->iov[i].iov.addr + dst_offset;
 
 			if (datatype_sz) {
+				ofi_mutex_lock(&rx_ctx->domain->atomic_lock);
 				sock_pe_do_atomic(NULL, dst, src,
 					rx_buffered->rx_op.atomic.datatype,
 					rx_buffered->rx_op.atomic.op,
 					len / datatype_sz, 0);
+				ofi_mutex_unlock(&rx_ctx->domain->atomic_lock);
 			} else {
 				memcpy(dst, src, len);
 			}
@@ -1322,6 +1351,8 @@ static int sock_pe_process_rx_send(struct sock_pe *pe,
 {
 	ssize_t i, ret = 0;
 	struct sock_rx_entry *rx_entry;
+	struct iovec iov[SOCK_EP_MAX_IOV_LIMIT];
+	size_t iov_cnt;
 	uint64_t len, rem, offset, data_len, done_data, used;
 
 	offset = 0;
@@ -1386,28 +1417,36 @@ static int sock_pe_process_rx_send(struct sock_pe *pe,
 	done_data = pe_entry->done_len - len;
 	pe_entry->data_len = data_len;
 	rem = pe_entry->data_len - done_data;
-	used = rx_entry->used;
 
-	for (i = 0; rem > 0 && i < rx_entry->rx_op.dest_iov_len; i++) {
+	while (rem > 0) {
+		iov_cnt = 0;
+		data_len = 0;
+		used = rx_entry->used;
+		for (i = 0; data_len < rem && i < rx_entry->rx_op.dest_iov_len; i++) {
+			/* skip used contents in rx_entry */
+			if (used >= rx_entry->iov[i].iov.len) {
+				used -= rx_entry->iov[i].iov.len;
+				continue;
+			}
 
-		/* skip used contents in rx_entry */
-		if (used >= rx_entry->iov[i].iov.len) {
-			used -= rx_entry->iov[i].iov.len;
-			continue;
+			offset = used;
+			iov[iov_cnt].iov_base = (char *) (uintptr_t)
+						rx_entry->iov[i].iov.addr + offset;
+			iov[iov_cnt].iov_len = MIN(rx_entry->iov[i].iov.len - used,
+						   rem - data_len);
+			data_len += iov[iov_cnt++].iov_len;
+			used = 0;
 		}
+		if (!iov_cnt)
+			break;
 
-		offset = used;
-		data_len = MIN(rx_entry->iov[i].iov.len - used, rem);
-		ret = sock_comm_recv(pe_entry,
-				     (char *) (uintptr_t) rx_entry->iov[i].iov.addr + offset,
-				     data_len);
+		ret = sock_comm_recvv(pe_entry, iov, iov_cnt);
 		if (ret <= 0)
 			return (int) ret;
 
 		if (!pe_entry->buf)
-			pe_entry->buf = rx_entry->iov[i].iov.addr + offset;
+			pe_entry->buf = (uintptr_t) iov[0].iov_base;
 		rem -= ret;
-		used = 0;
 		pe_entry->done_len += ret;
 		rx_entry->used += ret;
 		if ((size_t) ret != data_len)
@@ -2116,6 +2155,8 @@ static int sock_pe_new_tx_entry(struct sock_pe *pe, struct sock_tx_ctx *tx_ctx)
 	struct sock_ep_attr *ep_attr;
 
 	pe_entry = sock_pe_acquire_entry(pe);
+	if (!pe_entry)
+		return 0;
 	memset(&pe_entry->pe.tx, 0, sizeof(pe_entry->pe.tx));
 	memset(&pe_entry->msg_hdr, 0, sizeof(pe_entry->msg_hdr));
 
@@ -2352,16 +2393,20 @@ out:
 
 void sock_pe_remove_tx_ctx(struct sock_tx_ctx *tx_ctx)
 {
-	pthread_mutex_lock(&tx_ctx->domain->pe->list_lock);
+	struct sock_pe *pe = sock_tx_ctx_pe(tx_ctx);
+
+	pthread_mutex_lock(&pe->list_lock);
 	dlist_remove(&tx_ctx->pe_entry);
-	pthread_mutex_unlock(&tx_ctx->domain->pe->list_lock);
+	pthread_mutex_unlock(&pe->list_lock);
 }
 
 void sock_pe_remove_rx_ctx(struct sock_rx_ctx *rx_ctx)
 {
-	pthread_mutex_lock(&rx_ctx->domain->pe->list_lock);
+	struct sock_pe *pe = sock_rx_ctx_pe(rx_ctx);
+
+	pthread_mutex_lock(&pe->list_lock);
 	dlist_remove(&rx_ctx->pe_entry);
-	pthread_mutex_unlock(&rx_ctx->domain->pe->list_lock);
+	pthread_mutex_unlock(&pe->list_lock);
 }
 
 static int sock_pe_progress_rx_ep(struct sock_pe *pe,
@@ -2540,7 +2585,7 @@ int sock_pe_progress_tx_ctx(struct sock_pe *pe, struct sock_tx_ctx *tx_ctx)
 	}
 
 	ofi_mutex_lock(&tx_ctx->rb_lock);
-	if (!ofi_rbempty(&tx_ctx->rb) && !dlist_empty(&pe->free_list)) {
+	if (!ofi_rbempty(&tx_ctx->rb) && sock_pe_entry_avail(pe)) {
 		ret = sock_pe_new_tx_entry(pe, tx_ctx);
 	}
 	ofi_mutex_unlock(&tx_ctx->rb_lock);
@@ -2683,23 +2728,11 @@ static void *sock_pe_progress_thread(void *data)
 
 static void sock_pe_init_table(struct sock_pe *pe)
 {
-	int i;
-
-	memset(&pe->pe_table, 0,
-	       sizeof(struct sock_pe_entry) * SOCK_PE_MAX_ENTRIES);
-
 	dlist_init(&pe->free_list);
 	dlist_init(&pe->busy_list);
-	dlist_init(&pe->pool_list);
 
-	for (i = 0; i < SOCK_PE_MAX_ENTRIES; i++) {
-		dlist_insert_head(&pe->pe_table[i].entry, &pe->free_list);
-		pe->pe_table[i].cache_sz = SOCK_PE_COMM_BUFF_SZ;
-		if (ofi_rbinit(&pe->pe_table[i].comm_buf, SOCK_PE_COMM_BUFF_SZ))
-			SOCK_LOG_ERROR("failed to init comm-cache\n");
-	}
-
-	pe->num_free_entries = SOCK_PE_MAX_ENTRIES;
+	pe->num_free_entries = 0;
+	pe->num_entries = 0;
 	SOCK_LOG_DBG("PE table init: OK\n");
 }
 
@@ -2718,11 +2751,13 @@ struct sock_pe *sock_pe_init(struct sock_domain *domain)
 	ofi_mutex_init(&pe->lock);
 	ofi_mutex_init(&pe->signal_lock);
 	pthread_mutex_init(&pe->list_lock, NULL);
+	ofi_atomic_initialize32(&pe->ep_cnt, 0);
 	pe->domain = domain;
 
 
-	ret = ofi_bufpool_create(&pe->pe_rx_pool,
-				 sizeof(struct sock_pe_entry), 16, 0, 1024, 0);
+	ret = ofi_bufpool_create(&pe->pe_pool, sizeof(struct sock_pe_entry),
+				 16, SOCK_PE_MAX_ENTRIES, SOCK_PE_CHUNK_ENTRIES,
+				 OFI_BUFPOOL_INDEXED);
 	if (ret) {
 		SOCK_LOG_ERROR("failed to create buffer pool\n");
 		goto err1;
@@ -2768,33 +2803,35 @@ err4:
 err3:
 	ofi_bufpool_destroy(pe->atomic_rx_pool);
 err2:
-	ofi_bufpool_destroy(pe->pe_rx_pool);
+	ofi_bufpool_destroy(pe->pe_pool);
 err1:
 	ofi_mutex_destroy(&pe->lock);
 	free(pe);
 	return NULL;
 }
 
-static void sock_pe_free_util_pool(struct sock_pe *pe)
+static void sock_pe_free_entry_list(struct dlist_entry *list)
 {
-	struct dlist_entry *entry;
 	struct sock_pe_entry *pe_entry;
 
-	while (!dlist_empty(&pe->pool_list)) {
-		entry = pe->pool_list.next;
-		pe_entry = container_of(entry, struct sock_pe_entry, entry);
+	while (!dlist_empty(list)) {
+		dlist_pop_front(list, struct sock_pe_entry, pe_entry, entry);
 		ofi_rbfree(&pe_entry->comm_buf);
-		dlist_remove(&pe_entry->entry);
-		ofi_buf_free(pe_entry);
+		ofi_ibuf_free(pe_entry);
 	}
+}
 
-	ofi_bufpool_destroy(pe->pe_rx_pool);
+static void sock_pe_free_util_pool(struct sock_pe *pe)
+{
+	sock_pe_free_entry_list(&pe->free_list);
+	sock_pe_free_entry_list(&pe->busy_list);
+
+	ofi_bufpool_destroy(pe->pe_pool);
 	ofi_bufpool_destroy(pe->atomic_rx_pool);
 }
 
 void sock_pe_finalize(struct sock_pe *pe)
 {
-	int i;
 	if (pe->domain->progress_mode == FI_PROGRESS_AUTO) {
 		pe->do_progress = 0;
 		sock_pe_signal(pe);
@@ -2803,10 +2840,6 @@ void sock_pe_finalize(struct sock_pe *pe)
 		ofi_close_socket(pe->signal_fds[1]);
 	}
 
-	for (i = 0; i < SOCK_PE_MAX_ENTRIES; i++) {
-		ofi_rbfree(&pe->pe_table[i].comm_buf);
-	}
-
 	sock_pe_free_util_pool(pe);
 	ofi_mutex_destroy(&pe->lock);
 	ofi_mutex_destroy(&pe->signal_lock);
@@ -2815,3 +2848,31 @@ void sock_pe_finalize(struct sock_pe *pe)
 	free(pe);
 	SOCK_LOG_DBG("Progress engine finalize: OK\n");
 }
+
+/*
+ * A domain may run several progress engines, each with its own progress
+ * thread, entry table and lock.  An endpoint is bound to a single engine for
+ * its lifetime, so the engine owns every connection in the endpoint's
+ * connection map and no two threads ever touch the same socket.  New
+ * endpoints go to the engine with the fewest endpoints attached.
+ */
+struct sock_pe *sock_pe_get(struct sock_domain *domain)
+{
+	struct sock_pe *pe;
+	size_t i;
+
+	pe = domain->pe_array[0];
+	for (i = 1; i < domain->pe_cnt; i++) {
+		if (ofi_atomic_get32(&domain->pe_array[i]->ep_cnt) <
+		    ofi_atomic_get32(&pe->ep_cnt))
+			pe = domain->pe_array[i];
+	}
+
+	ofi_atomic_inc32(&pe->ep_cnt);
+	return pe;
+}
+
+void sock_pe_put(struct sock_pe *pe)
+{
+	ofi_atomic_dec32(&pe->ep_cnt);
+}
@@ -67,7 +67,7 @@ static struct fi_ops udpx_domain_fi_ops = {
 	.close = udpx_domain_close,
 	.bind = fi_no_bind,
 	.control = fi_no_control,
-	.ops_open = fi_no_ops_open,
+	.ops_open = ofi_domain_ops_open,
 };
 
 static struct fi_ops_mr udpx_mr_ops = {
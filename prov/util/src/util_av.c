@@ -256,6 +256,28 @@ void *ofi_av_addr_context(struct util_av *av, fi_addr_t fi_addr)
 	return (char *) addr + av->context_offset;
 }
 
+/* Like ofi_av_addr_context(), but returns NULL for addresses beyond the
+ * entries of the AV, such as FI_ADDR_NOTAVAIL.  The entry is located
+ * directly, as ofi_bufpool_get_ibuf() asserts that its region is in use.
+ * Unused entries are zeroed, so callers that clear the context on removal
+ * can check it to tell whether the entry is in use.
+ */
+void *ofi_av_addr_context_checked(struct util_av *av, fi_addr_t fi_addr)
+{
+	struct ofi_bufpool *pool = av->av_entry_pool;
+	struct util_av_entry *entry = NULL;
+
+	ofi_mutex_lock(&av->lock);
+	if (fi_addr < pool->entry_cnt) {
+		entry = (struct util_av_entry *)
+			(pool->region_table[fi_addr / pool->attr.chunk_cnt]->
+			 mem_region + (fi_addr % pool->attr.chunk_cnt) *
+			 pool->entry_size);
+	}
+	ofi_mutex_unlock(&av->lock);
+	return entry ? entry->data + av->context_offset : NULL;
+}
+
 int ofi_verify_av_insert(struct util_av *av, uint64_t flags, void *context)
 {
 	if (av->flags & FI_EVENT) {
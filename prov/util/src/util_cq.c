@@ -227,7 +227,8 @@ ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 
 	cq = container_of(cq_fid, struct util_cq, cq_fid);
 
-	cq->progress(cq);
+	OFI_PROBE(util_cq_progress, cq->progress(cq));
+	OFI_PROBE_START(util_cq_read);
 	ofi_genlock_lock(&cq->cq_lock);
 	if (ofi_cirque_isempty(cq->cirq)) {
 		i = -FI_EAGAIN;
@@ -275,6 +276,7 @@ ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 	}
 out:
 	ofi_genlock_unlock(&cq->cq_lock);
+	OFI_PROBE_END(util_cq_read);
 	return i;
 }
 
@@ -86,11 +86,127 @@ int ofi_domain_close(struct util_domain *domain)
 	ofi_mutex_unlock(&domain->fabric->lock);
 
 	free(domain->name);
+	ofi_mutex_destroy(&domain->progress_lock);
 	ofi_genlock_destroy(&domain->lock);
 	ofi_atomic_dec32(&domain->fabric->ref);
 	return 0;
 }
 
+/* An endpoint is hot while its progress generates completions.  It goes
+ * cold after OFI_PROGRESS_IDLE calls without any, and cold endpoints are
+ * progressed on every OFI_PROGRESS_COLD_INTERVAL call only, unless no
+ * endpoint is hot.
+ */
+#define OFI_PROGRESS_IDLE		16
+#define OFI_PROGRESS_COLD_INTERVAL	16
+
+void ofi_domain_add_ep(struct util_domain *domain, struct util_ep *ep)
+{
+	if (!ep->progress)
+		return;
+
+	ofi_mutex_lock(&domain->progress_lock);
+	if (dlist_empty(&ep->progress_entry)) {
+		ep->progress_idle = 0;
+		dlist_insert_tail(&ep->progress_entry, &domain->progress_cold);
+	}
+	ofi_mutex_unlock(&domain->progress_lock);
+}
+
+void ofi_domain_remove_ep(struct util_domain *domain, struct util_ep *ep)
+{
+	ofi_mutex_lock(&domain->progress_lock);
+	dlist_remove_init(&ep->progress_entry);
+	ofi_mutex_unlock(&domain->progress_lock);
+}
+
+static uint64_t util_ep_comp_cnt(struct util_ep *ep)
+{
+	uint64_t cnt = 0;
+
+	if (ep->tx_cq)
+		cnt += ep->tx_cq->cirq->wcnt;
+	if (ep->rx_cq && ep->rx_cq != ep->tx_cq)
+		cnt += ep->rx_cq->cirq->wcnt;
+	if (ep->tx_cntr)
+		cnt += ofi_atomic_get64(&ep->tx_cntr->cnt);
+	if (ep->rx_cntr && ep->rx_cntr != ep->tx_cntr)
+		cnt += ofi_atomic_get64(&ep->rx_cntr->cnt);
+	return cnt;
+}
+
+/* Returns true if the endpoint generated completions */
+static bool util_domain_progress_ep(struct util_ep *ep)
+{
+	uint64_t comps;
+
+	ep->progress(ep);
+	comps = util_ep_comp_cnt(ep);
+	if (comps == ep->progress_comps) {
+		ep->progress_idle++;
+		return false;
+	}
+
+	ep->progress_comps = comps;
+	ep->progress_idle = 0;
+	return true;
+}
+
+static int util_domain_progress(struct fid_domain *domain_fid)
+{
+	struct util_domain *domain;
+	struct util_ep *ep;
+	struct dlist_entry *tmp;
+
+	domain = container_of(domain_fid, struct util_domain, domain_fid);
+	ofi_mutex_lock(&domain->progress_lock);
+	dlist_foreach_container_safe(&domain->progress_hot, struct util_ep,
+				     ep, progress_entry, tmp) {
+		if (!util_domain_progress_ep(ep) &&
+		    ep->progress_idle >= OFI_PROGRESS_IDLE) {
+			dlist_remove(&ep->progress_entry);
+			dlist_insert_tail(&ep->progress_entry,
+					  &domain->progress_cold);
+		}
+	}
+
+	if (!dlist_empty(&domain->progress_hot) &&
+	    ++domain->progress_cnt < OFI_PROGRESS_COLD_INTERVAL)
+		goto out;
+
+	domain->progress_cnt = 0;
+	dlist_foreach_container_safe(&domain->progress_cold, struct util_ep,
+				     ep, progress_entry, tmp) {
+		if (!util_domain_progress_ep(ep))
+			continue;
+
+		dlist_remove(&ep->progress_entry);
+		dlist_insert_tail(&ep->progress_entry, &domain->progress_hot);
+	}
+out:
+	ofi_mutex_unlock(&domain->progress_lock);
+	return 0;
+}
+
+static struct fi_ops_progress util_domain_progress_ops = {
+	.size = sizeof(struct fi_ops_progress),
+	.progress = util_domain_progress,
+};
+
+int ofi_domain_ops_open(struct fid *fid, const char *name, uint64_t flags,
+			void **ops, void *context)
+{
+	if (flags)
+		return -FI_EBADFLAGS;
+
+	if (!strcasecmp(name, FI_PROGRESS_OPS_1)) {
+		*ops = &util_domain_progress_ops;
+		return 0;
+	}
+
+	return -FI_ENOSYS;
+}
+
 static struct fi_ops_mr util_domain_mr_ops = {
 	.size = sizeof(struct fi_ops_mr),
 	.reg = fi_no_mr_reg,
@@ -121,6 +237,11 @@ util_domain_init(struct util_domain *domain, const struct fi_info *info,
 		ofi_genlock_destroy(&domain->lock);
 		return -FI_ENOMEM;
 	}
+
+	ofi_mutex_init(&domain->progress_lock);
+	dlist_init(&domain->progress_hot);
+	dlist_init(&domain->progress_cold);
+	domain->progress_cnt = 0;
 	return 0;
 }
 
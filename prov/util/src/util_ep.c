@@ -64,6 +64,7 @@ int ofi_ep_bind_cq(struct util_ep *ep, struct util_cq *cq, uint64_t flags)
 	}
 
 	if (flags & (FI_TRANSMIT | FI_RECV)) {
+		ofi_domain_add_ep(ep->domain, ep);
 		return fid_list_insert(&cq->ep_list,
 				       &cq->ep_list_lock,
 				       &ep->ep_fid.fid);
@@ -229,6 +230,7 @@ int ofi_endpoint_init(struct fid_domain *domain, const struct util_prov *util_pr
 	ep->caps = info->caps;
 	ep->flags = 0;
 	ep->progress = progress;
+	dlist_init(&ep->progress_entry);
 	ep->tx_op_flags = info->tx_attr->op_flags;
 	ep->rx_op_flags = info->rx_attr->op_flags;
 	ep->tx_msg_flags = 0;
@@ -269,6 +271,8 @@ int ofi_endpoint_init(struct fid_domain *domain, const struct util_prov *util_pr
 
 int ofi_endpoint_close(struct util_ep *util_ep)
 {
+	ofi_domain_remove_ep(util_ep->domain, util_ep);
+
 	if (util_ep->tx_cq) {
 		fid_list_remove(&util_ep->tx_cq->ep_list,
 				&util_ep->tx_cq->ep_list_lock,
@@ -92,6 +92,14 @@ static int util_poll_run(struct fid_poll *poll_fid, void **context, int count)
 		case FI_CLASS_CQ:
 			cq = container_of(fid_entry->fid, struct util_cq,
 					  cq_fid.fid);
+			/* Only util CQs record fi_cq_signal wakeups.  Report
+			 * a pending one so that fi_cq_sread returns for it.
+			 */
+			if (cq->cq_fid.ops->signal == ofi_cq_signal &&
+			    ofi_atomic_get32(&cq->wakeup)) {
+				ret = 1;
+				break;
+			}
 			ret = fi_cq_read(&cq->cq_fid, NULL, 0);
 			if (ret == 0 || ret == -FI_EAVAIL)
 				ret = 1;
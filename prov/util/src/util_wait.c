@@ -39,7 +39,6 @@
 #include <ofi_util.h>
 #include <ofi_epoll.h>
 
-
 int ofi_trywait(struct fid_fabric *fabric, struct fid **fids, int count)
 {
 	struct util_cq *cq;
@@ -134,6 +133,14 @@ int ofi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 	ofi_atomic_initialize32(&wait->ref, 0);
 	wait->wait_fid.fid.fclass = FI_CLASS_WAIT;
 
+	/* Read here rather than in fi_ini, as providers built as separate
+	 * libraries carry their own copy of the util code.
+	 */
+	wait->spin = 0;
+	fi_param_get_int(NULL, "wait_spin", &wait->spin);
+	if (wait->spin < 0)
+		wait->spin = 0;
+
 	switch (attr->wait_obj) {
 	case FI_WAIT_UNSPEC:
 		wait->wait_obj = FI_WAIT_FD;
@@ -269,11 +276,27 @@ out:
 	return ret;
 }
 
+/* The fence orders the caller's update of the CQ, EQ or counter, which
+ * may be made without a lock under FI_THREAD_DOMAIN, before the check for
+ * sleepers.  It pairs with the fence a waiter issues after registering.
+ */
 static void util_wait_fd_signal(struct util_wait *util_wait)
 {
 	struct util_wait_fd *wait;
 	wait = container_of(util_wait, struct util_wait_fd, util_wait);
-	fd_signal_set(&wait->signal);
+	ofi_atomic_fence();
+	if (ofi_atomic_get32(&wait->sleepers))
+		fd_signal_set(&wait->signal);
+}
+
+static void util_wait_fd_export(struct util_wait_fd *wait)
+{
+	ofi_mutex_lock(&wait->util_wait.lock);
+	if (!wait->exported) {
+		wait->exported = true;
+		ofi_atomic_inc32(&wait->sleepers);
+	}
+	ofi_mutex_unlock(&wait->util_wait.lock);
 }
 
 static int util_wait_update_pollfd(struct util_wait_fd *wait_fd,
@@ -371,29 +394,55 @@ release:
 	return ret;
 }
 
+/* Events are polled for up to wait->spin microseconds before the
+ * thread blocks.  A blocking thread registers as a sleeper and checks
+ * for events once more, so that a signal raised before it registered is
+ * not lost.  The recheck polls the CQs, EQs and counters of the wait
+ * set through its pollset, which also reports pending fi_cq_signal
+ * wakeups.
+ */
 static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 {
 	struct ofi_epollfds_event event;
 	struct util_wait_fd *wait;
-	uint64_t endtime;
+	uint64_t endtime, spin_end;
+	bool sleeping = false;
 	int ret;
 
 	wait = container_of(wait_fid, struct util_wait_fd, util_wait.wait_fid);
 	endtime = ofi_timeout_time(timeout);
+	spin_end = ofi_gettime_us() + wait->util_wait.spin;
 
 	while (1) {
 		ret = wait->util_wait.wait_try(&wait->util_wait);
-		if (ret)
-			return ret == -FI_EAGAIN ? 0 : ret;
+		if (ret) {
+			if (ret == -FI_EAGAIN)
+				ret = 0;
+			break;
+		}
+
+		if (ofi_adjust_timeout(endtime, &timeout)) {
+			ret = -FI_ETIMEDOUT;
+			break;
+		}
+
+		if (wait->util_wait.spin && ofi_gettime_us() < spin_end)
+			continue;
 
-		if (ofi_adjust_timeout(endtime, &timeout))
-			return -FI_ETIMEDOUT;
+		if (!sleeping) {
+			ofi_atomic_inc32(&wait->sleepers);
+			ofi_atomic_fence();
+			sleeping = true;
+			continue;
+		}
 
 		ret = (wait->util_wait.wait_obj == FI_WAIT_FD) ?
 		      ofi_epoll_wait(wait->epoll_fd, &event, 1, timeout) :
 		      ofi_pollfds_wait(wait->pollfds, &event, 1, timeout);
-		if (ret > 0)
-			return FI_SUCCESS;
+		if (ret > 0) {
+			ret = FI_SUCCESS;
+			break;
+		}
 
 		if (ret < 0) {
 #if ENABLE_DEBUG
@@ -403,9 +452,13 @@ static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 #endif
 			FI_WARN(wait->util_wait.prov, FI_LOG_FABRIC,
 				"poll failed\n");
-			return ret;
+			break;
 		}
 	}
+
+	if (sleeping)
+		ofi_atomic_dec32(&wait->sleepers);
+	return ret;
 }
 
 static int util_wait_fd_control(struct fid *fid, int command, void *arg)
@@ -417,6 +470,7 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 	wait = container_of(fid, struct util_wait_fd, util_wait.wait_fid.fid);
 	switch (command) {
 	case FI_GETWAIT:
+		util_wait_fd_export(wait);
 		if (wait->util_wait.wait_obj == FI_WAIT_FD) {
 #ifdef HAVE_EPOLL
 			*(int *) arg = wait->epoll_fd;
@@ -541,6 +595,7 @@ int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
 
 	wait->util_wait.signal = util_wait_fd_signal;
 	wait->util_wait.wait_try = util_wait_fd_try;
+	ofi_atomic_initialize32(&wait->sleepers, 0);
 	ret = fd_signal_init(&wait->signal);
 	if (ret)
 		goto err2;
@@ -2122,18 +2122,6 @@ void ofi_get_list_of_addr(const struct fi_provider *prov, const char *env_name,
 }
 #endif
 
-int ofi_cpu_supports(unsigned func, unsigned reg, unsigned bit)
-{
-	unsigned cpuinfo[4] = { 0 };
-
-	ofi_cpuid(0, 0, cpuinfo);
-	if (cpuinfo[0] < func)
-		return 0;
-
-	ofi_cpuid(func, 0, cpuinfo);
-	return cpuinfo[reg] & bit;
-}
-
 void ofi_remove_comma(char *buffer)
 {
 	size_t sz = strlen(buffer);
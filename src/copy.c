@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ofi.h>
+#include <ofi_mem.h>
+#include <ofi_atomic.h>
+#include <ofi_list.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define OFI_COPY_X86 1
+#endif
+
+#define OFI_COPY_PREFETCH	512
+#define OFI_COPY_NT_MIN		(64 * 1024)
+#define OFI_COPY_NT_DEFAULT	(1024 * 1024)
+#define OFI_COPY_CHUNK_MIN	(256 * 1024)
+#define OFI_COPY_THREAD_CHUNKS	4
+
+/*
+ * Each engine streams len bytes with non-temporal stores, without a
+ * trailing fence.  The destination is aligned to the vector size with an
+ * ordinary copy first.  Copies shorter than OFI_COPY_NT_MIN, which a
+ * thread may issue while another selects the engine, use memcpy.
+ */
+struct ofi_copy_engine {
+	const char	*name;
+	int		(*supported)(void);
+	void		(*stream)(void *dst, const void *src, size_t len);
+};
+
+static void copy_nt_init(void *dst, const void *src, size_t len);
+
+size_t ofi_copy_nt_size;
+void (*ofi_copy_nt)(void *dst, const void *src, size_t len) = copy_nt_init;
+const char *ofi_copy_engine_name = "memcpy";
+
+static void (*copy_stream)(void *dst, const void *src, size_t len);
+static pthread_mutex_t copy_select_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * ofi_copy reads the threshold and the function without a lock, so the
+ * function is stored last and with release semantics.
+ */
+#ifdef __GNUC__
+#define copy_publish(ptr, val)	__atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define copy_acquire(ptr)	__atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#else
+#define copy_publish(ptr, val)	(*(ptr) = (val))
+#define copy_acquire(ptr)	(*(ptr))
+#endif
+
+
+static int copy_supported(void)
+{
+	return 1;
+}
+
+static void copy_stream_memcpy(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+#ifdef OFI_COPY_X86
+
+#define OFI_XCR0_AVX		0x06
+#define OFI_XCR0_AVX512		0xe6
+
+/* The OS must save the vector registers for their use to be safe */
+static int copy_xcr0_enabled(uint32_t mask)
+{
+	uint32_t eax, edx;
+
+	if (!ofi_cpu_supports(0x1, OFI_OSXSAVE_REG, OFI_OSXSAVE_BIT))
+		return 0;
+
+	asm volatile("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return (eax & mask) == mask;
+}
+
+static void copy_stream_sse2(void *dst, const void *src, size_t len)
+{
+	const char *s = src;
+	char *d = dst;
+	size_t head;
+	__m128i a, b, c, e;
+
+	if (len < OFI_COPY_NT_MIN) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	head = -(uintptr_t) d & 15;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	len -= head;
+
+	for (; len >= 64; len -= 64, d += 64, s += 64) {
+		_mm_prefetch(s + OFI_COPY_PREFETCH, _MM_HINT_NTA);
+		a = _mm_loadu_si128((const __m128i *) s);
+		b = _mm_loadu_si128((const __m128i *) (s + 16));
+		c = _mm_loadu_si128((const __m128i *) (s + 32));
+		e = _mm_loadu_si128((const __m128i *) (s + 48));
+		_mm_stream_si128((__m128i *) d, a);
+		_mm_stream_si128((__m128i *) (d + 16), b);
+		_mm_stream_si128((__m128i *) (d + 32), c);
+		_mm_stream_si128((__m128i *) (d + 48), e);
+	}
+	memcpy(d, s, len);
+}
+
+#ifdef HAVE_AVX_TARGET
+
+static int copy_supported_avx2(void)
+{
+	return ofi_cpu_supports(0x7, OFI_AVX2_REG, OFI_AVX2_BIT) &&
+	       copy_xcr0_enabled(OFI_XCR0_AVX);
+}
+
+__attribute__((target("avx2")))
+static void copy_stream_avx2(void *dst, const void *src, size_t len)
+{
+	const char *s = src;
+	char *d = dst;
+	size_t head;
+	__m256i a, b, c, e;
+
+	if (len < OFI_COPY_NT_MIN) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	head = -(uintptr_t) d & 31;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	len -= head;
+
+	for (; len >= 128; len -= 128, d += 128, s += 128) {
+		_mm_prefetch(s + OFI_COPY_PREFETCH, _MM_HINT_NTA);
+		_mm_prefetch(s + OFI_COPY_PREFETCH + 64, _MM_HINT_NTA);
+		a = _mm256_loadu_si256((const __m256i *) s);
+		b = _mm256_loadu_si256((const __m256i *) (s + 32));
+		c = _mm256_loadu_si256((const __m256i *) (s + 64));
+		e = _mm256_loadu_si256((const __m256i *) (s + 96));
+		_mm256_stream_si256((__m256i *) d, a);
+		_mm256_stream_si256((__m256i *) (d + 32), b);
+		_mm256_stream_si256((__m256i *) (d + 64), c);
+		_mm256_stream_si256((__m256i *) (d + 96), e);
+	}
+	_mm256_zeroupper();
+	memcpy(d, s, len);
+}
+
+static int copy_supported_avx512(void)
+{
+	return ofi_cpu_supports(0x7, OFI_AVX512F_REG,
+				OFI_AVX512F_BIT) &&
+	       copy_xcr0_enabled(OFI_XCR0_AVX512);
+}
+
+__attribute__((target("avx512f")))
+static void copy_stream_avx512(void *dst, const void *src, size_t len)
+{
+	const char *s = src;
+	char *d = dst;
+	size_t head;
+	__m512i a, b, c, e;
+
+	if (len < OFI_COPY_NT_MIN) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	head = -(uintptr_t) d & 63;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	len -= head;
+
+	for (; len >= 256; len -= 256, d += 256, s += 256) {
+		_mm_prefetch(s + OFI_COPY_PREFETCH, _MM_HINT_NTA);
+		_mm_prefetch(s + OFI_COPY_PREFETCH + 64, _MM_HINT_NTA);
+		_mm_prefetch(s + OFI_COPY_PREFETCH + 128, _MM_HINT_NTA);
+		_mm_prefetch(s + OFI_COPY_PREFETCH + 192, _MM_HINT_NTA);
+		a = _mm512_loadu_si512((const void *) s);
+		b = _mm512_loadu_si512((const void *) (s + 64));
+		c = _mm512_loadu_si512((const void *) (s + 128));
+		e = _mm512_loadu_si512((const void *) (s + 192));
+		_mm512_stream_si512((void *) d, a);
+		_mm512_stream_si512((void *) (d + 64), b);
+		_mm512_stream_si512((void *) (d + 128), c);
+		_mm512_stream_si512((void *) (d + 192), e);
+	}
+	_mm256_zeroupper();
+	memcpy(d, s, len);
+}
+
+#endif /* HAVE_AVX_TARGET */
+
+#define copy_fence()	_mm_sfence()
+
+#else /* OFI_COPY_X86 */
+
+#define copy_fence()	do { } while (0)
+
+#endif /* OFI_COPY_X86 */
+
+/* Ordered from most to least preferred */
+static const struct ofi_copy_engine copy_engines[] = {
+#ifdef OFI_COPY_X86
+#ifdef HAVE_AVX_TARGET
+	{ "avx512", copy_supported_avx512, copy_stream_avx512 },
+	{ "avx2", copy_supported_avx2, copy_stream_avx2 },
+#endif
+	{ "sse2", copy_supported, copy_stream_sse2 },
+#endif
+	{ "memcpy", copy_supported, copy_stream_memcpy },
+};
+
+static void copy_nt(void *dst, const void *src, size_t len)
+{
+	copy_stream(dst, src, len);
+	copy_fence();
+}
+
+static size_t copy_default_nt_size(void)
+{
+	long size = 0;
+
+	/* Larger copies would displace the private caches of the core */
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	return size > 0 ? (size_t) size : OFI_COPY_NT_DEFAULT;
+}
+
+static int copy_select(const char *name, size_t nt_size)
+{
+	const struct ofi_copy_engine *engine = NULL;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(copy_engines); i++) {
+		if (name && strcasecmp(name, copy_engines[i].name))
+			continue;
+		if (copy_engines[i].supported()) {
+			engine = &copy_engines[i];
+			break;
+		}
+	}
+	if (!engine)
+		return -FI_ENOSYS;
+
+	copy_publish(&copy_stream, engine->stream);
+	ofi_copy_engine_name = engine->name;
+	if (engine->stream == copy_stream_memcpy) {
+		ofi_copy_nt_size = SIZE_MAX;
+		copy_publish(&ofi_copy_nt, copy_stream_memcpy);
+	} else {
+		if (!nt_size)
+			nt_size = copy_default_nt_size();
+		ofi_copy_nt_size = MAX(nt_size, OFI_COPY_NT_MIN);
+		copy_publish(&ofi_copy_nt, copy_nt);
+	}
+	return 0;
+}
+
+/*
+ * Select the named engine, or the best supported one if name is NULL.
+ * A threshold of 0 selects the default.
+ */
+int ofi_copy_select(const char *name, size_t nt_size)
+{
+	int ret;
+
+	pthread_mutex_lock(&copy_select_lock);
+	ret = copy_select(name, nt_size);
+	pthread_mutex_unlock(&copy_select_lock);
+	return ret;
+}
+
+/*
+ * Providers built as separate libraries carry their own copy of this file,
+ * so the engine is selected on first use rather than by fi_ini.  Threads
+ * copying at the same time wait for the first one to select it.
+ */
+static void copy_select_default(void)
+{
+	size_t nt_size = 0;
+	char *name = NULL;
+
+	pthread_mutex_lock(&copy_select_lock);
+	if (copy_acquire(&ofi_copy_nt) != copy_nt_init)
+		goto unlock;
+
+	fi_param_get_str(NULL, "copy_engine", &name);
+	if (!fi_param_get_size_t(NULL, "copy_nt_size", &nt_size) && !nt_size)
+		nt_size = SIZE_MAX;
+	if (name && !strcasecmp(name, "auto"))
+		name = NULL;
+	if (copy_select(name, nt_size))
+		copy_select(NULL, nt_size);
+unlock:
+	pthread_mutex_unlock(&copy_select_lock);
+}
+
+static void copy_nt_init(void *dst, const void *src, size_t len)
+{
+	copy_select_default();
+	ofi_copy(dst, src, len);
+}
+
+void ofi_copy_init(void)
+{
+	fi_param_define(NULL, "copy_engine", FI_PARAM_STRING,
+			"Instruction set used for large memory copies: auto, "
+			"avx512, avx2, sse2 or memcpy (default: auto)");
+	fi_param_define(NULL, "copy_nt_size", FI_PARAM_SIZE_T,
+			"Copies of at least this many bytes bypass the cache "
+			"with non-temporal stores.  0 disables them "
+			"(default: the L2 cache size)");
+	copy_select_default();
+}
+
+void ofi_copy_batch(const struct ofi_copy_vec *vec, size_t count)
+{
+	bool streamed = false;
+	size_t i;
+
+	if (copy_acquire(&ofi_copy_nt) == copy_nt_init)
+		copy_select_default();
+
+	for (i = 0; i < count; i++) {
+		if (i + 1 < count)
+			ofi_prefetch(vec[i + 1].src);
+
+		if (vec[i].len < ofi_copy_nt_size) {
+			memcpy(vec[i].dst, vec[i].src, vec[i].len);
+		} else {
+			copy_stream(vec[i].dst, vec[i].src, vec[i].len);
+			streamed = true;
+		}
+	}
+	if (streamed)
+		copy_fence();
+}
+
+
+/*
+ * Copy pool.  A copy is split into page aligned chunks, which the calling
+ * thread and up to one helper per remaining chunk claim in order until
+ * none are left.  The caller returns once every chunk has been copied.
+ */
+struct ofi_copy_job {
+	struct dlist_entry	entry;
+	int			(*copy)(void *arg, size_t offset, size_t len);
+	void			*arg;
+	size_t			size;
+	size_t			chunk;
+	size_t			chunk_cnt;
+	size_t			helper_cnt;
+	ofi_atomic64_t		next;
+	ofi_atomic32_t		helpers;
+	ofi_atomic32_t		err;
+};
+
+struct ofi_copy_pool {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	struct dlist_entry	jobs;
+	int			run;
+	size_t			thread_cnt;
+	pthread_t		*threads;
+};
+
+static void copy_job_work(struct ofi_copy_job *job)
+{
+	size_t i, offset;
+	int ret;
+
+	while ((i = (size_t) ofi_atomic_inc64(&job->next) - 1) <
+	       job->chunk_cnt) {
+		offset = i * job->chunk;
+		ret = job->copy(job->arg, offset,
+				MIN(job->chunk, job->size - offset));
+		if (ret)
+			ofi_atomic_set32(&job->err, ret);
+	}
+}
+
+static void *copy_pool_thread(void *arg)
+{
+	struct ofi_copy_pool *pool = arg;
+	struct ofi_copy_job *job;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->run) {
+		if (dlist_empty(&pool->jobs)) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+
+		job = container_of(pool->jobs.next, struct ofi_copy_job,
+				   entry);
+		if ((size_t) ofi_atomic_inc32(&job->helpers) >=
+		    job->helper_cnt)
+			dlist_remove_init(&job->entry);
+		pthread_mutex_unlock(&pool->lock);
+
+		copy_job_work(job);
+		/* The job belongs to the caller once this drops to 0 */
+		ofi_atomic_dec32(&job->helpers);
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+int ofi_copy_pool_run(struct ofi_copy_pool *pool, size_t size,
+		      int (*copy)(void *arg, size_t offset, size_t len),
+		      void *arg)
+{
+	struct ofi_copy_job job;
+
+	if (!pool || size < 2 * OFI_COPY_CHUNK_MIN)
+		return copy(arg, 0, size);
+
+	job.copy = copy;
+	job.arg = arg;
+	job.size = size;
+	job.chunk = size / ((pool->thread_cnt + 1) * OFI_COPY_THREAD_CHUNKS);
+	job.chunk = ofi_get_aligned_size(MAX(job.chunk, OFI_COPY_CHUNK_MIN),
+					 ofi_get_page_size());
+	job.chunk_cnt = (size + job.chunk - 1) / job.chunk;
+	job.helper_cnt = MIN(pool->thread_cnt, job.chunk_cnt - 1);
+	ofi_atomic_initialize64(&job.next, 0);
+	ofi_atomic_initialize32(&job.helpers, 0);
+	ofi_atomic_initialize32(&job.err, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	dlist_insert_tail(&job.entry, &pool->jobs);
+	if (job.helper_cnt == 1)
+		pthread_cond_signal(&pool->cond);
+	else
+		pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	copy_job_work(&job);
+
+	pthread_mutex_lock(&pool->lock);
+	if (!dlist_empty(&job.entry))
+		dlist_remove_init(&job.entry);
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Every chunk has been claimed, wait for helpers still copying */
+	while (ofi_atomic_get32(&job.helpers))
+		sched_yield();
+
+	return ofi_atomic_get32(&job.err);
+}
+
+void ofi_copy_pool_close(struct ofi_copy_pool *pool)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->run = 0;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->thread_cnt; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+int ofi_copy_pool_open(size_t thread_cnt, struct ofi_copy_pool **pool)
+{
+	struct ofi_copy_pool *copy_pool;
+	size_t i;
+	int ret;
+
+	if (!thread_cnt)
+		return -FI_EINVAL;
+
+	copy_pool = calloc(1, sizeof(*copy_pool));
+	if (!copy_pool)
+		return -FI_ENOMEM;
+
+	copy_pool->threads = calloc(thread_cnt, sizeof(*copy_pool->threads));
+	if (!copy_pool->threads) {
+		free(copy_pool);
+		return -FI_ENOMEM;
+	}
+
+	pthread_mutex_init(&copy_pool->lock, NULL);
+	pthread_cond_init(&copy_pool->cond, NULL);
+	dlist_init(&copy_pool->jobs);
+	copy_pool->run = 1;
+
+	for (i = 0; i < thread_cnt; i++) {
+		ret = pthread_create(&copy_pool->threads[i], NULL,
+				     copy_pool_thread, copy_pool);
+		if (ret)
+			break;
+		copy_pool->thread_cnt++;
+	}
+
+	if (i < thread_cnt) {
+		ofi_copy_pool_close(copy_pool);
+		return -ret;
+	}
+
+	*pool = copy_pool;
+	return 0;
+}
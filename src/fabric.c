@@ -805,6 +805,7 @@ void fi_ini(void)
 	ofi_osd_init();
 	ofi_mem_init();
 	ofi_pmem_init();
+	ofi_copy_init();
 	ofi_perf_init();
 	ofi_hook_init();
 	ofi_hmem_init();
@@ -826,6 +827,10 @@ void fi_ini(void)
 			"this to optimize resource allocations "
 			"(default: provider specific)");
 	fi_param_get_size_t(NULL, "universe_size", &ofi_universe_size);
+	fi_param_define(NULL, "wait_spin", FI_PARAM_INT,
+			"Time in microseconds that blocking calls such as "
+			"fi_cq_sread poll for events before the thread goes "
+			"to sleep (default: 0)");
 
 	ofi_load_dl_prov();
 
@@ -170,6 +170,10 @@ static ssize_t ofi_copy_hmem_iov_buf(enum fi_hmem_iface hmem_iface, uint64_t dev
 		if (!len)
 			continue;
 
+		if (hmem_iface == FI_HMEM_SYSTEM && i + 1 < hmem_iov_count &&
+		    len < size)
+			ofi_prefetch(hmem_iov[i + 1].iov_base);
+
 		if (dir == OFI_COPY_BUF_TO_IOV)
 			ret = ofi_copy_to_hmem(hmem_iface, device, hmem_buf,
 					       (char *)buf + done, len);
@@ -56,10 +56,13 @@ uint64_t ofi_copy_iov_buf(const struct iovec *iov, size_t iov_count, uint64_t io
 		len -= iov_offset;
 
 		len = MIN(len, bufsize);
+		if (i + 1 < iov_count && len < bufsize)
+			ofi_prefetch(iov[i + 1].iov_base);
+
 		if (dir == OFI_COPY_BUF_TO_IOV)
-			memcpy(iov_buf, (char *) buf + done, len);
+			ofi_copy(iov_buf, (char *) buf + done, len);
 		else if (dir == OFI_COPY_IOV_TO_BUF)
-			memcpy((char *) buf + done, iov_buf, len);
+			ofi_copy((char *) buf + done, iov_buf, len);
 
 		iov_offset = 0;
 		bufsize -= len;
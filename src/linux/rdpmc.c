@@ -25,8 +25,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <errno.h>
 
 #include <rdma/fi_errno.h>
+#include "ofi.h"
 
 
 /**
@@ -90,16 +92,18 @@ int rdpmc_open(unsigned counter, struct rdpmc_ctx *ctx)
 int rdpmc_open_attr(struct perf_event_attr *attr, struct rdpmc_ctx *ctx,
 		    struct rdpmc_ctx *leader_ctx)
 {
+	int err;
+
 	ctx->fd = perf_event_open(attr, 0, -1,
 			  leader_ctx ? leader_ctx->fd : -1, 0);
-	if (ctx->fd < 0) {
-		perror("perf_event_open");
+	if (ctx->fd < 0)
 		return -1;
-	}
+
 	ctx->buf = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, ctx->fd, 0);
 	if (ctx->buf == MAP_FAILED) {
+		err = errno;
 		close(ctx->fd);
-		perror("mmap on perf fd");
+		errno = err;
 		return -1;
 	}
 	/* Not sure why this happens? */
@@ -181,6 +185,8 @@ static uint64_t rdpmc_sw_id(uint32_t cntr_id)
 	}
 }
 
+static int rdpmc_failed;
+
 int ofi_pmu_open(struct ofi_perf_ctx **ctx, enum ofi_perf_domain domain,
 		 uint32_t cntr_id, uint32_t flags)
 {
@@ -209,14 +215,32 @@ int ofi_pmu_open(struct ofi_perf_ctx **ctx, enum ofi_perf_domain domain,
 		attr.config = rdpmc_sw_id(cntr_id);
 		break;
 	default:
-		return -FI_ENOSYS;
+		ret = -FI_ENOSYS;
+		goto err;
 	}
 
-	if (attr.config == ~0)
-		return -FI_ENOSYS;
+	if (attr.config == ~0) {
+		ret = -FI_ENOSYS;
+		goto err;
+	}
 
 	ret = rdpmc_open_attr(&attr, &(*ctx)->ctx, NULL);
-	return ret ? -errno : 0;
+	if (ret) {
+		ret = errno ? -errno : -FI_ENOSYS;
+		/* Each thread using probes opens a counter, so a PMU that is
+		 * not available is only reported once.
+		 */
+		if (__sync_bool_compare_and_swap(&rdpmc_failed, 0, 1))
+			FI_INFO(&core_prov, FI_LOG_CORE,
+				"unable to open PMU counter: %s\n",
+				fi_strerror(-ret));
+		goto err;
+	}
+	return 0;
+err:
+	free(*ctx);
+	*ctx = NULL;
+	return ret;
 }
 
 inline uint64_t ofi_pmu_read(struct ofi_perf_ctx *ctx)
@@ -36,6 +36,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include <rdma/fi_errno.h>
 #include <rdma/fi_ext.h>
@@ -83,12 +84,27 @@ enum {
 	 ((uint64_t) (1 << level)))
 
 static int log_interval = 2000;
+static int log_rate;
+static int log_async;
+static size_t log_async_size = 256 * 1024;
+static FILE *log_file;
 uint64_t log_mask;
 struct fi_filter prov_log_filter;
 extern struct ofi_common_locks common_locks;
 
 static pid_t pid;
 
+static void ofi_log(const struct fi_provider *prov, enum fi_log_level level,
+		    enum fi_log_subsys subsys, const char *func, int line,
+		    const char *msg);
+static struct fi_ops_log ofi_import_log_ops;
+
+/* Log function restored when an imported logger is closed */
+static void (*ofi_log_default)(const struct fi_provider *prov,
+			       enum fi_log_level level,
+			       enum fi_log_subsys subsys, const char *func,
+			       int line, const char *msg) = ofi_log;
+
 static int fi_convert_log_str(const char *value)
 {
 	int i;
@@ -103,12 +119,499 @@ static int fi_convert_log_str(const char *value)
 	return 0;
 }
 
+#ifndef _WIN32
+
+#define OFI_LOG_FLUSH_MS	10
+#define OFI_LOG_MSG_MAX		1024
+#define OFI_LOG_SITES		64
+#define OFI_LOG_SITE_PROBE	4
+#define OFI_LOG_PAD		0xff
+
+/*
+ * The first 8 bytes are all that is written for a pad record, which may be
+ * that small.  The message is formatted by the caller, since its arguments
+ * may point to the caller's stack; the rest of the line is formatted by the
+ * log thread.  Names are copied, as providers may be unloaded before their
+ * messages are written.
+ */
+struct ofi_log_rec {
+	uint32_t		size;
+	uint8_t			level;
+	uint8_t			subsys;
+	uint16_t		reserved;
+	uint32_t		line;
+	uint32_t		suppressed;
+	uint64_t		ts;
+	char			prov[16];
+	char			func[40];
+	char			msg[];
+};
+
+struct ofi_log_site {
+	const char		*func;
+	int			line;
+	uint32_t		count;
+	uint32_t		suppressed;
+	uint64_t		start;
+};
+
+/*
+ * Single producer, single consumer byte ring.  Only the owning thread
+ * advances head, and only the log thread advances tail.  A record never
+ * wraps; the end of the buffer is filled with a pad record instead.  When
+ * the ring is full, new messages are dropped and counted.
+ */
+struct ofi_log_ring {
+	struct dlist_entry	entry;
+	ofi_atomic64_t		head;
+	ofi_atomic64_t		tail;
+	ofi_atomic64_t		drops;
+	ofi_atomic32_t		orphan;
+	uint64_t		size_mask;
+	/* Owned by the log thread */
+	uint64_t		cur;
+	uint64_t		end;
+	uint64_t		reported;
+	/* Owned by the producer */
+	struct ofi_log_site	site[OFI_LOG_SITES];
+	char			buf[];
+};
+
+static pthread_mutex_t log_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t log_async_thread;
+static pthread_key_t log_async_key;
+static struct dlist_entry log_async_rings;
+static uint64_t log_async_gen;
+static int log_async_run;
+
+static __thread struct ofi_log_ring *log_ring;
+static __thread uint64_t log_ring_gen;
+
+static uint64_t ofi_log_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void ofi_log_ring_orphan(void *arg)
+{
+	struct ofi_log_ring *ring = arg;
+
+	ofi_atomic_set32(&ring->orphan, 1);
+}
+
+static struct ofi_log_ring *ofi_log_ring_get(void)
+{
+	struct ofi_log_ring *ring;
+
+	if (log_ring && log_ring_gen == log_async_gen)
+		return log_ring;
+
+	ring = calloc(1, sizeof(*ring) + log_async_size);
+	if (!ring)
+		return NULL;
+
+	ofi_atomic_initialize64(&ring->head, 0);
+	ofi_atomic_initialize64(&ring->tail, 0);
+	ofi_atomic_initialize64(&ring->drops, 0);
+	ofi_atomic_initialize32(&ring->orphan, 0);
+	ring->size_mask = log_async_size - 1;
+
+	pthread_mutex_lock(&log_async_lock);
+	if (!log_async_run) {
+		pthread_mutex_unlock(&log_async_lock);
+		free(ring);
+		return NULL;
+	}
+	dlist_insert_tail(&ring->entry, &log_async_rings);
+	pthread_setspecific(log_async_key, ring);
+	log_ring_gen = log_async_gen;
+	pthread_mutex_unlock(&log_async_lock);
+
+	log_ring = ring;
+	return ring;
+}
+
+/*
+ * Allow log_rate messages per call site every log_interval ms.  The number
+ * suppressed is reported with the next message from the site.  Sites that
+ * do not fit in the table are not limited.
+ */
+static bool ofi_log_site_limit(struct ofi_log_ring *ring, const char *func,
+			       int line, uint64_t now, uint32_t *suppressed)
+{
+	struct ofi_log_site *site;
+	size_t i, slot;
+
+	slot = (size_t) ((((uintptr_t) func + line) *
+			  0x9E3779B97F4A7C15ULL) >> 32) % OFI_LOG_SITES;
+	for (i = 0; i < OFI_LOG_SITE_PROBE; i++) {
+		site = &ring->site[slot];
+		if (!site->func) {
+			site->func = func;
+			site->line = line;
+			site->start = now;
+			break;
+		}
+		if (site->func == func && site->line == line)
+			break;
+		slot = (slot + 1) % OFI_LOG_SITES;
+	}
+	if (i == OFI_LOG_SITE_PROBE)
+		return false;
+
+	if (now - site->start >= (uint64_t) log_interval * 1000000) {
+		*suppressed = site->suppressed;
+		site->start = now;
+		site->count = 0;
+		site->suppressed = 0;
+	}
+
+	if (site->count >= (uint32_t) log_rate) {
+		site->suppressed++;
+		return true;
+	}
+	site->count++;
+	return false;
+}
+
+static struct ofi_log_rec *
+ofi_log_reserve(struct ofi_log_ring *ring, size_t len, uint64_t *head)
+{
+	struct ofi_log_rec *rec;
+	uint64_t pos, pad, tail;
+
+	len = ofi_get_aligned_size(sizeof(*rec) + len, 8);
+	*head = ofi_atomic_get64(&ring->head);
+	tail = ofi_atomic_get64(&ring->tail);
+	pos = *head & ring->size_mask;
+	pad = (pos + len > log_async_size) ? log_async_size - pos : 0;
+
+	if (log_async_size - (*head - tail) < pad + len) {
+		ofi_atomic_inc64(&ring->drops);
+		return NULL;
+	}
+
+	if (pad) {
+		rec = (struct ofi_log_rec *) &ring->buf[pos];
+		rec->size = (uint32_t) pad;
+		rec->level = OFI_LOG_PAD;
+		*head += pad;
+		pos = 0;
+	}
+	return (struct ofi_log_rec *) &ring->buf[pos];
+}
+
+static void ofi_log_copy_name(char *dst, size_t size, const char *src)
+{
+	size_t len;
+
+	len = MIN(strlen(src), size - 1);
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+static void ofi_log_async_vlog(const struct fi_provider *prov,
+			       enum fi_log_level level,
+			       enum fi_log_subsys subsys, const char *func,
+			       int line, const char *fmt, va_list args)
+{
+	struct ofi_log_ring *ring;
+	struct ofi_log_rec *rec;
+	uint32_t suppressed = 0;
+	uint64_t head, now;
+	char msg[OFI_LOG_MSG_MAX];
+	int len;
+
+	ring = ofi_log_ring_get();
+	if (!ring) {
+		vsnprintf(msg, sizeof(msg), fmt, args);
+		ofi_log(prov, level, subsys, func, line, msg);
+		return;
+	}
+
+	now = ofi_log_now();
+	if (log_rate &&
+	    ofi_log_site_limit(ring, func, line, now, &suppressed))
+		return;
+
+	rec = ofi_log_reserve(ring, OFI_LOG_MSG_MAX, &head);
+	if (!rec)
+		return;
+
+	len = vsnprintf(rec->msg, OFI_LOG_MSG_MAX, fmt, args);
+	len = MIN(MAX(len, 0), OFI_LOG_MSG_MAX - 1);
+
+	rec->size = (uint32_t) ofi_get_aligned_size(sizeof(*rec) + len + 1, 8);
+	rec->level = (uint8_t) level;
+	rec->subsys = (uint8_t) subsys;
+	rec->line = line;
+	rec->suppressed = suppressed;
+	rec->ts = now;
+	ofi_log_copy_name(rec->prov, sizeof(rec->prov), prov->name);
+	ofi_log_copy_name(rec->func, sizeof(rec->func), func);
+
+	head += rec->size;
+	ofi_atomic_set64(&ring->head, head);
+
+	/* Wake the log thread early if the ring is filling up */
+	if (head - ofi_atomic_get64(&ring->tail) > log_async_size / 2)
+		pthread_cond_signal(&log_async_cond);
+}
+
+static void ofi_log_async_msg(const struct fi_provider *prov,
+			      enum fi_log_level level,
+			      enum fi_log_subsys subsys, const char *func,
+			      int line, const char *fmt, ...)
+{
+	va_list vargs;
+
+	va_start(vargs, fmt);
+	ofi_log_async_vlog(prov, level, subsys, func, line, fmt, vargs);
+	va_end(vargs);
+}
+
+static void ofi_log_async(const struct fi_provider *prov,
+			  enum fi_log_level level, enum fi_log_subsys subsys,
+			  const char *func, int line, const char *msg)
+{
+	ofi_log_async_msg(prov, level, subsys, func, line, "%s", msg);
+}
+
+static void ofi_log_write_hdr(uint64_t ts, const char *prov,
+			      const char *subsys, const char *func, int line,
+			      const char *level)
+{
+	fprintf(log_file, "%s:%d:%" PRIu64 ".%09" PRIu64 ":%s:%s:%s:%s():%d<%s> ",
+		PACKAGE, pid, ts / 1000000000, ts % 1000000000, log_prefix,
+		prov, subsys, func, line, level);
+}
+
+static void ofi_log_write(const struct ofi_log_rec *rec)
+{
+	if (rec->suppressed) {
+		ofi_log_write_hdr(rec->ts, rec->prov, log_subsys[rec->subsys],
+				  rec->func, rec->line, log_levels[rec->level]);
+		fprintf(log_file, "%" PRIu32 " messages suppressed by "
+			"log_rate\n", rec->suppressed);
+	}
+	ofi_log_write_hdr(rec->ts, rec->prov, log_subsys[rec->subsys],
+			  rec->func, rec->line, log_levels[rec->level]);
+	fputs(rec->msg, log_file);
+}
+
+static struct ofi_log_rec *ofi_log_ring_peek(struct ofi_log_ring *ring)
+{
+	struct ofi_log_rec *rec;
+
+	while (ring->cur != ring->end) {
+		rec = (struct ofi_log_rec *) &ring->buf[ring->cur &
+							ring->size_mask];
+		if (rec->level != OFI_LOG_PAD)
+			return rec;
+		ring->cur += rec->size;
+	}
+	return NULL;
+}
+
+/*
+ * Write out everything logged so far, merged across threads in timestamp
+ * order.  Caller must hold log_async_lock.
+ */
+static void ofi_log_async_drain(void)
+{
+	struct ofi_log_ring *ring, *min_ring;
+	struct ofi_log_rec *rec, *min_rec;
+	struct dlist_entry *tmp;
+	uint64_t drops;
+
+	dlist_foreach_container(&log_async_rings, struct ofi_log_ring,
+				ring, entry) {
+		ring->cur = ofi_atomic_get64(&ring->tail);
+		ring->end = ofi_atomic_get64(&ring->head);
+	}
+
+	for (;;) {
+		min_ring = NULL;
+		min_rec = NULL;
+		dlist_foreach_container(&log_async_rings, struct ofi_log_ring,
+					ring, entry) {
+			rec = ofi_log_ring_peek(ring);
+			if (rec && (!min_rec || rec->ts < min_rec->ts)) {
+				min_rec = rec;
+				min_ring = ring;
+			}
+		}
+		if (!min_rec)
+			break;
+
+		ofi_log_write(min_rec);
+		min_ring->cur += min_rec->size;
+	}
+
+	dlist_foreach_container_safe(&log_async_rings, struct ofi_log_ring,
+				     ring, entry, tmp) {
+		ofi_atomic_set64(&ring->tail, ring->cur);
+
+		drops = ofi_atomic_get64(&ring->drops);
+		if (drops != ring->reported) {
+			ofi_log_write_hdr(ofi_log_now(), core_prov.name,
+					  log_subsys[FI_LOG_CORE], __func__,
+					  __LINE__, log_levels[FI_LOG_WARN]);
+			fprintf(log_file, "%" PRIu64 " messages dropped, "
+				"increase FI_LOG_ASYNC_SIZE\n",
+				drops - ring->reported);
+			ring->reported = drops;
+		}
+
+		if (ofi_atomic_get32(&ring->orphan) &&
+		    ring->cur == ofi_atomic_get64(&ring->head)) {
+			dlist_remove(&ring->entry);
+			free(ring);
+		}
+	}
+	fflush(log_file);
+}
+
+static void *ofi_log_async_handler(void *arg)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&log_async_lock);
+	while (log_async_run) {
+		ofi_log_async_drain();
+
+		/* The condition uses the default, realtime, clock */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += OFI_LOG_FLUSH_MS * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		if (log_async_run)
+			pthread_cond_timedwait(&log_async_cond,
+					       &log_async_lock, &ts);
+	}
+	ofi_log_async_drain();
+	pthread_mutex_unlock(&log_async_lock);
+	return NULL;
+}
+
+static int ofi_log_async_start(void)
+{
+	int ret;
+
+	log_async_size = roundup_power_of_two(MAX(log_async_size,
+					      4 * OFI_LOG_MSG_MAX));
+
+	ret = pthread_key_create(&log_async_key, ofi_log_ring_orphan);
+	if (ret)
+		return -ret;
+
+	dlist_init(&log_async_rings);
+	log_async_gen++;
+	log_async_run = 1;
+	ret = pthread_create(&log_async_thread, NULL, ofi_log_async_handler,
+			     NULL);
+	if (ret) {
+		log_async_run = 0;
+		pthread_key_delete(log_async_key);
+		return -ret;
+	}
+	return 0;
+}
+
+/*
+ * Bumping the generation sends threads that log after this point to
+ * ofi_log_ring_get, which no longer hands out a ring once the log thread
+ * is stopped.  A thread may still be writing to the ring it already holds,
+ * so only rings whose thread has exited, and the caller's own ring, are
+ * freed.  Rings of other live threads are left allocated, and anything
+ * they log from here on is lost.
+ */
+static void ofi_log_async_stop(void)
+{
+	struct ofi_log_ring *ring;
+	struct dlist_entry *tmp;
+
+	pthread_mutex_lock(&log_async_lock);
+	log_async_run = 0;
+	log_async_gen++;
+	pthread_cond_signal(&log_async_cond);
+	pthread_mutex_unlock(&log_async_lock);
+	pthread_join(log_async_thread, NULL);
+
+	dlist_foreach_container_safe(&log_async_rings, struct ofi_log_ring,
+				     ring, entry, tmp) {
+		if (ring != log_ring && !ofi_atomic_get32(&ring->orphan))
+			continue;
+		dlist_remove(&ring->entry);
+		free(ring);
+	}
+	log_ring = NULL;
+	pthread_key_delete(log_async_key);
+}
+
+#else /* _WIN32 */
+
+static int ofi_log_async_start(void)
+{
+	return -FI_ENOSYS;
+}
+
+static void ofi_log_async_stop(void)
+{
+}
+
+static void ofi_log_async(const struct fi_provider *prov,
+			  enum fi_log_level level, enum fi_log_subsys subsys,
+			  const char *func, int line, const char *msg)
+{
+	ofi_log(prov, level, subsys, func, line, msg);
+}
+
+static void ofi_log_async_vlog(const struct fi_provider *prov,
+			       enum fi_log_level level,
+			       enum fi_log_subsys subsys, const char *func,
+			       int line, const char *fmt, va_list args)
+{
+	char msg[1024];
+
+	vsnprintf(msg, sizeof(msg), fmt, args);
+	ofi_log(prov, level, subsys, func, line, msg);
+}
+
+#endif /* _WIN32 */
+
+static void ofi_log_open_file(void)
+{
+	char *path = NULL, *name;
+
+	log_file = stderr;
+	fi_param_get_str(NULL, "log_file", &path);
+	if (!path || asprintf(&name, "%s.%d", path, pid) < 0)
+		return;
+
+	log_file = fopen(name, "a");
+	if (!log_file) {
+		fprintf(stderr, "%s: unable to open log file %s: %s\n",
+			PACKAGE, name, strerror(errno));
+		log_file = stderr;
+	}
+	free(name);
+}
+
 void fi_log_init(void)
 {
 	struct fi_filter subsys_filter;
 	int level, i;
 	char *levelstr = NULL, *provstr = NULL, *subsysstr = NULL;
 
+	/* Parameters defined below are logged at debug level */
+	log_file = stderr;
 	fi_param_define(NULL, "log_interval", FI_PARAM_INT,
 			"Delay in ms between rate limited log messages "
 			"(default 2000)");
@@ -136,6 +639,39 @@ void fi_log_init(void)
 	}
 	ofi_free_filter(&subsys_filter);
 	pid = getpid();
+
+	fi_param_define(NULL, "log_file", FI_PARAM_STRING,
+			"Write log messages to this file instead of stderr.  "
+			"The process id is appended to the name.");
+	ofi_log_open_file();
+
+	fi_param_define(NULL, "log_rate", FI_PARAM_INT,
+			"With log_async, the maximum number of messages "
+			"logged by a thread from one call site every "
+			"log_interval ms.  The number of messages suppressed "
+			"is reported.  0 is unlimited (default: 0)");
+	fi_param_get_int(NULL, "log_rate", &log_rate);
+	if (log_rate < 0)
+		log_rate = 0;
+
+	fi_param_define(NULL, "log_async", FI_PARAM_BOOL,
+			"Buffer log messages per thread and write them from a "
+			"background thread.  Messages are timestamped in ns "
+			"and dropped if the buffer is full (default: no)");
+	fi_param_define(NULL, "log_async_size", FI_PARAM_SIZE_T,
+			"Size in bytes of the per thread log buffer "
+			"(default: %zu)", log_async_size);
+	fi_param_get_bool(NULL, "log_async", &log_async);
+	fi_param_get_size_t(NULL, "log_async_size", &log_async_size);
+	if (log_async && log_mask & FI_LOG_LEVEL_MASK) {
+		if (!ofi_log_async_start())
+			ofi_log_default = ofi_log_async;
+		else
+			log_async = 0;
+	} else {
+		log_async = 0;
+	}
+	ofi_import_log_ops.log = ofi_log_default;
 }
 
 static int ofi_log_enabled(const struct fi_provider *prov,
@@ -152,7 +688,7 @@ static void ofi_log(const struct fi_provider *prov, enum fi_log_level level,
 		    enum fi_log_subsys subsys, const char *func, int line,
 		    const char *msg)
 {
-	fprintf(stderr, "%s:%d:%ld:%s:%s:%s:%s():%d<%s> %s",
+	fprintf(log_file, "%s:%d:%ld:%s:%s:%s:%s():%d<%s> %s",
 		PACKAGE, pid, (unsigned long) time(NULL), log_prefix,
 		prov->name, log_subsys[subsys], func, line,
 		log_levels[level], msg);
@@ -201,7 +737,7 @@ static int ofi_close_import(struct fid *fid)
 	pthread_mutex_lock(&common_locks.ini_lock);
 	log_fid.ops->enabled = ofi_log_enabled;
 	log_fid.ops->ready = ofi_log_ready;
-	log_fid.ops->log = ofi_log;
+	log_fid.ops->log = ofi_log_default;
 	pthread_mutex_unlock(&common_locks.ini_lock);
 	return 0;
 }
@@ -281,7 +817,7 @@ int ofi_open_log(uint32_t version, void *attr, size_t attr_len,
 	pthread_mutex_lock(&common_locks.ini_lock);
 	if (log_fid.ops->enabled != ofi_log_enabled ||
 	    log_fid.ops->ready != ofi_log_ready ||
-	    log_fid.ops->log != ofi_log) {
+	    log_fid.ops->log != ofi_log_default) {
 		ret = -FI_EALREADY;
 		goto unlock;
 	}
@@ -311,8 +847,20 @@ void ofi_tostr_log_subsys(char *buf, size_t len, enum fi_log_subsys subsys)
 	ofi_strncatf(buf, len, log_subsys[subsys]);
 }
 
+/* Called by fi_fini with ini_lock held */
 void fi_log_fini(void)
 {
+	if (log_async) {
+		if (log_fid.ops->log == ofi_log_async)
+			log_fid.ops->log = ofi_log;
+		ofi_log_default = ofi_log;
+		ofi_log_async_stop();
+		log_async = 0;
+	}
+	if (log_file && log_file != stderr) {
+		fclose(log_file);
+		log_file = stderr;
+	}
 	ofi_free_filter(&prov_log_filter);
 }
 
@@ -358,6 +906,12 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 	va_list vargs;
 
 	va_start(vargs, fmt);
+	/* Format directly into the thread's log buffer */
+	if (log_fid.ops->log == ofi_log_async) {
+		ofi_log_async_vlog(prov, level, subsys, func, line, fmt, vargs);
+		va_end(vargs);
+		return;
+	}
 	vsnprintf(msg + size, sizeof(msg) - size, fmt, vargs);
 	va_end(vargs);
 
@@ -55,6 +55,13 @@ void ofi_perf_init(void)
 	fi_param_define(NULL, "perf_cntr", FI_PARAM_STRING,
 			"Performance counter to analyze (default: cpu_instr). "
 			"Options: cpu_instr, cpu_cycles.");
+#if ENABLE_PROBES
+	fi_param_define(NULL, "probe_file", FI_PARAM_STRING,
+			"Append provider probe counts to this file, with the "
+			"process id added to the name, when the library is "
+			"unloaded.  Display them using fi_probe.");
+#endif
+
 	fi_param_get_str(NULL, "perf_cntr", &param_val);
 	if (!param_val)
 		return;
@@ -96,7 +103,7 @@ void ofi_perfset_close(struct ofi_perfset *set)
 	free(set->data);
 }
 
-static const char *ofi_perf_name(void)
+const char *ofi_perf_name(void)
 {
 	switch (perf_domain) {
 	case OFI_PMU_CPU:
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#if ENABLE_PROBES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <ofi.h>
+#include <ofi_probe.h>
+
+/*
+ * This file is built into libfabric and into each provider built as a
+ * separate library.  Every copy keeps its own list of threads and appends
+ * its own section to the probe file.
+ */
+
+__thread struct ofi_probe_thread *ofi_probe_self;
+
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ofi_probe_thread *probe_threads;
+static struct ofi_probe_thread probe_overflow;
+static uint32_t probe_thread_cnt;
+static char *probe_file;
+static int probe_ready;
+static int probe_pmu_failed;
+static int probe_overflow_used;
+
+static const char *probe_names[] = {
+	OFI_PROBE_FOREACH(OFI_PROBE_STR)
+};
+
+
+struct ofi_probe_thread *ofi_probe_register(void)
+{
+	struct ofi_probe_thread *thread;
+	char *path = NULL;
+
+	thread = calloc(1, sizeof(*thread));
+
+	pthread_mutex_lock(&probe_lock);
+	if (!probe_ready) {
+		fi_param_get_str(NULL, "probe_file", &path);
+		if (path)
+			probe_file = strdup(path);
+		probe_ready = 1;
+	}
+
+	/* Threads that cannot allocate their own counters share one set */
+	if (!thread) {
+		thread = &probe_overflow;
+		thread->id = UINT32_MAX;
+		probe_overflow_used = 1;
+		goto unlock;
+	}
+
+	/* Do not retry the PMU on every thread once it has failed */
+	if (!probe_pmu_failed &&
+	    ofi_pmu_open(&thread->ctx, OFI_PMU_CPU, OFI_PMC_CPU_CYCLES, 0))
+		probe_pmu_failed = 1;
+
+	thread->id = probe_thread_cnt++;
+	thread->next = probe_threads;
+	probe_threads = thread;
+unlock:
+	pthread_mutex_unlock(&probe_lock);
+	return thread;
+}
+
+static void probe_write(FILE *out, struct ofi_probe_thread *thread)
+{
+	struct ofi_probe_data *data;
+	int i;
+
+	fprintf(out, "thread %" PRIu32 " %s\n", thread->id,
+		thread->ctx ? "cycles" : "ns");
+
+	for (i = 0; i < ofi_probe_max; i++) {
+		data = &thread->data[i];
+		if (!data->events)
+			continue;
+
+		fprintf(out, "%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+			"\n", probe_names[i], data->events, data->sum,
+			data->min, data->max);
+	}
+}
+
+/* Threads may still be running, so their counters are read unlocked and
+ * are not freed.
+ */
+FI_DESTRUCTOR(ofi_probe_fini(void))
+{
+	struct ofi_probe_thread *thread;
+	char *path;
+	FILE *out;
+
+	pthread_mutex_lock(&probe_lock);
+	if (!probe_file || asprintf(&path, "%s.%d", probe_file, getpid()) < 0)
+		goto unlock;
+
+	out = fopen(path, "a");
+	free(path);
+	if (!out)
+		goto unlock;
+
+	fprintf(out, "ofi_probe %d pid %d threads %" PRIu32 "\n",
+		OFI_PROBE_FILE_VERSION, getpid(), probe_thread_cnt);
+	for (thread = probe_threads; thread; thread = thread->next)
+		probe_write(out, thread);
+	if (probe_overflow_used)
+		probe_write(out, &probe_overflow);
+	fclose(out);
+unlock:
+	free(probe_file);
+	probe_file = NULL;
+	pthread_mutex_unlock(&probe_lock);
+}
+
+#endif /* ENABLE_PROBES */
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "ofi.h"
+#include "ofi_mem.h"
+
+/* Measures the libfabric copy engine.  Each test gathers size bytes from
+ * iov_cnt segments, separated by a gap so they are not contiguous, into a
+ * single buffer with ofi_copy_batch.  Buffers are rotated through a pool
+ * larger than the cache unless -w is given.  With -p, each copy is also
+ * split across the given numbers of copy pool helper threads.
+ */
+
+#define BENCH_GAP		64
+#define BENCH_POOL		(256 * 1024 * 1024)
+#define BENCH_MIN_NS		200000000ULL
+
+static const char *engines[] = { "memcpy", "sse2", "avx2", "avx512" };
+static size_t sizes[64] = { 256, 4096, 65536, 262144, 1048576, 4194304,
+			    16777216, 67108864 };
+static size_t size_cnt = 8;
+static size_t iov_cnts[16] = { 1, 4, 16, 64 };
+static size_t iov_cnt_cnt = 4;
+static size_t thread_cnts[16];
+static size_t thread_cnt_cnt;
+static size_t nt_size;
+static int warm;
+
+struct bench_copy {
+	struct ofi_copy_vec	*vec;
+	size_t			iov_cnt;
+};
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("\n");
+	printf("Measures the bandwidth of the libfabric memory copy engine.\n");
+	printf("\n");
+	printf("  -e ENGINE  only test the given engine: memcpy, sse2, avx2 "
+	       "or avx512\n");
+	printf("  -s SIZES   comma separated copy sizes in bytes\n");
+	printf("  -n COUNTS  comma separated iov counts\n");
+	printf("  -t BYTES   use non-temporal stores from this size "
+	       "(default: the L2 cache size)\n");
+	printf("  -w         reuse the same buffers, so they stay in cache\n");
+	printf("  -p COUNTS  comma separated copy pool helper thread counts\n");
+}
+
+static size_t parse_list(char *str, size_t *list, size_t max)
+{
+	char *tok, *save;
+	size_t cnt = 0;
+
+	for (tok = strtok_r(str, ",", &save); tok && cnt < max;
+	     tok = strtok_r(NULL, ",", &save))
+		list[cnt++] = strtoull(tok, NULL, 0);
+	return cnt;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void build_vec(struct ofi_copy_vec *vec, size_t iov_cnt, size_t size,
+		      char *src, char *dst)
+{
+	size_t i, seg;
+
+	for (i = 0; i < iov_cnt; i++) {
+		seg = size / iov_cnt + (i < size % iov_cnt);
+		vec[i].src = src;
+		vec[i].dst = dst;
+		vec[i].len = seg;
+		src += seg + BENCH_GAP;
+		dst += seg;
+	}
+}
+
+/* Copies bytes [offset, offset + len) of the gathered vector */
+static int bench_chunk(void *arg, size_t offset, size_t len)
+{
+	struct bench_copy *copy = arg;
+	struct ofi_copy_vec chunk[64];
+	size_t i, cnt = 0;
+
+	for (i = 0; i < copy->iov_cnt && len; i++) {
+		if (offset >= copy->vec[i].len) {
+			offset -= copy->vec[i].len;
+			continue;
+		}
+		chunk[cnt].src = (const char *) copy->vec[i].src + offset;
+		chunk[cnt].dst = (char *) copy->vec[i].dst + offset;
+		chunk[cnt].len = MIN(copy->vec[i].len - offset, len);
+		len -= chunk[cnt].len;
+		offset = 0;
+		if (++cnt == ARRAY_SIZE(chunk)) {
+			ofi_copy_batch(chunk, cnt);
+			cnt = 0;
+		}
+	}
+	ofi_copy_batch(chunk, cnt);
+	return 0;
+}
+
+static void bench_copy(struct ofi_copy_pool *pool, struct ofi_copy_vec *vec,
+		       size_t iov_cnt, size_t size)
+{
+	struct bench_copy copy = { vec, iov_cnt };
+
+	if (pool)
+		(void) ofi_copy_pool_run(pool, size, bench_chunk, &copy);
+	else
+		ofi_copy_batch(vec, iov_cnt);
+}
+
+static int run_test(struct ofi_copy_pool *pool, size_t threads, size_t size,
+		    size_t iov_cnt, char *src, char *dst)
+{
+	struct ofi_copy_vec *vec;
+	size_t span, slots, slot = 0, i;
+	uint64_t start, elapsed, iters = 0;
+
+	vec = calloc(iov_cnt, sizeof(*vec));
+	if (!vec)
+		return -1;
+
+	span = size + iov_cnt * BENCH_GAP;
+	slots = warm ? 1 : MAX(BENCH_POOL / span, 1);
+
+	/* Check the copy once before timing it */
+	for (i = 0; i < span; i++)
+		src[i] = (char) (i * 7 + 1);
+	memset(dst, 0, size);
+	build_vec(vec, iov_cnt, size, src, dst);
+	bench_copy(pool, vec, iov_cnt, size);
+	for (i = 0; i < iov_cnt; i++) {
+		if (memcmp(vec[i].dst, vec[i].src, vec[i].len)) {
+			fprintf(stderr, "data mismatch, size %zu iovs %zu\n",
+				size, iov_cnt);
+			free(vec);
+			return -1;
+		}
+	}
+
+	start = now_ns();
+	do {
+		build_vec(vec, iov_cnt, size, src + slot * span,
+			  dst + slot * size);
+		bench_copy(pool, vec, iov_cnt, size);
+		slot = (slot + 1) % slots;
+		iters++;
+		elapsed = now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+
+	printf("%-8s %8zu %12zu %6zu %10" PRIu64 " %12.2f %10.2f\n",
+	       ofi_copy_engine_name, threads, size, iov_cnt, iters,
+	       (double) elapsed / iters / 1000.0,
+	       (double) size * iters / elapsed);
+	free(vec);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *engine = NULL;
+	struct ofi_copy_pool *pool;
+	size_t i, j, k, t, max_size = 0, max_iovs = 0;
+	char *src, *dst;
+	int op, ret = EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "e:s:n:t:wp:h")) != -1) {
+		switch (op) {
+		case 'e':
+			engine = optarg;
+			break;
+		case 's':
+			size_cnt = parse_list(optarg, sizes, ARRAY_SIZE(sizes));
+			break;
+		case 'n':
+			iov_cnt_cnt = parse_list(optarg, iov_cnts,
+						 ARRAY_SIZE(iov_cnts));
+			break;
+		case 't':
+			nt_size = strtoull(optarg, NULL, 0);
+			break;
+		case 'w':
+			warm = 1;
+			break;
+		case 'p':
+			thread_cnt_cnt = parse_list(optarg, thread_cnts,
+						    ARRAY_SIZE(thread_cnts));
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < size_cnt; i++)
+		max_size = MAX(max_size, sizes[i]);
+	for (i = 0; i < iov_cnt_cnt; i++) {
+		if (!iov_cnts[i]) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		max_iovs = MAX(max_iovs, iov_cnts[i]);
+	}
+
+	src = malloc(MAX(BENCH_POOL, max_size) + max_iovs * BENCH_GAP);
+	dst = malloc(MAX(BENCH_POOL, max_size));
+	if (!src || !dst) {
+		fprintf(stderr, "unable to allocate buffers\n");
+		goto out;
+	}
+	memset(src, 1, MAX(BENCH_POOL, max_size) + max_iovs * BENCH_GAP);
+	memset(dst, 0, MAX(BENCH_POOL, max_size));
+
+	if (!thread_cnt_cnt)
+		thread_cnt_cnt = 1;
+
+	printf("%-8s %8s %12s %6s %10s %12s %10s\n", "engine", "threads",
+	       "bytes", "iovs", "iters", "usec/copy", "GB/sec");
+	for (i = 0; i < ARRAY_SIZE(engines); i++) {
+		if (engine && strcasecmp(engine, engines[i]))
+			continue;
+
+		if (ofi_copy_select(engines[i], nt_size)) {
+			if (engine)
+				fprintf(stderr, "%s is not supported\n",
+					engine);
+			continue;
+		}
+
+		for (t = 0; t < thread_cnt_cnt; t++) {
+			pool = NULL;
+			if (thread_cnts[t] &&
+			    ofi_copy_pool_open(thread_cnts[t], &pool)) {
+				fprintf(stderr, "unable to start %zu threads\n",
+					thread_cnts[t]);
+				goto out;
+			}
+
+			for (j = 0; j < size_cnt; j++) {
+				for (k = 0; k < iov_cnt_cnt; k++) {
+					if (iov_cnts[k] > sizes[j])
+						continue;
+					if (run_test(pool, thread_cnts[t],
+						     sizes[j], iov_cnts[k],
+						     src, dst)) {
+						if (pool)
+							ofi_copy_pool_close(pool);
+						goto out;
+					}
+				}
+			}
+			if (pool)
+				ofi_copy_pool_close(pool);
+		}
+	}
+	ret = EXIT_SUCCESS;
+out:
+	free(src);
+	free(dst);
+	return ret;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ofi_probe.h"
+
+/* Displays the probe counts written by libfabric (FI_PROBE_FILE) when it
+ * was built with --enable-probes.
+ */
+
+struct probe_stat {
+	char		name[64];
+	char		units[16];
+	uint32_t	pid;
+	uint32_t	thread;
+	uint64_t	events;
+	uint64_t	sum;
+	uint64_t	min;
+	uint64_t	max;
+};
+
+static struct probe_stat *stats;
+static size_t stat_cnt, stat_size;
+
+static int per_thread;
+static const char *stage_filter;
+
+static const char *stage_names[] = {
+	OFI_PROBE_FOREACH(OFI_PROBE_STR)
+};
+
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [OPTIONS] PROBE_FILE...\n", argv0);
+	printf("       %s -l\n", argv0);
+	printf("\n");
+	printf("Displays provider probe counts written by libfabric "
+	       "(FI_PROBE_FILE).\n");
+	printf("Counts from all files and threads are combined unless -t "
+	       "is given.\n");
+	printf("\n");
+	printf("  -s STAGE  only display the given stage\n");
+	printf("  -t        display each process and thread separately\n");
+	printf("  -l        list the stages known to this build\n");
+}
+
+static struct probe_stat *find_stat(const char *name, const char *units,
+				    uint32_t pid, uint32_t thread)
+{
+	struct probe_stat *stat;
+	size_t i;
+
+	if (!per_thread)
+		pid = thread = 0;
+
+	for (i = 0; i < stat_cnt; i++) {
+		stat = &stats[i];
+		if (!strcmp(stat->name, name) && !strcmp(stat->units, units) &&
+		    stat->pid == pid && stat->thread == thread)
+			return stat;
+	}
+
+	if (stat_cnt == stat_size) {
+		stat_size = stat_size ? stat_size * 2 : 64;
+		stats = realloc(stats, stat_size * sizeof(*stats));
+		if (!stats)
+			return NULL;
+	}
+
+	stat = &stats[stat_cnt++];
+	memset(stat, 0, sizeof(*stat));
+	snprintf(stat->name, sizeof(stat->name), "%s", name);
+	snprintf(stat->units, sizeof(stat->units), "%s", units);
+	stat->pid = pid;
+	stat->thread = thread;
+	return stat;
+}
+
+static int read_file(const char *path)
+{
+	struct probe_stat *stat;
+	char line[256], name[64], units[16] = "";
+	uint64_t events, sum, min, max;
+	uint32_t pid = 0, thread = 0;
+	int version, lineno = 0;
+	FILE *in;
+
+	in = fopen(path, "r");
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof line, in)) {
+		lineno++;
+		if (sscanf(line, "ofi_probe %d pid %" SCNu32, &version,
+			   &pid) == 2) {
+			if (version != OFI_PROBE_FILE_VERSION) {
+				fprintf(stderr, "%s:%d: unsupported version "
+					"%d\n", path, lineno, version);
+				goto err;
+			}
+			continue;
+		}
+
+		if (sscanf(line, "thread %" SCNu32 " %15s", &thread,
+			   units) == 2)
+			continue;
+
+		if (sscanf(line, "%63s %" SCNu64 " %" SCNu64 " %" SCNu64
+			   " %" SCNu64, name, &events, &sum, &min, &max) != 5 ||
+		    !units[0]) {
+			fprintf(stderr, "%s:%d: not a probe file\n", path,
+				lineno);
+			goto err;
+		}
+
+		if (!events || (stage_filter && strcmp(stage_filter, name)))
+			continue;
+
+		stat = find_stat(name, units, pid, thread);
+		if (!stat) {
+			fprintf(stderr, "out of memory\n");
+			goto err;
+		}
+
+		if (!stat->events || min < stat->min)
+			stat->min = min;
+		if (max > stat->max)
+			stat->max = max;
+		stat->events += events;
+		stat->sum += sum;
+	}
+
+	fclose(in);
+	return 0;
+err:
+	fclose(in);
+	return -1;
+}
+
+/* Unknown stages, from another build, sort after the known ones */
+static int stage_index(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ofi_probe_max; i++) {
+		if (!strcmp(stage_names[i], name))
+			break;
+	}
+	return i;
+}
+
+static int stat_cmp(const void *a, const void *b)
+{
+	const struct probe_stat *sa = a, *sb = b;
+	int ret;
+
+	if (sa->pid != sb->pid)
+		return sa->pid < sb->pid ? -1 : 1;
+	if (sa->thread != sb->thread)
+		return sa->thread < sb->thread ? -1 : 1;
+
+	ret = stage_index(sa->name) - stage_index(sb->name);
+	if (!ret)
+		ret = strcmp(sa->name, sb->name);
+	return ret ? ret : strcmp(sa->units, sb->units);
+}
+
+static void print_stats(void)
+{
+	struct probe_stat *stat, *prev = NULL;
+	const char *indent = per_thread ? "    " : "";
+	size_t i;
+
+	qsort(stats, stat_cnt, sizeof(*stats), stat_cmp);
+
+	for (i = 0; i < stat_cnt; prev = stat, i++) {
+		stat = &stats[i];
+		if (per_thread && (!prev || stat->pid != prev->pid ||
+				   stat->thread != prev->thread)) {
+			printf("pid: %" PRIu32 "\n", stat->pid);
+			printf("thread: %" PRIu32 "\n", stat->thread);
+		}
+
+		printf("%sstage: %s\n", indent, stat->name);
+		printf("%s    units: %s\n", indent, stat->units);
+		printf("%s    events: %" PRIu64 "\n", indent, stat->events);
+		printf("%s    avg: %.1f\n", indent,
+		       (double) stat->sum / stat->events);
+		printf("%s    min: %" PRIu64 "\n", indent, stat->min);
+		printf("%s    max: %" PRIu64 "\n", indent, stat->max);
+		printf("%s    total: %" PRIu64 "\n", indent, stat->sum);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int i, op, list = 0, ret = EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "s:tlh")) != -1) {
+		switch (op) {
+		case 's':
+			stage_filter = optarg;
+			break;
+		case 't':
+			per_thread = 1;
+			break;
+		case 'l':
+			list = 1;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (list) {
+		if (!ENABLE_PROBES)
+			printf("# probes are not enabled in this build\n");
+		for (i = 0; i < ofi_probe_max; i++)
+			printf("%s\n", stage_names[i]);
+		return EXIT_SUCCESS;
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = optind; i < argc; i++) {
+		if (read_file(argv[i]))
+			goto out;
+	}
+
+	print_stats();
+	ret = EXIT_SUCCESS;
+out:
+	free(stats);
+	return ret;
+}
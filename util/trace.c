@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2026 agent <agent@local>. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ofi_trace.h"
+
+/* Converts perf hook trace files to the Chrome trace event JSON format,
+ * which can be loaded by Perfetto (ui.perfetto.dev) or chrome://tracing.
+ */
+
+struct trace_file {
+	struct ofi_trace_hdr	hdr;
+	char			**names;
+	char			*name_buf;
+};
+
+struct trace_rec {
+	struct ofi_trace_rec	rec;
+	struct trace_file	*file;
+};
+
+/* Maps an outstanding (pid, context) pair to the flow that posted it */
+struct trace_flow {
+	uint64_t		context;
+	uint32_t		pid;
+	uint64_t		id;
+};
+
+static struct trace_rec *recs;
+static size_t rec_cnt, rec_size;
+
+static struct trace_flow *flows;
+static size_t flow_mask;
+
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [-o OUTPUT] TRACE_FILE...\n", argv0);
+	printf("\n");
+	printf("Converts trace files written by the perf hook "
+	       "(FI_PERF_TRACE_FILE)\n");
+	printf("to Chrome trace event JSON, viewable with Perfetto or "
+	       "chrome://tracing.\n");
+	printf("Files from several processes are merged into one trace.\n");
+	printf("\n");
+	printf("  -o OUTPUT  write JSON to OUTPUT instead of stdout\n");
+}
+
+static int read_file(const char *path, struct trace_file *file)
+{
+	struct ofi_trace_rec rec;
+	struct trace_rec *tmp;
+	size_t i, off, size;
+	FILE *in;
+
+	in = fopen(path, "rb");
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+
+	if (fread(&file->hdr, sizeof file->hdr, 1, in) != 1 ||
+	    memcmp(file->hdr.magic, OFI_TRACE_MAGIC, sizeof file->hdr.magic) ||
+	    file->hdr.version != OFI_TRACE_VERSION) {
+		fprintf(stderr, "%s: not a libfabric trace file\n", path);
+		goto err;
+	}
+
+	file->name_buf = calloc(1, file->hdr.name_len + 1);
+	file->names = calloc(file->hdr.name_cnt, sizeof(*file->names));
+	if (!file->name_buf || !file->names ||
+	    fread(file->name_buf, file->hdr.name_len, 1, in) != 1) {
+		fprintf(stderr, "%s: truncated header\n", path);
+		goto err;
+	}
+
+	for (i = 0, off = 0; i < file->hdr.name_cnt; i++) {
+		if (off >= file->hdr.name_len) {
+			fprintf(stderr, "%s: corrupt name table\n", path);
+			goto err;
+		}
+		file->names[i] = &file->name_buf[off];
+		off += strlen(file->names[i]) + 1;
+	}
+
+	/* A partial record at the end means the writer did not close cleanly */
+	while (fread(&rec, sizeof rec, 1, in) == 1) {
+		if (rec_cnt == rec_size) {
+			size = rec_size ? rec_size * 2 : 4096;
+			tmp = realloc(recs, size * sizeof(*recs));
+			if (!tmp) {
+				fprintf(stderr, "out of memory\n");
+				goto err;
+			}
+			recs = tmp;
+			rec_size = size;
+		}
+		recs[rec_cnt].rec = rec;
+		recs[rec_cnt].file = file;
+		rec_cnt++;
+	}
+
+	fclose(in);
+	return 0;
+err:
+	fclose(in);
+	return -1;
+}
+
+static int rec_cmp(const void *a, const void *b)
+{
+	const struct trace_rec *ra = a, *rb = b;
+
+	if (ra->rec.start != rb->rec.start)
+		return ra->rec.start < rb->rec.start ? -1 : 1;
+	return 0;
+}
+
+static struct trace_flow *flow_find(uint32_t pid, uint64_t context)
+{
+	size_t slot;
+
+	slot = (size_t) ((context * 0x9E3779B97F4A7C15ULL) ^ pid) & flow_mask;
+	while (flows[slot].context &&
+	       (flows[slot].context != context || flows[slot].pid != pid))
+		slot = (slot + 1) & flow_mask;
+	return &flows[slot];
+}
+
+/* Removal with linear probing: reinsert the rest of the cluster */
+static void flow_remove(struct trace_flow *flow)
+{
+	struct trace_flow tmp, *dst;
+	size_t slot;
+
+	flow->context = 0;
+	slot = ((size_t) (flow - flows) + 1) & flow_mask;
+	while (flows[slot].context) {
+		tmp = flows[slot];
+		flows[slot].context = 0;
+		dst = flow_find(tmp.pid, tmp.context);
+		*dst = tmp;
+		slot = (slot + 1) & flow_mask;
+	}
+}
+
+static const char *rec_name(const struct trace_rec *r)
+{
+	if (r->rec.name < r->file->hdr.name_cnt)
+		return r->file->names[r->rec.name];
+	return "unknown";
+}
+
+static void write_json(FILE *out)
+{
+	const struct ofi_trace_rec *rec;
+	struct trace_flow *flow;
+	uint64_t t0, next_id = 1;
+	double ts, dur;
+	uint32_t pid;
+	size_t i;
+
+	t0 = rec_cnt ? recs[0].rec.start : 0;
+	fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+	for (i = 0; i < rec_cnt; i++) {
+		rec = &recs[i].rec;
+		pid = recs[i].file->hdr.pid;
+		ts = (double) (rec->start - t0) / 1000.0;
+		dur = (double) (rec->end - rec->start) / 1000.0;
+
+		if (rec->event == OFI_TRACE_POST) {
+			fprintf(out, "{\"name\": \"%s\", \"cat\": \"post\", "
+				"\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+				"\"pid\": %" PRIu32 ", \"tid\": %" PRIu32 ", "
+				"\"args\": {\"context\": \"0x%" PRIx64 "\", "
+				"\"len\": %" PRIu64 ", \"addr\": %" PRIu64 ", "
+				"\"ret\": %" PRId32 "}},\n", rec_name(&recs[i]),
+				ts, dur, pid, rec->tid, rec->context,
+				rec->len, rec->addr, rec->ret);
+
+			if (rec->ret || !rec->context)
+				continue;
+
+			flow = flow_find(pid, rec->context);
+			flow->context = rec->context;
+			flow->pid = pid;
+			flow->id = next_id++;
+			fprintf(out, "{\"name\": \"xfer\", \"cat\": \"xfer\", "
+				"\"ph\": \"s\", \"id\": %" PRIu64 ", "
+				"\"ts\": %.3f, \"pid\": %" PRIu32 ", "
+				"\"tid\": %" PRIu32 "},\n", flow->id, ts, pid,
+				rec->tid);
+			continue;
+		}
+
+		/* Give completions a width so flow arrows can bind to them */
+		fprintf(out, "{\"name\": \"%s\", \"cat\": \"completion\", "
+			"\"ph\": \"X\", \"ts\": %.3f, \"dur\": 0.001, "
+			"\"pid\": %" PRIu32 ", \"tid\": %" PRIu32 ", "
+			"\"args\": {\"context\": \"0x%" PRIx64 "\", "
+			"\"len\": %" PRIu64 ", \"flags\": \"0x%" PRIx64 "\", "
+			"\"err\": %" PRId32 ", \"cq\": \"%s\"}},\n",
+			rec->event == OFI_TRACE_COMP_ERR ? "error" : "completion",
+			ts, pid, rec->tid, rec->context, rec->len, rec->flags,
+			-rec->ret, rec_name(&recs[i]));
+
+		if (!rec->context)
+			continue;
+
+		flow = flow_find(pid, rec->context);
+		if (!flow->context)
+			continue;
+
+		fprintf(out, "{\"name\": \"xfer\", \"cat\": \"xfer\", "
+			"\"ph\": \"f\", \"bp\": \"e\", \"id\": %" PRIu64 ", "
+			"\"ts\": %.3f, \"pid\": %" PRIu32 ", \"tid\": %" PRIu32
+			"},\n", flow->id, ts, pid, rec->tid);
+		flow_remove(flow);
+	}
+
+	/* Trailing metadata event avoids special casing the last comma */
+	fprintf(out, "{\"name\": \"trace_info\", \"ph\": \"M\", \"pid\": 0, "
+		"\"args\": {\"records\": %zu}}\n]}\n", rec_cnt);
+}
+
+int main(int argc, char *argv[])
+{
+	struct trace_file *files;
+	const char *output = NULL;
+	FILE *out = stdout;
+	int i, op, ret = EXIT_FAILURE;
+
+	while ((op = getopt(argc, argv, "o:h")) != -1) {
+		switch (op) {
+		case 'o':
+			output = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	files = calloc(argc - optind, sizeof(*files));
+	if (!files)
+		return EXIT_FAILURE;
+
+	for (i = optind; i < argc; i++) {
+		if (read_file(argv[i], &files[i - optind]))
+			goto out;
+	}
+
+	qsort(recs, rec_cnt, sizeof(*recs), rec_cmp);
+
+	for (flow_mask = 1024; flow_mask < rec_cnt * 2; flow_mask <<= 1)
+		;
+	flows = calloc(flow_mask, sizeof(*flows));
+	if (!flows)
+		goto out;
+	flow_mask--;
+
+	if (output) {
+		out = fopen(output, "w");
+		if (!out) {
+			perror(output);
+			goto out;
+		}
+	}
+
+	write_json(out);
+	if (output)
+		fclose(out);
+	ret = EXIT_SUCCESS;
+out:
+	for (i = 0; i < argc - optind; i++) {
+		free(files[i].names);
+		free(files[i].name_buf);
+	}
+	free(files);
+	free(flows);
+	free(recs);
+	return ret;
+}